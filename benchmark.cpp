@@ -0,0 +1,2212 @@
+/*
+benchmark
+
+headless benchmarks for the CPU side of the application (no window or OpenGL context is created).
+Usage: benchmark [name of a benchmark group] [--json file], without a group all the groups are executed. With --json
+the timed results are also written to the file (see util3d/benchmark.h).
+
+Real-Time Graphics Programming - a.a. 2023/2024
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <deque>
+#include <thread>
+#include <array>
+#include <unordered_map>
+#include <set>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <utils/physics.h>
+
+#include "util3d/entities.h"
+#include "util3d/geometry.h"
+#include "util3d/collision_proxy.h"
+#include "util3d/occlusion.h"
+#include "util3d/bvh.h"
+#include "util3d/probes.h"
+#include "util3d/light_assignment.h"
+#include "util3d/lod.h"
+#include "util3d/dynamic_resolution.h"
+#include "util3d/latency.h"
+#include "util3d/frame_pacer.h"
+#include "util3d/frame_graph.h"
+#include "util3d/range_allocator.h"
+#include "util3d/procedural.h"
+#include "util3d/light_flicker.h"
+#include "util3d/camera_path.h"
+#include "util3d/benchmark.h"
+
+// all Bullet allocations go through the pool of util3d/physics_pool.h, also here, so the counters are comparable
+bool physicsAllocatorInstalled = installPhysicsAllocator();
+
+//////////////////////////////////////////
+// entity storage: packed component arrays vs the previous layout
+// (std::vector of raw btRigidBody pointers for the bullets, and per-frame matrices for the splats)
+
+struct SphereData {
+    btRigidBody *body;
+};
+
+struct SplatData {
+    glm::vec3 pos;
+    glm::mat4 rot;
+};
+
+void benchEntities(size_t count) {
+    const int frames = 20;
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+    std::uniform_int_distribution<size_t> junkSize(16, 512);
+
+    Physics physics;
+    EntityWorld world;
+    world.bullets.reserve(count);
+    world.splats.reserve(count);
+
+    std::vector<SphereData> spheres;
+    std::vector<SplatData> splats;
+    // allocations of other sizes interleaved with the bodies, to obtain a heap layout similar to a long session
+    std::vector<std::vector<char>> junk;
+
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 pos(coord(generator), coord(generator), coord(generator));
+        Entity e = spawnBullet(world, physics, pos, glm::vec3(0, 0, -1), 20, 0);
+        spheres.push_back({world.bullets.column<BULLET_BODY>()[world.bullets.rowOf(e)]});
+        junk.emplace_back(junkSize(generator));
+
+        glm::vec3 normal = glm::normalize(glm::vec3(coord(generator), coord(generator), coord(generator)));
+        e = spawnSplat(world.splats, pos, normal, -normal);
+        size_t row = world.splats.rowOf(e);
+        splats.push_back({world.splats.column<SPLAT_POSITION>()[row], world.splats.column<SPLAT_ROTATION>()[row]});
+    }
+    // bullets are created and destroyed continuously while playing, so the old vector does not follow allocation order
+    std::shuffle(spheres.begin(), spheres.end(), generator);
+
+    std::vector<glm::mat4> matrices(count);
+    std::string suffix = " (" + std::to_string(count) + ")";
+
+    printBenchResult(runBenchmark("entities/bullets AoS pointers" + suffix, count * frames, 5, [&] {
+        for (int f = 0; f < frames; f++) {
+            for (size_t i = 0; i < spheres.size(); i++) {
+                auto pos = spheres[i].body->getCenterOfMassPosition();
+                auto modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(pos.x(), pos.y(), pos.z()));
+                matrices[i] = glm::scale(modelMatrix, glm::vec3(BULLET_RENDER_SCALE));
+            }
+        }
+    }));
+
+    printBenchResult(runBenchmark("entities/bullets SoA sync+extract" + suffix, count * frames, 5, [&] {
+        for (int f = 0; f < frames; f++) {
+            syncBulletsFromPhysics(world.bullets);
+            extractBulletMatrices(world.bullets, world.bulletModelMatrices);
+        }
+    }));
+
+    printBenchResult(runBenchmark("entities/bullets SoA extract only" + suffix, count * frames, 5, [&] {
+        for (int f = 0; f < frames; f++)
+            extractBulletMatrices(world.bullets, world.bulletModelMatrices);
+    }));
+
+    printBenchResult(runBenchmark("entities/splats AoS per-frame matrix" + suffix, count * frames, 5, [&] {
+        for (int f = 0; f < frames; f++) {
+            for (size_t i = 0; i < splats.size(); i++) {
+                auto modelMatrix = glm::translate(glm::mat4(1.0f), splats[i].pos);
+                modelMatrix = glm::scale(modelMatrix, glm::vec3(SPLAT_RENDER_SCALE));
+                matrices[i] = modelMatrix * splats[i].rot;
+            }
+        }
+    }));
+
+    printBenchResult(runBenchmark("entities/splats SoA packed matrices" + suffix, count * frames, 5, [&] {
+        for (int f = 0; f < frames; f++) {
+            const auto &model = world.splats.column<SPLAT_MODEL>();
+            for (size_t i = 0; i < model.size(); i++)
+                matrices[i] = model[i];
+        }
+    }));
+
+    // spawn/destroy churn: half of the entities are removed and created again
+    printBenchResult(runBenchmark("entities/splats SoA destroy+create churn" + suffix, count, 5, [&] {
+        for (size_t i = world.splats.size(); i-- > count / 2;)
+            world.splats.destroyRow(i);
+        for (size_t i = count / 2; i < count; i++)
+            spawnSplat(world.splats, glm::vec3(i * 0.001f), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0));
+    }));
+
+    while (!world.bullets.empty())
+        destroyBulletRow(world, physics, world.bullets.size() - 1);
+}
+
+//////////////////////////////////////////
+// firing modes: discrete projectiles, projectiles with swept-sphere CCD, and hitscan, at different time steps
+
+// adds the level to the simulation, in the same way of the application
+btRigidBody *addLevelShape(Physics &physics, btCollisionShape *shape) {
+    auto backroomBody = new btRigidBody(0, new btDefaultMotionState(), shape);
+    backroomBody->setFriction(0.9);
+    physics.dynamicsWorld->addRigidBody(backroomBody);
+    return backroomBody;
+}
+
+btRigidBody *addLevel(Physics &physics, const std::vector<MeshGeometry> &level) {
+    return addLevelShape(physics, createTriangleMeshShape(level));
+}
+
+// shots fired from inside the rooms (below the ceiling lights), in random directions close to the horizontal plane.
+// The bullets do not filter the collisions between them, so each shot starts from its own cell of a 5x5 grid around
+// the light, wider than a bullet: the 25 shots in a row (more than the ones fired in a step) never overlap at the spawn
+// and push each other, also from the same room
+std::vector<HitscanShot> makeShots(size_t count, unsigned int seed) {
+    const float spacing = 3.0f * BULLET_RADIUS;
+    EntityWorld lights;
+    initCeilingLights(lights.lights);
+    const auto &lightPosition = lights.lights.column<LIGHT_POSITION>();
+
+    std::default_random_engine generator(seed);
+    std::uniform_int_distribution<int> light(0, NR_CEILING_LIGHTS - 1);
+    std::uniform_real_distribution<float> yaw(0.0f, 2.0f * glm::pi<float>());
+    std::uniform_real_distribution<float> pitch(-0.3f, 0.3f);
+
+    std::vector<HitscanShot> shots;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 origin = lightPosition[light(generator)];
+        origin.x += (static_cast<int>(i % 5) - 2) * spacing;
+        origin.z += (static_cast<int>(i / 5 % 5) - 2) * spacing;
+        origin.y = 0.5f;
+        float y = yaw(generator), p = pitch(generator);
+        shots.push_back({origin, glm::normalize(glm::vec3(cos(y) * cos(p), sin(p), sin(y) * cos(p)))});
+    }
+    return shots;
+}
+
+struct FiringResult {
+    size_t impacts = 0;
+    // bullets which crossed a surface of the level without being stopped
+    size_t tunneled = 0;
+    // time spent in simulation, impact detection and hitscan queries
+    double ms = 0;
+};
+
+FiringResult simulateFiring(const std::vector<MeshGeometry> &level, const std::vector<HitscanShot> &shots,
+                            FireMode mode, bool ccd, float timeStep, int shotsPerStep) {
+    Physics physics;
+    EntityWorld world;
+    btRigidBody *levelBody = addLevel(physics, level);
+    FiringSettings settings;
+    settings.mode = mode;
+    settings.ccd = ccd;
+
+    const float maxLifetime = 3.0f;
+    FiringResult result;
+    std::vector<HitscanShot> pending;
+    std::vector<std::pair<Entity, glm::vec3> > before;
+    size_t next = 0;
+    float time = 0;
+
+    while (next < shots.size() || !world.bullets.empty()) {
+        for (int i = 0; i < shotsPerStep && next < shots.size(); i++, next++) {
+            if (mode == FIRE_HITSCAN)
+                pending.push_back(shots[next]);
+            else
+                spawnBullet(world, physics, shots[next].origin, shots[next].direction, BULLET_SPEED, time, ccd);
+        }
+
+        before.clear();
+        for (size_t i = 0; i < world.bullets.size(); i++)
+            before.push_back({world.bullets.entities()[i], world.bullets.column<BULLET_POSITION>()[i]});
+
+        Timer timer;
+        physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        syncBulletsFromPhysics(world.bullets);
+        result.impacts += collideBulletsWithLevel(world, physics, levelBody);
+        result.impacts += resolveHitscanShots(world, levelBody, pending, settings);
+        result.ms += timer.elapsedMs();
+        time += timeStep;
+
+        // a bullet still alive whose motion in this step crosses the level has tunneled through it
+        for (auto &bullet: before) {
+            if (!world.bullets.alive(bullet.first))
+                continue;
+            size_t row = world.bullets.rowOf(bullet.first);
+            const glm::vec3 &now = world.bullets.column<BULLET_POSITION>()[row];
+            btVector3 from(bullet.second.x, bullet.second.y, bullet.second.z), to(now.x, now.y, now.z);
+            btCollisionWorld::ClosestRayResultCallback callback(from, to);
+            btCollisionWorld::rayTestSingle(btTransform(btQuaternion::getIdentity(), from),
+                                            btTransform(btQuaternion::getIdentity(), to), levelBody,
+                                            levelBody->getCollisionShape(), levelBody->getWorldTransform(), callback);
+            if (callback.hasHit() || time - world.bullets.column<BULLET_SPAWN_TIME>()[row] > maxLifetime) {
+                if (callback.hasHit())
+                    result.tunneled++;
+                destroyBulletRow(world, physics, row);
+            }
+        }
+    }
+    return result;
+}
+
+void benchFiring() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    std::vector<HitscanShot> shots = makeShots(2000, 7);
+
+    // reference: impacts expected by casting each shot as a ray (gravity is negligible on the short distances)
+    size_t expected = 0;
+    {
+        Physics physics;
+        btRigidBody *levelBody = addLevel(physics, level);
+        EntityWorld world;
+        std::vector<HitscanShot> pending = shots;
+        FiringSettings settings;
+        expected = resolveHitscanShots(world, levelBody, pending, settings);
+    }
+    std::cout << shots.size() << " shots, " << expected << " expected impacts (ray reference)" << std::endl;
+
+    struct Mode {
+        std::string name;
+        FireMode mode;
+        bool ccd;
+    } modes[] = {
+        {"projectile discrete", FIRE_PROJECTILE, false},
+        {"projectile ccd", FIRE_PROJECTILE, true},
+        {"hitscan", FIRE_HITSCAN, false},
+    };
+    float timeSteps[] = {1.0f / 120.0f, 1.0f / 60.0f, 1.0f / 30.0f, 1.0f / 15.0f};
+
+    std::cout << std::left << std::setw(22) << "mode" << std::right << std::setw(10) << "step (ms)"
+            << std::setw(10) << "impacts" << std::setw(10) << "tunneled" << std::setw(14) << "impacts/s" << std::endl;
+    for (auto &mode: modes) {
+        for (float timeStep: timeSteps) {
+            FiringResult result = simulateFiring(level, shots, mode.mode, mode.ccd, timeStep, 10);
+            std::cout << std::left << std::setw(22) << mode.name << std::right << std::fixed << std::setprecision(2)
+                    << std::setw(10) << timeStep * 1000.0f
+                    << std::setw(10) << result.impacts << std::setw(10) << result.tunneled
+                    << std::setw(14) << std::setprecision(0) << result.impacts / (result.ms / 1000.0)
+                    << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+//////////////////////////////////////////
+// soak test of the bullet lifecycle: sustained fire in every direction (also out of the map) for 10 simulated
+// minutes. Fails if the number of bodies in the simulation is not bounded by the cap of the lifecycle manager
+bool soakBullets() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    Physics physics;
+    EntityWorld world;
+    btRigidBody *levelBody = addLevel(physics, level);
+    BulletLifecycle lifecycle;
+    setKillVolume(lifecycle, levelBody, 5.0f);
+
+    std::default_random_engine generator(3);
+    std::uniform_real_distribution<float> angle(-glm::pi<float>(), glm::pi<float>());
+    std::vector<HitscanShot> shots = makeShots(1, 11);
+
+    const float timeStep = 1.0f / 60.0f;
+    const int steps = 60 * 60 * 10;
+    // the player is one body, and the cap can be exceeded by the bullets fired in a single frame
+    const int baseBodies = physics.dynamicsWorld->getNumCollisionObjects() + 1;
+    int maxBodies = 0;
+    size_t impacts = 0, fired = 0;
+    float time = 0;
+
+    Timer timer;
+    for (int step = 0; step < steps; step++) {
+        // 10 bullets per second, like holding the mouse button
+        if (step % 6 == 0) {
+            float yaw = angle(generator), pitch = angle(generator) * 0.5f;
+            glm::vec3 direction(cos(yaw) * cos(pitch), sin(pitch), sin(yaw) * cos(pitch));
+            spawnBullet(world, physics, shots[0].origin, direction, BULLET_SPEED, time);
+            fired++;
+        }
+        physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        time += timeStep;
+        syncBulletsFromPhysics(world.bullets);
+        impacts += collideBulletsWithLevel(world, physics, levelBody);
+        reclaimBullets(world, physics, lifecycle, time);
+        maxBodies = std::max(maxBodies, physics.dynamicsWorld->getNumCollisionObjects());
+    }
+
+    int bound = baseBodies + static_cast<int>(lifecycle.maxBullets) + 1;
+    std::cout << fired << " bullets fired in " << timer.elapsedMs() << " ms, " << impacts << " impacts" << std::endl;
+    std::cout << "live bullets: " << world.bullets.size() << ", max bodies: " << maxBodies << " (bound " << bound
+            << "), reclaimed: age " << lifecycle.reclaimedAge << ", bounds " << lifecycle.reclaimedBounds
+            << ", sleeping " << lifecycle.reclaimedSleeping << ", evicted " << lifecycle.reclaimedEvicted << std::endl;
+    bool bounded = maxBodies <= bound && world.bulletSpawnOrder.size() <= 2 * world.bullets.size() + 64;
+    // after the report and the check, which look at the bullets still alive
+    destroyAllBullets(world, physics);
+    std::cout << (bounded ? "PASSED" : "FAILED") << ": body count bounded" << std::endl;
+    return bounded;
+}
+
+//////////////////////////////////////////
+// allocations of the Bullet objects during sustained fire: bodies created with Physics::createRigidBody and
+// deleted (as before the pools, leaking shape and motion state), vs bodies from the pools with a shared shape
+
+struct AllocationResult {
+    double allocationsPerSecond = 0;
+    double ms = 0;
+    int64_t liveBlocksGrowth = 0;
+    int64_t liveBytesGrowth = 0;
+};
+
+// fires shotsPerSecond bullets for the given simulated time, and removes each bullet after one second
+AllocationResult sustainedFire(const std::vector<MeshGeometry> &level, bool pooled, float seconds, int shotsPerSecond) {
+    Physics physics;
+    addLevel(physics, level);
+    std::vector<HitscanShot> shots = makeShots(1024, 5);
+
+    const float timeStep = 1.0f / 60.0f;
+    const int steps = static_cast<int>(seconds / timeStep);
+    std::deque<std::pair<btRigidBody *, float> > live;
+    float time = 0, shotsDue = 0;
+    size_t next = 0;
+
+    PhysicsAllocatorStats start = PhysicsAllocator::instance().getStats();
+    Timer timer;
+    for (int step = 0; step < steps; step++) {
+        for (shotsDue += shotsPerSecond * timeStep; shotsDue >= 1.0f; shotsDue -= 1.0f) {
+            const HitscanShot &shot = shots[next++ % shots.size()];
+            btRigidBody *body;
+            if (pooled)
+                body = BulletBodyPool::instance().create(physics, shot.origin, BULLET_RADIUS, 1.0f, 0.9f, 0.0f);
+            else
+                body = physics.createRigidBody(SPHERE, shot.origin, glm::vec3(BULLET_RADIUS), shot.direction, 1.0f,
+                                               0.9f, 0.0f);
+            body->setLinearVelocity(btVector3(shot.direction.x, shot.direction.y, shot.direction.z) * BULLET_SPEED);
+            live.push_back({body, time});
+        }
+        physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        time += timeStep;
+        while (!live.empty() && time - live.front().second > 1.0f) {
+            if (pooled) {
+                BulletBodyPool::instance().destroy(physics, live.front().first);
+            } else {
+                physics.dynamicsWorld->removeRigidBody(live.front().first);
+                delete live.front().first;
+            }
+            live.pop_front();
+        }
+    }
+    AllocationResult result;
+    result.ms = timer.elapsedMs();
+    PhysicsAllocatorStats end = PhysicsAllocator::instance().getStats();
+    result.allocationsPerSecond = (end.allocations - start.allocations) / seconds;
+    result.liveBlocksGrowth = static_cast<int64_t>(end.liveBlocks) - static_cast<int64_t>(start.liveBlocks);
+    result.liveBytesGrowth = static_cast<int64_t>(end.liveBytes) - static_cast<int64_t>(start.liveBytes);
+
+    for (auto &bullet: live) {
+        if (pooled) {
+            BulletBodyPool::instance().destroy(physics, bullet.first);
+        } else {
+            physics.dynamicsWorld->removeRigidBody(bullet.first);
+            delete bullet.first;
+        }
+    }
+    return result;
+}
+
+void benchAllocations() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    const float seconds = 60.0f;
+
+    std::cout << std::left << std::setw(22) << "bodies" << std::right << std::setw(12) << "shots/s"
+            << std::setw(14) << "allocs/s" << std::setw(14) << "leaked blocks" << std::setw(14) << "leaked KB"
+            << std::setw(12) << "ms" << std::endl;
+    for (int shotsPerSecond: {10, 100, 1000}) {
+        for (bool pooled: {false, true}) {
+            AllocationResult result = sustainedFire(level, pooled, seconds, shotsPerSecond);
+            std::cout << std::left << std::setw(22) << (pooled ? "pooled, shared shape" : "createRigidBody")
+                    << std::right << std::fixed << std::setprecision(1)
+                    << std::setw(12) << shotsPerSecond << std::setw(14) << result.allocationsPerSecond
+                    << std::setw(14) << result.liveBlocksGrowth << std::setw(14) << result.liveBytesGrowth / 1024.0
+                    << std::setw(12) << result.ms << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+// leak check: 100k bullets fired headlessly through the whole pipeline (spawn, impacts, lifecycle).
+// After a warm-up, which brings the internal caches of Bullet (pair cache, manifold pool, ...) to their peak,
+// the memory in use must go back to the same level once all the bullets are removed
+bool leakCheck() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    Physics physics;
+    EntityWorld world;
+    btRigidBody *levelBody = addLevel(physics, level);
+    BulletLifecycle lifecycle;
+    setKillVolume(lifecycle, levelBody, 5.0f);
+    std::vector<HitscanShot> shots = makeShots(4096, 13);
+
+    const float timeStep = 1.0f / 60.0f;
+    const int shotsPerStep = 20;
+    float time = 0;
+    size_t fired = 0;
+    auto fire = [&](size_t count) {
+        for (size_t target = fired + count; fired < target;) {
+            for (int i = 0; i < shotsPerStep && fired < target; i++, fired++) {
+                const HitscanShot &shot = shots[fired % shots.size()];
+                spawnBullet(world, physics, shot.origin, shot.direction, BULLET_SPEED, time);
+            }
+            physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+            time += timeStep;
+            syncBulletsFromPhysics(world.bullets);
+            collideBulletsWithLevel(world, physics, levelBody);
+            reclaimBullets(world, physics, lifecycle, time);
+        }
+        destroyAllBullets(world, physics);
+        // one more step, so that the pairs of the removed bodies are cleaned up
+        physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+    };
+
+    fire(5000);
+    PhysicsAllocatorStats warm = PhysicsAllocator::instance().getStats();
+    Timer timer;
+    fire(100000);
+    double ms = timer.elapsedMs();
+    PhysicsAllocatorStats end = PhysicsAllocator::instance().getStats();
+
+    BulletBodyPool &pool = BulletBodyPool::instance();
+    std::cout << fired << " bullets fired, " << (end.allocations - warm.allocations) << " allocations ("
+            << end.recycled - warm.recycled << " recycled) in " << ms << " ms" << std::endl;
+    std::cout << "live blocks: " << warm.liveBlocks << " after warm-up, " << end.liveBlocks << " at the end; "
+            << "pooled bodies " << pool.liveBodies() << ", motion states " << pool.liveMotionStates()
+            << ", shared shapes " << pool.sharedShapes() << std::endl;
+    bool passed = end.liveBlocks <= warm.liveBlocks && end.liveBytes <= warm.liveBytes &&
+                  pool.liveBodies() == 0 && pool.liveMotionStates() == 0;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": no leaked physics memory" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// level collision representations: full triangle mesh vs the proxy of boxes (+ fallback mesh).
+// Same scripted load for both: 4 player boxes standing in the rooms, and sustained fire (cap of 256 bullets)
+
+struct NarrowphaseResult {
+    double narrowphaseMs = 0;
+    double stepMs = 0;
+    size_t manifolds = 0;
+    size_t contacts = 0;
+    size_t impacts = 0;
+};
+
+NarrowphaseResult runNarrowphase(btCollisionShape *levelShape, int steps) {
+    Physics physics;
+    EntityWorld world;
+    btRigidBody *levelBody = addLevelShape(physics, levelShape);
+    BulletLifecycle lifecycle;
+    setKillVolume(lifecycle, levelBody, 5.0f);
+    std::vector<HitscanShot> shots = makeShots(4096, 17);
+
+    std::vector<btRigidBody *> players;
+    for (int i = 0; i < 4; i++) {
+        glm::vec3 pos = shots[i * 7].origin;
+        pos.y = 0.2f;
+        players.push_back(physics.createRigidBody(BOX, pos, glm::vec3(0.2f, 0.9f, 0.2f), glm::vec3(0.0f), 1.0f, 0.9f, 0.0f));
+        players.back()->setAngularFactor(btVector3(0.0f, 1.0f, 0.0f));
+    }
+
+    const float timeStep = 1.0f / 60.0f;
+    NarrowphaseResult result;
+    btCollisionWorld *collisionWorld = physics.dynamicsWorld;
+    btDispatcher *dispatcher = collisionWorld->getDispatcher();
+    float time = 0;
+    for (int step = 0; step < steps; step++) {
+        for (int i = 0; i < 2; i++) {
+            const HitscanShot &shot = shots[(step * 2 + i) % shots.size()];
+            spawnBullet(world, physics, shot.origin, shot.direction, BULLET_SPEED, time);
+        }
+        // the players walk in circles
+        for (size_t i = 0; i < players.size(); i++) {
+            float angle = time + i;
+            btVector3 velocity = players[i]->getLinearVelocity();
+            players[i]->activate();
+            players[i]->setLinearVelocity(btVector3(cos(angle) * 2.0f, velocity.y(), sin(angle) * 2.0f));
+        }
+
+        Timer stepTimer;
+        physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        result.stepMs += stepTimer.elapsedMs();
+        time += timeStep;
+
+        // narrowphase only: the pairs found by the broadphase of this step are processed again
+        Timer narrowphaseTimer;
+        dispatcher->dispatchAllCollisionPairs(collisionWorld->getBroadphase()->getOverlappingPairCache(),
+                                              collisionWorld->getDispatchInfo(), dispatcher);
+        result.narrowphaseMs += narrowphaseTimer.elapsedMs();
+        for (int m = 0; m < dispatcher->getNumManifolds(); m++) {
+            int contacts = dispatcher->getManifoldByIndexInternal(m)->getNumContacts();
+            result.manifolds += contacts > 0;
+            result.contacts += contacts;
+        }
+
+        syncBulletsFromPhysics(world.bullets);
+        result.impacts += collideBulletsWithLevel(world, physics, levelBody);
+        reclaimBullets(world, physics, lifecycle, time);
+    }
+    destroyAllBullets(world, physics);
+    return result;
+}
+
+void benchCollisionProxy() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    std::vector<glm::vec3> triangles = collectTriangles(level);
+
+    Timer buildTimer;
+    CollisionProxy proxy = createCollisionProxy(triangles);
+    double buildMs = buildTimer.elapsedMs();
+    std::cout << "proxy: " << proxy.stats.boxes << " boxes from " << proxy.stats.planes << " planes, "
+            << proxy.stats.fallbackTriangles << " of " << proxy.stats.inputTriangles
+            << " triangles in the fallback mesh, built in " << buildMs << " ms" << std::endl;
+    btBvhTriangleMeshShape *triangleMesh = createTriangleMeshShape(level);
+
+    // accuracy: the shots of the firing benchmark cast as rays against both representations
+    std::vector<HitscanShot> shots = makeShots(2000, 7);
+    size_t sameHit = 0, differentHit = 0;
+    double distance = 0;
+    btRigidBody meshBody(0, nullptr, triangleMesh), proxyBody(0, nullptr, proxy.shape);
+    for (auto &shot: shots) {
+        btVector3 from(shot.origin.x, shot.origin.y, shot.origin.z);
+        btVector3 to = from + btVector3(shot.direction.x, shot.direction.y, shot.direction.z) * 100.0f;
+        btTransform fromTransform(btQuaternion::getIdentity(), from), toTransform(btQuaternion::getIdentity(), to);
+        btCollisionWorld::ClosestRayResultCallback meshHit(from, to), proxyHit(from, to);
+        btCollisionWorld::rayTestSingle(fromTransform, toTransform, &meshBody, triangleMesh,
+                                        meshBody.getWorldTransform(), meshHit);
+        btCollisionWorld::rayTestSingle(fromTransform, toTransform, &proxyBody, proxy.shape,
+                                        proxyBody.getWorldTransform(), proxyHit);
+        if (meshHit.hasHit() != proxyHit.hasHit()) {
+            differentHit++;
+        } else if (meshHit.hasHit()) {
+            sameHit++;
+            distance += (meshHit.m_hitPointWorld - proxyHit.m_hitPointWorld).length();
+        }
+    }
+    std::cout << "rays: " << sameHit << " hit both, " << differentHit << " hit only one, mean distance of the hit points "
+            << (sameHit ? distance / sameHit : 0) << std::endl;
+
+    const int steps = 60 * 30;
+    std::cout << std::left << std::setw(16) << "level shape" << std::right << std::setw(16) << "narrowphase ms"
+            << std::setw(12) << "step ms" << std::setw(12) << "manifolds" << std::setw(12) << "contacts"
+            << std::setw(10) << "impacts" << std::endl;
+    std::pair<std::string, btCollisionShape *> shapes[] = {{"triangle mesh", triangleMesh}, {"proxy", proxy.shape}};
+    for (auto &shape: shapes) {
+        NarrowphaseResult result = runNarrowphase(shape.second, steps);
+        std::cout << std::left << std::setw(16) << shape.first << std::right << std::fixed << std::setprecision(4)
+                << std::setw(16) << result.narrowphaseMs / steps << std::setw(12) << result.stepMs / steps
+                << std::setprecision(1) << std::setw(12) << (double) result.manifolds / steps
+                << std::setw(12) << (double) result.contacts / steps << std::setw(10) << result.impacts
+                << std::defaultfloat << std::endl;
+    }
+}
+
+//////////////////////////////////////////
+// occlusion culling along a scripted camera path: the camera walks from a ceiling light to the next one at eye height,
+// and looks around at each of them. Reports visible set and culling cost per frame; the culled chunks and splats are
+// checked with rays against the level: fails if too many of them were actually visible
+
+struct CameraPose {
+    glm::vec3 position;
+    float yaw;
+};
+
+std::vector<CameraPose> cameraPath(int framesPerSegment) {
+    EntityWorld lights;
+    initCeilingLights(lights.lights);
+    std::vector<glm::vec3> waypoints = lights.lights.column<LIGHT_POSITION>();
+    std::vector<CameraPose> path;
+    for (size_t w = 0; w + 1 < waypoints.size(); w++) {
+        glm::vec3 from = waypoints[w], to = waypoints[w + 1];
+        from.y = to.y = 0.5f;
+        float heading = std::atan2(to.z - from.z, to.x - from.x);
+        // look around
+        for (int f = 0; f < framesPerSegment; f++)
+            path.push_back({from, heading + 2.0f * glm::pi<float>() * f / framesPerSegment});
+        // walk to the next light
+        for (int f = 0; f < framesPerSegment; f++)
+            path.push_back({glm::mix(from, to, (float) f / framesPerSegment), heading});
+    }
+    return path;
+}
+
+// true if the point can be seen from the eye (no level surface in between)
+bool pointVisible(btCollisionObject *level, const glm::vec3 &eye, const glm::vec3 &point) {
+    glm::vec3 target = point + glm::normalize(eye - point) * 0.02f;
+    btVector3 from(eye.x, eye.y, eye.z), to(target.x, target.y, target.z);
+    btCollisionWorld::ClosestRayResultCallback callback(from, to);
+    btCollisionWorld::rayTestSingle(btTransform(btQuaternion::getIdentity(), from),
+                                    btTransform(btQuaternion::getIdentity(), to), level, level->getCollisionShape(),
+                                    level->getWorldTransform(), callback);
+    return !callback.hasHit();
+}
+
+bool inFrustum(const glm::mat4 &viewProjection, const glm::vec3 &point) {
+    glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+    return clip.w > 0.1f && std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w;
+}
+
+bool benchOcclusion() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    std::vector<glm::vec3> occluders = selectOccluders(collectTriangles(level), 0.25f);
+    std::vector<LevelChunk> chunks;
+    size_t totalTriangles = 0;
+    for (unsigned int m = 0; m < level.size(); m++) {
+        buildLevelChunks(level[m].positions, level[m].indices, m, 4.0f, chunks);
+        totalTriangles += level[m].indices.size() / 3;
+    }
+
+    // splats all over the level, placed by hitscan shots
+    Physics physics;
+    btRigidBody *levelBody = addLevel(physics, level);
+    EntityWorld world;
+    std::vector<HitscanShot> shots = makeShots(5000, 23);
+    FiringSettings settings;
+    resolveHitscanShots(world, levelBody, shots, settings);
+    const auto &splatPosition = world.splats.column<SPLAT_POSITION>();
+
+    std::cout << chunks.size() << " chunks, " << totalTriangles << " triangles, " << occluders.size() / 3
+            << " occluders, " << world.splats.size() << " splats" << std::endl;
+
+    std::vector<CameraPose> path = cameraPath(60);
+    glm::mat4 projection = glm::perspective(45.0f, 1200.0f / 900.0f, 0.1f, 10000.0f);
+    OcclusionBuffer occlusion(256, 192);
+
+    double rasterMs = 0, hierarchyMs = 0, testMs = 0;
+    size_t chunksVisible = 0, trianglesVisible = 0, splatsVisible = 0;
+    size_t checked = 0, wronglyCulled = 0;
+    for (size_t f = 0; f < path.size(); f++) {
+        const CameraPose &pose = path[f];
+        glm::vec3 front(std::cos(pose.yaw), 0.0f, std::sin(pose.yaw));
+        glm::mat4 viewProjection = projection * glm::lookAt(pose.position, pose.position + front, glm::vec3(0, 1, 0));
+
+        Timer timer;
+        occlusion.begin(viewProjection);
+        occlusion.rasterize(occluders);
+        rasterMs += timer.elapsedMs();
+        timer.reset();
+        occlusion.buildHierarchy();
+        hierarchyMs += timer.elapsedMs();
+
+        timer.reset();
+        std::vector<char> chunkVisible(chunks.size()), splatVisible(world.splats.size());
+        for (size_t c = 0; c < chunks.size(); c++)
+            chunkVisible[c] = occlusion.visible(chunks[c].aabbMin, chunks[c].aabbMax);
+        for (size_t i = 0; i < splatPosition.size(); i++)
+            splatVisible[i] = occlusion.visibleSphere(splatPosition[i], SPLAT_BOUNDING_RADIUS);
+        testMs += timer.elapsedMs();
+
+        for (size_t c = 0; c < chunks.size(); c++) {
+            if (chunkVisible[c]) {
+                chunksVisible++;
+                trianglesVisible += chunks[c].count / 3;
+            }
+        }
+        for (char visible: splatVisible)
+            splatsVisible += visible;
+
+        // validation, on a subset of the frames: a few triangles of each culled chunk, and the culled splats
+        if (f % 10 != 0)
+            continue;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            if (chunkVisible[c])
+                continue;
+            const MeshGeometry &mesh = level[chunks[c].mesh];
+            unsigned int step = std::max(3u, chunks[c].count / 8 / 3 * 3);
+            for (unsigned int i = chunks[c].firstIndex; i + 2 < chunks[c].firstIndex + chunks[c].count; i += step) {
+                glm::vec3 centroid = (mesh.positions[mesh.indices[i]] + mesh.positions[mesh.indices[i + 1]] +
+                                      mesh.positions[mesh.indices[i + 2]]) / 3.0f;
+                if (!inFrustum(viewProjection, centroid))
+                    continue;
+                checked++;
+                wronglyCulled += pointVisible(levelBody, pose.position, centroid);
+            }
+        }
+        for (size_t i = 0; i < splatPosition.size(); i++) {
+            if (splatVisible[i] || !inFrustum(viewProjection, splatPosition[i]))
+                continue;
+            checked++;
+            wronglyCulled += pointVisible(levelBody, pose.position, splatPosition[i]);
+        }
+    }
+
+    double frames = static_cast<double>(path.size());
+    std::cout << path.size() << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+            << "visible per frame: " << chunksVisible / frames << "/" << chunks.size() << " chunks, "
+            << trianglesVisible / frames << "/" << totalTriangles << " triangles, "
+            << splatsVisible / frames << "/" << world.splats.size() << " splats" << std::endl;
+    std::cout << std::setprecision(3) << "culling per frame: " << rasterMs / frames << " ms rasterization, "
+            << hierarchyMs / frames << " ms hierarchy, " << testMs / frames << " ms tests" << std::endl;
+    double errorRate = checked ? (double) wronglyCulled / checked : 0;
+    std::cout << "validation: " << wronglyCulled << " of " << checked << " culled samples were visible ("
+            << errorRate * 100.0 << "%)" << std::defaultfloat << std::endl;
+    bool passed = errorRate <= 0.01;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": culled objects are hidden" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// irradiance probes for the dynamic objects: bake time, and shading cost per pixel compared to the loop over the
+// 25 lights of shader.frag (both evaluated on the CPU, on random fragments of small objects around the level)
+
+// diffuse and specular factors of the forward path (sum of calcPointLight over the lights, without the colors)
+void forwardLighting(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &attenuations,
+                     float ambient, float diffuse, float specular, const glm::vec3 &position, const glm::vec3 &normal,
+                     float &outDiffuse, float &outSpecular) {
+    outDiffuse = outSpecular = 0.0f;
+    for (size_t i = 0; i < positions.size(); i++) {
+        glm::vec3 lightDir = glm::normalize(positions[i] - position);
+        float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+        float distance = glm::length(positions[i] - position);
+        const glm::vec3 &a = attenuations[i];
+        float attenuation = 1.0f / (a.x + a.y * distance + a.z * distance * distance);
+        // shininess is 0, so the specular term is constant
+        outDiffuse += (ambient + diffuse * diff) * attenuation;
+        outSpecular += specular * attenuation;
+    }
+}
+
+bool benchProbes() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    std::vector<glm::vec3> triangles = collectTriangles(level);
+    Bvh bvh;
+    bvh.build(triangles);
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+    for (auto &p: triangles) {
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+    LightArchetype lights;
+    initCeilingLights(lights);
+    const auto &positions = lights.column<LIGHT_POSITION>();
+    const auto &attenuations = lights.column<LIGHT_ATTENUATION>();
+    // intensities of the warmed-up lights (see the flicker in work06b.cpp)
+    std::vector<glm::vec3> ambient(positions.size(), glm::vec3(0.05f)), diffuse(positions.size(), glm::vec3(0.8f)),
+            specular(positions.size(), glm::vec3(1.0f));
+
+    ProbeGrid probes;
+    unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double singleThreadMs = 0;
+    for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+        Timer timer;
+        probes.bake(bvh, positions, attenuations, boundsMin, boundsMax, 0.5f, threads);
+        double ms = timer.elapsedMs();
+        if (threads == 1)
+            singleThreadMs = ms;
+        std::cout << probes.probeCount() << " probes (" << probes.dims.x << "x" << probes.dims.y << "x"
+                << probes.dims.z << "), bake with " << threads << " threads: " << ms << " ms, speedup "
+                << singleThreadMs / ms << std::endl;
+        if (threads == maxThreads)
+            break;
+    }
+    Timer timer;
+    const int updates = 20;
+    for (int i = 0; i < updates; i++) {
+        // flickering lights: the intensities change at each frame
+        ambient[i % ambient.size()] = glm::vec3(0.05f + 0.001f * i);
+        probes.combine(ambient, diffuse, specular);
+    }
+    ambient.assign(positions.size(), glm::vec3(0.05f));
+    std::cout << "update with the light intensities: " << timer.elapsedMs() / updates << " ms per frame" << std::endl;
+
+    // fragments of bullets and splats: random points in the walkable height of the level, random normals
+    std::default_random_engine generator(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f);
+    const size_t pixels = 200000;
+    std::vector<glm::vec3> fragmentPositions(pixels), fragmentNormals(pixels);
+    for (size_t i = 0; i < pixels; i++) {
+        fragmentPositions[i] = glm::vec3(glm::mix(boundsMin.x, boundsMax.x, unit(generator)),
+                                         glm::mix(-0.6f, 1.0f, unit(generator)),
+                                         glm::mix(boundsMin.z, boundsMax.z, unit(generator)));
+        glm::vec3 n(signedUnit(generator), signedUnit(generator), signedUnit(generator));
+        // the shader uses the absolute value of the normal
+        fragmentNormals[i] = glm::abs(glm::normalize(n + glm::vec3(1e-6f)));
+    }
+
+    float sink = 0.0f;
+    timer.reset();
+    for (size_t i = 0; i < pixels; i++) {
+        float d, s;
+        forwardLighting(positions, attenuations, 0.05f, 0.8f, 1.0f, fragmentPositions[i], fragmentNormals[i], d, s);
+        sink += d + s;
+    }
+    double forwardNs = timer.elapsedMs() * 1e6 / pixels;
+    timer.reset();
+    for (size_t i = 0; i < pixels; i++) {
+        glm::vec4 sh;
+        float s;
+        probes.sample(fragmentPositions[i], sh, s);
+        sink += evalProbeDiffuse(sh, fragmentNormals[i]) + s;
+    }
+    double probesNs = timer.elapsedMs() * 1e6 / pixels;
+    std::cout << std::fixed << std::setprecision(1) << "shading per pixel: " << forwardNs << " ns with "
+            << positions.size() << " lights, " << probesNs << " ns with the probes (2 trilinear lookups), "
+            << forwardNs / probesNs << "x" << std::defaultfloat << " (" << (sink > 0 ? "ok" : "-") << ")" << std::endl;
+
+    // accuracy: without shadows the probes only approximate the attenuation (trilinear) and N.L (L1 SH)
+    probes.bake(bvh, positions, attenuations, boundsMin, boundsMax, 0.5f, maxThreads, false);
+    probes.combine(ambient, diffuse, specular);
+    double relativeError = 0;
+    for (size_t i = 0; i < pixels; i++) {
+        float d, s;
+        forwardLighting(positions, attenuations, 0.05f, 0.8f, 1.0f, fragmentPositions[i], fragmentNormals[i], d, s);
+        glm::vec4 sh;
+        float ps;
+        probes.sample(fragmentPositions[i], sh, ps);
+        // white diffuse and specular colors
+        relativeError += std::abs(evalProbeDiffuse(sh, fragmentNormals[i]) + ps - (d + s)) / (d + s);
+    }
+    relativeError /= pixels;
+    std::cout << "mean relative error without shadows: " << relativeError * 100.0 << "%" << std::endl;
+    bool passed = relativeError < 0.06;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": probe lighting matches the forward lighting" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// levels of detail of bullets and splats: triangles submitted per frame during heavy fire, seen from the shooting
+// position, with the levels and with the full models (no culling, as if everything was in view)
+
+struct LodModel {
+    std::string name;
+    MeshGeometry geometry;
+    // triangles of each level, the full model first
+    std::vector<size_t> triangles;
+};
+
+LodModel loadLodModel(const std::string &path, const LodSettings &settings, float renderScale) {
+    LodModel model;
+    model.name = path;
+    std::vector<MeshGeometry> meshes = loadGeometry(path);
+    if (meshes.empty())
+        return model;
+    // both models have a single mesh
+    model.geometry = meshes[0];
+    const MeshGeometry &mesh = model.geometry;
+    model.triangles.push_back(mesh.indices.size() / 3);
+    Timer timer;
+    std::vector<std::vector<unsigned int> > levels =
+            generateLodLevels(mesh.positions, mesh.normals, mesh.indices, settings.ratios);
+    double ms = timer.elapsedMs();
+    std::cout << path << ": " << model.triangles[0] << " triangles";
+    for (size_t i = 0; i < levels.size(); i++) {
+        model.triangles.push_back(levels[i].size() / 3);
+        float error = simplifyMesh(mesh.positions, mesh.normals, mesh.indices, levels[i].size() / 3).error;
+        std::cout << ", " << model.triangles.back() << " (error " << error * renderScale * 1000.0f << " mm)";
+    }
+    std::cout << ", generated in " << ms << " ms" << std::endl;
+    return model;
+}
+
+bool benchLod() {
+    LodModel bullet = loadLodModel("models/sphere.obj", BULLET_LODS, BULLET_RENDER_SCALE);
+    LodModel splat = loadLodModel("models/newscene.obj", SPLAT_LODS, SPLAT_RENDER_SCALE);
+    if (bullet.triangles.size() != BULLET_LODS.levels() || splat.triangles.size() != SPLAT_LODS.levels()) {
+        std::cout << "FAILED: models not loaded" << std::endl;
+        return false;
+    }
+
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    Physics physics;
+    EntityWorld world;
+    btRigidBody *levelBody = addLevel(physics, level);
+    BulletLifecycle lifecycle;
+    setKillVolume(lifecycle, levelBody, 5.0f);
+
+    // camera of the application (1200x900 window) at the shooting position
+    glm::vec3 eye = makeShots(1, 11)[0].origin;
+    float pixelScale = lodPixelScale(glm::perspective(45.0f, 1200.0f / 900.0f, 0.1f, 10000.0f), 900.0f);
+
+    std::default_random_engine generator(5);
+    std::uniform_real_distribution<float> yaw(-glm::pi<float>(), glm::pi<float>()), pitch(-0.3f, 0.3f);
+    const float timeStep = 1.0f / 60.0f;
+    const int steps = 60 * 30;
+    size_t lodTotal = 0, fullTotal = 0, lodPeak = 0, fullPeak = 0, switches = 0, switchesNoHysteresis = 0;
+    LodSettings bulletNoHysteresis = BULLET_LODS, splatNoHysteresis = SPLAT_LODS;
+    bulletNoHysteresis.hysteresis = splatNoHysteresis.hysteresis = 0.0f;
+    std::vector<uint8_t> bulletLevels, splatLevels;
+    // levels of the previous frame by entity (the rows of the bullets change when some of them are removed)
+    std::unordered_map<Entity, uint8_t> bulletPrevious, splatPrevious, bulletPreviousNoHysteresis,
+            splatPreviousNoHysteresis;
+    auto countSwitches = [](const std::vector<Entity> &entities, const std::vector<uint8_t> &levels,
+                            std::unordered_map<Entity, uint8_t> &previous) {
+        size_t count = 0;
+        for (size_t i = 0; i < entities.size(); i++) {
+            auto found = previous.find(entities[i]);
+            if (found != previous.end() && found->second != levels[i])
+                count++;
+            previous[entities[i]] = levels[i];
+        }
+        return count;
+    };
+    double selectMs = 0;
+    float time = 0;
+    for (int step = 0; step < steps; step++) {
+        // heavy fire: 30 bullets per second, while turning around
+        if (step % 2 == 0) {
+            float y = yaw(generator), p = pitch(generator);
+            spawnBullet(world, physics, eye, glm::vec3(cos(y) * cos(p), sin(p), sin(y) * cos(p)), BULLET_SPEED,
+                        time);
+        }
+        physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+        time += timeStep;
+        syncBulletsFromPhysics(world.bullets);
+        collideBulletsWithLevel(world, physics, levelBody);
+        reclaimBullets(world, physics, lifecycle, time);
+
+        // levels with hysteresis (kept in the archetypes, like the application), and without it for comparison
+        const auto &bulletPosition = world.bullets.column<BULLET_POSITION>();
+        const auto &splatPosition = world.splats.column<SPLAT_POSITION>();
+        auto &bulletLod = world.bullets.column<BULLET_LOD>();
+        auto &splatLod = world.splats.column<SPLAT_LOD>();
+        Timer timer;
+        selectLods(bulletPosition, BULLET_RENDER_RADIUS, eye, pixelScale, BULLET_LODS, true, bulletLod);
+        selectLods(splatPosition, SPLAT_BOUNDING_RADIUS, eye, pixelScale, SPLAT_LODS, true, splatLod);
+        selectMs += timer.elapsedMs();
+        switches += countSwitches(world.bullets.entities(), bulletLod, bulletPrevious);
+        switches += countSwitches(world.splats.entities(), splatLod, splatPrevious);
+        bulletLevels.assign(bulletLod.size(), 0);
+        splatLevels.assign(splatLod.size(), 0);
+        selectLods(bulletPosition, BULLET_RENDER_RADIUS, eye, pixelScale, bulletNoHysteresis, true, bulletLevels);
+        selectLods(splatPosition, SPLAT_BOUNDING_RADIUS, eye, pixelScale, splatNoHysteresis, true, splatLevels);
+        switchesNoHysteresis += countSwitches(world.bullets.entities(), bulletLevels, bulletPreviousNoHysteresis);
+        switchesNoHysteresis += countSwitches(world.splats.entities(), splatLevels, splatPreviousNoHysteresis);
+
+        size_t lodTriangles = 0;
+        for (uint8_t lod: bulletLod)
+            lodTriangles += bullet.triangles[lod];
+        for (uint8_t lod: splatLod)
+            lodTriangles += splat.triangles[lod];
+        size_t fullTriangles = world.bullets.size() * bullet.triangles[0] + world.splats.size() * splat.triangles[0];
+        lodTotal += lodTriangles;
+        fullTotal += fullTriangles;
+        lodPeak = std::max(lodPeak, lodTriangles);
+        fullPeak = std::max(fullPeak, fullTriangles);
+    }
+    std::cout << world.bullets.size() << " bullets and " << world.splats.size() << " splats at the end, selection "
+            << selectMs * 1000.0 / steps << " us per frame" << std::endl;
+    std::cout << "triangles per frame: " << fullTotal / steps << " full models (peak " << fullPeak << "), "
+            << lodTotal / steps << " with the levels of detail (peak " << lodPeak << "), "
+            << std::fixed << std::setprecision(1) << 100.0 * lodTotal / std::max<size_t>(fullTotal, 1) << "%"
+            << std::defaultfloat << std::endl;
+    std::cout << "level switches: " << switches << " with hysteresis, " << switchesNoHysteresis << " without"
+            << std::endl;
+    destroyAllBullets(world, physics);
+
+    bool passed = lodTotal * 2 < fullTotal && switches <= switchesNoHysteresis;
+    for (size_t i = 1; i < bullet.triangles.size(); i++)
+        passed = passed && bullet.triangles[i] < bullet.triangles[i - 1];
+    for (size_t i = 1; i < splat.triangles.size(); i++)
+        passed = passed && splat.triangles[i] < splat.triangles[i - 1];
+    std::cout << (passed ? "PASSED" : "FAILED") << ": levels of detail halve the submitted triangles" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// light of the vertices of the level (emissive term of the ceiling panels): load-time nearest light lookup, which
+// must give the same lights of the previous gl_VertexID / 6 in the shader, and must not depend on the vertex order
+
+bool benchLightAssignment() {
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    LightArchetype lights;
+    initCeilingLights(lights);
+    LightGrid grid;
+    grid.build(lights.column<LIGHT_POSITION>(), 3.42f);
+
+    Timer timer;
+    std::vector<std::vector<unsigned int> > assigned;
+    size_t vertices = 0;
+    for (auto &mesh: level) {
+        assigned.push_back(assignNearestLights(mesh.positions, mesh.indices, grid));
+        vertices += mesh.positions.size();
+    }
+    std::cout << "assignment of " << vertices << " vertices: " << timer.elapsedMs() << " ms" << std::endl;
+
+    bool passed = true;
+    size_t panels = 0;
+    std::default_random_engine generator(3);
+    for (size_t m = 0; m < level.size(); m++) {
+        const MeshGeometry &mesh = level[m];
+        if (mesh.emissive == glm::vec3(0.0f))
+            continue;
+        // 2 triangles per panel, in the order of the lights (the 2 corners of the diagonal are shared)
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+            passed = passed && assigned[m][mesh.indices[i]] == i / 6;
+        panels += mesh.indices.size() / 6;
+
+        // the same mesh with shuffled vertices and triangles
+        std::vector<unsigned int> order(mesh.positions.size());
+        for (unsigned int v = 0; v < order.size(); v++)
+            order[v] = v;
+        std::shuffle(order.begin(), order.end(), generator);
+        std::vector<glm::vec3> positions(order.size());
+        for (size_t v = 0; v < order.size(); v++)
+            positions[order[v]] = mesh.positions[v];
+        std::vector<std::array<unsigned int, 3> > triangles;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+            triangles.push_back({order[mesh.indices[i]], order[mesh.indices[i + 1]], order[mesh.indices[i + 2]]});
+        std::shuffle(triangles.begin(), triangles.end(), generator);
+        std::vector<unsigned int> indices;
+        for (auto &triangle: triangles)
+            indices.insert(indices.end(), triangle.begin(), triangle.end());
+        std::vector<unsigned int> shuffled = assignNearestLights(positions, indices, grid);
+        for (size_t v = 0; v < order.size(); v++)
+            passed = passed && shuffled[order[v]] == assigned[m][v];
+    }
+    passed = passed && panels == static_cast<size_t>(NR_CEILING_LIGHTS);
+    std::cout << panels << " emissive panels" << std::endl;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": each panel keeps its light, in any vertex order" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// dynamic resolution controller, with a model of the GPU time of a frame (fixed part plus a part proportional to
+// the pixels, with noise) under a scripted load: the level, then a storm of splats, then the level again.
+// The measures reach the controller 2 frames late, like the timer queries of the application
+
+bool benchDynamicResolution() {
+    struct Phase {
+        const char *name;
+        float fixedMs, pixelsMs;
+    };
+    const Phase phases[] = {{"level", 3.0f, 16.0f}, {"splat storm", 3.0f, 30.0f}, {"level", 3.0f, 16.0f}};
+    const int PHASE_FRAMES = 300, LATENCY = 2;
+    ResolutionSettings settings;
+    ResolutionController controller(settings);
+    std::default_random_engine generator(11);
+    std::uniform_real_distribution<float> noise(0.9f, 1.1f);
+
+    bool passed = true;
+    std::deque<float> pending;
+    float scale = controller.scale();
+    int frame = 0;
+    std::cout << "frame, scale, frame ms" << std::endl;
+    for (const Phase &phase: phases) {
+        double steadyMs = 0;
+        int changes = 0;
+        for (int i = 0; i < PHASE_FRAMES; i++, frame++) {
+            float frameMs = (phase.fixedMs + phase.pixelsMs * scale * scale) * noise(generator);
+            pending.push_back(frameMs);
+            if (frame % 30 == 0)
+                std::cout << frame << ", " << scale << ", " << frameMs << std::endl;
+            float next = scale;
+            if (pending.size() > LATENCY) {
+                next = controller.update(pending.front());
+                pending.pop_front();
+            }
+            // the second half of the phase is the steady state
+            if (i >= PHASE_FRAMES / 2) {
+                steadyMs += frameMs;
+                changes += next != scale;
+            }
+            scale = next;
+        }
+        steadyMs /= PHASE_FRAMES - PHASE_FRAMES / 2;
+        // within the budget (and its dead band), unless the scale is already at its limits
+        bool withinBudget = steadyMs <= settings.budgetMs * (1.0f + settings.deadBand) ||
+                            scale <= settings.minScale;
+        // and not lower than needed: the next scale would not be within the budget
+        float nextScale = scale + settings.step;
+        bool highEnough = phase.fixedMs + phase.pixelsMs * nextScale * nextScale >
+                          settings.budgetMs * (1.0f - settings.deadBand) || scale >= settings.maxScale;
+        std::cout << phase.name << ": scale " << scale << ", " << steadyMs << " ms per frame, " << changes
+                << " changes in the steady state" << std::endl;
+        passed = passed && withinBudget && highEnough && changes <= 2;
+    }
+    std::cout << (passed ? "PASSED" : "FAILED") << ": the frame time follows the budget without oscillations"
+            << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// render graph of the frame (util3d/frame_graph.h), declared headless: the passes only record their order and
+// check that the targets they read were written before, and the memory of the targets is compared with the
+// previous fixed framebuffers (scene, bright, depth, copy of the depth and two blur buffers at full size)
+
+// records the passes, and the targets written so far (by name, as the aliased targets share their slot). The
+// retained targets can be read first, with what the last frames wrote
+class RecordingPassContext : public RenderPassContext {
+public:
+    explicit RecordingPassContext(const RenderGraph &graph) : graph(graph) {}
+
+    std::vector<std::string> order;
+    bool readsWritten = true;
+
+    void record(const std::string &name, const std::vector<RenderTarget> &reads,
+                const std::vector<RenderTarget> &writes) {
+        order.push_back(name);
+        for (RenderTarget target: reads)
+            if (!graph.targets()[target].imported && !graph.targets()[target].retained &&
+                written.count(graph.targets()[target].name) == 0)
+                readsWritten = false;
+        for (RenderTarget target: writes)
+            written.insert(graph.targets()[target].name);
+    }
+
+    void beginPass(const std::vector<RenderTarget> &) override {}
+
+    unsigned int texture(RenderTarget target) override {
+        return static_cast<unsigned int>(graph.targets()[target].slot + 1);
+    }
+
+    unsigned int framebuffer(const std::vector<RenderTarget> &) override {
+        return 0;
+    }
+
+private:
+    const RenderGraph &graph;
+    std::set<std::string> written;
+};
+
+// declares the frame with passes which record themselves, and executes it
+bool runFrameGraph(RenderGraph &graph, int width, int height, bool decals, std::vector<std::string> &order,
+                   FrameCaching caching = FRAME_UNCACHED) {
+    FramePasses passes;
+    FrameTargets targets;
+    RecordingPassContext *recorder = nullptr;
+    auto recording = [&](const std::string &name, std::function<std::vector<RenderTarget>()> reads,
+                         std::function<std::vector<RenderTarget>()> writes) {
+        return [&recorder, name, reads, writes](RenderPassContext &) {
+            recorder->record(name, reads(), writes());
+        };
+    };
+    passes.scene = recording("scene", [&] { return std::vector<RenderTarget>(); },
+                             [&] { return std::vector<RenderTarget>{targets.scene, targets.bright, targets.depth}; });
+    passes.depthCopy = recording("depth copy", [&] { return std::vector<RenderTarget>{targets.depth}; },
+                                 [&] { return std::vector<RenderTarget>{targets.depthCopy}; });
+    passes.decals = recording("decals", [&] { return std::vector<RenderTarget>{targets.depthCopy, targets.depth}; },
+                              [&] { return std::vector<RenderTarget>{targets.scene, targets.bright}; });
+    passes.bullets = recording("bullets", [&] { return std::vector<RenderTarget>(); },
+                               [&] { return std::vector<RenderTarget>{targets.scene, targets.bright}; });
+    passes.bloomFirst = recording("bloom first", [&] { return std::vector<RenderTarget>{targets.bright}; },
+                                  [&] { return std::vector<RenderTarget>{targets.blur[1]}; });
+    // the blur iterations: blur 1 -> blur 0 -> blur 1 ...
+    passes.bloom = recording("bloom", [&] { return std::vector<RenderTarget>{targets.blur[1]}; },
+                             [&] { return std::vector<RenderTarget>{targets.blur[0], targets.blur[1]}; });
+    passes.composite = recording("composite", [&] { return std::vector<RenderTarget>{targets.scene, targets.blur[0]}; },
+                                 [&] { return std::vector<RenderTarget>{targets.backbuffer}; });
+
+    targets = declareFrameGraph(graph, width, height, decals, passes, caching);
+    if (!graph.compile()) {
+        std::cout << "compile failed: " << graph.error() << std::endl;
+        return false;
+    }
+    RecordingPassContext context(graph);
+    recorder = &context;
+    graph.execute(context);
+    order = context.order;
+    return context.readsWritten;
+}
+
+bool benchRenderGraph() {
+    const int width = 1200, height = 900;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    // previous framebuffers: 2 RGBA16F color buffers, a depth buffer, a copy of the depth, 2 RGBA16F blur buffers
+    const size_t fixedBytes = pixels * (8 + 8 + 4 + 4 + 8 + 8);
+    bool passed = true;
+
+    for (bool decals: {true, false}) {
+        RenderGraph graph;
+        std::vector<std::string> order;
+        bool valid = runFrameGraph(graph, width, height, decals, order);
+        std::vector<std::string> expected = {"scene"};
+        if (decals) {
+            expected.push_back("depth copy");
+            expected.push_back("decals");
+        }
+        for (const char *name: {"bullets", "bloom first", "bloom", "composite"})
+            expected.push_back(name);
+        bool ordered = order == expected;
+
+        // the first blur target takes the memory of the bright parts
+        const auto &targets = graph.targets();
+        int brightSlot = -1, blurSlot = -1;
+        for (auto &target: targets) {
+            if (target.name == "bright")
+                brightSlot = target.slot;
+            if (target.name == "blur 0")
+                blurSlot = target.slot;
+        }
+        bool aliased = brightSlot >= 0 && brightSlot == blurSlot;
+        // 32 bytes per pixel with the decals, 28 without (the previous framebuffers took 40)
+        size_t expectedBytes = pixels * (decals ? 32 : 28);
+        bool smaller = graph.memoryBytes() == expectedBytes;
+
+        std::cout << (decals ? "with" : "without") << " decals: " << order.size() << " passes, "
+                << graph.slots().size() << " textures, " << graph.memoryBytes() / (1024.0 * 1024.0) << " MB ("
+                << graph.unaliasedBytes() / (1024.0 * 1024.0) << " MB without aliasing, "
+                << fixedBytes / (1024.0 * 1024.0) << " MB with the fixed framebuffers)" << std::endl;
+        std::cout << graph.describe();
+        passed = passed && valid && ordered && aliased && smaller;
+    }
+
+    // a pass reading a target before it is written is an error
+    {
+        RenderGraph graph;
+        TargetDesc desc;
+        desc.width = width;
+        desc.height = height;
+        RenderTarget backbuffer = graph.import("backbuffer");
+        RenderTarget a = graph.create("a", desc);
+        graph.addPass("reads a", {a}, {backbuffer}, nullptr);
+        graph.addPass("writes a", {}, {a}, nullptr);
+        bool rejected = !graph.compile();
+        std::cout << "wrong order: " << (rejected ? graph.error() : "accepted") << std::endl;
+        passed = passed && rejected;
+    }
+
+    // a pass whose results are not used is culled, and its target is not allocated
+    {
+        RenderGraph graph;
+        TargetDesc desc;
+        desc.width = width;
+        desc.height = height;
+        RenderTarget backbuffer = graph.import("backbuffer");
+        RenderTarget a = graph.create("a", desc);
+        RenderTarget unused = graph.create("unused", desc);
+        graph.addPass("writes a", {}, {a}, nullptr);
+        graph.addPass("writes unused", {a}, {unused}, nullptr);
+        graph.addPass("composite", {a}, {backbuffer}, nullptr);
+        bool culled = graph.compile() && graph.passes()[1].culled && graph.targets()[unused].slot < 0 &&
+                      graph.slots().size() == 1;
+        std::cout << "unused pass " << (culled ? "culled" : "not culled") << std::endl;
+        passed = passed && culled;
+    }
+
+    // render on demand: the scene and the bloom go to retained targets, which have their own slots, and a cached
+    // frame is only the composite pass reading them
+    {
+        RenderGraph graph;
+        std::vector<std::string> order;
+        bool valid = runFrameGraph(graph, width, height, true, order, FRAME_RETAINED);
+        bool retained = true;
+        for (auto &target: graph.targets()) {
+            if (target.slot < 0)
+                continue;
+            bool shouldRetain = target.name == "scene" || target.name == "blur 0";
+            retained = retained && target.retained == shouldRetain &&
+                       (graph.retainedName(target.slot) == target.name) == shouldRetain;
+        }
+        // blur 0 does not take the memory of the bright parts anymore
+        bool memory = graph.memoryBytes() == pixels * 40;
+        std::cout << "retained frame: " << order.size() << " passes, " << graph.slots().size() << " textures, "
+                << graph.memoryBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+        std::cout << graph.describe();
+
+        RenderGraph cached;
+        std::vector<std::string> cachedOrder;
+        bool cachedValid = runFrameGraph(cached, width, height, true, cachedOrder, FRAME_CACHED);
+        bool composite = cachedOrder == std::vector<std::string>{"composite"} && cached.slots().size() == 2 &&
+                         !cached.retainedName(0).empty() && !cached.retainedName(1).empty() &&
+                         cached.memoryBytes() == pixels * 16;
+        std::cout << "cached frame: " << cachedOrder.size() << " pass, " << cached.slots().size() << " textures"
+                << std::endl;
+        std::cout << cached.describe();
+        passed = passed && valid && retained && memory && cachedValid && composite;
+    }
+
+    std::cout << (passed ? "PASSED" : "FAILED") << ": the passes are ordered and the targets aliased or retained"
+            << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// geometry arena (util3d/geometry_arena.h): the suballocation of its buffers, with models loaded and unloaded at
+// random. Each element of a buffer holds the id of the mesh which owns it (instead of the vertices), so a range
+// given twice, or lost by the growth or the compaction, shows up as a wrong id
+
+struct ShadowBuffer {
+    RangeAllocator ranges;
+    std::vector<int> owners;
+    // time spent in the allocator, without the checks
+    double allocatorMs = 0;
+    size_t operations = 0;
+
+    explicit ShadowBuffer(size_t capacity) : ranges(capacity), owners(capacity, -1) {}
+
+    RangeId allocate(size_t size, int owner) {
+        Timer timer;
+        RangeId id = ranges.allocate(size);
+        allocatorMs += timer.elapsedMs();
+        operations++;
+        // a larger buffer keeps the contents of the previous one
+        owners.resize(ranges.capacity(), -1);
+        std::fill(owners.begin() + ranges.offset(id), owners.begin() + ranges.offset(id) + size, owner);
+        return id;
+    }
+
+    void free(RangeId id) {
+        Timer timer;
+        ranges.free(id);
+        allocatorMs += timer.elapsedMs();
+        operations++;
+    }
+
+    void compact() {
+        // the moves go towards the start of the buffer, in order, so they can be copied in place
+        for (auto &move: ranges.compact())
+            std::copy(owners.begin() + move.source, owners.begin() + move.source + move.size,
+                      owners.begin() + move.destination);
+    }
+
+    bool owns(RangeId id, int owner) const {
+        for (size_t i = ranges.offset(id); i < ranges.offset(id) + ranges.size(id); i++)
+            if (owners[i] != owner)
+                return false;
+        return true;
+    }
+
+    // the free blocks are merged (never next to each other) and cover what the ranges do not use
+    bool consistent() const {
+        size_t free = 0, end = 0;
+        bool separated = true;
+        for (auto &block: ranges.freeList()) {
+            if (end != 0 && block.first <= end)
+                separated = false;
+            end = block.first + block.second;
+            free += block.second;
+        }
+        return separated && end <= ranges.capacity() && free + ranges.used() == ranges.capacity();
+    }
+};
+
+struct ArenaMesh {
+    int owner;
+    RangeId vertices, indices;
+};
+
+bool benchArena() {
+    const int ITERATIONS = 20000;
+    const size_t MAX_MODELS = 40;
+    std::mt19937 random(7);
+    // small initial buffers, so the growth is exercised too
+    ShadowBuffer vertices(1 << 12), indices(1 << 14);
+    std::vector<std::vector<ArenaMesh> > models;
+    int nextOwner = 0;
+    size_t loads = 0, unloads = 0, meshes = 0, peakMeshes = 0;
+    bool intact = true, consistent = true;
+    float worstFragmentation = 0;
+
+    auto checkAll = [&]() {
+        for (auto &model: models)
+            for (auto &mesh: model)
+                intact = intact && vertices.owns(mesh.vertices, mesh.owner) && indices.owns(mesh.indices, mesh.owner);
+        consistent = consistent && vertices.consistent() && indices.consistent();
+    };
+
+    for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+        bool load = models.empty() || (models.size() < MAX_MODELS && random() % 2 == 0);
+        if (load) {
+            // 1 to 8 meshes of 24 to 6000 vertices, with about 1.5 triangles per vertex
+            std::vector<ArenaMesh> model;
+            int count = 1 + static_cast<int>(random() % 8);
+            for (int m = 0; m < count; m++) {
+                size_t vertexCount = 24 + random() % 6000;
+                int owner = nextOwner++;
+                model.push_back(ArenaMesh{owner, vertices.allocate(vertexCount, owner),
+                                          indices.allocate(vertexCount * 9 / 2, owner)});
+            }
+            meshes += model.size();
+            models.push_back(model);
+            loads++;
+        } else {
+            size_t which = random() % models.size();
+            for (auto &mesh: models[which]) {
+                vertices.free(mesh.vertices);
+                indices.free(mesh.indices);
+            }
+            meshes -= models[which].size();
+            models.erase(models.begin() + which);
+            unloads++;
+        }
+        peakMeshes = std::max(peakMeshes, meshes);
+        worstFragmentation = std::max(worstFragmentation, vertices.ranges.fragmentation());
+        if ((iteration + 1) % 5000 == 0) {
+            checkAll();
+            std::cout << "after " << iteration + 1 << " loads/unloads: " << models.size() << " models, "
+                    << meshes << " meshes, vertices " << vertices.ranges.used() << "/" << vertices.ranges.capacity()
+                    << " (" << vertices.ranges.freeBlockCount() << " free blocks, fragmentation "
+                    << vertices.ranges.fragmentation() * 100.0f << "%), indices " << indices.ranges.used() << "/"
+                    << indices.ranges.capacity() << " (" << indices.ranges.freeBlockCount()
+                    << " free blocks, fragmentation " << indices.ranges.fragmentation() * 100.0f << "%)"
+                    << std::endl;
+        }
+    }
+    double allocatorMs = vertices.allocatorMs + indices.allocatorMs;
+    size_t operations = vertices.operations + indices.operations;
+    std::cout << loads << " loads and " << unloads << " unloads: " << operations << " allocations and frees in "
+            << allocatorMs << " ms (" << allocatorMs * 1e6 / operations << " ns each), worst vertex fragmentation "
+            << worstFragmentation * 100.0f << "%" << std::endl;
+    // one buffer per mesh: a vertex array, a vertex buffer and an element buffer for each one
+    std::cout << "peak " << peakMeshes << " meshes: " << 2 * peakMeshes << " buffers and " << peakMeshes
+            << " vertex arrays with the buffers of each mesh, 2 and 1 with the arena" << std::endl;
+
+    // the compaction leaves a single free block, and the meshes keep their contents
+    vertices.compact();
+    indices.compact();
+    checkAll();
+    bool compacted = vertices.ranges.fragmentation() == 0.0f && indices.ranges.fragmentation() == 0.0f &&
+                     vertices.ranges.freeBlockCount() <= 1 && indices.ranges.freeBlockCount() <= 1;
+    std::cout << "compacted: vertices " << vertices.ranges.freeBlockCount() << " free block, indices "
+            << indices.ranges.freeBlockCount() << " free block" << std::endl;
+
+    // with all the models unloaded, the free space is a single block again
+    for (auto &model: models)
+        for (auto &mesh: model) {
+            vertices.ranges.free(mesh.vertices);
+            indices.ranges.free(mesh.indices);
+        }
+    models.clear();
+    bool empty = vertices.ranges.used() == 0 && vertices.ranges.freeBlockCount() == 1 &&
+                 vertices.ranges.largestFreeBlock() == vertices.ranges.capacity() && indices.ranges.used() == 0 &&
+                 indices.ranges.freeBlockCount() == 1 && indices.ranges.allocations() == 0;
+
+    bool passed = intact && consistent && compacted && empty;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": the ranges never overlap, and the free space is merged"
+            << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// procedural level (util3d/procedural.h): fly-through of the endless backrooms, with the chunks generated on the
+// worker threads and loaded as in the application: the vertices are converted to the format of the renderer and
+// copied in a buffer suballocated with a RangeAllocator (in memory, instead of the geometry arena), and the shape
+// of the chunk is added to the compound of the level body. The frames are paced at 60 Hz, so the workers have the
+// time of real frames
+
+const uint32_t WORLD_SEED = 1234;
+
+// same layout of Vertex (util3d/mesh.h)
+struct WorldVertex {
+    glm::vec3 position, normal;
+    glm::vec2 texCoords, lightmapCoords;
+    unsigned int lightId;
+};
+
+struct WorldRun {
+    StreamerStats stats;
+    size_t maxChunks = 0, startRss = 0, middleRss = 0, endRss = 0;
+    // frames with a chunk next to the camera not loaded yet
+    unsigned int missingFrames = 0;
+    int finalRadius = 0;
+    bool unloaded = false;
+};
+
+WorldRun flyThrough(const StreamerSettings &settings, int frames, float speed) {
+    WorldRun run;
+    run.startRss = residentMemoryBytes();
+    Physics physics;
+    auto *levelShape = new btCompoundShape();
+    btRigidBody *levelBody = addLevelShape(physics, levelShape);
+    RangeAllocator vertexRanges(1 << 14), indexRanges(1 << 16);
+    std::vector<WorldVertex> vertexBuffer(vertexRanges.capacity());
+    std::vector<unsigned int> indexBuffer(indexRanges.capacity());
+    std::map<ChunkCoord, std::pair<RangeId, RangeId> > ranges;
+    btTransform identity;
+    identity.setIdentity();
+
+    {
+        ChunkStreamer streamer(WORLD_SEED, settings);
+        streamer.onLoad = [&](Chunk &chunk) {
+            size_t vertexCount = 0, indexCount = 0;
+            for (auto &mesh: chunk.meshes) {
+                vertexCount += mesh.positions.size();
+                indexCount += mesh.indices.size();
+            }
+            RangeId vertices = vertexRanges.allocate(vertexCount), indices = indexRanges.allocate(indexCount);
+            // a larger buffer keeps the contents of the previous one, like the arena
+            vertexBuffer.resize(vertexRanges.capacity());
+            indexBuffer.resize(indexRanges.capacity());
+            size_t vertex = vertexRanges.offset(vertices), index = indexRanges.offset(indices), base = 0;
+            for (auto &mesh: chunk.meshes) {
+                for (size_t i = 0; i < mesh.positions.size(); i++)
+                    vertexBuffer[vertex++] = WorldVertex{mesh.positions[i], mesh.normals[i], mesh.texCoords[i],
+                                                         glm::vec2(0.0f), mesh.lightIds[i]};
+                for (unsigned int i: mesh.indices)
+                    indexBuffer[index++] = static_cast<unsigned int>(base) + i;
+                base += mesh.positions.size();
+            }
+            ranges[chunk.coord] = std::make_pair(vertices, indices);
+            chunk.rendererBytes = vertexCount * sizeof(WorldVertex) + indexCount * sizeof(unsigned int);
+            levelShape->addChildShape(identity, chunk.shape);
+            physics.dynamicsWorld->updateSingleAabb(levelBody);
+        };
+        streamer.onUnload = [&](Chunk &chunk) {
+            auto &chunkRanges = ranges[chunk.coord];
+            vertexRanges.free(chunkRanges.first);
+            indexRanges.free(chunkRanges.second);
+            ranges.erase(chunk.coord);
+            levelShape->removeChildShape(chunk.shape);
+            physics.dynamicsWorld->updateSingleAabb(levelBody);
+        };
+
+        // a wide curve from the start cell, crossing a chunk every couple of seconds
+        const float timeStep = 1.0f / 60.0f;
+        glm::vec3 position(1.5f, 0.2f, 1.5f);
+        streamer.preload(position);
+        auto next = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            float heading = frame * 0.003f;
+            position += glm::vec3(std::cos(heading), 0.0f, std::sin(heading)) * speed * timeStep;
+            streamer.update(position);
+            physics.dynamicsWorld->stepSimulation(timeStep, 1, timeStep);
+            run.maxChunks = std::max(run.maxChunks, streamer.residentChunks().size());
+            if (streamer.stats.missing > 0)
+                run.missingFrames++;
+            if (frame == frames / 2)
+                run.middleRss = residentMemoryBytes();
+            next += std::chrono::microseconds(16667);
+            std::this_thread::sleep_until(next);
+        }
+        run.endRss = residentMemoryBytes();
+        run.finalRadius = streamer.currentRadius();
+        streamer.clear();
+        run.stats = streamer.stats;
+        run.unloaded = levelShape->getNumChildShapes() == 0 && vertexRanges.used() == 0 && indexRanges.used() == 0 &&
+                       ranges.empty();
+    }
+    physics.dynamicsWorld->removeRigidBody(levelBody);
+    delete levelBody->getMotionState();
+    delete levelBody;
+    delete levelShape;
+    return run;
+}
+
+bool benchWorld() {
+    // the same chunk from two generations, and no wall given by both of two chunks next to each other
+    std::unique_ptr<Chunk> first = generateChunk(WORLD_SEED, ChunkCoord{2, -1});
+    std::unique_ptr<Chunk> second = generateChunk(WORLD_SEED, ChunkCoord{2, -1});
+    std::unique_ptr<Chunk> neighbour = generateChunk(WORLD_SEED, ChunkCoord{3, -1});
+    bool deterministic = first->boxes.size() == second->boxes.size() && first->lights == second->lights;
+    for (int s = 0; s < CHUNK_SURFACES; s++)
+        deterministic = deterministic && first->meshes[s].positions == second->meshes[s].positions &&
+                        first->meshes[s].indices == second->meshes[s].indices;
+    bool seams = true;
+    for (auto &a: first->boxes)
+        for (auto &b: neighbour->boxes)
+            if (glm::length(a.center - b.center) < 1e-4f)
+                seams = false;
+    std::cout << "chunk of " << PROCEDURAL_CHUNK_SIZE << " m: " << first->boxes.size() << " boxes, "
+            << first->lights.size() << " lights, " << first->bytes() / 1024 << " KB, generated in "
+            << first->generationMs << " ms" << std::endl;
+
+    const int FRAMES = 360;
+    bool passed = deterministic && seams;
+    StreamerSettings settings;
+    // a budget which holds all the chunks of the radius, and one which does not
+    for (size_t budget: {size_t(32) * 1024 * 1024, size_t(1024) * 1024}) {
+        settings.memoryBudget = budget;
+        WorldRun run = flyThrough(settings, FRAMES, 12.0f);
+        const StreamerStats &stats = run.stats;
+        int side = 2 * (settings.radius + 1) + 1;
+        std::cout << "budget " << budget / 1024 << " KB, radius " << settings.radius << ", " << settings.threads
+                << " workers, " << FRAMES << " frames at 12 m/s:" << std::endl;
+        std::cout << "  generation: " << stats.generated << " chunks, " << stats.generationMs / stats.generated
+                << " ms per chunk (worst " << stats.maxGenerationMs << " ms), " << stats.discarded
+                << " discarded" << std::endl;
+        std::cout << "  loads: " << stats.loaded << " chunks, " << stats.totalLoadMs / stats.frames
+                << " ms per frame (worst " << stats.maxLoadMs << " ms), " << stats.evicted << " evicted, "
+                << stats.evictedForBudget << " for the budget (radius " << run.finalRadius << " at the end)"
+                << std::endl;
+        std::cout << "  resident: up to " << run.maxChunks << " chunks, " << stats.peakResidentBytes / 1024
+                << " KB; process " << run.startRss / (1024 * 1024) << " MB at the start, "
+                << run.middleRss / (1024 * 1024) << " MB halfway, " << run.endRss / (1024 * 1024)
+                << " MB at the end; " << run.missingFrames << " frames with a missing chunk next to the camera"
+                << std::endl;
+        passed = passed && stats.peakResidentBytes <= budget && run.maxChunks <= static_cast<size_t>(side * side) &&
+                 run.unloaded;
+    }
+    std::cout << (passed ? "PASSED" : "FAILED")
+            << ": the chunks are deterministic, their walls are not repeated, the memory stays within the budget"
+            << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// loading of the OBJ models: the importer of ASSIMP (which Model used for all the models) vs util3d/obj_loader.h, on
+// the models of the application and on a large level made of copies of backrooms.obj. The files are in the page
+// cache (they have just been read or written), so this is the time of the parsing, not of the disk
+
+// differences between the meshes of two loaders: the vertices may be joined or not, so the triangles are compared
+// corner by corner (position, normal and texture coordinates, within the rounding of the float parsers)
+struct GeometryDifference {
+    bool sameMeshes = true;
+    size_t vertices[2] = {0, 0};
+    size_t triangles = 0, different = 0;
+    // the largest relative difference of the area of a mesh: a polygon split in other triangles covers the same area
+    double areaError = 0;
+};
+
+GeometryDifference compareGeometry(const std::vector<MeshGeometry> &reference, const std::vector<MeshGeometry> &other) {
+    GeometryDifference difference;
+    difference.sameMeshes = reference.size() == other.size();
+    auto close = [](const float *a, const float *b, int count, float tolerance) {
+        for (int i = 0; i < count; i++)
+            if (std::abs(a[i] - b[i]) > tolerance * std::max(1.0f, std::abs(a[i])))
+                return false;
+        return true;
+    };
+    auto area = [](const MeshGeometry &mesh) {
+        double total = 0;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const glm::vec3 &a = mesh.positions[mesh.indices[i]];
+            total += 0.5 * glm::length(glm::cross(mesh.positions[mesh.indices[i + 1]] - a,
+                                                  mesh.positions[mesh.indices[i + 2]] - a));
+        }
+        return total;
+    };
+    for (size_t m = 0; m < std::min(reference.size(), other.size()); m++) {
+        const MeshGeometry &a = reference[m], &b = other[m];
+        difference.vertices[0] += a.positions.size();
+        difference.vertices[1] += b.positions.size();
+        difference.triangles += a.indices.size() / 3;
+        if (a.name != b.name || a.indices.size() != b.indices.size() || glm::length(a.diffuse - b.diffuse) > 1e-6f ||
+            glm::length(a.emissive - b.emissive) > 1e-6f) {
+            difference.sameMeshes = false;
+            continue;
+        }
+        for (size_t i = 0; i + 2 < a.indices.size(); i += 3) {
+            bool same = true;
+            for (int k = 0; k < 3 && same; k++) {
+                unsigned int va = a.indices[i + k], vb = b.indices[i + k];
+                same = close(&a.positions[va].x, &b.positions[vb].x, 3, 1e-6f) &&
+                       close(&a.normals[va].x, &b.normals[vb].x, 3, 1e-5f) &&
+                       close(&a.texCoords[va].x, &b.texCoords[vb].x, 2, 1e-6f);
+            }
+            difference.different += !same;
+        }
+        double areaA = area(a), areaB = area(b);
+        difference.areaError = std::max(difference.areaError, std::abs(areaA - areaB) / std::max(areaA, 1e-12));
+    }
+    return difference;
+}
+
+// a level of about targetBytes, made of copies of backrooms.obj side by side with renamed objects. The faces of half
+// of the copies use negative indices (from the end of the lists read so far), which the loaders must resolve too.
+// Returns the number of copies (0 if the files cannot be read or written)
+size_t writeLargeLevel(const std::string &source, const std::string &path, size_t targetBytes) {
+    std::ifstream input(source);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(input, line);) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        lines.push_back(line);
+    }
+    std::ofstream output(path, std::ios::binary);
+    if (lines.empty() || !output)
+        return 0;
+    // elements written so far: positions, texture coordinates, normals
+    long long counts[3] = {0, 0, 0};
+    size_t written = 0, copies = 0;
+    char buffer[128];
+    for (; written < targetBytes; copies++) {
+        long long bases[3] = {counts[0], counts[1], counts[2]};
+        glm::vec3 offset(40.0f * static_cast<float>(copies % 10), 0.0f, 40.0f * static_cast<float>(copies / 10));
+        bool relative = copies % 2 == 1;
+        std::string text;
+        for (const std::string &line: lines) {
+            if (line.compare(0, 2, "v ") == 0) {
+                glm::vec3 p;
+                std::sscanf(line.c_str() + 2, "%f %f %f", &p.x, &p.y, &p.z);
+                p += offset;
+                std::snprintf(buffer, sizeof(buffer), "v %.8f %.8f %.8f\n", p.x, p.y, p.z);
+                text += buffer;
+                counts[0]++;
+            } else if (line.compare(0, 3, "vt ") == 0 || line.compare(0, 3, "vn ") == 0) {
+                text += line + "\n";
+                counts[line[1] == 't' ? 1 : 2]++;
+            } else if (line.compare(0, 2, "f ") == 0) {
+                std::istringstream corners(line.substr(2));
+                text += "f";
+                for (std::string corner; corners >> corner;) {
+                    text += " ";
+                    // position/texture coordinates/normal, with the empty ones kept
+                    size_t start = 0;
+                    for (int attribute = 0; attribute < 3 && start <= corner.size(); attribute++) {
+                        size_t slash = std::min(corner.find('/', start), corner.size());
+                        if (slash > start) {
+                            long long index = std::stoll(corner.substr(start, slash - start)) + bases[attribute];
+                            text += std::to_string(relative ? index - counts[attribute] - 1 : index);
+                        }
+                        if (slash < corner.size())
+                            text += "/";
+                        start = slash + 1;
+                    }
+                }
+                text += "\n";
+            } else if (line.compare(0, 2, "o ") == 0) {
+                text += line + "_" + std::to_string(copies) + "\n";
+            } else if (line.compare(0, 6, "mtllib") != 0 || copies == 0) {
+                text += line + "\n";
+            }
+        }
+        output << text;
+        written += text.size();
+    }
+    return output ? copies : 0;
+}
+
+bool benchObjLoader() {
+    const size_t LARGE_BYTES = 100 * 1024 * 1024;
+    // next to backrooms.obj, for its material library
+    const std::string large = "backrooms_map/obj_benchmark_large.obj";
+    size_t copies = writeLargeLevel("backrooms_map/backrooms.obj", large, LARGE_BYTES);
+    std::cout << "large level: " << copies << " copies of backrooms.obj" << std::endl;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool passed = copies > 0;
+
+    for (const std::string &path: {std::string("backrooms_map/backrooms.obj"), std::string("models/sphere.obj"),
+                                   std::string("models/newscene.obj"), large}) {
+        Timer timer;
+        std::vector<MeshGeometry> assimp = loadGeometryAssimp(path);
+        double assimpMs = timer.elapsedMs();
+        ObjModel model;
+        timer.reset();
+        bool loaded = loadObj(path, model, 1);
+        double singleMs = timer.elapsedMs();
+        timer.reset();
+        loaded = loadObj(path, model, threads) && loaded;
+        double parallelMs = timer.elapsedMs();
+        std::vector<MeshGeometry> fast = geometryFromObj(model);
+        GeometryDifference difference = compareGeometry(assimp, fast);
+        // a polygon of more than 4 corners may be split differently (fan vs ear clipping), on the same surface
+        bool identical = difference.sameMeshes && difference.different == 0;
+        bool sameSurface = difference.sameMeshes && difference.areaError < 1e-5;
+        passed = passed && loaded && !assimp.empty() && (identical || sameSurface);
+
+        std::cout << path << " (" << std::fixed << std::setprecision(1)
+                << static_cast<double>(model.fileBytes) / (1024.0 * 1024.0) << " MB): ASSIMP " << assimpMs
+                << " ms, fast path " << singleMs << " ms on 1 thread, " << parallelMs << " ms on " << threads
+                << " (map " << model.mapMs << ", parse " << model.parseMs << ", meshes " << model.buildMs
+                << " ms), " << assimpMs / std::max(parallelMs, 1e-3) << "x" << std::defaultfloat << std::endl;
+        std::cout << "    " << fast.size() << " meshes, " << difference.triangles << " triangles, vertices "
+                << difference.vertices[0] << " -> " << difference.vertices[1] << " joined; "
+                << (identical ? "identical triangles" :
+                    sameSurface ? std::to_string(difference.different) + " triangles split differently, same surface" :
+                    "DIFFERENT GEOMETRY") << std::endl;
+    }
+    std::remove(large.c_str());
+
+    std::cout << (passed ? "PASSED" : "FAILED")
+            << ": the fast path loads the same meshes, materials and triangles of ASSIMP" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// input latency (util3d/latency.h) with a model of the frame loop: the events are polled at the start of the frame,
+// the simulation and the wait for the queries take WORK_MS before the scene is submitted, the frame is swapped at
+// the end of its period and the GPU finishes it a bit later. The same scripted input is replayed without and with the
+// late latch (the events polled again after the work): the late latch must save about the time of the work
+
+bool benchLatency() {
+    const double FRAME_MS = 16.7, WORK_MS = 8.0, GPU_MS = 20.0;
+    const double REPLAY_SECONDS = 10.0, REPLAY_RATE = 500.0;
+    bool passed = true;
+    LatencyTracker runs[2];
+    for (int late = 0; late < 2; late++) {
+        LatencyTracker &tracker = runs[late];
+        InputReplay replay(REPLAY_SECONDS, REPLAY_RATE);
+        replay.start(0.0);
+        size_t delivered = 0;
+        auto poll = [&](double now) {
+            delivered += replay.deliver(now, [&](const ReplayEvent &, double time) {
+                tracker.input(time);
+            });
+        };
+        // the GPU end of each frame is known 2 frames later, as with the queries of the application
+        std::deque<std::pair<unsigned int, double> > gpuEnds;
+        unsigned int frame = 0;
+        for (double start = 0.0; !replay.finished() || start < REPLAY_SECONDS * 1000.0 + 3 * FRAME_MS;
+             start += FRAME_MS, frame++) {
+            if (gpuEnds.size() == 2) {
+                tracker.gpuDone(gpuEnds.front().first, gpuEnds.front().second);
+                gpuEnds.pop_front();
+            }
+            poll(start / 1000.0);
+            tracker.latch(start / 1000.0);
+            if (late) {
+                poll((start + WORK_MS) / 1000.0);
+                tracker.latch((start + WORK_MS) / 1000.0);
+            }
+            tracker.endFrame(frame, (start + FRAME_MS) / 1000.0, true);
+            gpuEnds.push_back({frame, (start + GPU_MS) / 1000.0});
+        }
+        std::cout << (late ? "late latch" : "latch at the start of the frame") << ", " << delivered << " events"
+                << std::endl;
+        std::cout << "  input to latch: " << tracker.toLatch.summary() << std::endl;
+        std::cout << "  input to swap:  " << tracker.toSwap.summary() << std::endl;
+        std::cout << "  input to GPU:   " << tracker.toGpu.summary() << std::endl;
+        std::cout << tracker.toGpu.bars(40);
+        // each event is counted once in each histogram (the GPU end of the last 2 frames is never read, but they
+        // come after the end of the replay)
+        passed = passed && tracker.toLatch.count() == delivered && tracker.toSwap.count() == delivered &&
+                 tracker.toGpu.count() == delivered;
+    }
+    double savedMs = runs[0].toSwap.mean() - runs[1].toSwap.mean();
+    double savedP99 = runs[0].toGpu.percentile(0.99) - runs[1].toGpu.percentile(0.99);
+    std::cout << "the late latch saves " << savedMs << " ms on average, " << savedP99 << " ms at the 99th percentile"
+            << std::endl;
+    // the events during the work (WORK_MS / FRAME_MS of them) are shown a frame earlier
+    passed = passed && std::abs(savedMs - WORK_MS) < 0.5 && savedP99 >= 0.0;
+    // the histogram itself: nearest rank percentiles
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 100; i++)
+        histogram.add(i);
+    passed = passed && histogram.percentile(0.5) == 50 && histogram.percentile(0.99) == 99 &&
+             histogram.percentile(1.0) == 100 && std::abs(histogram.mean() - 50.5) < 1e-9;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": the late latch shows the inputs a frame earlier" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// frame limiter (util3d/frame_pacer.h): frames with a random amount of work, paced at 120 fps by the limiter and by a
+// plain sleep for the rest of the period. The starts of the frames should keep the period with the limiter (the plain
+// sleep drifts by its lateness at each frame), but this depends on the load of the machine: the times are only
+// printed, and the group checks the parts which do not depend on the clock (the snapping and the statistics)
+
+bool benchPacing() {
+    const double FPS = 120.0, PERIOD_MS = 1000.0 / FPS;
+    const int FRAMES = 240;
+    typedef std::chrono::steady_clock Clock;
+    auto work = [](double ms) {
+        Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                    std::chrono::duration<double, std::milli>(ms));
+        while (Clock::now() < end) {
+        }
+    };
+    FrameTimeStats results[2];
+    for (int limited = 1; limited >= 0; limited--) {
+        std::default_random_engine generator(5);
+        std::uniform_real_distribution<double> workMs(0.0, PERIOD_MS * 0.6);
+        FrameLimiter limiter;
+        FrameTimeStats &times = results[limited];
+        Clock::time_point first = Clock::now(), previous = first, frameStart = first;
+        for (int frame = 0; frame <= FRAMES; frame++) {
+            if (limited) {
+                limiter.wait(FPS);
+            } else if (frame > 0) {
+                double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+                if (elapsed < PERIOD_MS)
+                    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(PERIOD_MS - elapsed));
+            }
+            frameStart = Clock::now();
+            if (frame == 0)
+                first = frameStart;
+            else
+                times.add(std::chrono::duration<double, std::milli>(frameStart - previous).count());
+            previous = frameStart;
+            work(workMs(generator));
+        }
+        double totalMs = std::chrono::duration<double, std::milli>(previous - first).count();
+        std::cout << (limited ? "limiter:     " : "plain sleep: ") << times.summary() << ", "
+                << FRAMES * 1000.0 / totalMs << " fps";
+        if (limited)
+            std::cout << " (slept " << limiter.sleptMs << " ms, spun " << limiter.spunMs << " ms, margin "
+                    << limiter.spinMargin() << " ms, " << limiter.misses << " misses)";
+        std::cout << std::endl;
+    }
+    // on an idle machine the limiter keeps the rate within 2% and most frames within 0.1 ms of the period
+    std::cout << "limiter rate off by " << std::abs(results[1].mean() - PERIOD_MS) / PERIOD_MS * 100.0
+            << "%, median frame off by " << std::abs(results[1].percentile(0.5) - PERIOD_MS) << " ms" << std::endl;
+
+    // the measured deltas snap to the period of the display only when they are close to a multiple of it
+    const double refresh = 1.0 / 60.0;
+    bool snapped = snapFrameDelta(refresh * 1.03, refresh) == refresh &&
+                   snapFrameDelta(refresh * 1.97, refresh) == 2.0 * refresh &&
+                   snapFrameDelta(refresh * 1.5, refresh) == refresh * 1.5 &&
+                   snapFrameDelta(refresh * 0.5, refresh) == refresh * 0.5 &&
+                   snapFrameDelta(refresh * 1.03, 0.0) == refresh * 1.03;
+    std::cout << "delta snapping " << (snapped ? "ok" : "wrong") << std::endl;
+    // the standard deviation of known values
+    FrameTimeStats known;
+    for (double ms: {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0})
+        known.add(ms);
+    bool statistics = std::abs(known.mean() - 5.0) < 1e-12 &&
+                      std::abs(known.stddev() - std::sqrt(32.0 / 7.0)) < 1e-12 &&
+                      known.percentile(0.5) == 4.0 && known.percentile(1.0) == 9.0;
+    // past MAX_SAMPLES the percentiles are those of the last samples, the mean of all of them
+    FrameTimeStats ring;
+    for (size_t i = 0; i < FrameTimeStats::MAX_SAMPLES + 100; i++)
+        ring.add(static_cast<double>(i));
+    statistics = statistics && ring.count() == FrameTimeStats::MAX_SAMPLES + 100 && ring.percentile(0.0) == 100.0 &&
+                 ring.percentile(1.0) == FrameTimeStats::MAX_SAMPLES + 99.0 &&
+                 std::abs(ring.mean() - (FrameTimeStats::MAX_SAMPLES + 99) / 2.0) < 1e-6;
+    std::cout << "statistics " << (statistics ? "ok" : "wrong") << std::endl;
+    bool passed = snapped && statistics;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": the frame deltas snap and the statistics are exact" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// camera path of the render benchmark (util3d/camera_path.h): the poses pass through the keys, the yaw takes the
+// shortest turn, the shots are fired once over the fixed steps, and the text file gives back the same path. The
+// flicker of the lights from the same seed must also repeat, so that two runs draw the same frames
+bool benchCameraPath() {
+    CameraPath path;
+    path.addKey({0.0f, glm::vec3(0.0f, 1.5f, 0.0f), 170.0f, 0.0f});
+    path.addKey({1.0f, glm::vec3(2.0f, 1.5f, 0.0f), -170.0f, 10.0f});
+    path.addKey({2.0f, glm::vec3(2.0f, 1.5f, 2.0f), -90.0f, 0.0f});
+    path.addKey({2.0f, glm::vec3(9.0f), 0.0f, 0.0f});
+    path.addShot(0.5f);
+    path.addShot(1.0f);
+    path.addShot(1.75f);
+
+    bool keys = path.keys.size() == 3 && path.duration() == 2.0f &&
+                glm::length(path.sample(1.0f).position - path.keys[1].position) < 1e-5f &&
+                glm::length(path.sample(-1.0f).position - path.keys[0].position) < 1e-5f &&
+                glm::length(path.sample(5.0f).position - path.keys[2].position) < 1e-5f;
+    // from 170 to -170 degrees through 180, not through 0
+    float yaw = path.sample(0.5f).yaw;
+    bool turn = std::abs(std::remainder(yaw - 180.0f, 360.0f)) < 1e-3f && std::abs(path.sample(0.5f).pitch - 5) < 1e-4f;
+
+    const float step = 1.0f / 60.0f;
+    size_t fired = 0;
+    for (unsigned int frame = 0; frame * step <= path.duration(); frame++)
+        fired += path.shotsBetween(frame * step - step, frame * step);
+
+    const char *file = "camera_path_check.txt";
+    CameraPath loaded;
+    bool roundTrip = path.save(file) && loaded.load(file) && loaded.keys.size() == path.keys.size() &&
+                     loaded.shots == path.shots;
+    for (size_t i = 0; roundTrip && i < path.keys.size(); i++)
+        roundTrip = loaded.keys[i].time == path.keys[i].time && loaded.keys[i].position == path.keys[i].position &&
+                    loaded.keys[i].yaw == path.keys[i].yaw && loaded.keys[i].pitch == path.keys[i].pitch;
+    std::remove(file);
+
+    // the default path: at walking speed, looking at the next point
+    CameraPath through = pathThrough({glm::vec3(0.0f), glm::vec3(3.0f, 2.0f, 0.0f), glm::vec3(3.0f, 2.0f, 3.0f)},
+                                     1.5f, 1.5f, 0.5f);
+    bool walking = through.keys.size() == 3 && std::abs(through.duration() - 4.0f) < 1e-5f &&
+                   through.keys[0].position.y == 1.5f && std::abs(through.keys[1].yaw - 90.0f) < 1e-4f &&
+                   through.shots.size() == 6;
+
+    bool repeated = true;
+    CeilingLightFlicker first(7), second(7);
+    glm::vec3 roomA(0.35f), roomB(0.35f);
+    std::vector<glm::vec3> a[3], b[3];
+    for (int i = 0; i < 3; i++)
+        a[i] = b[i] = std::vector<glm::vec3>(25, glm::vec3(0.0f));
+    for (int frame = 0; frame < 1200 && repeated; frame++) {
+        first.update(step, roomA, a[0], a[1], a[2]);
+        second.update(step, roomB, b[0], b[1], b[2]);
+        repeated = roomA == roomB && a[0] == b[0] && a[1] == b[1] && first.ceiling == second.ceiling;
+    }
+
+    std::cout << "keys " << (keys ? "ok" : "wrong") << ", yaw " << yaw << " at the middle of the turn, " << fired
+            << " of " << path.shots.size() << " shots fired, file " << (roundTrip ? "ok" : "wrong")
+            << ", default path of " << through.duration() << " s, flicker " << (repeated ? "repeated" : "different")
+            << std::endl;
+    bool passed = keys && turn && fired == path.shots.size() && roundTrip && walking && repeated;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": the camera path plays back the recorded poses and shots"
+            << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// micro benchmarks of the hot paths of the CPU side of the application, to compare between commits (--json): the
+// loading of each model (the parsing, without the upload of Model), the collision structures of the level, the
+// collision pass of the bullets, the matrices of the splats, the flicker of the lights and the per-instance uniform
+// loop of the splats (the matrices computed and copied as glUniform would, without a context)
+bool benchMicro() {
+    const char *assets[] = {"models/sphere.obj", "models/newscene.obj", "backrooms_map/backrooms.obj"};
+    bool passed = true;
+    for (const char *path: assets) {
+        std::vector<MeshGeometry> reference = loadGeometry(path);
+        size_t triangles = collectTriangles(reference).size() / 3;
+        passed = passed && triangles > 0;
+        printBenchResult(runBenchmark(std::string("micro/load obj ") + path, triangles, 5, [&] {
+            ObjModel model;
+            loadObj(path, model);
+        }));
+        printBenchResult(runBenchmark(std::string("micro/load assimp ") + path, triangles, 3, [&] {
+            loadGeometryAssimp(path);
+        }));
+    }
+
+    std::vector<MeshGeometry> level = loadGeometry("backrooms_map/backrooms.obj");
+    std::vector<glm::vec3> triangles = collectTriangles(level);
+    size_t levelTriangles = triangles.size() / 3;
+    printBenchResult(runBenchmark("micro/level btBvhTriangleMeshShape", levelTriangles, 5, [&] {
+        btBvhTriangleMeshShape *shape = createTriangleMeshShape(level);
+        delete shape->getMeshInterface();
+        delete shape;
+    }));
+    printBenchResult(runBenchmark("micro/level bvh build", levelTriangles, 5, [&] {
+        Bvh bvh;
+        bvh.build(triangles);
+    }));
+
+    // 10 s of fire at 60 steps per second, 5 shots per step, as in the loop of the application
+    {
+        const int steps = 600, shotsPerStep = 5;
+        std::vector<HitscanShot> shots = makeShots(steps * shotsPerStep, 11);
+        Physics physics;
+        EntityWorld world;
+        btRigidBody *levelBody = addLevel(physics, level);
+        BulletLifecycle lifecycle;
+        setKillVolume(lifecycle, levelBody, 5.0f);
+        size_t impacts = 0;
+        printBenchResult(runBenchmark("micro/bullet collision pass (600 steps)", steps, 3, [&] {
+            float time = 0;
+            for (int step = 0; step < steps; step++) {
+                for (int i = 0; i < shotsPerStep; i++) {
+                    const HitscanShot &shot = shots[step * shotsPerStep + i];
+                    spawnBullet(world, physics, shot.origin, shot.direction, BULLET_SPEED, time);
+                }
+                physics.dynamicsWorld->stepSimulation(1.0f / 60.0f, 10);
+                syncBulletsFromPhysics(world.bullets);
+                impacts += collideBulletsWithLevel(world, physics, levelBody);
+                reclaimBullets(world, physics, lifecycle, time);
+                time += 1.0f / 60.0f;
+            }
+            destroyAllBullets(world, physics);
+            world.splats = SplatArchetype();
+        }));
+        std::cout << "  " << impacts / 3 << " impacts per run" << std::endl;
+        passed = passed && impacts > 0;
+    }
+
+    // splats on random surfaces
+    const size_t splatCount = 10000;
+    std::default_random_engine generator(5);
+    std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+    std::vector<glm::vec3> contacts, normals;
+    for (size_t i = 0; i < splatCount; i++) {
+        contacts.push_back(glm::vec3(coord(generator), coord(generator), coord(generator)));
+        normals.push_back(glm::normalize(glm::vec3(coord(generator), coord(generator), coord(generator))));
+    }
+    SplatArchetype splats;
+    printBenchResult(runBenchmark("micro/splat matrices", splatCount, 5, [&] {
+        splats = SplatArchetype();
+        splats.reserve(splatCount);
+        for (size_t i = 0; i < splatCount; i++)
+            spawnSplat(splats, contacts[i], normals[i], -normals[i]);
+    }));
+
+    // 10 minutes of lights at 60 frames per second
+    {
+        const int frames = 36000;
+        EntityWorld lights;
+        initCeilingLights(lights.lights);
+        glm::vec3 roomAmbient(0.35f);
+        float ceilingSum = 0;
+        printBenchResult(runBenchmark("micro/light flicker (10 min)", frames, 5, [&] {
+            CeilingLightFlicker flicker;
+            for (int f = 0; f < frames; f++) {
+                flicker.update(1.0f / 60.0f, roomAmbient, lights.lights.column<LIGHT_AMBIENT>(),
+                               lights.lights.column<LIGHT_DIFFUSE>(), lights.lights.column<LIGHT_SPECULAR>());
+                ceilingSum += flicker.ceiling;
+            }
+            passed = passed && flicker.warmedUp();
+        }));
+        passed = passed && ceilingSum > 0;
+    }
+
+    // the loop of the splats drawn as meshes: the normal matrix of each one, and the copy of both matrices to the
+    // uniforms (here a buffer of the same size)
+    {
+        glm::mat4 view = glm::lookAt(glm::vec3(0, 1.5f, 0), glm::vec3(1, 1.5f, 1), glm::vec3(0, 1, 0));
+        const auto &model = splats.column<SPLAT_MODEL>();
+        std::vector<float> uniforms(16 + 9);
+        double checksum = 0;
+        printBenchResult(runBenchmark("micro/splat uniform loop", model.size(), 5, [&] {
+            for (size_t i = 0; i < model.size(); i++) {
+                glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(view * model[i]));
+                std::memcpy(uniforms.data(), &model[i][0][0], 16 * sizeof(float));
+                std::memcpy(uniforms.data() + 16, &normalMatrix[0][0], 9 * sizeof(float));
+                checksum += uniforms[16];
+            }
+        }));
+        passed = passed && std::isfinite(checksum);
+    }
+
+    std::cout << (passed ? "PASSED" : "FAILED") << ": the micro benchmarks ran on all the models" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+struct BenchGroup {
+    std::string name;
+    // returns false if a check of the group failed
+    std::function<bool()> run;
+};
+
+int main(int argc, char **argv) {
+    std::vector<BenchGroup> groups = {
+        {"entities", [] {
+            benchEntities(10000);
+            benchEntities(100000);
+            return true;
+        }},
+        {"firing", [] {
+            benchFiring();
+            return true;
+        }},
+        {"proxy", [] {
+            benchCollisionProxy();
+            return true;
+        }},
+        {"occlusion", benchOcclusion},
+        {"probes", benchProbes},
+        {"lights", benchLightAssignment},
+        {"lod", benchLod},
+        {"resolution", benchDynamicResolution},
+        {"graph", benchRenderGraph},
+        {"latency", benchLatency},
+        {"pacing", benchPacing},
+        {"path", benchCameraPath},
+        {"micro", benchMicro},
+        {"arena", benchArena},
+        {"world", benchWorld},
+        {"obj", benchObjLoader},
+        {"soak", soakBullets},
+        {"leak", leakCheck},
+        {"allocations", [] {
+            benchAllocations();
+            return true;
+        }},
+    };
+
+    std::string selected, jsonPath;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else
+            selected = argument;
+    }
+    bool found = false, passed = true;
+    std::vector<std::pair<std::string, bool> > outcomes;
+    for (auto &group : groups) {
+        if (!selected.empty() && group.name != selected)
+            continue;
+        found = true;
+        std::cout << "== " << group.name << " ==" << std::endl;
+        bool groupPassed = group.run();
+        outcomes.push_back({group.name, groupPassed});
+        passed = groupPassed && passed;
+    }
+    if (!found) {
+        std::cout << "unknown benchmark: " << selected << std::endl;
+        return 1;
+    }
+    if (!jsonPath.empty()) {
+        std::ofstream json(jsonPath);
+        writeBenchJson(json, benchResults(), outcomes);
+        std::cout << "results written to " << jsonPath << std::endl;
+    }
+    return passed ? 0 : 1;
+}
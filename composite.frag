@@ -0,0 +1,137 @@
+/*
+composite.frag: the whole post-processing after the bloom blur, in a single pass to the default framebuffer:
+bloom add and tone mapping (with the upscale of the dynamic resolution), crosshair overlay, and the VHS effect of
+the game and of the pause screen.
+The VHS effect is based on https://www.shadertoy.com/view/ldXGW4; its simplex noise is read from a tiling noise
+texture (see util3d/noise.h) instead of being computed in the shader.
+*/
+
+#version 410 core
+
+in vec2 TexCoords;
+out vec4 fragColor;
+
+// scene and blurred bright parts (see util3d/dynamic_resolution.h for uvScale)
+uniform sampler2D scene;
+uniform sampler2D bloomBlur;
+uniform bool bloom;
+uniform float exposure;
+uniform vec2 uvScale = vec2(1.0);
+uniform float sharpness = 0.0;
+
+// crosshair, over the whole screen
+uniform sampler2D crosshair;
+// pause screen
+uniform sampler2D overlay;
+
+uniform sampler2D noiseTexture;
+// lattice cells of the noise across the texture
+uniform float noisePeriod;
+uniform float iTime;
+
+// change these values to 0.0 to turn off individual effects
+uniform float vertJerkOpt = 0.1;
+uniform float vertMovementOpt = 0.0;
+uniform float bottomStaticOpt = 0.1;
+uniform float scalinesOpt = 0.2;
+uniform float rgbOffsetOpt = 0.1;
+uniform float horzFuzzOpt = 0.3;
+uniform float desaturate = 0.0;
+
+const float gamma = 2.2;
+
+// noise in [-1, 1], with features of about 1 unit like the simplex noise it replaces
+float noise(vec2 v)
+{
+    return texture(noiseTexture, fract(v / noisePeriod)).r;
+}
+
+// bloom, tone mapping and gamma of a point of the scene
+vec3 toneMapped(vec2 uv)
+{
+    vec3 hdrColor = texture(scene, uv).rgb;
+    if(bloom)
+    hdrColor += texture(bloomBlur, uv).rgb; // additive blending
+    vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
+    return pow(result, vec3(1.0 / gamma));
+}
+
+// final image before the VHS effect: upscaled (and sharpened) scene, with the crosshair
+vec3 image(vec2 uv)
+{
+    vec2 texel = 1.0 / textureSize(scene, 0);
+    vec2 uvMax = uvScale - 0.5 * texel;
+    vec2 source = min(uv * uvScale, uvMax);
+    vec3 color = toneMapped(source);
+    if (sharpness > 0.0)
+    {
+        // unsharp mask with the 4 neighbours of the source texel
+        vec3 neighbours = toneMapped(min(source + vec2(texel.x, 0.0), uvMax)) + toneMapped(source - vec2(texel.x, 0.0))
+                        + toneMapped(min(source + vec2(0.0, texel.y), uvMax)) + toneMapped(source - vec2(0.0, texel.y));
+        color = clamp(color + sharpness * (4.0 * color - neighbours), 0.0, 1.0);
+    }
+    vec4 crosshairColor = texture(crosshair, uv);
+    return mix(color, crosshairColor.rgb, crosshairColor.a);
+}
+
+float staticV(vec2 uv) {
+    float staticHeight = noise(vec2(9.0,iTime*1.2+3.0))*0.3+5.0;
+    float staticAmount = noise(vec2(1.0,iTime*1.2-6.0))*0.1+0.3;
+    float staticStrength = noise(vec2(-9.75,iTime*0.6-3.0))*2.0+2.0;
+    return (1.0-step(noise(vec2(5.0*pow(iTime,2.0)+pow(uv.x*7.0,1.2),pow((mod(iTime,100.0)+100.0)*uv.y*0.3+3.0,staticHeight))),staticAmount))*staticStrength;
+}
+
+void main()
+{
+    vec2 uv = TexCoords;
+
+    float fuzzOffset = noise(vec2(iTime*15.0,uv.y*80.0))*0.003;
+    float largeFuzzOffset = noise(vec2(iTime*1.0,uv.y*25.0))*0.004;
+
+    float vertMovementOn = (1.0-step(noise(vec2(iTime*0.2,8.0)),0.4))*vertMovementOpt;
+    float vertJerk = (1.0-step(noise(vec2(iTime*1.5,5.0)),0.6))*vertJerkOpt;
+    float vertJerk2 = (1.0-step(noise(vec2(iTime*5.5,5.0)),0.2))*vertJerkOpt;
+    float yOffset = abs(sin(iTime)*4.0)*vertMovementOn+vertJerk*vertJerk2*0.3;
+    float y = mod(uv.y+yOffset,1.0);
+
+    float xOffset = (fuzzOffset + largeFuzzOffset) * horzFuzzOpt;
+
+    float staticVal = 0.0;
+
+    for (float y = -1.0; y <= 1.0; y += 1.0) {
+        float maxDist = 5.0/200.0;
+        float dist = y/200.0;
+        staticVal += staticV(vec2(uv.x,uv.y+dist))*(maxDist-abs(dist))*1.5;
+    }
+
+    staticVal *= bottomStaticOpt;
+
+    // the channels are shifted apart: without the shift, the image is composed only once
+    vec3 color;
+    if (rgbOffsetOpt > 0.0)
+    {
+        color.r = image(vec2(uv.x + xOffset -0.01*rgbOffsetOpt,y)).r;
+        color.g = image(vec2(uv.x + xOffset,                   y)).g;
+        color.b = image(vec2(uv.x + xOffset +0.01*rgbOffsetOpt,y)).b;
+    }
+    else
+        color = image(vec2(uv.x + xOffset, y));
+    color += staticVal;
+
+    vec3 desaturated = vec3(0.21 * color.r + 0.72 * color.g + 0.07 * color.b);
+
+    color = mix(color,desaturated,desaturate);
+
+    bool isPaused = desaturate>0;
+
+    if(isPaused)
+    {
+        vec4 pauseOverlay = texture(overlay, uv);
+        color = mix(color,pauseOverlay.rgb,pauseOverlay.a);
+    }
+
+    float scanline = sin(uv.y*800.0)*0.04*scalinesOpt;
+    color -= scanline;
+
+    fragColor = vec4(color,1.0);
+}
@@ -0,0 +1,62 @@
+/*
+decal.frag: paints the surface of the scene inside the box of a splat (see util3d/decals.h).
+The lighting is the one of the splat meshes from the irradiance probes (calcProbeLighting of shader.frag)
+*/
+
+#version 410 core
+
+// copy of the depth buffer of the scene (the level)
+uniform sampler2D sceneDepth;
+// size of the render targets, and of the part drawn at the current render scale (the viewport)
+uniform vec2 targetSize;
+uniform vec2 renderSize;
+// clip space -> world
+uniform mat4 invViewProjection;
+
+// colors of the splat material
+uniform vec3 decalDiffuse;
+uniform vec3 decalSpecular;
+
+// irradiance probes (see util3d/probes.h)
+uniform sampler3D probeIrradiance;
+uniform sampler3D probeSpecular;
+uniform vec3 probeGridOrigin;
+uniform vec3 probeGridScale;
+uniform vec3 probeGridOffset;
+
+flat in mat4 vInvBox;
+flat in vec3 vDecalNormal;
+
+const float gamma = 2.2;
+
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+void main(void)
+{
+    // world position of the visible surface
+    float depth = texture(sceneDepth, gl_FragCoord.xy / targetSize).r;
+    vec2 ndc = gl_FragCoord.xy / renderSize * 2.0 - 1.0;
+    vec4 world = invViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec3 worldPos = world.xyz / world.w;
+    // the derivatives are taken before any discard
+    vec3 surfaceNormal = normalize(cross(dFdx(worldPos), dFdy(worldPos)));
+
+    vec3 local = (vInvBox * vec4(worldPos, 1.0)).xyz;
+    if (any(greaterThan(abs(local), vec3(1.0))) || dot(local.xy, local.xy) > 1.0)
+        discard;
+    // surfaces at a steep angle with the splat (e.g. the wall next to a splat on the floor) are not painted
+    if (abs(dot(surfaceNormal, vDecalNormal)) < 0.5)
+        discard;
+
+    // same normal of the splat mesh in shader.vert
+    vec3 normal = abs(vDecalNormal.zyx);
+    vec3 uvw = (worldPos - probeGridOrigin) * probeGridScale + probeGridOffset;
+    vec4 sh = texture(probeIrradiance, uvw);
+    float specular = texture(probeSpecular, uvw).r;
+    float diffuse = max(sh.x + dot(sh.yzw, normal), 0.0);
+    vec3 result = diffuse * pow(decalDiffuse, vec3(gamma)) + specular * pow(decalSpecular, vec3(gamma));
+
+    BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    FragColor = vec4(result, 1.0);
+}
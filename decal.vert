@@ -0,0 +1,25 @@
+/*
+decal.vert: box of a paint splat decal, one instance per splat (see util3d/decals.h)
+*/
+
+#version 410 core
+
+// unit cube
+layout (location = 0) in vec3 position;
+// per instance: unit cube -> world, and world -> unit cube
+layout (location = 1) in mat4 box;
+layout (location = 5) in mat4 invBox;
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+flat out mat4 vInvBox;
+// axis of the splat (normal of its disc)
+flat out vec3 vDecalNormal;
+
+void main()
+{
+    vInvBox = invBox;
+    vDecalNormal = normalize(vec3(box[2]));
+    gl_Position = projectionMatrix * viewMatrix * box * vec4(position, 1.0);
+}
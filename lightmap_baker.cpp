@@ -0,0 +1,612 @@
+/*
+lightmap_baker
+
+offline baker of the lighting of the 25 ceiling lights on the level (see util3d/lightmap.h for what is stored).
+1) the triangles of the level are grouped in planar charts (polygons and coplanar neighbours), each chart is projected
+   on its plane and the charts are packed in an atlas (the "UV2" lightmap coordinates of the vertices)
+2) each texel of the atlas covered by a chart gets the world position and the normal of its point of the level, and
+   for each light the attenuation and the shadowed diffuse term are computed, tracing a shadow ray on a BVH of the
+   level. The texels are distributed on a pool of threads
+3) the empty texels around the charts are filled with the values of their neighbours (bilinear filtering at the
+   borders of the charts), and the result is written to backrooms_map/backrooms.lightmap
+
+Usage: lightmap_baker [options]
+  --texels-per-meter N   resolution of the lightmap (default 5)
+  --threads N            number of threads (default: all the hardware threads)
+  --no-shadows           skip the shadow rays (the result must match the forward lighting of shader.frag)
+  --scaling              bake with 1, 2, 4, ... threads and report time and speedup
+  --diff                 ray trace some views of the level, lit by the forward formula and by the lightmap, and
+                         write them with their difference as PPM images (lightmap_diff_N_*.ppm)
+  --output PATH          output file
+
+Real-Time Graphics Programming - a.a. 2023/2024
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "util3d/entities.h"
+#include "util3d/geometry.h"
+#include "util3d/bvh.h"
+#include "util3d/lightmap.h"
+#include "util3d/benchmark.h"
+
+struct BakeSettings {
+    float texelsPerMeter = 5.0f;
+    // empty texels around each chart, filled by the dilation
+    int padding = 1;
+    bool shadows = true;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    // offset of the origin of the shadow rays, to avoid hitting the surface of the texel itself
+    float shadowBias = 0.01f;
+};
+
+struct BakeLight {
+    glm::vec3 position;
+    // constant, linear, quadratic
+    glm::vec3 attenuation;
+};
+
+// point of the level seen by a texel
+struct TexelSample {
+    glm::vec3 position;
+    // interpolated vertex normal, not normalized like vNormal in the fragment shader
+    glm::vec3 normal;
+    // distance (texels) of the texel center from the triangle, 0 if inside: the closest triangle wins
+    float distance = 0.0f;
+    bool valid = false;
+};
+
+struct Atlas {
+    uint32_t width = 0, height = 0;
+    size_t charts = 0;
+    std::vector<TexelSample> samples;
+    // lightmap coordinates of the vertices, per mesh
+    std::vector<std::vector<glm::vec2> > coords;
+};
+
+//////////////////////////////////////////
+// 1) charts and atlas
+
+class DisjointSets {
+public:
+    explicit DisjointSets(size_t size) : parent(size) {
+        std::iota(parent.begin(), parent.end(), 0);
+    }
+
+    size_t find(size_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void merge(size_t a, size_t b) {
+        a = find(a);
+        b = find(b);
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+
+private:
+    std::vector<size_t> parent;
+};
+
+struct Chart {
+    std::vector<size_t> triangles;
+    glm::vec3 tangent, bitangent;
+    glm::vec2 min, max;
+    // position of the chart in the atlas (texels)
+    int x = 0, y = 0, width = 0, height = 0;
+};
+
+std::array<long long, 3> quantize(const glm::vec3 &p) {
+    return {std::llround(p.x * 1e4), std::llround(p.y * 1e4), std::llround(p.z * 1e4)};
+}
+
+Atlas buildAtlas(const std::vector<MeshGeometry> &meshes, const BakeSettings &settings) {
+    // all the triangles of the level: mesh and first index of each one
+    std::vector<std::pair<unsigned int, size_t> > triangles;
+    for (unsigned int m = 0; m < meshes.size(); m++)
+        for (size_t i = 0; i + 2 < meshes[m].indices.size(); i += 3)
+            triangles.push_back({m, i});
+    auto vertexOf = [&](size_t t, int k) {
+        const MeshGeometry &mesh = meshes[triangles[t].first];
+        return mesh.positions[mesh.indices[triangles[t].second + k]];
+    };
+    std::vector<glm::vec3> faceNormals(triangles.size());
+    for (size_t t = 0; t < triangles.size(); t++) {
+        glm::vec3 n = glm::cross(vertexOf(t, 1) - vertexOf(t, 0), vertexOf(t, 2) - vertexOf(t, 0));
+        float length = glm::length(n);
+        faceNormals[t] = length > 1e-12f ? n / length : glm::vec3(0.0f);
+    }
+
+    // a vertex is shared only by the corners with the same position, texture coordinates and normal (see
+    // util3d/obj_loader.h), which on the level are on the same plane: the triangles sharing a vertex go in the same
+    // chart, so each vertex ends up in a single chart
+    DisjointSets sets(triangles.size());
+    {
+        size_t base = 0;
+        for (unsigned int m = 0; m < meshes.size(); m++) {
+            std::vector<size_t> owner(meshes[m].positions.size(), SIZE_MAX);
+            size_t count = meshes[m].indices.size() / 3;
+            for (size_t t = 0; t < count; t++) {
+                for (int k = 0; k < 3; k++) {
+                    size_t &first = owner[meshes[m].indices[t * 3 + k]];
+                    if (first == SIZE_MAX)
+                        first = base + t;
+                    else
+                        sets.merge(first, base + t);
+                }
+            }
+            base += count;
+        }
+    }
+    // coplanar triangles sharing an edge are in the same chart
+    std::map<std::array<long long, 6>, std::vector<size_t> > edges;
+    for (size_t t = 0; t < triangles.size(); t++) {
+        for (int k = 0; k < 3; k++) {
+            auto a = quantize(vertexOf(t, k)), b = quantize(vertexOf(t, (k + 1) % 3));
+            if (b < a)
+                std::swap(a, b);
+            edges[{a[0], a[1], a[2], b[0], b[1], b[2]}].push_back(t);
+        }
+    }
+    for (auto &edge: edges) {
+        auto &list = edge.second;
+        for (size_t i = 0; i < list.size(); i++) {
+            for (size_t j = i + 1; j < list.size(); j++) {
+                const glm::vec3 &na = faceNormals[list[i]], &nb = faceNormals[list[j]];
+                if (glm::dot(na, nb) > 0.999f && std::abs(glm::dot(na, vertexOf(list[j], 0) - vertexOf(list[i], 0))) < 1e-3f)
+                    sets.merge(list[i], list[j]);
+            }
+        }
+    }
+
+    std::map<size_t, Chart> chartMap;
+    for (size_t t = 0; t < triangles.size(); t++)
+        chartMap[sets.find(t)].triangles.push_back(t);
+    std::vector<Chart> charts;
+    charts.reserve(chartMap.size());
+    for (auto &entry: chartMap)
+        charts.push_back(std::move(entry.second));
+
+    // projection of each chart on its plane, in texels
+    Atlas atlas;
+    atlas.charts = charts.size();
+    double totalArea = 0;
+    int maxWidth = 0;
+    for (Chart &chart: charts) {
+        glm::vec3 normal(0.0f);
+        for (size_t t: chart.triangles)
+            normal += glm::cross(vertexOf(t, 1) - vertexOf(t, 0), vertexOf(t, 2) - vertexOf(t, 0));
+        normal = glm::length(normal) > 1e-12f ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 reference = std::abs(normal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        chart.tangent = glm::normalize(glm::cross(reference, normal)) * settings.texelsPerMeter;
+        chart.bitangent = glm::normalize(glm::cross(normal, chart.tangent)) * settings.texelsPerMeter;
+        chart.min = glm::vec2(FLT_MAX);
+        chart.max = glm::vec2(-FLT_MAX);
+        for (size_t t: chart.triangles) {
+            for (int k = 0; k < 3; k++) {
+                glm::vec2 p(glm::dot(vertexOf(t, k), chart.tangent), glm::dot(vertexOf(t, k), chart.bitangent));
+                chart.min = glm::min(chart.min, p);
+                chart.max = glm::max(chart.max, p);
+            }
+        }
+        chart.width = static_cast<int>(std::ceil(chart.max.x - chart.min.x)) + 1 + settings.padding * 2;
+        chart.height = static_cast<int>(std::ceil(chart.max.y - chart.min.y)) + 1 + settings.padding * 2;
+        totalArea += static_cast<double>(chart.width) * chart.height;
+        maxWidth = std::max(maxWidth, chart.width);
+    }
+
+    // shelf packing, tallest charts first
+    std::vector<size_t> order(charts.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return charts[a].height > charts[b].height;
+    });
+    int atlasWidth = std::max(maxWidth, static_cast<int>(std::ceil(std::sqrt(totalArea) * 1.1)));
+    atlasWidth = (atlasWidth + 3) & ~3;
+    int x = 0, y = 0, shelfHeight = 0;
+    for (size_t c: order) {
+        Chart &chart = charts[c];
+        if (x + chart.width > atlasWidth) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        chart.x = x;
+        chart.y = y;
+        x += chart.width;
+        shelfHeight = std::max(shelfHeight, chart.height);
+    }
+    atlas.width = static_cast<uint32_t>(atlasWidth);
+    atlas.height = static_cast<uint32_t>((y + shelfHeight + 3) & ~3);
+    atlas.samples.assign(static_cast<size_t>(atlas.width) * atlas.height, TexelSample());
+    atlas.coords.resize(meshes.size());
+    for (unsigned int m = 0; m < meshes.size(); m++)
+        atlas.coords[m].assign(meshes[m].positions.size(), glm::vec2(0.0f));
+
+    // lightmap coordinates of the vertices, and rasterization of the triangles on the texel centers
+    for (Chart &chart: charts) {
+        glm::vec2 offset = glm::vec2(chart.x + settings.padding, chart.y + settings.padding) - chart.min;
+        for (size_t t: chart.triangles) {
+            const MeshGeometry &mesh = meshes[triangles[t].first];
+            unsigned int index[3];
+            glm::vec2 texel[3];
+            for (int k = 0; k < 3; k++) {
+                index[k] = mesh.indices[triangles[t].second + k];
+                const glm::vec3 &p = mesh.positions[index[k]];
+                texel[k] = glm::vec2(glm::dot(p, chart.tangent), glm::dot(p, chart.bitangent)) + offset;
+                atlas.coords[triangles[t].first][index[k]] = texel[k] / glm::vec2(atlas.width, atlas.height);
+            }
+            float doubleArea = (texel[1].x - texel[0].x) * (texel[2].y - texel[0].y) -
+                               (texel[1].y - texel[0].y) * (texel[2].x - texel[0].x);
+            if (std::abs(doubleArea) < 1e-8f)
+                continue;
+            auto barycentric = [&](const glm::vec2 &p) {
+                float w0 = ((texel[1].x - p.x) * (texel[2].y - p.y) - (texel[1].y - p.y) * (texel[2].x - p.x)) / doubleArea;
+                float w1 = ((texel[2].x - p.x) * (texel[0].y - p.y) - (texel[2].y - p.y) * (texel[0].x - p.x)) / doubleArea;
+                return glm::vec3(w0, w1, 1.0f - w0 - w1);
+            };
+            // conservative rasterization: the texels whose center is outside the triangle, but which are still touched
+            // by it, take the closest point of the triangle (thin triangles and borders of the charts)
+            glm::vec2 lo = glm::min(texel[0], glm::min(texel[1], texel[2])) - 1.0f;
+            glm::vec2 hi = glm::max(texel[0], glm::max(texel[1], texel[2])) + 1.0f;
+            for (int ty = std::max(0, static_cast<int>(lo.y)); ty <= static_cast<int>(hi.y) && ty < static_cast<int>(atlas.height); ty++) {
+                for (int tx = std::max(0, static_cast<int>(lo.x)); tx <= static_cast<int>(hi.x) && tx < static_cast<int>(atlas.width); tx++) {
+                    glm::vec2 p(tx + 0.5f, ty + 0.5f);
+                    glm::vec3 w = barycentric(p);
+                    float distance = 0.0f;
+                    if (w.x < 0.0f || w.y < 0.0f || w.z < 0.0f) {
+                        distance = FLT_MAX;
+                        glm::vec2 closest;
+                        for (int k = 0; k < 3; k++) {
+                            glm::vec2 a = texel[k], edge = texel[(k + 1) % 3] - a;
+                            float s = glm::clamp(glm::dot(p - a, edge) / std::max(glm::dot(edge, edge), 1e-12f), 0.0f, 1.0f);
+                            glm::vec2 q = a + edge * s;
+                            if (glm::length(p - q) < distance) {
+                                distance = glm::length(p - q);
+                                closest = q;
+                            }
+                        }
+                        if (distance > 0.75f)
+                            continue;
+                        w = glm::max(barycentric(closest), glm::vec3(0.0f));
+                        w /= w.x + w.y + w.z;
+                    }
+                    TexelSample &sample = atlas.samples[static_cast<size_t>(ty) * atlas.width + tx];
+                    if (sample.valid && sample.distance <= distance)
+                        continue;
+                    sample.position = mesh.positions[index[0]] * w.x + mesh.positions[index[1]] * w.y + mesh.positions[index[2]] * w.z;
+                    sample.normal = mesh.normals[index[0]] * w.x + mesh.normals[index[1]] * w.y + mesh.normals[index[2]] * w.z;
+                    sample.distance = distance;
+                    sample.valid = true;
+                }
+            }
+        }
+    }
+    return atlas;
+}
+
+//////////////////////////////////////////
+// 2) baking
+
+// attenuation and diffuse term of a light on a point, as in calcPointLight of shader.frag
+// (N.B. the fragment shader uses abs(vNormal), and vNormal is the normal with swapped x and z)
+void pointLightTerms(const BakeLight &light, const glm::vec3 &position, const glm::vec3 &normal, float &attenuation,
+                     float &diffuse, glm::vec3 &direction, float &distance) {
+    glm::vec3 toLight = light.position - position;
+    distance = glm::length(toLight);
+    direction = distance > 0.0f ? toLight / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 shaderNormal = glm::abs(glm::vec3(normal.z, normal.y, normal.x));
+    diffuse = std::max(glm::dot(shaderNormal, direction), 0.0f);
+    attenuation = 1.0f / (light.attenuation.x + light.attenuation.y * distance +
+                          light.attenuation.z * distance * distance);
+    diffuse *= attenuation;
+}
+
+// 2 values per light and texel (attenuation, attenuated and shadowed diffuse term), texel-major
+std::vector<float> bakeTexels(const Atlas &atlas, const std::vector<BakeLight> &lights, const Bvh &bvh,
+                              const BakeSettings &settings, unsigned int threads) {
+    size_t nrLights = lights.size();
+    std::vector<float> values(atlas.samples.size() * nrLights * 2, 0.0f);
+    std::atomic<uint32_t> nextRow(0);
+    auto worker = [&]() {
+        for (uint32_t row = nextRow++; row < atlas.height; row = nextRow++) {
+            for (uint32_t x = 0; x < atlas.width; x++) {
+                size_t texel = static_cast<size_t>(row) * atlas.width + x;
+                const TexelSample &sample = atlas.samples[texel];
+                if (!sample.valid)
+                    continue;
+                float *out = &values[texel * nrLights * 2];
+                for (size_t i = 0; i < nrLights; i++) {
+                    float attenuation, diffuse, distance;
+                    glm::vec3 direction;
+                    pointLightTerms(lights[i], sample.position, sample.normal, attenuation, diffuse, direction, distance);
+                    if (settings.shadows && diffuse > 0.0f &&
+                        bvh.occluded(sample.position + direction * settings.shadowBias, direction,
+                                     distance - 2.0f * settings.shadowBias))
+                        diffuse = 0.0f;
+                    out[i * 2] = attenuation;
+                    out[i * 2 + 1] = diffuse;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &thread: pool)
+        thread.join();
+    return values;
+}
+
+//////////////////////////////////////////
+// 3) dilation and packing
+
+// each pass gives to the empty texels the average of their filled neighbours
+void dilate(const Atlas &atlas, std::vector<float> &values, size_t valuesPerTexel, int passes) {
+    std::vector<char> filled(atlas.samples.size());
+    for (size_t i = 0; i < filled.size(); i++)
+        filled[i] = atlas.samples[i].valid;
+    int w = static_cast<int>(atlas.width), h = static_cast<int>(atlas.height);
+    for (int pass = 0; pass < passes; pass++) {
+        std::vector<char> next = filled;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                size_t texel = static_cast<size_t>(y) * w + x;
+                if (filled[texel])
+                    continue;
+                int count = 0;
+                std::vector<float> sum(valuesPerTexel, 0.0f);
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx, ny = y + dy;
+                        if (nx < 0 || ny < 0 || nx >= w || ny >= h || !filled[static_cast<size_t>(ny) * w + nx])
+                            continue;
+                        const float *neighbour = &values[(static_cast<size_t>(ny) * w + nx) * valuesPerTexel];
+                        for (size_t k = 0; k < valuesPerTexel; k++)
+                            sum[k] += neighbour[k];
+                        count++;
+                    }
+                }
+                if (count == 0)
+                    continue;
+                for (size_t k = 0; k < valuesPerTexel; k++)
+                    values[texel * valuesPerTexel + k] = sum[k] / count;
+                next[texel] = 1;
+            }
+        }
+        filled.swap(next);
+    }
+}
+
+Lightmap packLightmap(const Atlas &atlas, const std::vector<float> &values, uint32_t nrLights) {
+    Lightmap lightmap;
+    lightmap.width = atlas.width;
+    lightmap.height = atlas.height;
+    lightmap.nrLights = nrLights;
+    lightmap.layers = lightmapLayers(nrLights);
+    lightmap.coords = atlas.coords;
+    lightmap.texels.assign(static_cast<size_t>(lightmap.layers) * lightmap.width * lightmap.height * 4, 0);
+    for (uint32_t y = 0; y < atlas.height; y++) {
+        for (uint32_t x = 0; x < atlas.width; x++) {
+            const float *texel = &values[(static_cast<size_t>(y) * atlas.width + x) * nrLights * 2];
+            for (uint32_t i = 0; i < nrLights; i++) {
+                size_t index = lightmap.texelIndex(i / LIGHTS_PER_LAYER, x, y) + (i % LIGHTS_PER_LAYER) * 2;
+                lightmap.texels[index] = floatToHalf(texel[i * 2]);
+                lightmap.texels[index + 1] = floatToHalf(texel[i * 2 + 1]);
+            }
+        }
+    }
+    return lightmap;
+}
+
+//////////////////////////////////////////
+// image diff against the forward lighting
+
+// light intensities once the lights are warmed up (see the flicker in work06b.cpp)
+const float STEADY_AMBIENT = 0.05f, STEADY_DIFFUSE = 0.8f, STEADY_SPECULAR = 1.0f;
+
+// bilinear sample of the baked values of a light, with the texel centers at (i + 0.5) / size like in OpenGL
+void sampleLightmap(const Lightmap &lightmap, glm::vec2 uv, uint32_t light, float &attenuation, float &diffuse) {
+    glm::vec2 p = uv * glm::vec2(lightmap.width, lightmap.height) - 0.5f;
+    int x0 = static_cast<int>(std::floor(p.x)), y0 = static_cast<int>(std::floor(p.y));
+    float fx = p.x - x0, fy = p.y - y0;
+    attenuation = diffuse = 0.0f;
+    for (int k = 0; k < 4; k++) {
+        int x = std::min(std::max(x0 + (k & 1), 0), static_cast<int>(lightmap.width) - 1);
+        int y = std::min(std::max(y0 + (k >> 1), 0), static_cast<int>(lightmap.height) - 1);
+        float weight = ((k & 1) ? fx : 1.0f - fx) * ((k >> 1) ? fy : 1.0f - fy);
+        size_t index = lightmap.texelIndex(light / LIGHTS_PER_LAYER, x, y) + (light % LIGHTS_PER_LAYER) * 2;
+        attenuation += weight * halfToFloat(lightmap.texels[index]);
+        diffuse += weight * halfToFloat(lightmap.texels[index + 1]);
+    }
+}
+
+void writePPM(const std::string &path, const std::vector<float> &image, int width, int height, float scale) {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    for (float value: image) {
+        // Reinhard tone mapping of the (grey) lighting
+        value *= scale;
+        unsigned char c = static_cast<unsigned char>(std::min(255.0f, 255.0f * value / (1.0f + value)));
+        file.put(c).put(c).put(c);
+    }
+}
+
+// renders some views of the level with both the forward lighting and the lightmap, and compares them.
+// Only the lighting is compared (white material), since the albedo is the same in both cases
+void diffViews(const std::vector<MeshGeometry> &meshes, const Bvh &bvh, const std::vector<BakeLight> &lights,
+               const Lightmap &lightmap) {
+    std::vector<std::pair<unsigned int, size_t> > triangles;
+    for (unsigned int m = 0; m < meshes.size(); m++)
+        for (size_t i = 0; i + 2 < meshes[m].indices.size(); i += 3)
+            triangles.push_back({m, i});
+
+    const int width = 320, height = 240;
+    glm::mat4 projection = glm::perspective(45.0f, (float) width / (float) height, 0.1f, 10000.0f);
+    // under some lights, looking along the corridors
+    const size_t viewLights[] = {0, 8, 14, 20};
+    const float yaws[] = {0.0f, 90.0f, 200.0f, 300.0f};
+    double totalSquared = 0;
+    size_t totalPixels = 0;
+    float maxError = 0;
+    for (int v = 0; v < 4; v++) {
+        glm::vec3 eye = lights[viewLights[v]].position - glm::vec3(0.0f, 0.55f, 0.0f);
+        float yaw = glm::radians(yaws[v]);
+        glm::vec3 front = glm::normalize(glm::vec3(std::cos(yaw), -0.15f, std::sin(yaw)));
+        glm::mat4 inverse = glm::inverse(projection * glm::lookAt(eye, eye + front, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        std::vector<float> forward(width * height, 0.0f), baked(width * height, 0.0f), difference(width * height);
+        double squared = 0;
+        for (int py = 0; py < height; py++) {
+            for (int px = 0; px < width; px++) {
+                glm::vec2 ndc((px + 0.5f) / width * 2.0f - 1.0f, 1.0f - (py + 0.5f) / height * 2.0f);
+                glm::vec4 target = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+                glm::vec3 direction = glm::normalize(glm::vec3(target) / target.w - eye);
+                BvhHit hit;
+                if (!bvh.intersect(eye, direction, 1000.0f, hit))
+                    continue;
+                const MeshGeometry &mesh = meshes[triangles[hit.triangle].first];
+                const unsigned int *index = &mesh.indices[triangles[hit.triangle].second];
+                float w0 = 1.0f - hit.u - hit.v;
+                glm::vec3 position = eye + direction * hit.t;
+                glm::vec3 normal = mesh.normals[index[0]] * w0 + mesh.normals[index[1]] * hit.u + mesh.normals[index[2]] * hit.v;
+                const auto &coords = lightmap.coords[triangles[hit.triangle].first];
+                glm::vec2 uv = coords[index[0]] * w0 + coords[index[1]] * hit.u + coords[index[2]] * hit.v;
+
+                float f = 0, b = 0;
+                for (uint32_t i = 0; i < lights.size(); i++) {
+                    float attenuation, diffuse, distance;
+                    glm::vec3 toLight;
+                    pointLightTerms(lights[i], position, normal, attenuation, diffuse, toLight, distance);
+                    f += (STEADY_AMBIENT + STEADY_SPECULAR) * attenuation + STEADY_DIFFUSE * diffuse;
+                    sampleLightmap(lightmap, uv, i, attenuation, diffuse);
+                    b += (STEADY_AMBIENT + STEADY_SPECULAR) * attenuation + STEADY_DIFFUSE * diffuse;
+                }
+                size_t pixel = static_cast<size_t>(py) * width + px;
+                forward[pixel] = f;
+                baked[pixel] = b;
+                float error = std::abs(f - b);
+                difference[pixel] = error * 10.0f;
+                squared += error * error;
+                maxError = std::max(maxError, error);
+            }
+        }
+        std::string prefix = "lightmap_diff_" + std::to_string(v);
+        writePPM(prefix + "_forward.ppm", forward, width, height, 0.5f);
+        writePPM(prefix + "_baked.ppm", baked, width, height, 0.5f);
+        writePPM(prefix + "_diff.ppm", difference, width, height, 1.0f);
+        std::cout << "view " << v << ": RMSE " << std::sqrt(squared / (width * height)) << std::endl;
+        totalSquared += squared;
+        totalPixels += width * height;
+    }
+    double rmse = std::sqrt(totalSquared / totalPixels);
+    std::cout << "lighting difference: RMSE " << rmse << ", max " << maxError
+            << " (images: lightmap_diff_*.ppm)" << std::endl;
+}
+
+//////////////////////////////////////////
+
+int main(int argc, char **argv) {
+    BakeSettings settings;
+    bool scaling = false, diff = false;
+    std::string output = "backrooms_map/backrooms.lightmap";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--texels-per-meter" && i + 1 < argc)
+            settings.texelsPerMeter = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--threads" && i + 1 < argc)
+            settings.threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--no-shadows")
+            settings.shadows = false;
+        else if (arg == "--scaling")
+            scaling = true;
+        else if (arg == "--diff")
+            diff = true;
+        else if (arg == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else {
+            std::cout << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<MeshGeometry> meshes = loadGeometry("backrooms_map/backrooms.obj");
+    if (meshes.empty())
+        return 1;
+
+    // the same lights of the application
+    LightArchetype lightArchetype;
+    initCeilingLights(lightArchetype);
+    std::vector<BakeLight> lights;
+    for (size_t i = 0; i < lightArchetype.size(); i++)
+        lights.push_back({lightArchetype.column<LIGHT_POSITION>()[i], lightArchetype.column<LIGHT_ATTENUATION>()[i]});
+
+    Timer timer;
+    Atlas atlas = buildAtlas(meshes, settings);
+    size_t covered = std::count_if(atlas.samples.begin(), atlas.samples.end(),
+                                   [](const TexelSample &s) { return s.valid; });
+    std::cout << "atlas: " << atlas.charts << " charts, " << atlas.width << "x" << atlas.height << " texels ("
+            << covered << " covered), " << timer.elapsedMs() << " ms" << std::endl;
+
+    timer.reset();
+    Bvh bvh;
+    bvh.build(collectTriangles(meshes));
+    std::cout << "BVH: " << bvh.triangleCount() << " triangles, " << bvh.nodeCount() << " nodes, "
+            << timer.elapsedMs() << " ms" << std::endl;
+
+    size_t rays = covered * lights.size();
+    std::vector<float> values;
+    std::vector<unsigned int> threadCounts;
+    if (scaling) {
+        for (unsigned int t = 1; t < settings.threads; t *= 2)
+            threadCounts.push_back(t);
+    }
+    threadCounts.push_back(settings.threads);
+    double singleThreadMs = 0;
+    for (unsigned int threads: threadCounts) {
+        timer.reset();
+        values = bakeTexels(atlas, lights, bvh, settings, threads);
+        double ms = timer.elapsedMs();
+        if (threads == 1)
+            singleThreadMs = ms;
+        std::cout << "bake with " << std::setw(2) << threads << " threads: " << std::fixed << std::setprecision(1)
+                << ms << " ms, " << std::setprecision(2) << rays / (ms * 1000.0) << " Mtexel-lights/s";
+        if (singleThreadMs > 0)
+            std::cout << ", speedup " << singleThreadMs / ms;
+        std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+
+    dilate(atlas, values, lights.size() * 2, settings.padding);
+    Lightmap lightmap = packLightmap(atlas, values, static_cast<uint32_t>(lights.size()));
+    if (!saveLightmap(output, lightmap))
+        return 1;
+    std::cout << "written " << output << " (" << lightmap.layers << " layers, shadows "
+            << (settings.shadows ? "on" : "off") << ")" << std::endl;
+
+    if (diff)
+        diffViews(meshes, bvh, lights, lightmap);
+    return 0;
+}
@@ -1,8 +1,13 @@
 #version 410 core
 
-uniform sampler2D texture_diffuse1;
+// variants (built with util3d/shader_cache.h), instead of branches on uniforms:
+// LEVEL for the level, otherwise a dynamic object (bullets, splats)
+// TEXTURED if the mesh has a diffuse texture, otherwise the diffuse color of the material
+// LIGHTMAP (level) or PROBES (dynamic objects) for the precomputed lighting, otherwise the loop over the lights
 
-uniform bool texture_diffuse1_present;
+#ifdef TEXTURED
+uniform sampler2D texture_diffuse1;
+#endif
 
 uniform struct Material {
     vec3 ambient;
@@ -11,36 +16,51 @@ uniform struct Material {
     vec3 emissive;
 } material;
 
-uniform struct AmbientLight {
+struct AmbientLight {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
-} ambient;
+};
 
-uniform struct Light {
+// the floats after the vectors keep the std140 layout compact (see util3d/light_block.h)
+struct Light {
     vec3 position;
     float constant;
-    float linear;
-    float quadratic;
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
-} lights[25];
+};
+
+// the values of the frame, written once per frame for all the variants
+layout (std140) uniform FrameLights {
+    AmbientLight ambient;
+    Light lights[25];
+    vec3 vEyePos;
+    float ceilingFlicker;
+    vec3 vEyeDir;
+    uint debugLightId;
+};
 
 
 in vec3 vWorldPos;
 in vec3 vNormal;
 in vec2 vTexCoords;
+in vec2 vLightmapCoords;
 flat in uint lightId;
 
-uniform uint backrooms;
-
-uniform uint debugLightId;
-
-uniform vec3 vEyePos;
-uniform vec3 vEyeDir;
+// baked lighting of the ceiling lights (see util3d/lightmap.h): for each light the attenuation and the
+// attenuated (and shadowed) diffuse term, 2 lights per layer
+uniform sampler2DArray lightmap;
 
-uniform float ceilingFlicker;
+// irradiance probes for the dynamic objects (see util3d/probes.h): L1 SH of the diffuse lighting and specular factor
+uniform sampler3D probeIrradiance;
+uniform sampler3D probeSpecular;
+// world position -> texture coordinates of the grid
+uniform vec3 probeGridOrigin;
+uniform vec3 probeGridScale;
+uniform vec3 probeGridOffset;
 
 const float gamma = 2.2;
 
@@ -48,11 +68,11 @@ layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
 vec3 getDiffuse() {
-    vec3 matDiffuse;
-    if (texture_diffuse1_present)
-        matDiffuse = texture2D(texture_diffuse1, vTexCoords).rgb;
-    else
-        matDiffuse = vec3(material.diffuse);
+#ifdef TEXTURED
+    vec3 matDiffuse = texture(texture_diffuse1, vTexCoords).rgb;
+#else
+    vec3 matDiffuse = vec3(material.diffuse);
+#endif
     vec3 diffuseColor = pow(matDiffuse, vec3(gamma));
     return diffuseColor;
     //return matDiffuse;
@@ -125,29 +145,66 @@ vec3 calcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
 
 }
 
+// same result of the sum of calcPointLight over the lights, with the terms which do not depend on the
+// intensities of the lights read from the lightmap (the specular term is constant, since shininess is 0)
+vec3 calcBakedLights()
+{
+    vec3 diffuse = vec3(0.0);
+    vec3 specular = vec3(0.0);
+    for (int layer = 0; layer < 13; layer++)
+    {
+        vec4 baked = texture(lightmap, vec3(vLightmapCoords, float(layer)));
+        int i = layer * 2;
+        diffuse += lights[i].ambient * baked.x + lights[i].diffuse * baked.y;
+        specular += lights[i].specular * baked.x;
+        if (i + 1 < 25)
+        {
+            diffuse += lights[i + 1].ambient * baked.z + lights[i + 1].diffuse * baked.w;
+            specular += lights[i + 1].specular * baked.z;
+        }
+    }
+    return diffuse * getDiffuse() + specular * getSpecular();
+}
+
+// lighting of the dynamic objects from the probe grid, with a single lookup instead of the loop over the lights
+vec3 calcProbeLighting()
+{
+    vec3 uvw = (vWorldPos - probeGridOrigin) * probeGridScale + probeGridOffset;
+    vec4 sh = texture(probeIrradiance, uvw);
+    float specular = texture(probeSpecular, uvw).r;
+    float diffuse = max(sh.x + dot(sh.yzw, abs(vNormal)), 0.0);
+    return diffuse * getDiffuse() + specular * getSpecular();
+}
+
 void main(void)
 {
     vec3 result = calcAmbient(ambient, vNormal, vEyeDir);
     result = vec3(0.0);
+#if defined(LEVEL) && defined(LIGHTMAP)
+    result = calcBakedLights();
+#elif !defined(LEVEL) && defined(PROBES)
+    result = calcProbeLighting();
+#else
     for (int i = 0; i < 25; i++)
     {
 //        if (i != debugLightId)
 //        continue;
         result += calcPointLight(lights[i], abs(vNormal), vWorldPos, vEyeDir);
     }
+#endif
+
+#ifdef LEVEL
+    //if (lightId == debugLightId)
+    result += (material.emissive * (lights[lightId].ambient.x * 2.0 / 0.05) * ceilingFlicker);
 
-    if (backrooms == 1) {
-        //if (lightId == debugLightId)
-        result += (material.emissive * (lights[lightId].ambient.x * 2.0 / 0.05) * ceilingFlicker);
-
-        float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-        if (brightness > 1.0)
-            BrightColor = vec4(result, 1.0);
-        else
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-        FragColor = vec4(result, 1.0);
-    } else {
+    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
+    if (brightness > 1.0)
+        BrightColor = vec4(result, 1.0);
+    else
         BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-        FragColor = vec4(result, 1.0);
-    }
+    FragColor = vec4(result, 1.0);
+#else
+    BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    FragColor = vec4(result, 1.0);
+#endif
 }
\ No newline at end of file
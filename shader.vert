@@ -20,6 +20,10 @@ layout (location = 0) in vec3 position;
 // vertex normal in world coordinate
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
+// coordinates in the lightmap atlas (level only)
+layout (location = 3) in vec2 lightmapCoord;
+// ceiling light of the vertex, assigned at load time (level only)
+layout (location = 4) in uint vertexLightId;
 // the numbers used for the location in the layout qualifier are the positions of the vertex attribute
 // as defined in the Mesh class
 
@@ -42,6 +46,7 @@ out vec3 vWorldPos;
 out vec3 vNormal;
 
 out vec2 vTexCoords;
+out vec2 vLightmapCoords;
 flat out uint lightId;
 
 
@@ -65,7 +70,8 @@ void main(){
 
     // we pass the texture coordinates to the fragment shader
     vTexCoords = texCoord;
+    vLightmapCoords = lightmapCoord;
 
-    lightId = gl_VertexID / 6u;
+    lightId = vertexLightId;
 
 }
@@ -0,0 +1,250 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// helpers for the benchmark executable: wall-clock timing of a repeated workload,
+// and (on Linux, when perf events are allowed) hardware counters for cache misses and instructions,
+// and the resident memory of the process. The printed results are also kept for the JSON report, which can be
+// compared between commits to find the regressions
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class Timer {
+public:
+    Timer() { reset(); }
+
+    void reset() {
+        start = std::chrono::steady_clock::now();
+    }
+
+    double elapsedMs() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+class PerfCounters {
+public:
+    PerfCounters() {
+        cacheMissesFd = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        instructionsFd = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        if (cacheMissesFd >= 0) close(cacheMissesFd);
+        if (instructionsFd >= 0) close(instructionsFd);
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // perf events may be missing (other OS, containers, perf_event_paranoid): in this case the counters read 0
+    bool available() const {
+        return cacheMissesFd >= 0;
+    }
+
+    void start() {
+        control(cacheMissesFd, true);
+        control(instructionsFd, true);
+    }
+
+    void stop() {
+        control(cacheMissesFd, false);
+        control(instructionsFd, false);
+        cacheMisses = read(cacheMissesFd);
+        instructions = read(instructionsFd);
+    }
+
+    uint64_t cacheMisses = 0;
+    uint64_t instructions = 0;
+
+private:
+    int cacheMissesFd = -1;
+    int instructionsFd = -1;
+
+    static int open(uint32_t type, uint64_t config) {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = type;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void) type;
+        (void) config;
+        return -1;
+#endif
+    }
+
+    static void control(int fd, bool enable) {
+#ifdef __linux__
+        if (fd < 0)
+            return;
+        if (enable) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        } else {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+#else
+        (void) fd;
+        (void) enable;
+#endif
+    }
+
+    static uint64_t read(int fd) {
+        uint64_t value = 0;
+#ifdef __linux__
+        if (fd >= 0 && ::read(fd, &value, sizeof(value)) != sizeof(value))
+            value = 0;
+#else
+        (void) fd;
+#endif
+        return value;
+    }
+};
+
+// resident set size of the process, in bytes (0 where /proc is missing)
+size_t residentMemoryBytes() {
+    size_t bytes = 0;
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident)
+        bytes = resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return bytes;
+}
+
+struct BenchResult {
+    std::string name;
+    // number of items processed by each run (entities, triangles, ...), used to normalize the results
+    size_t items = 1;
+    double bestMs = 0;
+    double meanMs = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t instructions = 0;
+};
+
+// runs the workload "repetitions" times, and keeps the best and mean time; counters refer to the best run
+template<typename F>
+BenchResult runBenchmark(const std::string &name, size_t items, int repetitions, F &&workload) {
+    BenchResult result;
+    result.name = name;
+    result.items = std::max<size_t>(items, 1);
+    result.bestMs = 1e30;
+
+    PerfCounters counters;
+    double total = 0;
+    for (int r = 0; r < repetitions; r++) {
+        counters.start();
+        Timer timer;
+        workload();
+        double ms = timer.elapsedMs();
+        counters.stop();
+        total += ms;
+        if (ms < result.bestMs) {
+            result.bestMs = ms;
+            result.cacheMisses = counters.cacheMisses;
+            result.instructions = counters.instructions;
+        }
+    }
+    result.meanMs = total / std::max(repetitions, 1);
+    return result;
+}
+
+// all the results printed so far
+std::vector<BenchResult> &benchResults() {
+    static std::vector<BenchResult> results;
+    return results;
+}
+
+void printBenchResult(const BenchResult &result) {
+    benchResults().push_back(result);
+    double perItemNs = result.bestMs * 1e6 / result.items;
+    std::cout << std::left << std::setw(44) << result.name << std::right
+            << std::setw(9) << result.items << " items"
+            << std::fixed << std::setprecision(3)
+            << std::setw(11) << result.bestMs << " ms best"
+            << std::setw(11) << result.meanMs << " ms mean"
+            << std::setw(10) << perItemNs << " ns/item";
+    if (result.cacheMisses > 0)
+        std::cout << std::setw(9) << (double) result.cacheMisses / result.items << " misses/item"
+                << std::setw(9) << (double) result.instructions / result.items << " instr/item";
+    std::cout << std::defaultfloat << std::endl;
+}
+
+// text as a JSON string, with the quotes
+std::string jsonString(const std::string &text) {
+    std::ostringstream out;
+    out << '"';
+    for (char c: text) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec
+                    << std::setfill(' ');
+        else
+            out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+// the results, and whether the checks of each group passed, with the compiler which built the benchmark
+void writeBenchJson(std::ostream &out, const std::vector<BenchResult> &results,
+                    const std::vector<std::pair<std::string, bool> > &groups) {
+#if defined(_MSC_VER)
+    std::string compiler = "msvc " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+    std::string compiler = std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    std::string compiler = std::string("gcc ") + __VERSION__;
+#else
+    std::string compiler = "unknown";
+#endif
+    out << "{" << std::endl;
+    out << "  \"compiler\": " << jsonString(compiler) << "," << std::endl;
+    out << "  \"groups\": [";
+    for (size_t g = 0; g < groups.size(); g++)
+        out << (g > 0 ? ", " : "") << "{\"name\": " << jsonString(groups[g].first) << ", \"passed\": "
+                << (groups[g].second ? "true" : "false") << "}";
+    out << "]," << std::endl;
+    out << "  \"results\": [" << std::endl;
+    out << std::setprecision(9);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        out << "    {\"name\": " << jsonString(result.name) << ", \"items\": " << result.items
+                << ", \"best_ms\": " << result.bestMs << ", \"mean_ms\": " << result.meanMs
+                << ", \"ns_per_item\": " << result.bestMs * 1e6 / result.items
+                << ", \"cache_misses\": " << result.cacheMisses << ", \"instructions\": " << result.instructions
+                << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+#endif
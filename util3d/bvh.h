@@ -0,0 +1,280 @@
+#ifndef BVH_H
+#define BVH_H
+
+// bounding volume hierarchy over a static triangle list, for the CPU ray tracing of the offline tools (lightmap baker).
+// The tree is built once with the surface area heuristic (binned on the longest axis of the centroids), and stored
+// as a flat array of nodes: the children of an inner node are consecutive, and the triangles of a leaf are a range
+// of the (reordered) triangle array. Queries are read-only, so any number of threads can trace at the same time.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+struct BvhHit {
+    float t = FLT_MAX;
+    // index of the triangle in the list given to build()
+    unsigned int triangle = 0;
+    // barycentric coordinates of the hit point (weights of the 2nd and 3rd vertex)
+    float u = 0, v = 0;
+};
+
+class Bvh {
+public:
+    static const unsigned int MAX_LEAF_SIZE = 4;
+    static const int NR_BINS = 12;
+
+    // triangles as a list of 3 consecutive vertices per triangle
+    void build(const std::vector<glm::vec3> &triangles) {
+        size_t count = triangles.size() / 3;
+        vertices = triangles;
+        vertices.resize(count * 3);
+        ids.resize(count);
+        centroids.resize(count);
+        for (unsigned int t = 0; t < count; t++) {
+            ids[t] = t;
+            centroids[t] = (vertices[t * 3] + vertices[t * 3 + 1] + vertices[t * 3 + 2]) / 3.0f;
+        }
+
+        nodes.clear();
+        nodes.reserve(count * 2);
+        nodes.push_back(Node());
+        nodes[0].first = 0;
+        nodes[0].count = static_cast<unsigned int>(count);
+        updateBounds(0);
+        if (count > 0)
+            subdivide(0);
+
+        // the triangles follow the order of the leaves
+        std::vector<glm::vec3> ordered(count * 3);
+        for (size_t t = 0; t < count; t++)
+            for (int k = 0; k < 3; k++)
+                ordered[t * 3 + k] = triangles[ids[t] * 3 + k];
+        vertices.swap(ordered);
+        centroids.clear();
+        centroids.shrink_to_fit();
+    }
+
+    // closest intersection along the ray, up to tMax
+    bool intersect(const glm::vec3 &origin, const glm::vec3 &direction, float tMax, BvhHit &hit) const {
+        hit.t = tMax;
+        return traverse(origin, direction, hit, false);
+    }
+
+    // true if anything is hit along the ray before tMax (shadow rays)
+    bool occluded(const glm::vec3 &origin, const glm::vec3 &direction, float tMax) const {
+        BvhHit hit;
+        hit.t = tMax;
+        return traverse(origin, direction, hit, true);
+    }
+
+    size_t nodeCount() const {
+        return nodes.size();
+    }
+
+    size_t triangleCount() const {
+        return ids.size();
+    }
+
+private:
+    struct Node {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+        // inner node: index of the first child (the second one follows); leaf: index of the first triangle
+        unsigned int first = 0;
+        // number of triangles, 0 for inner nodes
+        unsigned int count = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> ids;
+    // only used during the build
+    std::vector<glm::vec3> centroids;
+
+    void updateBounds(unsigned int index) {
+        Node &node = nodes[index];
+        node.min = glm::vec3(FLT_MAX);
+        node.max = glm::vec3(-FLT_MAX);
+        for (unsigned int t = node.first; t < node.first + node.count; t++) {
+            for (int k = 0; k < 3; k++) {
+                node.min = glm::min(node.min, vertices[ids[t] * 3 + k]);
+                node.max = glm::max(node.max, vertices[ids[t] * 3 + k]);
+            }
+        }
+    }
+
+    static float area(const glm::vec3 &min, const glm::vec3 &max) {
+        glm::vec3 e = max - min;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    void subdivide(unsigned int index) {
+        Node node = nodes[index];
+        if (node.count <= MAX_LEAF_SIZE)
+            return;
+
+        glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+        for (unsigned int t = node.first; t < node.first + node.count; t++) {
+            cmin = glm::min(cmin, centroids[ids[t]]);
+            cmax = glm::max(cmax, centroids[ids[t]]);
+        }
+        glm::vec3 extent = cmax - cmin;
+        int axis = 0;
+        if (extent.y > extent[axis])
+            axis = 1;
+        if (extent.z > extent[axis])
+            axis = 2;
+        if (extent[axis] <= 0.0f)
+            return; // all the centroids in the same point
+
+        // binned SAH: cost of splitting after each bin
+        struct Bin {
+            glm::vec3 min = glm::vec3(FLT_MAX), max = glm::vec3(-FLT_MAX);
+            unsigned int count = 0;
+        } bins[NR_BINS];
+        float scale = NR_BINS / extent[axis];
+        auto binOf = [&](unsigned int id) {
+            return std::min(NR_BINS - 1, static_cast<int>((centroids[id][axis] - cmin[axis]) * scale));
+        };
+        for (unsigned int t = node.first; t < node.first + node.count; t++) {
+            Bin &bin = bins[binOf(ids[t])];
+            bin.count++;
+            for (int k = 0; k < 3; k++) {
+                bin.min = glm::min(bin.min, vertices[ids[t] * 3 + k]);
+                bin.max = glm::max(bin.max, vertices[ids[t] * 3 + k]);
+            }
+        }
+        float leftArea[NR_BINS - 1], rightArea[NR_BINS - 1];
+        unsigned int leftCount[NR_BINS - 1], rightCount[NR_BINS - 1];
+        glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX), rmin(FLT_MAX), rmax(-FLT_MAX);
+        unsigned int lsum = 0, rsum = 0;
+        for (int i = 0; i < NR_BINS - 1; i++) {
+            lsum += bins[i].count;
+            lmin = glm::min(lmin, bins[i].min);
+            lmax = glm::max(lmax, bins[i].max);
+            leftCount[i] = lsum;
+            leftArea[i] = lsum ? area(lmin, lmax) : 0.0f;
+
+            int j = NR_BINS - 1 - i;
+            rsum += bins[j].count;
+            rmin = glm::min(rmin, bins[j].min);
+            rmax = glm::max(rmax, bins[j].max);
+            rightCount[j - 1] = rsum;
+            rightArea[j - 1] = rsum ? area(rmin, rmax) : 0.0f;
+        }
+        int bestSplit = -1;
+        float bestCost = FLT_MAX;
+        for (int i = 0; i < NR_BINS - 1; i++) {
+            if (leftCount[i] == 0 || rightCount[i] == 0)
+                continue;
+            float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+        // not splitting costs a test per triangle against the whole node
+        if (bestSplit < 0 || bestCost >= node.count * area(node.min, node.max))
+            return;
+
+        unsigned int *begin = ids.data() + node.first, *end = begin + node.count;
+        unsigned int *middle = std::partition(begin, end, [&](unsigned int id) { return binOf(id) <= bestSplit; });
+        unsigned int leftSize = static_cast<unsigned int>(middle - begin);
+
+        unsigned int left = static_cast<unsigned int>(nodes.size());
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[left].first = node.first;
+        nodes[left].count = leftSize;
+        nodes[left + 1].first = node.first + leftSize;
+        nodes[left + 1].count = node.count - leftSize;
+        nodes[index].first = left;
+        nodes[index].count = 0;
+        updateBounds(left);
+        updateBounds(left + 1);
+        subdivide(left);
+        subdivide(left + 1);
+    }
+
+    // slab test, returns the entry distance (FLT_MAX if missed)
+    static float intersectBox(const Node &node, const glm::vec3 &origin, const glm::vec3 &invDirection, float tMax) {
+        glm::vec3 t0 = (node.min - origin) * invDirection;
+        glm::vec3 t1 = (node.max - origin) * invDirection;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+        return enter <= exit ? enter : FLT_MAX;
+    }
+
+    // Moller-Trumbore, both faces
+    bool intersectTriangle(unsigned int t, const glm::vec3 &origin, const glm::vec3 &direction, BvhHit &hit) const {
+        const glm::vec3 &a = vertices[t * 3], &b = vertices[t * 3 + 1], &c = vertices[t * 3 + 2];
+        glm::vec3 e1 = b - a, e2 = c - a;
+        glm::vec3 p = glm::cross(direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-12f)
+            return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        float distance = glm::dot(e2, q) * invDet;
+        if (distance <= 0.0f || distance >= hit.t)
+            return false;
+        hit.t = distance;
+        hit.triangle = ids[t];
+        hit.u = u;
+        hit.v = v;
+        return true;
+    }
+
+    bool traverse(const glm::vec3 &origin, const glm::vec3 &direction, BvhHit &hit, bool anyHit) const {
+        if (ids.empty())
+            return false;
+        glm::vec3 invDirection;
+        for (int k = 0; k < 3; k++)
+            invDirection[k] = direction[k] != 0.0f ? 1.0f / direction[k] : FLT_MAX;
+
+        bool found = false;
+        unsigned int stack[64];
+        int size = 0;
+        if (intersectBox(nodes[0], origin, invDirection, hit.t) == FLT_MAX)
+            return false;
+        stack[size++] = 0;
+        while (size > 0) {
+            const Node &node = nodes[stack[--size]];
+            if (node.count > 0) {
+                for (unsigned int t = node.first; t < node.first + node.count; t++) {
+                    if (intersectTriangle(t, origin, direction, hit)) {
+                        found = true;
+                        if (anyHit)
+                            return true;
+                    }
+                }
+                continue;
+            }
+            // the closest child is visited first
+            float d0 = intersectBox(nodes[node.first], origin, invDirection, hit.t);
+            float d1 = intersectBox(nodes[node.first + 1], origin, invDirection, hit.t);
+            unsigned int closer = node.first, farther = node.first + 1;
+            if (d1 < d0) {
+                std::swap(d0, d1);
+                std::swap(closer, farther);
+            }
+            if (d1 != FLT_MAX)
+                stack[size++] = farther;
+            if (d0 != FLT_MAX)
+                stack[size++] = closer;
+        }
+        return found;
+    }
+};
+#endif
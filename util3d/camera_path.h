@@ -0,0 +1,154 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+// a camera path for the render benchmark: the poses of the camera (position, yaw and pitch in degrees, as the Camera
+// class) at given times, and the times of the shots fired along it. It is recorded while playing (E key of work06b)
+// and saved as text, one line per key ("key time x y z yaw pitch") or shot ("shot time"), so it can be edited and
+// kept with the results. The positions are interpolated with a Catmull-Rom spline (it passes through the keys with
+// a continuous velocity), the angles linearly (the yaw on the shortest turn).
+// Nothing here uses OpenGL, so it can be checked headless.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct CameraKey {
+    float time;
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+class CameraPath {
+public:
+    // in time order
+    std::vector<CameraKey> keys;
+    std::vector<float> shots;
+
+    bool empty() const {
+        return keys.empty();
+    }
+
+    float duration() const {
+        return keys.empty() ? 0.0f : keys.back().time;
+    }
+
+    void clear() {
+        keys.clear();
+        shots.clear();
+    }
+
+    // keys at the same time as the last one are ignored
+    void addKey(const CameraKey &key) {
+        if (keys.empty() || key.time > keys.back().time)
+            keys.push_back(key);
+    }
+
+    void addShot(float time) {
+        shots.push_back(time);
+    }
+
+    // pose at this time (clamped to the path)
+    CameraKey sample(float time) const {
+        if (keys.empty())
+            return {time, glm::vec3(0.0f), -90.0f, 0.0f};
+        if (time <= keys.front().time)
+            return keys.front();
+        if (time >= keys.back().time)
+            return keys.back();
+        size_t next = std::upper_bound(keys.begin(), keys.end(), time,
+                                       [](float t, const CameraKey &key) { return t < key.time; }) - keys.begin();
+        const CameraKey &a = keys[next - 1], &b = keys[next];
+        const CameraKey &before = keys[next > 1 ? next - 2 : next - 1];
+        const CameraKey &after = keys[std::min(next + 1, keys.size() - 1)];
+        float t = (time - a.time) / (b.time - a.time);
+
+        CameraKey pose;
+        pose.time = time;
+        pose.position = catmullRom(before.position, a.position, b.position, after.position, t);
+        float turn = std::remainder(b.yaw - a.yaw, 360.0f);
+        pose.yaw = a.yaw + turn * t;
+        pose.pitch = a.pitch + (b.pitch - a.pitch) * t;
+        return pose;
+    }
+
+    // number of shots in the time interval (from, to]
+    size_t shotsBetween(float from, float to) const {
+        size_t count = 0;
+        for (float shot: shots)
+            if (shot > from && shot <= to)
+                count++;
+        return count;
+    }
+
+    bool save(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "# camera path of work06b: key time x y z yaw pitch, shot time" << std::endl;
+        out << std::setprecision(9);
+        for (const CameraKey &key: keys)
+            out << "key " << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z
+                    << " " << key.yaw << " " << key.pitch << std::endl;
+        for (float shot: shots)
+            out << "shot " << shot << std::endl;
+        return static_cast<bool>(out);
+    }
+
+    // false if the file is missing or has no keys
+    bool load(const std::string &path) {
+        clear();
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "key") {
+                CameraKey key;
+                if (fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+                    addKey(key);
+            } else if (kind == "shot") {
+                float time;
+                if (fields >> time)
+                    addShot(time);
+            }
+        }
+        std::sort(shots.begin(), shots.end());
+        return !keys.empty();
+    }
+
+private:
+    static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3,
+                                float t) {
+        float t2 = t * t, t3 = t2 * t;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+};
+
+// the path used when none was recorded: through the given points (e.g., below the ceiling lights) at eye height, at
+// walking speed, looking ahead, with a shot every shotInterval seconds after the first second
+CameraPath pathThrough(const std::vector<glm::vec3> &points, float eyeHeight, float speed, float shotInterval) {
+    CameraPath path;
+    float time = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        glm::vec3 position(points[i].x, eyeHeight, points[i].z);
+        if (i > 0)
+            time += glm::length(position - path.keys.back().position) / speed;
+        // towards the next point (from the one before at the end)
+        size_t from = i + 1 < points.size() || i == 0 ? i : i - 1;
+        glm::vec3 ahead = points[std::min(from + 1, points.size() - 1)] - points[from];
+        float yaw = glm::degrees(std::atan2(ahead.z, ahead.x));
+        path.addKey({time, position, yaw, -5.0f});
+    }
+    for (float shot = 1.0f; shotInterval > 0.0f && shot < time; shot += shotInterval)
+        path.addShot(shot);
+    return path;
+}
+#endif
@@ -0,0 +1,245 @@
+#ifndef COLLISION_PROXY_H
+#define COLLISION_PROXY_H
+
+// load-time generation of a simplified collision shape for the level.
+// The backrooms map is almost entirely made of axis-aligned walls, floors and ceilings: the triangles lying on the
+// same axis-aligned plane are merged into rectangles (greedy meshing on the grid of their vertex coordinates), and
+// each rectangle becomes a thin box placed behind the surface. Everything else (slanted or irregular parts) is kept
+// as a triangle mesh. Boxes and fallback mesh are the children of a single btCompoundShape, so the level is still
+// one rigid body, and box-vs-box / sphere-vs-box tests replace the tests against the triangle soup.
+
+#include <glm/glm.hpp>
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <vector>
+
+struct ProxySettings {
+    // a triangle is axis-aligned if the other components of its unit normal are below this value
+    float axisTolerance = 1e-3f;
+    // triangles closer than this to the same plane are merged, and vertex coordinates closer than this are welded
+    float weldTolerance = 1e-3f;
+    // thickness of the boxes, which extend behind the surface (opposite to the normal of the triangles)
+    float slabThickness = 0.05f;
+};
+
+struct CollisionProxyStats {
+    size_t inputTriangles = 0;
+    // groups of triangles lying on the same axis-aligned plane
+    size_t planes = 0;
+    size_t boxes = 0;
+    size_t fallbackTriangles = 0;
+};
+
+struct CollisionProxy {
+    btCompoundShape *shape = nullptr;
+    // the children are owned by the proxy (the compound shape only references them)
+    std::vector<btCollisionShape *> children;
+    btTriangleMesh *fallbackMesh = nullptr;
+    CollisionProxyStats stats;
+};
+
+// sorted coordinates of the vertices of a plane, with the values closer than the tolerance welded together
+void weldCoordinates(std::vector<float> &coords, float tolerance) {
+    std::sort(coords.begin(), coords.end());
+    std::vector<float> welded;
+    for (float c: coords)
+        if (welded.empty() || c - welded.back() > tolerance)
+            welded.push_back(c);
+    coords.swap(welded);
+}
+
+// index of the welded coordinate closest to x
+int coordinateIndex(const std::vector<float> &coords, float x) {
+    auto it = std::lower_bound(coords.begin(), coords.end(), x);
+    if (it == coords.end())
+        return static_cast<int>(coords.size()) - 1;
+    if (it != coords.begin() && x - *(it - 1) < *it - x)
+        --it;
+    return static_cast<int>(it - coords.begin());
+}
+
+// the triangles of an axis-aligned plane, projected on the 2 other axes
+struct ProxyPlane {
+    int axis;
+    // +1 if the normal points towards +axis, -1 otherwise
+    int side;
+    float coordinate;
+    std::vector<glm::vec2> vertices;
+};
+
+// builds the proxy from a triangle list (3 consecutive vertices per triangle)
+CollisionProxy createCollisionProxy(const std::vector<glm::vec3> &triangles, const ProxySettings &settings = ProxySettings()) {
+    CollisionProxy proxy;
+    proxy.shape = new btCompoundShape(true);
+    proxy.stats.inputTriangles = triangles.size() / 3;
+    std::vector<glm::vec3> fallback;
+
+    // 1) triangles are grouped by axis, side and (quantized) distance of their plane
+    std::map<std::tuple<int, int, long long>, ProxyPlane> planes;
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+        const glm::vec3 &a = triangles[t], &b = triangles[t + 1], &c = triangles[t + 2];
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if (length < 1e-12f)
+            continue; // degenerate, no collisions anyway
+        n /= length;
+
+        int axis = -1;
+        for (int k = 0; k < 3; k++)
+            if (std::abs(n[(k + 1) % 3]) < settings.axisTolerance && std::abs(n[(k + 2) % 3]) < settings.axisTolerance)
+                axis = k;
+        if (axis < 0) {
+            fallback.insert(fallback.end(), {a, b, c});
+            continue;
+        }
+
+        int side = n[axis] > 0 ? 1 : -1;
+        float coordinate = (a[axis] + b[axis] + c[axis]) / 3.0f;
+        auto key = std::make_tuple(axis, side, std::llround(coordinate / settings.weldTolerance));
+        ProxyPlane &plane = planes[key];
+        plane.axis = axis;
+        plane.side = side;
+        plane.coordinate = coordinate;
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (const glm::vec3 *p: {&a, &b, &c})
+            plane.vertices.push_back(glm::vec2((*p)[u], (*p)[v]));
+    }
+    proxy.stats.planes = planes.size();
+
+    for (auto &entry: planes) {
+        ProxyPlane &plane = entry.second;
+        int u = (plane.axis + 1) % 3, v = (plane.axis + 2) % 3;
+
+        std::vector<float> us, vs;
+        for (const glm::vec2 &p: plane.vertices) {
+            us.push_back(p.x);
+            vs.push_back(p.y);
+        }
+        weldCoordinates(us, settings.weldTolerance);
+        weldCoordinates(vs, settings.weldTolerance);
+        auto toWorld = [&](const glm::vec2 &p) {
+            glm::vec3 w;
+            w[plane.axis] = plane.coordinate;
+            w[u] = p.x;
+            w[v] = p.y;
+            return w;
+        };
+        size_t width = us.size() - 1, height = vs.size() - 1;
+        if (width == 0 || height == 0) {
+            for (const glm::vec2 &p: plane.vertices)
+                fallback.push_back(toWorld(p));
+            continue;
+        }
+
+        // 2) coverage of the cells of the grid of the vertex coordinates, sampled at the center and near the 4 corners.
+        // If the union of the triangles is rectilinear each cell is entirely inside or outside it (all samples agree),
+        // so a cell with only some samples covered is crossed by a slanted border ("partial")
+        const int ALL_SAMPLES = 31;
+        const float offsets[5][2] = {{0.5f, 0.5f}, {0.01f, 0.01f}, {0.99f, 0.01f}, {0.01f, 0.99f}, {0.99f, 0.99f}};
+        std::vector<int> coverage(width * height, 0);
+        const std::vector<glm::vec2> &vertices = plane.vertices;
+        for (size_t t = 0; t < vertices.size(); t += 3) {
+            const glm::vec2 &a = vertices[t], &b = vertices[t + 1], &c = vertices[t + 2];
+            float doubleArea = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (std::abs(doubleArea) < 1e-12f)
+                continue;
+            int i0 = coordinateIndex(us, std::min({a.x, b.x, c.x})), i1 = coordinateIndex(us, std::max({a.x, b.x, c.x}));
+            int j0 = coordinateIndex(vs, std::min({a.y, b.y, c.y})), j1 = coordinateIndex(vs, std::max({a.y, b.y, c.y}));
+            for (int j = j0; j < j1; j++) {
+                for (int i = i0; i < i1; i++) {
+                    for (int k = 0; k < 5; k++) {
+                        glm::vec2 p(us[i] + (us[i + 1] - us[i]) * offsets[k][0], vs[j] + (vs[j + 1] - vs[j]) * offsets[k][1]);
+                        // barycentric coordinates of the sample
+                        float w0 = ((b.x - p.x) * (c.y - p.y) - (b.y - p.y) * (c.x - p.x)) / doubleArea;
+                        float w1 = ((c.x - p.x) * (a.y - p.y) - (c.y - p.y) * (a.x - p.x)) / doubleArea;
+                        float w2 = 1.0f - w0 - w1;
+                        if (w0 >= -1e-5f && w1 >= -1e-5f && w2 >= -1e-5f)
+                            coverage[j * width + i] |= 1 << k;
+                    }
+                }
+            }
+        }
+
+        // 3) the triangles overlapping a partial cell go to the fallback mesh, so the surface of the cell is still exact.
+        // Their fully covered cells become boxes anyway: a box and a triangle on the same surface are harmless
+        for (size_t t = 0; t < vertices.size(); t += 3) {
+            const glm::vec2 &a = vertices[t], &b = vertices[t + 1], &c = vertices[t + 2];
+            int i0 = coordinateIndex(us, std::min({a.x, b.x, c.x})), i1 = coordinateIndex(us, std::max({a.x, b.x, c.x}));
+            int j0 = coordinateIndex(vs, std::min({a.y, b.y, c.y})), j1 = coordinateIndex(vs, std::max({a.y, b.y, c.y}));
+            bool partial = false;
+            for (int j = j0; j < j1 && !partial; j++)
+                for (int i = i0; i < i1 && !partial; i++)
+                    partial = coverage[j * width + i] != 0 && coverage[j * width + i] != ALL_SAMPLES;
+            if (partial)
+                fallback.insert(fallback.end(), {toWorld(a), toWorld(b), toWorld(c)});
+        }
+        std::vector<char> covered(width * height);
+        for (size_t cell = 0; cell < covered.size(); cell++)
+            covered[cell] = coverage[cell] == ALL_SAMPLES;
+
+        // 4) greedy merge of the covered cells: each rectangle grows along u, then along v while the whole span is covered
+        for (size_t j = 0; j < height; j++) {
+            for (size_t i = 0; i < width; i++) {
+                if (!covered[j * width + i])
+                    continue;
+                size_t i1 = i + 1;
+                while (i1 < width && covered[j * width + i1])
+                    i1++;
+                size_t j1 = j + 1;
+                for (bool full = true; full && j1 < height; ) {
+                    for (size_t k = i; k < i1 && full; k++)
+                        full = covered[j1 * width + k] != 0;
+                    if (full)
+                        j1++;
+                }
+                for (size_t y = j; y < j1; y++)
+                    std::fill(covered.begin() + y * width + i, covered.begin() + y * width + i1, 0);
+
+                btVector3 halfExtents, center;
+                halfExtents[plane.axis] = settings.slabThickness * 0.5f;
+                halfExtents[u] = (us[i1] - us[i]) * 0.5f;
+                halfExtents[v] = (vs[j1] - vs[j]) * 0.5f;
+                center[plane.axis] = plane.coordinate - plane.side * settings.slabThickness * 0.5f;
+                center[u] = (us[i1] + us[i]) * 0.5f;
+                center[v] = (vs[j1] + vs[j]) * 0.5f;
+
+                btBoxShape *box = new btBoxShape(halfExtents);
+                btTransform transform;
+                transform.setIdentity();
+                transform.setOrigin(center);
+                proxy.shape->addChildShape(transform, box);
+                proxy.children.push_back(box);
+                proxy.stats.boxes++;
+            }
+        }
+    }
+
+    // 5) all the remaining triangles in a single BVH triangle mesh
+    if (!fallback.empty()) {
+        proxy.fallbackMesh = new btTriangleMesh();
+        for (size_t t = 0; t + 2 < fallback.size(); t += 3)
+            proxy.fallbackMesh->addTriangle(btVector3(fallback[t].x, fallback[t].y, fallback[t].z),
+                                            btVector3(fallback[t + 1].x, fallback[t + 1].y, fallback[t + 1].z),
+                                            btVector3(fallback[t + 2].x, fallback[t + 2].y, fallback[t + 2].z));
+        btBvhTriangleMeshShape *mesh = new btBvhTriangleMeshShape(proxy.fallbackMesh, true);
+        btTransform transform;
+        transform.setIdentity();
+        proxy.shape->addChildShape(transform, mesh);
+        proxy.children.push_back(mesh);
+        proxy.stats.fallbackTriangles = fallback.size() / 3;
+    }
+    return proxy;
+}
+
+void destroyCollisionProxy(CollisionProxy &proxy) {
+    delete proxy.shape;
+    for (btCollisionShape *child: proxy.children)
+        delete child;
+    delete proxy.fallbackMesh;
+    proxy = CollisionProxy();
+}
+#endif
@@ -0,0 +1,123 @@
+#ifndef DECALS_H
+#define DECALS_H
+
+// screen-space deferred decals for the paint splats.
+// Instead of drawing the splat mesh with its own matrices for each splat, the splats are drawn with a single
+// instanced draw call of a unit cube: each instance is the box of a splat, and its fragments read the depth of the
+// scene, rebuild the world position of the visible surface and paint it if it falls inside the box (and inside the
+// disc of the splat). The boxes are depth tested against the scene, so hidden splats are rejected before shading.
+// The splats never move, so the instance data is computed and uploaded only once, when a splat is created.
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "entities.h"
+#include "gl_handles.h"
+
+#include <algorithm>
+#include <vector>
+
+// half extents of the box of a splat: the disc of the splat model (radius 100 units), and enough depth on both
+// sides of the splat position to reach the surface it has been spawned on (see spawnSplat and impactPosition)
+const float SPLAT_DECAL_RADIUS = 100.0f * SPLAT_RENDER_SCALE;
+const float SPLAT_DECAL_DEPTH = 0.2f;
+
+// per instance data: unit cube -> world (for the vertices), and its inverse (for the fragments)
+struct DecalInstance {
+    glm::mat4 box;
+    glm::mat4 invBox;
+};
+
+DecalInstance makeSplatDecal(const glm::vec3 &position, const glm::mat4 &rotation) {
+    DecalInstance decal;
+    decal.box = glm::translate(glm::mat4(1.0f), position) * rotation *
+                glm::scale(glm::mat4(1.0f), glm::vec3(SPLAT_DECAL_RADIUS, SPLAT_DECAL_RADIUS, SPLAT_DECAL_DEPTH));
+    decal.invBox = glm::inverse(decal.box);
+    return decal;
+}
+
+class DecalBuffer {
+public:
+    // unit cube, and the (empty) instance buffer
+    void init() {
+        // 12 triangles, counter-clockwise seen from outside
+        const float cube[] = {
+            -1, -1, 1, 1, -1, 1, 1, 1, 1, -1, -1, 1, 1, 1, 1, -1, 1, 1,
+            1, -1, -1, -1, -1, -1, -1, 1, -1, 1, -1, -1, -1, 1, -1, 1, 1, -1,
+            -1, -1, -1, -1, -1, 1, -1, 1, 1, -1, -1, -1, -1, 1, 1, -1, 1, -1,
+            1, -1, 1, 1, -1, -1, 1, 1, -1, 1, -1, 1, 1, 1, -1, 1, 1, 1,
+            -1, 1, 1, 1, 1, 1, 1, 1, -1, -1, 1, 1, 1, 1, -1, -1, 1, -1,
+            -1, -1, -1, 1, -1, -1, 1, -1, 1, -1, -1, -1, 1, -1, 1, -1, -1, 1,
+        };
+        VAO = GLVertexArray::create();
+        cubeVBO = GLBuffer::create();
+        instanceVBO = GLBuffer::create();
+        glBindVertexArray(VAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO.get());
+        glBufferData(GL_ARRAY_BUFFER, sizeof(cube), cube, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *) 0);
+        // the two matrices take 4 attribute locations each (1-4 and 5-8), one column per location
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        for (GLuint i = 0; i < 8; i++) {
+            glEnableVertexAttribArray(1 + i);
+            glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(DecalInstance),
+                                  (void *) (i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(1 + i, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // uploads the decals of the splats created since the last call: the new ones are at the end of the archetype.
+    // If any splat was destroyed since then (e.g., by the stress run, which replaces all of them), the rows are not
+    // the ones uploaded anymore and everything is uploaded again
+    void sync(const SplatArchetype &splats) {
+        const auto &position = splats.column<SPLAT_POSITION>();
+        const auto &rotation = splats.column<SPLAT_ROTATION>();
+        if (splats.destroyedRows() != syncedRemovals) {
+            instances.clear();
+            syncedRemovals = splats.destroyedRows();
+        }
+        size_t first = instances.size();
+        if (first == position.size())
+            return;
+        for (size_t i = first; i < position.size(); i++)
+            instances.push_back(makeSplatDecal(position[i], rotation[i]));
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO.get());
+        if (instances.size() > capacity) {
+            // the buffer grows by doubling, the old contents are uploaded again with the new ones
+            capacity = std::max(instances.size(), capacity * 2);
+            glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(DecalInstance), NULL, GL_STATIC_DRAW);
+            first = 0;
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(DecalInstance),
+                        (instances.size() - first) * sizeof(DecalInstance), &instances[first]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // draws the boxes of all the decals
+    void draw() const {
+        if (instances.empty())
+            return;
+        glBindVertexArray(VAO.get());
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(instances.size()));
+        glBindVertexArray(0);
+    }
+
+    size_t count() const {
+        return instances.size();
+    }
+
+private:
+    GLVertexArray VAO;
+    GLBuffer cubeVBO, instanceVBO;
+    size_t capacity = 0;
+    std::vector<DecalInstance> instances;
+    // destroyedRows() of the splats at the last upload
+    uint64_t syncedRemovals = 0;
+};
+#endif
@@ -0,0 +1,90 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// dynamic resolution: the scene and the bloom are rendered at a fraction of the window size, chosen at each frame by
+// a feedback controller to keep the GPU time of the frame within a budget, and the final composite upscales them.
+// The render targets keep the size of the window and the scaled passes draw in their lower left corner, so a new
+// scale does not reallocate anything.
+// The GPU time of a frame is roughly a fixed part plus a part proportional to the pixels (scale^2), so the scale is
+// corrected by sqrt(budget / time). The time is averaged over some frames, each correction is limited, and there
+// are no corrections within a dead band around the budget or right after a change (the timer queries are read a
+// couple of frames later), so that the noise of the measures does not make the scale oscillate.
+
+#include <algorithm>
+#include <cmath>
+
+struct ResolutionSettings {
+    // GPU time of a frame to stay within, a bit less than a 60 Hz frame
+    float budgetMs = 14.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // the scales are multiples of step, so that small corrections do not change the viewport at each frame
+    float step = 0.05f;
+    // weight of the last frame in the average time
+    float smoothing = 0.2f;
+    // relative distance from the budget without corrections
+    float deadBand = 0.1f;
+    // largest correction of the scale at once
+    float maxChange = 0.1f;
+    // frames without corrections after a change, while the measures of the old scale are still arriving
+    int cooldownFrames = 4;
+};
+
+class ResolutionController {
+public:
+    explicit ResolutionController(const ResolutionSettings &settings = ResolutionSettings()) : settings(settings) {
+        reset();
+    }
+
+    void reset() {
+        currentScale = settings.maxScale;
+        average = -1.0f;
+        cooldown = 0;
+    }
+
+    // scale for the next frame, given the GPU time of the last measured frame
+    float update(float frameMs) {
+        average = average < 0.0f ? frameMs : average + settings.smoothing * (frameMs - average);
+        if (cooldown > 0) {
+            cooldown--;
+            return currentScale;
+        }
+        float ratio = average / settings.budgetMs;
+        if (std::abs(ratio - 1.0f) < settings.deadBand || ratio <= 0.0f)
+            return currentScale;
+
+        float target = currentScale / std::sqrt(ratio);
+        target = std::min(std::max(target, currentScale - settings.maxChange), currentScale + settings.maxChange);
+        target = std::round(target / settings.step) * settings.step;
+        target = std::min(std::max(target, settings.minScale), settings.maxScale);
+        if (std::abs(target - currentScale) > 0.5f * settings.step) {
+            // the average restarts from the time expected at the new scale, instead of catching up slowly
+            float pixels = (target * target) / (currentScale * currentScale);
+            average *= pixels;
+            currentScale = target;
+            cooldown = settings.cooldownFrames;
+        }
+        return currentScale;
+    }
+
+    float scale() const {
+        return currentScale;
+    }
+
+    // average GPU time of the frames
+    float averageMs() const {
+        return average < 0.0f ? 0.0f : average;
+    }
+
+private:
+    ResolutionSettings settings;
+    float currentScale = 1.0f;
+    float average = -1.0f;
+    int cooldown = 0;
+};
+
+// size (pixels) of a scaled viewport
+int scaledSize(int size, float scale) {
+    return std::max(1, static_cast<int>(size * scale + 0.5f));
+}
+#endif
@@ -0,0 +1,521 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+// data-oriented storage for the dynamic objects of the scene (bullets, paint splats and ceiling lights).
+// Each kind of object is an "archetype": a set of tightly packed component arrays (one std::vector per component),
+// kept index-aligned, so that the systems below iterate over contiguous memory instead of chasing pointers.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <utils/physics.h>
+#include "physics_pool.h"
+#include "lod.h"
+
+#include <cstdint>
+#include <deque>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// an entity is a 32 bit handle: the low 24 bits index the sparse table of its archetype,
+// the high 8 bits are a generation counter, used to detect handles to entities which have been destroyed
+typedef uint32_t Entity;
+
+const Entity NULL_ENTITY = 0xFFFFFFFFu;
+const uint32_t ENTITY_INDEX_BITS = 24;
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+const uint8_t ENTITY_MAX_GENERATION = 0xFF;
+
+template<typename... Components>
+class Archetype {
+public:
+    // adds a new entity at the end of the packed arrays, and returns its handle
+    Entity create(Components... components) {
+        uint32_t index;
+        if (!freeIndices.empty()) {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        } else {
+            index = static_cast<uint32_t>(sparse.size());
+            sparse.push_back(0);
+            generations.push_back(0);
+        }
+        sparse[index] = static_cast<uint32_t>(dense.size());
+        Entity entity = (static_cast<uint32_t>(generations[index]) << ENTITY_INDEX_BITS) | index;
+        dense.push_back(entity);
+        pushColumns(std::index_sequence_for<Components...>{}, std::move(components)...);
+        return entity;
+    }
+
+    bool alive(Entity entity) const {
+        uint32_t index = entity & ENTITY_INDEX_MASK;
+        return entity != NULL_ENTITY && index < sparse.size() &&
+               generations[index] == (entity >> ENTITY_INDEX_BITS) && dense[sparse[index]] == entity;
+    }
+
+    // position of the entity inside the packed arrays (valid until the next destroy)
+    size_t rowOf(Entity entity) const {
+        return sparse[entity & ENTITY_INDEX_MASK];
+    }
+
+    void destroy(Entity entity) {
+        destroyRow(rowOf(entity));
+    }
+
+    // O(1) removal: the last row is moved in the hole, so the arrays stay packed.
+    // N.B.) iterating and removing at the same time must then be done backwards
+    void destroyRow(size_t row) {
+        size_t last = dense.size() - 1;
+        Entity removed = dense[row];
+        if (row != last) {
+            dense[row] = dense[last];
+            sparse[dense[row] & ENTITY_INDEX_MASK] = static_cast<uint32_t>(row);
+            moveColumns(std::index_sequence_for<Components...>{}, last, row);
+        }
+        dense.pop_back();
+        popColumns(std::index_sequence_for<Components...>{});
+
+        uint32_t index = removed & ENTITY_INDEX_MASK;
+        // a slot whose generation would wrap is retired: a handle of its first generation could still be stored
+        // somewhere (e.g., the spawn order of the bullets) and would look alive again
+        if (generations[index] == ENTITY_MAX_GENERATION) {
+            retiredIndices++;
+        } else {
+            generations[index]++;
+            freeIndices.push_back(index);
+        }
+        removals++;
+    }
+
+    // slots never reused as their generations are exhausted (each one after 256 entities)
+    size_t retiredSlots() const {
+        return retiredIndices;
+    }
+
+    // number of rows destroyed so far: the copies of the rows (e.g., the decals of the splats on the GPU) are stale
+    // when it changes, as the rows may have been moved or replaced by others at the same position
+    uint64_t destroyedRows() const {
+        return removals;
+    }
+
+    // packed array of the I-th component
+    template<size_t I>
+    auto &column() {
+        return std::get<I>(columns);
+    }
+
+    template<size_t I>
+    const auto &column() const {
+        return std::get<I>(columns);
+    }
+
+    const std::vector<Entity> &entities() const {
+        return dense;
+    }
+
+    size_t size() const {
+        return dense.size();
+    }
+
+    bool empty() const {
+        return dense.empty();
+    }
+
+    void reserve(size_t n) {
+        dense.reserve(n);
+        reserveColumns(std::index_sequence_for<Components...>{}, n);
+    }
+
+private:
+    std::tuple<std::vector<Components>...> columns;
+    // row -> entity handle
+    std::vector<Entity> dense;
+    // entity index -> row
+    std::vector<uint32_t> sparse;
+    std::vector<uint8_t> generations;
+    std::vector<uint32_t> freeIndices;
+    size_t retiredIndices = 0;
+    uint64_t removals = 0;
+
+    template<size_t... I>
+    void pushColumns(std::index_sequence<I...>, Components &&... components) {
+        (std::get<I>(columns).push_back(std::move(components)), ...);
+    }
+
+    template<size_t... I>
+    void moveColumns(std::index_sequence<I...>, size_t from, size_t to) {
+        ((std::get<I>(columns)[to] = std::move(std::get<I>(columns)[from])), ...);
+    }
+
+    template<size_t... I>
+    void popColumns(std::index_sequence<I...>) {
+        (std::get<I>(columns).pop_back(), ...);
+    }
+
+    template<size_t... I>
+    void reserveColumns(std::index_sequence<I...>, size_t n) {
+        (std::get<I>(columns).reserve(n), ...);
+    }
+};
+
+//////////////////////////////////////////
+// components of each archetype
+
+// bullets: rigid body, and position/velocity copied back from the simulation at each frame.
+// The level of detail used in the last frame is kept for the hysteresis of the selection (see util3d/lod.h)
+enum BulletColumn { BULLET_BODY, BULLET_POSITION, BULLET_VELOCITY, BULLET_SPAWN_TIME, BULLET_LOD };
+typedef Archetype<btRigidBody *, glm::vec3, glm::vec3, float, uint8_t> BulletArchetype;
+
+// paint splats are static once created, so their model matrix is computed only once at spawn
+enum SplatColumn { SPLAT_POSITION, SPLAT_ROTATION, SPLAT_MODEL, SPLAT_LOD };
+typedef Archetype<glm::vec3, glm::mat4, glm::mat4, uint8_t> SplatArchetype;
+
+// point lights: attenuation is (constant, linear, quadratic)
+enum LightColumn { LIGHT_POSITION, LIGHT_ATTENUATION, LIGHT_AMBIENT, LIGHT_DIFFUSE, LIGHT_SPECULAR };
+typedef Archetype<glm::vec3, glm::vec3, glm::vec3, glm::vec3, glm::vec3> LightArchetype;
+
+const int NR_CEILING_LIGHTS = 25;
+
+// scale applied to the models used for rendering
+const float BULLET_RADIUS = 0.13f;
+const float BULLET_SPEED = 20.0f;
+const float BULLET_RENDER_SCALE = 0.05f;
+const float SPLAT_RENDER_SCALE = 0.002f;
+// bounding radius of a rendered splat (the model is 200x200 units), used for culling
+const float SPLAT_BOUNDING_RADIUS = 0.3f;
+// radius of a rendered bullet (the sphere model has radius 1)
+const float BULLET_RENDER_RADIUS = BULLET_RENDER_SCALE;
+
+// levels of detail: the sphere has 760 triangles, and it is only a few pixels wide a couple of rooms away;
+// the splat is a thin 16-sided cylinder (60 triangles)
+const LodSettings BULLET_LODS = {{0.25f, 0.1f, 0.03f}, {20.0f, 8.0f, 3.0f}};
+const LodSettings SPLAT_LODS = {{0.5f, 0.25f}, {60.0f, 20.0f}};
+
+struct EntityWorld {
+    BulletArchetype bullets;
+    SplatArchetype splats;
+    LightArchetype lights;
+
+    // output of the render extraction system, one model matrix per bullet
+    std::vector<glm::mat4> bulletModelMatrices;
+
+    // bullet handles in order of creation, for the age limit and the oldest-first eviction.
+    // Handles of bullets already destroyed are skipped lazily when they reach the front
+    std::deque<Entity> bulletSpawnOrder;
+};
+
+// limits on the bullets alive in the simulation, and counters of the reclaimed ones
+struct BulletLifecycle {
+    // seconds after which a bullet is removed
+    float maxAge = 8.0f;
+    // kill volume: bullets leaving this box (e.g., fired out of the map) are removed
+    glm::vec3 boundsMin = glm::vec3(-1000.0f);
+    glm::vec3 boundsMax = glm::vec3(1000.0f);
+    // bullets deactivated by Bullet (resting somewhere without a reported contact) are removed
+    bool removeSleeping = true;
+    // hard cap: when exceeded, the oldest bullets are evicted
+    size_t maxBullets = 256;
+
+    // metrics
+    size_t reclaimedAge = 0;
+    size_t reclaimedBounds = 0;
+    size_t reclaimedSleeping = 0;
+    size_t reclaimedEvicted = 0;
+
+    size_t reclaimed() const {
+        return reclaimedAge + reclaimedBounds + reclaimedSleeping + reclaimedEvicted;
+    }
+};
+
+// bullets can be simulated as rigid bodies (projectiles), or resolved instantly with a query against the level (hitscan)
+enum FireMode { FIRE_PROJECTILE, FIRE_HITSCAN };
+
+struct FiringSettings {
+    FireMode mode = FIRE_PROJECTILE;
+    // swept-sphere continuous collision detection for the projectiles, to avoid tunneling with large time steps
+    bool ccd = true;
+    // maximum distance of a hitscan shot
+    float range = 100.0f;
+    // if > 0, hitscan shots are swept spheres of this radius instead of rays
+    float sweepRadius = 0.0f;
+};
+
+// a manifold point is considered an impact if the bullet is (almost) touching the surface
+const float BULLET_CONTACT_THRESHOLD = 0.005f;
+
+// a hitscan shot waiting to be resolved at the end of the frame
+struct HitscanShot {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// position of a splat: the contact point, moved a little along the surface normal
+glm::vec3 impactPosition(const btVector3 &point, const btVector3 &normal) {
+    btVector3 position = point + normal * 0.1;
+    return glm::vec3(position.x(), position.y(), position.z());
+}
+
+//////////////////////////////////////////
+// systems
+
+// the ceiling lights are placed on a grid of 4 rows, following the layout of the emissive panels of the map
+void initCeilingLights(LightArchetype &lights) {
+    lights.reserve(NR_CEILING_LIGHTS);
+    glm::vec3 pos(-8.6, 1.25, 7.93);
+    for (int y = 0; y < 4; y++) {
+        pos.x = -8.6;
+        int x = 0;
+        if (y == 2) {
+            x--;
+            pos.x -= 3.42;
+        }
+        for (; x < 6; x++) {
+            lights.create(pos, glm::vec3(1.0f, 0.09f, 0.032f), glm::vec3(-0.1), glm::vec3(0), glm::vec3(0));
+            pos += glm::vec3(3.42, 0, 0);
+        }
+        pos += glm::vec3(0, 0, y == 2 ? -5.67 : -4.54);
+    }
+}
+
+// creates the rigid body of a bullet, and gives it the initial speed along the shooting direction
+Entity spawnBullet(EntityWorld &world, Physics &physics, glm::vec3 position, glm::vec3 direction, float speed,
+                   float time, bool ccd = true) {
+    // bodies and motion states come from the pools, and the sphere shape is shared by all the bullets
+    btRigidBody *body = BulletBodyPool::instance().create(physics, position, BULLET_RADIUS, 1.0f, 0.9f, 0.0f);
+    body->setLinearVelocity(body->getLinearVelocity() + btVector3(direction.x, direction.y, direction.z) * speed);
+    if (ccd) {
+        // CCD is used when the bullet moves more than its radius in a step; the swept sphere is kept
+        // a little smaller than the collision shape, as suggested by the Bullet documentation
+        body->setCcdMotionThreshold(BULLET_RADIUS);
+        body->setCcdSweptSphereRadius(BULLET_RADIUS * 0.9f);
+    }
+    btVector3 velocity = body->getLinearVelocity();
+    Entity entity = world.bullets.create(body, position, glm::vec3(velocity.x(), velocity.y(), velocity.z()), time, 0);
+    // the handle is stored in the body, to find the bullet from the contact manifolds of the simulation
+    body->setUserIndex(static_cast<int>(entity));
+    world.bulletSpawnOrder.push_back(entity);
+    return entity;
+}
+
+// adds a splat on a surface: the splat model lies on the XY plane, so it is rotated to align +Z with the surface normal
+Entity spawnSplat(SplatArchetype &splats, glm::vec3 contact, glm::vec3 normal, glm::vec3 velocity) {
+    normal = glm::normalize(normal);
+
+    // dot normal with bullet speed so we can check if the normal is flipped
+    if (glm::dot(normal, velocity) > 0) {
+        normal = -normal;
+    }
+
+    auto initial = glm::vec3(0, 0, 1);
+    auto angle = glm::acos(glm::dot(initial, normal));
+
+    auto axis = glm::normalize(glm::cross(initial, normal));
+
+    glm::mat4 rot;
+    if (angle > 0.001 && axis.x == axis.x) {
+        rot = glm::rotate(glm::mat4(1.0f), angle, axis);
+    } else {
+        rot = glm::mat4(1.0f);
+    }
+    auto pos = contact + normal * -0.04f;
+
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+    model = glm::scale(model, glm::vec3(SPLAT_RENDER_SCALE));
+    model = model * rot;
+    return splats.create(pos, rot, model, 0);
+}
+
+// removes a bullet from the simulation and from the packed arrays; body and motion state go back to the pools
+void destroyBulletRow(EntityWorld &world, Physics &physics, size_t row) {
+    BulletBodyPool::instance().destroy(physics, world.bullets.column<BULLET_BODY>()[row]);
+    world.bullets.destroyRow(row);
+}
+
+// removes all the bullets (e.g., before destroying the simulation)
+void destroyAllBullets(EntityWorld &world, Physics &physics) {
+    for (size_t i = world.bullets.size(); i-- > 0;)
+        destroyBulletRow(world, physics, i);
+    world.bulletSpawnOrder.clear();
+}
+
+// the kill volume is the bounding box of the level, enlarged by a margin
+void setKillVolume(BulletLifecycle &lifecycle, btCollisionObject *level, float margin) {
+    btVector3 aabbMin, aabbMax;
+    level->getCollisionShape()->getAabb(level->getWorldTransform(), aabbMin, aabbMax);
+    lifecycle.boundsMin = glm::vec3(aabbMin.x(), aabbMin.y(), aabbMin.z()) - glm::vec3(margin);
+    lifecycle.boundsMax = glm::vec3(aabbMax.x(), aabbMax.y(), aabbMax.z()) + glm::vec3(margin);
+}
+
+// removes the bullets which are too old, outside the kill volume, sleeping, or exceeding the cap.
+// Age and cap only look at the front of the spawn order (bullets are created in time order), while
+// bounds and sleeping state need a pass on the packed arrays; every removal is O(1).
+// Must be called after syncBulletsFromPhysics, since it uses the packed positions
+void reclaimBullets(EntityWorld &world, Physics &physics, BulletLifecycle &lifecycle, float time) {
+    auto &order = world.bulletSpawnOrder;
+    while (!order.empty()) {
+        Entity oldest = order.front();
+        if (!world.bullets.alive(oldest)) {
+            order.pop_front();
+            continue;
+        }
+        size_t row = world.bullets.rowOf(oldest);
+        if (world.bullets.size() > lifecycle.maxBullets) {
+            lifecycle.reclaimedEvicted++;
+        } else if (time - world.bullets.column<BULLET_SPAWN_TIME>()[row] > lifecycle.maxAge) {
+            lifecycle.reclaimedAge++;
+        } else {
+            break;
+        }
+        destroyBulletRow(world, physics, row);
+        order.pop_front();
+    }
+
+    auto &body = world.bullets.column<BULLET_BODY>();
+    auto &position = world.bullets.column<BULLET_POSITION>();
+    for (size_t i = world.bullets.size(); i-- > 0;) {
+        const glm::vec3 &p = position[i];
+        if (p.x < lifecycle.boundsMin.x || p.y < lifecycle.boundsMin.y || p.z < lifecycle.boundsMin.z ||
+            p.x > lifecycle.boundsMax.x || p.y > lifecycle.boundsMax.y || p.z > lifecycle.boundsMax.z) {
+            lifecycle.reclaimedBounds++;
+            destroyBulletRow(world, physics, i);
+        } else if (lifecycle.removeSleeping && body[i]->getActivationState() == ISLAND_SLEEPING) {
+            lifecycle.reclaimedSleeping++;
+            destroyBulletRow(world, physics, i);
+        }
+    }
+
+    // the spawn order only holds live bullets and stale handles not yet at the front: if stale handles
+    // accumulate (bullets removed by impacts), they are compacted so the queue stays bounded
+    if (order.size() > 2 * world.bullets.size() + 64) {
+        std::deque<Entity> live;
+        for (Entity e: order)
+            if (world.bullets.alive(e))
+                live.push_back(e);
+        order.swap(live);
+    }
+}
+
+// copies the state of the simulation in the packed position/velocity arrays
+void syncBulletsFromPhysics(BulletArchetype &bullets) {
+    auto &body = bullets.column<BULLET_BODY>();
+    auto &position = bullets.column<BULLET_POSITION>();
+    auto &velocity = bullets.column<BULLET_VELOCITY>();
+    for (size_t i = 0, n = bullets.size(); i < n; i++) {
+        const btVector3 &p = body[i]->getCenterOfMassPosition();
+        const btVector3 &v = body[i]->getLinearVelocity();
+        position[i] = glm::vec3(p.x(), p.y(), p.z());
+        velocity[i] = glm::vec3(v.x(), v.y(), v.z());
+    }
+}
+
+// each bullet touching the level is replaced by a splat on the hit surface.
+// Instead of a contactPairTest for each bullet, the contact manifolds already computed by the last
+// simulation step are scanned once: only the pairs (bullet, level) with a contact point are considered.
+// Returns the number of impacts.
+size_t collideBulletsWithLevel(EntityWorld &world, Physics &physics, btCollisionObject *level) {
+    struct Impact {
+        Entity bullet;
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+    std::vector<Impact> impacts;
+
+    btDispatcher *dispatcher = physics.dynamicsWorld->getDispatcher();
+    for (int m = 0, n = dispatcher->getNumManifolds(); m < n; m++) {
+        btPersistentManifold *manifold = dispatcher->getManifoldByIndexInternal(m);
+        const btCollisionObject *body0 = manifold->getBody0();
+        const btCollisionObject *body1 = manifold->getBody1();
+        if (body0 != level && body1 != level)
+            continue;
+        const btCollisionObject *other = body0 == level ? body1 : body0;
+        Entity bullet = static_cast<Entity>(other->getUserIndex());
+        if (!world.bullets.alive(bullet) || world.bullets.column<BULLET_BODY>()[world.bullets.rowOf(bullet)] != other)
+            continue;
+
+        // deepest contact point of the pair
+        int deepest = -1;
+        for (int c = 0; c < manifold->getNumContacts(); c++) {
+            btScalar distance = manifold->getContactPoint(c).getDistance();
+            if (distance <= BULLET_CONTACT_THRESHOLD &&
+                (deepest < 0 || distance < manifold->getContactPoint(deepest).getDistance()))
+                deepest = c;
+        }
+        if (deepest < 0)
+            continue;
+
+        // the normal is on B, pointing towards A: we want the point on the level, and the normal pointing out of it
+        const btManifoldPoint &point = manifold->getContactPoint(deepest);
+        btVector3 normal = body1 == level ? point.m_normalWorldOnB : -point.m_normalWorldOnB;
+        const btVector3 &onLevel = body1 == level ? point.m_positionWorldOnB : point.m_positionWorldOnA;
+        impacts.push_back({bullet, impactPosition(onLevel, normal), glm::vec3(normal.x(), normal.y(), normal.z())});
+    }
+
+    // bodies are removed only after the scan, because removing them destroys their manifolds
+    size_t count = 0;
+    for (auto &impact: impacts) {
+        // a bullet can appear in more than one manifold (e.g., a corner)
+        if (!world.bullets.alive(impact.bullet))
+            continue;
+        size_t row = world.bullets.rowOf(impact.bullet);
+        spawnSplat(world.splats, impact.position, impact.normal, world.bullets.column<BULLET_VELOCITY>()[row]);
+        destroyBulletRow(world, physics, row);
+        count++;
+    }
+    return count;
+}
+
+// resolves all the hitscan shots of the frame with queries against the level only (no broadphase, no rigid bodies),
+// and spawns the splats directly. Returns the number of impacts
+size_t resolveHitscanShots(EntityWorld &world, btCollisionObject *level, std::vector<HitscanShot> &shots,
+                           const FiringSettings &settings) {
+    size_t count = 0;
+    const btTransform &levelTransform = level->getWorldTransform();
+    btSphereShape sweepShape(settings.sweepRadius > 0 ? settings.sweepRadius : BULLET_RADIUS);
+
+    for (auto &shot: shots) {
+        btVector3 from(shot.origin.x, shot.origin.y, shot.origin.z);
+        btVector3 to = from + btVector3(shot.direction.x, shot.direction.y, shot.direction.z) * settings.range;
+
+        btVector3 point, normal;
+        bool hit;
+        if (settings.sweepRadius > 0) {
+            btTransform fromTransform(btQuaternion::getIdentity(), from);
+            btTransform toTransform(btQuaternion::getIdentity(), to);
+            btCollisionWorld::ClosestConvexResultCallback callback(from, to);
+            btCollisionWorld::objectQuerySingle(&sweepShape, fromTransform, toTransform, level,
+                                                level->getCollisionShape(), levelTransform, callback, 0);
+            hit = callback.hasHit();
+            point = callback.m_hitPointWorld;
+            normal = callback.m_hitNormalWorld;
+        } else {
+            btTransform fromTransform(btQuaternion::getIdentity(), from);
+            btTransform toTransform(btQuaternion::getIdentity(), to);
+            btCollisionWorld::ClosestRayResultCallback callback(from, to);
+            btCollisionWorld::rayTestSingle(fromTransform, toTransform, level, level->getCollisionShape(),
+                                            levelTransform, callback);
+            hit = callback.hasHit();
+            point = callback.m_hitPointWorld;
+            normal = callback.m_hitNormalWorld.normalized();
+        }
+
+        if (hit) {
+            spawnSplat(world.splats, impactPosition(point, normal), glm::vec3(normal.x(), normal.y(), normal.z()),
+                       shot.direction);
+            count++;
+        }
+    }
+    shots.clear();
+    return count;
+}
+
+// fills the list of model matrices of the bullets, reading only the packed positions
+void extractBulletMatrices(const BulletArchetype &bullets, std::vector<glm::mat4> &modelMatrices) {
+    const auto &position = bullets.column<BULLET_POSITION>();
+    modelMatrices.resize(bullets.size());
+    for (size_t i = 0, n = bullets.size(); i < n; i++) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position[i]);
+        modelMatrices[i] = glm::scale(model, glm::vec3(BULLET_RENDER_SCALE));
+    }
+}
+#endif
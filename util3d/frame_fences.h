@@ -0,0 +1,69 @@
+#ifndef FRAME_FENCES_H
+#define FRAME_FENCES_H
+
+// OpenGL side of the frame pacing (util3d/frame_pacer.h): a fence after the commands of each frame, and at the start
+// of a frame the CPU waits until the GPU has finished the frame maxFramesInFlight before it. Without it the driver
+// lets the CPU queue several frames ahead, each of them adding its time to the latency of the inputs.
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <deque>
+
+class FrameFences {
+public:
+    // counters since the creation: starts which had to wait, and the time waited
+    unsigned int waits = 0;
+    double waitedMs = 0;
+
+    FrameFences() = default;
+    FrameFences(const FrameFences &) = delete;
+    FrameFences &operator=(const FrameFences &) = delete;
+
+    // needs the context, as the other owners of OpenGL objects
+    ~FrameFences() {
+        clear();
+    }
+
+    // at the start of a frame: waits until at most maxFramesInFlight - 1 frames are still on the GPU, so that this one
+    // is at most the maxFramesInFlight-th (0 for no limit). Returns the time waited in milliseconds
+    double wait(unsigned int maxFramesInFlight) {
+        if (maxFramesInFlight == 0) {
+            clear();
+            return 0.0;
+        }
+        auto start = std::chrono::steady_clock::now();
+        bool waited = false;
+        while (fences.size() >= maxFramesInFlight) {
+            GLenum status = glClientWaitSync(fences.front(), 0, 0);
+            while (status == GL_TIMEOUT_EXPIRED) {
+                waited = true;
+                status = glClientWaitSync(fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(fences.front());
+            fences.pop_front();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (waited) {
+            waits++;
+            waitedMs += ms;
+        }
+        return ms;
+    }
+
+    // after the last command of the frame (before the swap)
+    void endFrame(unsigned int maxFramesInFlight) {
+        if (maxFramesInFlight > 0)
+            fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    }
+
+    void clear() {
+        for (GLsync fence: fences)
+            glDeleteSync(fence);
+        fences.clear();
+    }
+
+private:
+    std::deque<GLsync> fences;
+};
+#endif
@@ -0,0 +1,122 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+// the passes of a frame of the application and their render targets, declared on a render graph
+// (util3d/render_graph.h). The application gives the code of the passes; the headless benchmark declares the same
+// frame with passes which only record their order.
+// All the targets have the size of the window: with the dynamic resolution, the scaled passes draw only in their
+// lower left corner.
+// With render on demand, the scene and the bloom are drawn in retained targets: when nothing which decides them
+// changed since the last frame drawn (e.g., while the game is paused), the frame is only the composite pass on what
+// that frame left in them.
+
+#include "render_graph.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+struct FramePasses {
+    // level, lights and splat meshes
+    std::function<void(RenderPassContext &)> scene;
+    // copy of the depth of the level for the decals, and the decals
+    std::function<void(RenderPassContext &)> depthCopy, decals;
+    std::function<void(RenderPassContext &)> bullets;
+    // first blur of the bright parts, then the other iterations between the two blur targets
+    std::function<void(RenderPassContext &)> bloomFirst, bloom;
+    // composite.frag, to the backbuffer
+    std::function<void(RenderPassContext &)> composite;
+};
+
+struct FrameTargets {
+    RenderTarget backbuffer = -1;
+    RenderTarget scene = -1, bright = -1, depth = -1;
+    RenderTarget depthCopy = -1;
+    // the bloom ends in blur[0]
+    RenderTarget blur[2] = {-1, -1};
+};
+
+enum FrameCaching {
+    // all the targets are transient
+    FRAME_UNCACHED,
+    // the whole frame, with the scene and the bloom kept for the next frames
+    FRAME_RETAINED,
+    // only the composite pass, on the scene and the bloom of the last FRAME_RETAINED frame
+    FRAME_CACHED
+};
+
+// values which decide the image of the scene and of the bloom (camera, lights, settings, number of objects...):
+// the last drawn can be reused while the signature of the frames stays the same as the one of that frame
+class FrameSignature {
+public:
+    void clear() {
+        bytes.clear();
+    }
+
+    template<typename T>
+    void add(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "the signature copies the bytes of the values");
+        size_t size = bytes.size();
+        bytes.resize(size + sizeof(T));
+        std::memcpy(bytes.data() + size, &value, sizeof(T));
+    }
+
+    template<typename T>
+    void add(const std::vector<T> &values) {
+        add(values.size());
+        for (const T &value: values)
+            add(value);
+    }
+
+    bool operator==(const FrameSignature &other) const {
+        return bytes == other.bytes;
+    }
+
+    bool operator!=(const FrameSignature &other) const {
+        return bytes != other.bytes;
+    }
+
+private:
+    std::vector<unsigned char> bytes;
+};
+
+FrameTargets declareFrameGraph(RenderGraph &graph, int width, int height, bool decals, const FramePasses &passes,
+                               FrameCaching caching = FRAME_UNCACHED) {
+    graph.reset();
+    FrameTargets targets;
+    TargetDesc color, depth;
+    color.format = TARGET_RGBA16F;
+    depth.format = TARGET_DEPTH24;
+    color.width = depth.width = width;
+    color.height = depth.height = height;
+
+    targets.backbuffer = graph.import("backbuffer");
+    bool retained = caching != FRAME_UNCACHED;
+    targets.scene = retained ? graph.retain("scene", color) : graph.create("scene", color);
+    targets.bright = graph.create("bright", color);
+    targets.depth = graph.create("depth", depth);
+    targets.blur[0] = retained ? graph.retain("blur 0", color) : graph.create("blur 0", color);
+    targets.blur[1] = graph.create("blur 1", color);
+
+    if (caching == FRAME_CACHED) {
+        graph.addPass("composite", {targets.scene, targets.blur[0]}, {targets.backbuffer}, passes.composite);
+        return targets;
+    }
+
+    graph.addPass("scene", {}, {targets.scene, targets.bright, targets.depth}, passes.scene);
+    if (decals) {
+        targets.depthCopy = graph.create("depth copy", depth);
+        graph.addPass("depth copy", {targets.depth}, {targets.depthCopy}, passes.depthCopy);
+        // the boxes are depth tested against the level (the depth is attached, but not written)
+        graph.addPass("decals", {targets.depthCopy, targets.depth}, {targets.scene, targets.bright, targets.depth},
+                      passes.decals);
+    }
+    graph.addPass("bullets", {}, {targets.scene, targets.bright, targets.depth}, passes.bullets);
+    // after the first blur the bright parts are not needed anymore, so blur 0 can take their memory (unless it is
+    // retained)
+    graph.addPass("bloom first", {targets.bright}, {targets.blur[1]}, passes.bloomFirst);
+    graph.addPass("bloom", {targets.blur[1]}, {targets.blur[0], targets.blur[1]}, passes.bloom);
+    graph.addPass("composite", {targets.scene, targets.blur[0]}, {targets.backbuffer}, passes.composite);
+    return targets;
+}
+#endif
@@ -0,0 +1,180 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+// frame pacing: the swap interval, a limiter which starts the frames at a regular period, the number of frames the
+// GPU can be behind (the fences are the OpenGL side, in util3d/frame_fences.h), and the statistics of the frame times.
+// The limiter sleeps until a bit before the start of the next frame and spins for the rest: the sleep of the system
+// can be late by a millisecond or more (up to 15.6 ms on Windows with the default timer), so the margin of the spin
+// follows the lateness of the recent sleeps. The next start is the previous one plus the period, not the end of the
+// wait plus the period, so a late frame does not delay the ones after it (unless it is more than a period late).
+// Nothing here uses OpenGL, so it can be checked headless (see the "pacing" group of the benchmark).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// values of glfwSwapInterval: adaptive vsync (it does not wait for the vertical blank when the frame is late) needs
+// WGL_EXT_swap_control_tear or GLX_EXT_swap_control_tear
+enum SwapInterval {
+    SWAP_ADAPTIVE = -1,
+    SWAP_IMMEDIATE = 0,
+    SWAP_VSYNC = 1
+};
+
+struct PacingSettings {
+    int swapInterval = SWAP_VSYNC;
+    // frames per second of the limiter, 0 for no limiter
+    double targetFps = 0;
+    // frames the GPU can be behind the CPU, 0 for no limit
+    unsigned int maxFramesInFlight = 2;
+};
+
+const char *swapIntervalName(int interval) {
+    return interval == SWAP_ADAPTIVE ? "adaptive vsync" : interval == SWAP_IMMEDIATE ? "immediate" : "vsync";
+}
+
+// frame times in milliseconds: mean and standard deviation (Welford) of all the samples, and the percentiles of the
+// last MAX_SAMPLES ones (kept in a ring, so that a long session does not grow it without bound)
+class FrameTimeStats {
+public:
+    // about 18 minutes at 60 frames per second
+    static const size_t MAX_SAMPLES = 1 << 16;
+
+    void add(double ms) {
+        if (samples.size() < MAX_SAMPLES)
+            samples.push_back(ms);
+        else
+            samples[oldest++ % MAX_SAMPLES] = ms;
+        sorted = false;
+        total++;
+        double delta = ms - runningMean;
+        runningMean += delta / total;
+        squares += delta * (ms - runningMean);
+    }
+
+    void clear() {
+        samples.clear();
+        sortedSamples.clear();
+        sorted = true;
+        oldest = total = 0;
+        runningMean = squares = 0;
+    }
+
+    size_t count() const {
+        return total;
+    }
+
+    double mean() const {
+        return runningMean;
+    }
+
+    double stddev() const {
+        return total > 1 ? std::sqrt(squares / (total - 1)) : 0.0;
+    }
+
+    // p in [0, 1], nearest rank among the samples kept
+    double percentile(double p) {
+        if (samples.empty())
+            return 0.0;
+        if (!sorted) {
+            sortedSamples = samples;
+            std::sort(sortedSamples.begin(), sortedSamples.end());
+            sorted = true;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(p * sortedSamples.size()));
+        return sortedSamples[std::min(std::max<size_t>(rank, 1), sortedSamples.size()) - 1];
+    }
+
+    std::string summary() {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << count() << " frames, mean " << mean() << " ms, stddev "
+                << stddev() << ", p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", max "
+                << percentile(1.0);
+        return out.str();
+    }
+
+private:
+    // the ring of the last samples (oldest is the next one overwritten once it is full), and a sorted copy
+    std::vector<double> samples, sortedSamples;
+    bool sorted = true;
+    size_t oldest = 0, total = 0;
+    double runningMean = 0, squares = 0;
+};
+
+class FrameLimiter {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // counters since the creation: time slept and spun, and frames started more than MISS_MS after their time
+    double sleptMs = 0, spunMs = 0;
+    unsigned int frames = 0, misses = 0;
+    static constexpr double MISS_MS = 0.5;
+
+    // waits for the start of the next frame at fps frames per second (no wait if fps <= 0). Returns the time waited
+    // in milliseconds
+    double wait(double fps) {
+        Clock::time_point now = Clock::now();
+        if (fps <= 0.0) {
+            started = false;
+            return 0.0;
+        }
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / fps));
+        // the first frame, or a frame more than a period late: the next ones are paced from now
+        if (!started || now - next > period)
+            next = now;
+        started = true;
+        frames++;
+        if (now - next > std::chrono::duration<double, std::milli>(MISS_MS))
+            misses++;
+
+        Clock::time_point begin = now;
+        std::chrono::duration<double, std::milli> remaining = next - now;
+        if (remaining.count() > spinMarginMs) {
+            Clock::time_point wake = next - std::chrono::duration_cast<Clock::duration>(
+                                         std::chrono::duration<double, std::milli>(spinMarginMs));
+            std::this_thread::sleep_until(wake);
+            now = Clock::now();
+            sleptMs += std::chrono::duration<double, std::milli>(now - begin).count();
+            // the margin covers the worst recent lateness, and slowly comes back when the sleeps are accurate
+            double lateMs = std::chrono::duration<double, std::milli>(now - wake).count();
+            spinMarginMs = std::min(std::max(std::max(spinMarginMs * 0.95, lateMs * 1.25 + 0.1), MIN_MARGIN_MS),
+                                    MAX_MARGIN_MS);
+        }
+        Clock::time_point spinStart = now;
+        while (now < next)
+            now = Clock::now();
+        spunMs += std::chrono::duration<double, std::milli>(now - spinStart).count();
+
+        next += period;
+        return std::chrono::duration<double, std::milli>(now - begin).count();
+    }
+
+    double spinMargin() const {
+        return spinMarginMs;
+    }
+
+private:
+    static constexpr double MIN_MARGIN_MS = 0.5, MAX_MARGIN_MS = 20.0;
+    Clock::time_point next;
+    bool started = false;
+    double spinMarginMs = 2.0;
+};
+
+// the time between two frames is a multiple of the period of the display (or of the limiter), but it is measured
+// with the noise of the wake-ups: within tolerance of a multiple it is taken as that multiple, so the animations
+// and the simulation advance by the same steps as the images (period <= 0: no snapping)
+double snapFrameDelta(double delta, double period, double tolerance = 0.05) {
+    if (period <= 0.0 || delta <= 0.0)
+        return delta;
+    double frames = std::round(delta / period);
+    if (frames >= 1.0 && std::abs(delta - frames * period) <= tolerance * period)
+        return frames * period;
+    return delta;
+}
+#endif
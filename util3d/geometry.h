@@ -0,0 +1,144 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+// CPU-only loading of the geometry of a model (no OpenGL buffers and no textures are created),
+// used to build collision shapes and by the headless tools (benchmark, bakers).
+// The same loader (util3d/obj_loader.h for the OBJ files, ASSIMP for the rest) and mesh filtering of the Model class
+// are used, so that vertices and triangles are in the same order of the meshes drawn by the application.
+
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include "obj_loader.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct MeshGeometry {
+    std::string name;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<unsigned int> indices;
+    glm::vec3 diffuse;
+    glm::vec3 emissive;
+};
+
+void processGeometryNode(aiNode *node, const aiScene *scene, std::vector<MeshGeometry> &meshes) {
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+        // same filter of Model::processNode
+        if (std::string("obj2") == mesh->mName.data)
+            continue;
+
+        MeshGeometry geometry;
+        geometry.name = mesh->mName.data;
+        geometry.positions.reserve(mesh->mNumVertices);
+        geometry.normals.reserve(mesh->mNumVertices);
+        geometry.texCoords.reserve(mesh->mNumVertices);
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+            geometry.positions.push_back(glm::vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z));
+            if (mesh->HasNormals())
+                geometry.normals.push_back(glm::vec3(mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z));
+            else
+                geometry.normals.push_back(glm::vec3(0.0f));
+            if (mesh->mTextureCoords[0])
+                geometry.texCoords.push_back(glm::vec2(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y));
+            else
+                geometry.texCoords.push_back(glm::vec2(0.0f));
+        }
+        geometry.indices.reserve(mesh->mNumFaces * 3);
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+            const aiFace &face = mesh->mFaces[f];
+            for (unsigned int j = 0; j < face.mNumIndices; j++)
+                geometry.indices.push_back(face.mIndices[j]);
+        }
+
+        aiColor3D diffuse, emissive;
+        aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+        material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+        material->Get(AI_MATKEY_COLOR_EMISSIVE, emissive);
+        geometry.diffuse = glm::vec3(diffuse.r, diffuse.g, diffuse.b);
+        geometry.emissive = glm::vec3(emissive.r, emissive.g, emissive.b);
+        meshes.push_back(geometry);
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+        processGeometryNode(node->mChildren[i], scene, meshes);
+}
+
+// with the importer of ASSIMP, whatever the format (the application used it for the OBJ files too, see
+// util3d/obj_loader.h)
+std::vector<MeshGeometry> loadGeometryAssimp(const std::string &path) {
+    std::vector<MeshGeometry> meshes;
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(
+        path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return meshes;
+    }
+    processGeometryNode(scene->mRootNode, scene, meshes);
+    return meshes;
+}
+
+std::vector<MeshGeometry> geometryFromObj(ObjModel &model) {
+    std::vector<MeshGeometry> meshes;
+    meshes.reserve(model.meshes.size());
+    for (ObjMesh &mesh: model.meshes) {
+        // same filter of Model::processNode
+        if (mesh.name == "obj2")
+            continue;
+        MeshGeometry geometry;
+        geometry.name = mesh.name;
+        geometry.positions = std::move(mesh.positions);
+        geometry.normals = std::move(mesh.normals);
+        geometry.texCoords = std::move(mesh.texCoords);
+        geometry.indices = std::move(mesh.indices);
+        geometry.diffuse = model.materials[mesh.material].diffuse;
+        geometry.emissive = model.materials[mesh.material].emissive;
+        meshes.push_back(std::move(geometry));
+    }
+    return meshes;
+}
+
+std::vector<MeshGeometry> loadGeometry(const std::string &path) {
+    if (!isObjFile(path))
+        return loadGeometryAssimp(path);
+    ObjModel model;
+    if (!loadObj(path, model))
+        return std::vector<MeshGeometry>();
+    return geometryFromObj(model);
+}
+
+// all the triangles of the meshes, as a list of 3 consecutive vertices per triangle
+std::vector<glm::vec3> collectTriangles(const std::vector<MeshGeometry> &meshes) {
+    std::vector<glm::vec3> triangles;
+    for (auto &mesh: meshes)
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+            triangles.insert(triangles.end(), {mesh.positions[mesh.indices[i]], mesh.positions[mesh.indices[i + 1]],
+                                               mesh.positions[mesh.indices[i + 2]]});
+    return triangles;
+}
+
+// static triangle mesh of the level, used by Bullet for the collisions with the player and the bullets
+btBvhTriangleMeshShape *createTriangleMeshShape(const std::vector<MeshGeometry> &meshes) {
+    auto *envMesh = new btTriangleMesh();
+    for (auto &mesh: meshes) {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const glm::vec3 &v1 = mesh.positions[mesh.indices[i]];
+            const glm::vec3 &v2 = mesh.positions[mesh.indices[i + 1]];
+            const glm::vec3 &v3 = mesh.positions[mesh.indices[i + 2]];
+            envMesh->addTriangle(
+                btVector3(v1.x, v1.y, v1.z),
+                btVector3(v2.x, v2.y, v2.z),
+                btVector3(v3.x, v3.y, v3.z)
+            );
+        }
+    }
+    return new btBvhTriangleMeshShape(envMesh, true);
+}
+#endif
@@ -0,0 +1,237 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+// vertices and indices of all the meshes of a vertex format in two large buffers, with a single vertex array:
+// the meshes take ranges of the buffers (util3d/range_allocator.h) and are drawn with the BaseVertex draw calls,
+// so their indices start from 0 as in separate buffers, and there is no buffer or vertex array per mesh.
+// When a buffer is full it is reallocated with the double of its size, and compact() moves the ranges to its start
+// after many meshes have been freed. The uploads and the copies go through the GL_COPY_* targets, to leave the
+// element buffer of the vertex array bound to it.
+// The vertex format is a struct with a static setupAttributes(), which sets the attributes of the buffer bound to
+// GL_ARRAY_BUFFER (see Vertex in util3d/mesh.h).
+
+#include <glad/glad.h>
+
+#include "gl_handles.h"
+#include "range_allocator.h"
+
+#include <sstream>
+#include <string>
+
+enum ArenaBuffer {
+    ARENA_VERTICES,
+    ARENA_INDICES,
+};
+
+template <typename VertexFormat>
+class GeometryArena {
+public:
+    // the ranges of a mesh, freed with it: like the GL handles, a block can be moved but not copied
+    class Block {
+    public:
+        Block() = default;
+
+        Block(GeometryArena *arena, size_t vertexCount, size_t indexCount) : arena(arena) {
+            vertices = arena->allocate(ARENA_VERTICES, vertexCount);
+            indices = arena->allocate(ARENA_INDICES, indexCount);
+        }
+
+        ~Block() {
+            reset();
+        }
+
+        Block(const Block &) = delete;
+        Block &operator=(const Block &) = delete;
+
+        Block(Block &&other) noexcept : arena(other.arena), vertices(other.vertices), indices(other.indices) {
+            other.arena = nullptr;
+        }
+
+        Block &operator=(Block &&other) noexcept {
+            if (this != &other) {
+                reset();
+                arena = other.arena;
+                vertices = other.vertices;
+                indices = other.indices;
+                other.arena = nullptr;
+            }
+            return *this;
+        }
+
+        void reset() {
+            if (arena == nullptr)
+                return;
+            arena->ranges[ARENA_VERTICES].free(vertices);
+            arena->ranges[ARENA_INDICES].free(indices);
+            arena = nullptr;
+        }
+
+        // binds the vertex array of the arena, for the draw calls of the block
+        void bind() const {
+            arena->bind();
+        }
+
+        // added to the indices by the BaseVertex draw calls
+        GLint baseVertex() const {
+            return static_cast<GLint>(arena->ranges[ARENA_VERTICES].offset(vertices));
+        }
+
+        // element buffer offset of the index at the given byte offset from the first index of the block
+        const void *indexOffset(size_t bytes) const {
+            return (const void *) (arena->ranges[ARENA_INDICES].offset(indices) * sizeof(GLuint) + bytes);
+        }
+
+        size_t indexCount() const {
+            return arena->ranges[ARENA_INDICES].size(indices);
+        }
+
+        void uploadVertices(const VertexFormat *data, size_t count) {
+            arena->upload(ARENA_VERTICES, vertices, data, count);
+        }
+
+        void uploadIndices(const GLuint *data, size_t count) {
+            arena->upload(ARENA_INDICES, indices, data, count);
+        }
+
+        // the block gets a range of indices of another size (e.g., with the levels of detail): the indices must be
+        // uploaded again
+        void resizeIndices(size_t count) {
+            if (count == indexCount())
+                return;
+            arena->ranges[ARENA_INDICES].free(indices);
+            indices = arena->allocate(ARENA_INDICES, count);
+        }
+
+    private:
+        GeometryArena *arena = nullptr;
+        RangeId vertices = -1, indices = -1;
+    };
+
+    // needs the OpenGL context; the capacities are in vertices and indices
+    GeometryArena(size_t vertexCapacity, size_t indexCapacity) {
+        VAO = GLVertexArray::create();
+        for (int buffer = 0; buffer < 2; buffer++) {
+            size_t capacity = buffer == ARENA_VERTICES ? vertexCapacity : indexCapacity;
+            ranges[buffer].grow(capacity);
+            buffers[buffer] = createBuffer(static_cast<ArenaBuffer>(buffer), capacity);
+        }
+        setupVertexArray();
+    }
+
+    // the blocks point to the arena, which must outlive them
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    Block allocate(size_t vertexCount, size_t indexCount) {
+        return Block(this, vertexCount, indexCount);
+    }
+
+    void bind() const {
+        glBindVertexArray(VAO.get());
+    }
+
+    // moves the ranges of both buffers to their start, copying the data to new buffers of the same size
+    void compact() {
+        for (int buffer = 0; buffer < 2; buffer++) {
+            std::vector<RangeMove> moves = ranges[buffer].compact();
+            if (moves.empty())
+                continue;
+            GLBuffer compacted = createBuffer(static_cast<ArenaBuffer>(buffer), ranges[buffer].capacity());
+            // the ranges which did not move are copied as well: everything before the first move, and the ranges
+            // between the moves (which were already next to the previous ones)
+            size_t size = elementSize(static_cast<ArenaBuffer>(buffer));
+            glBindBuffer(GL_COPY_READ_BUFFER, buffers[buffer].get());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, compacted.get());
+            size_t copied = 0;
+            for (auto &move: moves) {
+                if (move.destination > copied)
+                    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copied * size, copied * size,
+                                        (move.destination - copied) * size);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.source * size,
+                                    move.destination * size, move.size * size);
+                copied = move.destination + move.size;
+            }
+            size_t used = ranges[buffer].used();
+            if (used > copied)
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copied * size, copied * size,
+                                    (used - copied) * size);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            buffers[buffer] = std::move(compacted);
+        }
+        setupVertexArray();
+    }
+
+    const RangeAllocator &allocator(ArenaBuffer buffer) const {
+        return ranges[buffer];
+    }
+
+    // occupancy and fragmentation of the two buffers
+    std::string describe() const {
+        std::ostringstream text;
+        const char *names[2] = {"vertices", "indices"};
+        for (int buffer = 0; buffer < 2; buffer++) {
+            const RangeAllocator &range = ranges[buffer];
+            text << (buffer == 0 ? "" : ", ") << names[buffer] << " " << range.used() << "/" << range.capacity()
+                    << " (" << range.freeBlockCount() << " free blocks, fragmentation "
+                    << static_cast<int>(range.fragmentation() * 100.0f) << "%)";
+        }
+        return text.str();
+    }
+
+private:
+    GLVertexArray VAO;
+    GLBuffer buffers[2];
+    RangeAllocator ranges[2];
+
+    static size_t elementSize(ArenaBuffer buffer) {
+        return buffer == ARENA_VERTICES ? sizeof(VertexFormat) : sizeof(GLuint);
+    }
+
+    static GLBuffer createBuffer(ArenaBuffer buffer, size_t capacity) {
+        GLBuffer name = GLBuffer::create();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, name.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * elementSize(buffer), NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return name;
+    }
+
+    // the attributes refer to the buffer bound when they are set, so they are set again when the buffers change
+    void setupVertexArray() {
+        glBindVertexArray(VAO.get());
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[ARENA_VERTICES].get());
+        VertexFormat::setupAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[ARENA_INDICES].get());
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // a range, growing the buffer if needed (the old contents are copied to the new one)
+    RangeId allocate(ArenaBuffer buffer, size_t count) {
+        size_t capacity = ranges[buffer].capacity();
+        RangeId id = ranges[buffer].allocate(count);
+        if (ranges[buffer].capacity() != capacity) {
+            GLBuffer grown = createBuffer(buffer, ranges[buffer].capacity());
+            glBindBuffer(GL_COPY_READ_BUFFER, buffers[buffer].get());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, grown.get());
+            if (capacity > 0)
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * elementSize(buffer));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            buffers[buffer] = std::move(grown);
+            setupVertexArray();
+        }
+        return id;
+    }
+
+    void upload(ArenaBuffer buffer, RangeId id, const void *data, size_t count) {
+        count = std::min(count, ranges[buffer].size(id));
+        if (count == 0)
+            return;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[buffer].get());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, ranges[buffer].offset(id) * elementSize(buffer),
+                        count * elementSize(buffer), data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,142 @@
+#ifndef GL_HANDLES_H
+#define GL_HANDLES_H
+
+// owners of OpenGL object names: the name is deleted with its owner, and the owners can be moved but not copied,
+// so each name is deleted exactly once (e.g., a Model moved around keeps its textures).
+// Each kind of object counts the names alive, to find the leaks: all of them must be 0 once the objects owning
+// GL names are destroyed (the counts are printed before the context is destroyed, see the end of main, and checked
+// by work06b --leak-check).
+// The owners must be destroyed while the context still exists.
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+template <typename Kind>
+class GLHandle {
+public:
+    GLHandle() = default;
+
+    // takes the ownership of an existing name
+    explicit GLHandle(GLuint name) : name(name) {
+        if (name != 0)
+            live()++;
+    }
+
+    // a new name
+    static GLHandle create() {
+        GLuint name = 0;
+        Kind::create(name);
+        return GLHandle(name);
+    }
+
+    ~GLHandle() {
+        reset();
+    }
+
+    GLHandle(const GLHandle &) = delete;
+    GLHandle &operator=(const GLHandle &) = delete;
+
+    GLHandle(GLHandle &&other) noexcept : name(other.name) {
+        other.name = 0;
+    }
+
+    GLHandle &operator=(GLHandle &&other) noexcept {
+        if (this != &other) {
+            reset();
+            name = other.name;
+            other.name = 0;
+        }
+        return *this;
+    }
+
+    GLuint get() const {
+        return name;
+    }
+
+    // deletes the name (if any)
+    void reset() {
+        if (name == 0)
+            return;
+        Kind::destroy(name);
+        live()--;
+        name = 0;
+    }
+
+    // names of this kind alive
+    static int &live() {
+        static int count = 0;
+        return count;
+    }
+
+private:
+    GLuint name = 0;
+};
+
+struct GLBufferKind {
+    static void create(GLuint &name) { glGenBuffers(1, &name); }
+    static void destroy(GLuint name) { glDeleteBuffers(1, &name); }
+};
+
+struct GLVertexArrayKind {
+    static void create(GLuint &name) { glGenVertexArrays(1, &name); }
+    static void destroy(GLuint name) { glDeleteVertexArrays(1, &name); }
+};
+
+struct GLTextureKind {
+    static void create(GLuint &name) { glGenTextures(1, &name); }
+    static void destroy(GLuint name) { glDeleteTextures(1, &name); }
+};
+
+typedef GLHandle<GLBufferKind> GLBuffer;
+typedef GLHandle<GLVertexArrayKind> GLVertexArray;
+typedef GLHandle<GLTextureKind> GLTexture;
+
+// total of the names alive
+int liveGLObjects() {
+    return GLBuffer::live() + GLVertexArray::live() + GLTexture::live();
+}
+
+// the names of each kind which exist in the context, found with glIs* up to limit: unlike the counts above, they
+// include the names not owned by the handles (e.g., the framebuffers of the render targets). It queries every name,
+// so it is only for the leak check (work06b --leak-check)
+struct GLNames {
+    std::vector<GLuint> buffers, vertexArrays, textures, framebuffers;
+
+    size_t count() const {
+        return buffers.size() + vertexArrays.size() + textures.size() + framebuffers.size();
+    }
+};
+
+GLNames glNamesAlive(GLuint limit = 1 << 16) {
+    GLNames names;
+    for (GLuint name = 1; name <= limit; name++) {
+        if (glIsBuffer(name))
+            names.buffers.push_back(name);
+        if (glIsVertexArray(name))
+            names.vertexArrays.push_back(name);
+        if (glIsTexture(name))
+            names.textures.push_back(name);
+        if (glIsFramebuffer(name))
+            names.framebuffers.push_back(name);
+    }
+    return names;
+}
+
+// the names of after which were not in before
+GLNames glNamesAdded(const GLNames &before, const GLNames &after) {
+    auto added = [](const std::vector<GLuint> &from, const std::vector<GLuint> &to) {
+        std::vector<GLuint> names;
+        std::set_difference(to.begin(), to.end(), from.begin(), from.end(), std::back_inserter(names));
+        return names;
+    };
+    GLNames names;
+    names.buffers = added(before.buffers, after.buffers);
+    names.vertexArrays = added(before.vertexArrays, after.vertexArrays);
+    names.textures = added(before.textures, after.textures);
+    names.framebuffers = added(before.framebuffers, after.framebuffers);
+    return names;
+}
+#endif
@@ -0,0 +1,228 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// input-to-photon latency: the time from an input event to the end of the first frame which shows it. The events
+// are stamped when the application receives them, and each frame records when its camera was latched (the view
+// matrix built from the inputs received so far), when it was swapped and, when the GL_TIMESTAMP queries are read,
+// when the GPU finished it (converted to the time of the CPU). The GPU end is the closest to the photons we can
+// measure: the display still adds its scanout.
+// With the late latch the application receives the inputs again just before the scene is submitted, after the
+// simulation and the wait for the queries, so the events of that time are in the frame instead of the next one.
+// The scripted replay gives mouse movements at fixed times, independent of the frames, so both modes can be compared
+// on the same input. Nothing here uses OpenGL or GLFW (the times are given by the application), so it can be checked
+// headless (see the "latency" group of the benchmark).
+
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// latencies in milliseconds, in buckets for the printed histogram. The count and the mean cover all the samples, the
+// percentiles the last ones (the bounded ring of FrameTimeStats, see util3d/frame_pacer.h)
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(double bucketMs = 2.0, size_t buckets = 50) : bucketMs(bucketMs), counts(buckets + 1) {}
+
+    void add(double ms) {
+        samples.add(ms);
+        size_t bucket = ms <= 0.0 ? 0 : static_cast<size_t>(ms / bucketMs);
+        counts[std::min(bucket, counts.size() - 1)]++;
+    }
+
+    void clear() {
+        samples.clear();
+        std::fill(counts.begin(), counts.end(), 0);
+    }
+
+    size_t count() const {
+        return samples.count();
+    }
+
+    double mean() const {
+        return samples.mean();
+    }
+
+    // p in [0, 1], nearest rank
+    double percentile(double p) {
+        return samples.percentile(p);
+    }
+
+    std::string summary() {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << count() << " samples, mean " << mean() << " ms, p50 "
+                << percentile(0.5) << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99) << ", max "
+                << percentile(1.0);
+        return out.str();
+    }
+
+    // one line per bucket between the first and the last used, with a bar of up to width characters
+    std::string bars(size_t width = 50) const {
+        std::ostringstream out;
+        size_t first = counts.size(), last = 0, largest = 0;
+        for (size_t b = 0; b < counts.size(); b++) {
+            if (counts[b] == 0)
+                continue;
+            first = std::min(first, b);
+            last = b;
+            largest = std::max(largest, counts[b]);
+        }
+        for (size_t b = first; b <= last && b < counts.size(); b++) {
+            out << std::setw(6) << b * bucketMs << (b + 1 == counts.size() ? "+  ms " : "   ms ") << std::setw(7)
+                    << counts[b] << " " << std::string(counts[b] * width / largest, '#') << std::endl;
+        }
+        return out.str();
+    }
+
+    double bucketWidth() const {
+        return bucketMs;
+    }
+
+    const std::vector<size_t> &buckets() const {
+        return counts;
+    }
+
+private:
+    double bucketMs;
+    std::vector<size_t> counts;
+    FrameTimeStats samples;
+};
+
+class LatencyTracker {
+public:
+    // from the input to the view which uses it, to the swap of its frame, and to the end of the frame on the GPU
+    LatencyHistogram toLatch, toSwap, toGpu;
+
+    // an input event received at this time (in seconds, as all the times)
+    void input(double time) {
+        pending.push_back(time);
+    }
+
+    // the view of the frame is built with the inputs received so far (called again by the late latch)
+    void latch(double time) {
+        for (double input: pending) {
+            toLatch.add((time - input) * 1000.0);
+            frameInputs.push_back(input);
+        }
+        pending.clear();
+    }
+
+    // end of the frame on the CPU: its inputs wait for the time of the GPU if it will be given
+    void endFrame(unsigned int frame, double swapTime, bool gpuTiming) {
+        for (double input: frameInputs)
+            toSwap.add((swapTime - input) * 1000.0);
+        if (gpuTiming && !frameInputs.empty())
+            waitingGpu.push_back({frame, frameInputs});
+        frameInputs.clear();
+    }
+
+    // time at which the GPU finished a frame (the frames before it which never got one are dropped)
+    void gpuDone(unsigned int frame, double time) {
+        while (!waitingGpu.empty() && waitingGpu.front().frame < frame)
+            waitingGpu.pop_front();
+        if (waitingGpu.empty() || waitingGpu.front().frame != frame)
+            return;
+        for (double input: waitingGpu.front().inputs)
+            toGpu.add((time - input) * 1000.0);
+        waitingGpu.pop_front();
+    }
+
+    void clear() {
+        toLatch.clear();
+        toSwap.clear();
+        toGpu.clear();
+        pending.clear();
+        frameInputs.clear();
+        waitingGpu.clear();
+    }
+
+private:
+    struct WaitingFrame {
+        unsigned int frame;
+        std::vector<double> inputs;
+    };
+    // inputs not latched yet, and the ones of the current frame
+    std::vector<double> pending, frameInputs;
+    std::deque<WaitingFrame> waitingGpu;
+};
+
+// mouse movements at a fixed rate (like the reports of a mouse), turning the camera left and right
+struct ReplayEvent {
+    // from the start of the replay
+    double time;
+    float dx, dy;
+};
+
+class InputReplay {
+public:
+    InputReplay() = default;
+
+    InputReplay(double seconds, double rate, unsigned int seed = 1) {
+        std::default_random_engine generator(seed);
+        std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+        size_t count = static_cast<size_t>(seconds * rate);
+        for (size_t i = 0; i < count; i++) {
+            double time = i / rate;
+            // a sweep of about a second each way, with the small noise of a hand
+            float dx = 6.0f * static_cast<float>(std::sin(time * 3.0)) + jitter(generator);
+            events.push_back({time, dx, jitter(generator)});
+        }
+    }
+
+    // starts again from the first event, at this time
+    void start(double time) {
+        startTime = time;
+        next = 0;
+    }
+
+    // gives the events up to this time to apply(event, time of the event)
+    template<typename Apply>
+    size_t deliver(double now, Apply apply) {
+        size_t delivered = 0;
+        while (next < events.size() && startTime + events[next].time <= now) {
+            apply(events[next], startTime + events[next].time);
+            next++;
+            delivered++;
+        }
+        return delivered;
+    }
+
+    bool finished() const {
+        return next >= events.size();
+    }
+
+    double duration() const {
+        return events.empty() ? 0.0 : events.back().time;
+    }
+
+private:
+    std::vector<ReplayEvent> events;
+    double startTime = 0;
+    size_t next = 0;
+};
+
+// the histograms of the runs as columns: bucket, then input to swap and input to GPU end of each run
+void writeLatencyCsv(std::ostream &out, const std::vector<std::string> &names,
+                     const std::vector<LatencyTracker *> &runs) {
+    out << "bucket_ms";
+    for (auto &name: names)
+        out << "," << name << "_swap," << name << "_gpu";
+    out << std::endl;
+    if (runs.empty())
+        return;
+    const LatencyHistogram &first = runs[0]->toSwap;
+    for (size_t b = 0; b < first.buckets().size(); b++) {
+        out << b * first.bucketWidth();
+        for (LatencyTracker *run: runs)
+            out << "," << run->toSwap.buckets()[b] << "," << run->toGpu.buckets()[b];
+        out << std::endl;
+    }
+}
+#endif
@@ -0,0 +1,104 @@
+#ifndef LIGHT_ASSIGNMENT_H
+#define LIGHT_ASSIGNMENT_H
+
+// load-time assignment of a ceiling light to each vertex of the level, used by the emissive term of the ceiling
+// panels in shader.frag (each panel flickers with its light).
+// Each triangle gets the light closest to its centroid, found with a uniform grid over the light positions (on the
+// XZ plane, since the lights are all at the same height), and its vertices store the index as a vertex attribute.
+// The result does not depend on the order of vertices and triangles, so the meshes can be reordered, split or welded.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+class LightGrid {
+public:
+    void build(const std::vector<glm::vec3> &lightPositions, float size) {
+        positions = lightPositions;
+        cellSize = size;
+        boundsMin = glm::vec2(FLT_MAX);
+        glm::vec2 boundsMax(-FLT_MAX);
+        for (auto &p: positions) {
+            boundsMin = glm::min(boundsMin, glm::vec2(p.x, p.z));
+            boundsMax = glm::max(boundsMax, glm::vec2(p.x, p.z));
+        }
+        if (positions.empty())
+            boundsMin = boundsMax = glm::vec2(0.0f);
+        width = static_cast<int>((boundsMax.x - boundsMin.x) / cellSize) + 1;
+        height = static_cast<int>((boundsMax.y - boundsMin.y) / cellSize) + 1;
+        cells.assign(static_cast<size_t>(width) * height, std::vector<unsigned int>());
+        for (unsigned int i = 0; i < positions.size(); i++) {
+            glm::ivec2 c = cellOf(positions[i]);
+            cells[static_cast<size_t>(c.y) * width + c.x].push_back(i);
+        }
+    }
+
+    // index of the closest light (in 3D), or -1 if there are no lights. The rings of cells around the point are
+    // visited until no closer light can be found in the next ring
+    int nearest(const glm::vec3 &point) const {
+        if (positions.empty())
+            return -1;
+        glm::ivec2 center = cellOf(point);
+        int best = -1;
+        float bestDistance = FLT_MAX;
+        int maxRing = std::max(width, height) + std::max(std::abs(center.x), std::abs(center.y));
+        for (int ring = 0; ring <= maxRing; ring++) {
+            // every point of the ring is at least (ring - 1) cells away on the plane
+            float ringDistance = std::max(0, ring - 1) * cellSize;
+            if (best >= 0 && ringDistance * ringDistance > bestDistance)
+                break;
+            for (int y = center.y - ring; y <= center.y + ring; y++) {
+                for (int x = center.x - ring; x <= center.x + ring; x++) {
+                    if (std::max(std::abs(x - center.x), std::abs(y - center.y)) != ring)
+                        continue; // inside the ring, already visited
+                    if (x < 0 || y < 0 || x >= width || y >= height)
+                        continue;
+                    for (unsigned int i: cells[static_cast<size_t>(y) * width + x]) {
+                        glm::vec3 d = positions[i] - point;
+                        float distance = glm::dot(d, d);
+                        // ties go to the lowest index, so the result is deterministic
+                        if (distance < bestDistance || (distance == bestDistance && static_cast<int>(i) < best)) {
+                            bestDistance = distance;
+                            best = static_cast<int>(i);
+                        }
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+private:
+    std::vector<glm::vec3> positions;
+    std::vector<std::vector<unsigned int> > cells;
+    glm::vec2 boundsMin = glm::vec2(0.0f);
+    float cellSize = 1.0f;
+    int width = 0, height = 0;
+
+    // cell of a point, possibly outside the grid
+    glm::ivec2 cellOf(const glm::vec3 &p) const {
+        return glm::ivec2(static_cast<int>(std::floor((p.x - boundsMin.x) / cellSize)),
+                          static_cast<int>(std::floor((p.z - boundsMin.y) / cellSize)));
+    }
+};
+
+// light of each vertex of a mesh: the light closest to the centroid of the triangles using the vertex
+// (a vertex shared by triangles with different lights keeps the lowest index, whatever the order of the triangles)
+std::vector<unsigned int> assignNearestLights(const std::vector<glm::vec3> &positions,
+                                              const std::vector<unsigned int> &indices, const LightGrid &grid) {
+    const unsigned int UNASSIGNED = ~0u;
+    std::vector<unsigned int> lights(positions.size(), UNASSIGNED);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        glm::vec3 centroid = (positions[indices[i]] + positions[indices[i + 1]] + positions[indices[i + 2]]) / 3.0f;
+        int light = grid.nearest(centroid);
+        for (int k = 0; k < 3; k++)
+            lights[indices[i + k]] = std::min(lights[indices[i + k]], static_cast<unsigned int>(std::max(light, 0)));
+    }
+    // vertices not used by any triangle
+    std::replace(lights.begin(), lights.end(), UNASSIGNED, 0u);
+    return lights;
+}
+#endif
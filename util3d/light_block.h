@@ -0,0 +1,78 @@
+#ifndef LIGHT_BLOCK_H
+#define LIGHT_BLOCK_H
+
+// the lights of the frame as the FrameLights uniform block of shader.frag (std140 layout): written once per frame
+// in the stream buffer (util3d/stream_buffer.h) and bound to all the variants, instead of the uniforms of each light
+// set on each variant. In std140 a vec3 takes 16 bytes unless a float follows it, so the floats of the lights fill
+// the gaps after the vectors, in the same order as in the shader.
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "entities.h"
+
+// binding point of the block
+const GLuint FRAME_LIGHTS_BINDING = 0;
+
+struct LightStd140 {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct FrameLightsStd140 {
+    // AmbientLight ambient
+    glm::vec3 ambientAmbient;
+    float padding0;
+    glm::vec3 ambientDiffuse;
+    float padding1;
+    glm::vec3 ambientSpecular;
+    float padding2;
+    LightStd140 lights[NR_CEILING_LIGHTS];
+    glm::vec3 eyePosition;
+    float ceilingFlicker;
+    glm::vec3 eyeDirection;
+    GLuint debugLightId;
+};
+
+static_assert(sizeof(LightStd140) == 64, "std140 layout of Light");
+static_assert(sizeof(FrameLightsStd140) == 48 + 64 * NR_CEILING_LIGHTS + 32, "std140 layout of FrameLights");
+
+// the values of the lights, without the ones of the camera
+FrameLightsStd140 packFrameLights(const LightArchetype &lights, const glm::vec3 &ambient, const glm::vec3 &diffuse,
+                                  const glm::vec3 &specular) {
+    FrameLightsStd140 block = {};
+    block.ambientAmbient = ambient;
+    block.ambientDiffuse = diffuse;
+    block.ambientSpecular = specular;
+    const auto &position = lights.column<LIGHT_POSITION>();
+    const auto &attenuation = lights.column<LIGHT_ATTENUATION>();
+    const auto &lightAmbient = lights.column<LIGHT_AMBIENT>();
+    const auto &lightDiffuse = lights.column<LIGHT_DIFFUSE>();
+    const auto &lightSpecular = lights.column<LIGHT_SPECULAR>();
+    for (size_t i = 0; i < position.size() && i < NR_CEILING_LIGHTS; i++) {
+        LightStd140 &light = block.lights[i];
+        light.position = position[i];
+        light.constant = attenuation[i].x;
+        light.linear = attenuation[i].y;
+        light.quadratic = attenuation[i].z;
+        light.ambient = lightAmbient[i];
+        light.diffuse = lightDiffuse[i];
+        light.specular = lightSpecular[i];
+    }
+    return block;
+}
+
+// the variants of shader.frag read the block from FRAME_LIGHTS_BINDING (there is no layout binding in GLSL 4.10)
+void bindFrameLightsBlock(GLuint program) {
+    GLuint index = glGetUniformBlockIndex(program, "FrameLights");
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, FRAME_LIGHTS_BINDING);
+}
+#endif
@@ -0,0 +1,128 @@
+#ifndef LIGHT_FLICKER_H
+#define LIGHT_FLICKER_H
+
+// the ceiling lights of the level: at the start they are switched on one group after the other, then all of them
+// flicker at random times. A flicker dims the room and the point lights (a strong one can leave one light on), and
+// the ceiling panels follow it through the ceiling factor given to the shaders. It only writes the colors of the
+// lights (the positions stay in the light archetype), so it can be run headless (see the "micro" group of the
+// benchmark).
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+class CeilingLightFlicker {
+public:
+    // flicker of the ceiling panels for the shaders (1 when the lights are steady)
+    float ceiling = 1.0f;
+
+    explicit CeilingLightFlicker(unsigned int seed = std::default_random_engine::default_seed)
+        : generator(seed), dist(0.0, 0.1) {}
+
+    // advances the lights by deltaTime seconds: roomAmbient is the ambient term of the whole room, the vectors are
+    // the colors of the point lights
+    void update(float deltaTime, glm::vec3 &roomAmbient, std::vector<glm::vec3> &ambient,
+                std::vector<glm::vec3> &diffuse, std::vector<glm::vec3> &specular) {
+        int count = static_cast<int>(ambient.size());
+        sinceDecision += deltaTime;
+        ceiling = 1.0f;
+        if (count == 0)
+            return;
+        if (warmingUp < 4) {
+            warmingUpDuration += deltaTime;
+            if (warmingUpDuration > 1.5) {
+                int i;
+                for (i = 0; i < (warmingUp == 2 ? 7 : 6) && warmingUpIdx + i < count; i++) {
+                    ambient[warmingUpIdx + i] = glm::vec3(0.05f);
+                    diffuse[warmingUpIdx + i] = glm::vec3(0.8f);
+                    specular[warmingUpIdx + i] = glm::vec3(1.0f);
+                }
+                warmingUpIdx += i;
+                warmingUp++;
+                warmingUpDuration = 0;
+            }
+        } else if (flickerDuration > 0) {
+            // a step of the flicker each 10 ms of the frame
+            float delta = deltaTime;
+            do {
+                float gen = std::abs(static_cast<float>(dist(generator)));
+                roomAmbient = glm::vec3(roomBase - gen * 0.5f);
+                for (int i = 0; i < count; i++) {
+                    if (ceilingBase < 1 && flickerLight == i)
+                        continue;
+                    ambient[i] = glm::vec3(pointBase - std::abs(static_cast<float>(dist(generator))) * 1.5f * 0.05f);
+                    diffuse[i] = glm::vec3(0);
+                }
+                if (ceilingBase < 1) {
+                    ceiling = ceilingBase - gen * 8;
+
+                    // the light left on changes every 0.3 s
+                    flickerLightDuration += deltaTime;
+                    if (flickerLightDuration > 0.3) {
+                        if (dist(generator) > 0) {
+                            flickerLight = lightIndex(count);
+                            ambient[flickerLight] = glm::vec3(0.2f);
+                        }
+                        flickerLightDuration = 0;
+                    }
+                }
+                delta -= 0.01;
+            } while (delta >= 0.01);
+            flickerDuration -= deltaTime;
+        } else {
+            roomAmbient = glm::vec3(0.35f);
+            for (int i = 0; i < count; i++) {
+                ambient[i] = glm::vec3(0.05f);
+                diffuse[i] = glm::vec3(0.8f);
+            }
+            ceilingBase = 1.0;
+            // a new flicker at most each 1/60 s
+            if (sinceDecision > (1 / 60.0f)) {
+                flickerDuration = (dist(generator) - 0.20) * 7;
+                if (flickerDuration > 0) {
+                    flickerLight = lightIndex(count);
+                    if (dist(generator) > 0.1) {
+                        // strong flicker: almost dark, with one light left on
+                        roomBase = 0.02f;
+                        flickerDuration += 0.5;
+                        flickerDuration *= 1.8;
+                        pointBase = 0.005f;
+                        ceilingBase = 0.35f;
+                    } else {
+                        roomBase = 0.35f;
+                        pointBase = 0.05f;
+                        ceilingBase = 0.7f;
+                    }
+                }
+
+                sinceDecision = 0;
+            }
+        }
+    }
+
+    // whether all the groups of lights have been switched on
+    bool warmedUp() const {
+        return warmingUp >= 4;
+    }
+
+private:
+    std::default_random_engine generator;
+    std::normal_distribution<double> dist;
+
+    int warmingUp = 0;
+    int warmingUpIdx = 0;
+    float warmingUpDuration = 0.2f;
+
+    float sinceDecision = 0;
+    float flickerDuration = 0;
+    float roomBase = 0.35f, pointBase = 0.05f, ceilingBase = 1.0f;
+    int flickerLight = -1;
+    float flickerLightDuration = 0;
+
+    int lightIndex(int count) {
+        return std::uniform_int_distribution<int>(0, count - 1)(generator);
+    }
+};
+#endif
@@ -0,0 +1,164 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+// baked lighting of the ceiling lights (see lightmap_baker.cpp).
+// The lights never move and only their intensities change (flicker), so for each texel of the level the baker
+// stores 2 values per light, which do not depend on the intensities:
+// - the attenuation of the light, which scales the ambient and the specular terms of calcPointLight (shader.frag)
+// - the attenuated diffuse term (N.L, times the visibility of the light if shadows are baked)
+// and the shader rebuilds the lighting as the sum over the lights of these values weighted by the current
+// ambient/diffuse/specular intensities of each light. The values of 2 lights are packed in the RGBA channels of
+// a layer of a texture array (half floats).
+//
+// File layout (little endian): header, then for each mesh of the level the number of its vertices followed by
+// their lightmap coordinates (2 floats each), then the texels (layers x height x width x 4 half floats).
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const uint32_t LIGHTMAP_MAGIC = 0x50414D4C; // "LMAP"
+const uint32_t LIGHTMAP_VERSION = 1;
+const uint32_t LIGHTS_PER_LAYER = 2;
+
+struct Lightmap {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t nrLights = 0;
+    uint32_t layers = 0;
+    // lightmap coordinates ([0,1] on the atlas) of the vertices, one vector per mesh of the level
+    std::vector<std::vector<glm::vec2> > coords;
+    std::vector<uint16_t> texels;
+
+    size_t texelIndex(uint32_t layer, uint32_t x, uint32_t y) const {
+        return ((static_cast<size_t>(layer) * height + y) * width + x) * 4;
+    }
+};
+
+uint32_t lightmapLayers(uint32_t nrLights) {
+    return (nrLights + LIGHTS_PER_LAYER - 1) / LIGHTS_PER_LAYER;
+}
+
+// IEEE 754 half precision conversions (round to nearest, no NaN payloads)
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    if (((bits >> 23) & 0xFFu) == 0xFFu)
+        return sign | 0x7C00u | (mantissa ? 0x200u : 0u);
+    if (exponent >= 31)
+        return sign | 0x7C00u;
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+        // subnormal
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1u)
+            half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u)
+        half++; // may carry into the exponent, which is still the correct rounding
+    return sign | static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+    uint32_t bits;
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // subnormal: normalize it
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400u)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    } else if (exponent == 31) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template<typename T>
+void writeValue(std::ofstream &file, const T &value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::ifstream &file, T &value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+bool saveLightmap(const std::string &path, const Lightmap &lightmap) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::LIGHTMAP:: cannot write " << path << std::endl;
+        return false;
+    }
+    writeValue(file, LIGHTMAP_MAGIC);
+    writeValue(file, LIGHTMAP_VERSION);
+    writeValue(file, lightmap.width);
+    writeValue(file, lightmap.height);
+    writeValue(file, lightmap.nrLights);
+    writeValue(file, lightmap.layers);
+    writeValue(file, static_cast<uint32_t>(lightmap.coords.size()));
+    for (auto &coords: lightmap.coords) {
+        writeValue(file, static_cast<uint32_t>(coords.size()));
+        file.write(reinterpret_cast<const char *>(coords.data()), coords.size() * sizeof(glm::vec2));
+    }
+    file.write(reinterpret_cast<const char *>(lightmap.texels.data()), lightmap.texels.size() * sizeof(uint16_t));
+    return static_cast<bool>(file);
+}
+
+// returns false (without messages) if the file does not exist, e.g. when the lightmap has not been baked yet
+bool loadLightmap(const std::string &path, Lightmap &lightmap) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    uint32_t magic = 0, version = 0, nrMeshes = 0;
+    if (!readValue(file, magic) || magic != LIGHTMAP_MAGIC || !readValue(file, version) ||
+        version != LIGHTMAP_VERSION) {
+        std::cout << "ERROR::LIGHTMAP:: " << path << " is not a lightmap of this version" << std::endl;
+        return false;
+    }
+    readValue(file, lightmap.width);
+    readValue(file, lightmap.height);
+    readValue(file, lightmap.nrLights);
+    readValue(file, lightmap.layers);
+    readValue(file, nrMeshes);
+    lightmap.coords.assign(nrMeshes, std::vector<glm::vec2>());
+    for (auto &coords: lightmap.coords) {
+        uint32_t count = 0;
+        readValue(file, count);
+        coords.resize(count);
+        file.read(reinterpret_cast<char *>(coords.data()), count * sizeof(glm::vec2));
+    }
+    lightmap.texels.resize(static_cast<size_t>(lightmap.layers) * lightmap.width * lightmap.height * 4);
+    file.read(reinterpret_cast<char *>(lightmap.texels.data()), lightmap.texels.size() * sizeof(uint16_t));
+    if (!file) {
+        std::cout << "ERROR::LIGHTMAP:: " << path << " is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,82 @@
+#ifndef LOD_H
+#define LOD_H
+
+// levels of detail of the models drawn many times (bullets and splats).
+// The levels are generated at load time by util3d/simplify.h, as fractions of the triangles of the full model, and
+// each object picks its level at each frame from its projected size on screen (radius in pixels). To avoid popping
+// back and forth when an object stays close to a threshold, the level changes only once the size is past the
+// threshold by a margin (hysteresis), so the current level of each object is kept in its archetype.
+
+#include <glm/glm.hpp>
+
+#include "simplify.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+struct LodSettings {
+    // fraction of the triangles of each level after the full model (level 0)
+    std::vector<float> ratios;
+    // minimum projected radius (pixels) of each level but the last one, which is used below all of them
+    std::vector<float> minPixels;
+    // relative margin around the thresholds, 0 disables the hysteresis
+    float hysteresis = 0.15f;
+
+    size_t levels() const {
+        return ratios.size() + 1;
+    }
+
+    // level for a projected radius, with the thresholds scaled
+    uint8_t levelFor(float pixels, float scale) const {
+        for (size_t i = 0; i < minPixels.size() && i + 1 < levels(); i++)
+            if (pixels >= minPixels[i] * scale)
+                return static_cast<uint8_t>(i);
+        return static_cast<uint8_t>(levels() - 1);
+    }
+
+    // level for a projected radius, given the level used in the previous frame
+    uint8_t select(float pixels, uint8_t current) const {
+        // coarser only if below the lowered thresholds, finer only if above the raised ones
+        uint8_t coarser = levelFor(pixels, 1.0f - hysteresis);
+        if (coarser > current)
+            return coarser;
+        uint8_t finer = levelFor(pixels, 1.0f + hysteresis);
+        if (finer < current)
+            return finer;
+        return current < levels() ? current : static_cast<uint8_t>(levels() - 1);
+    }
+};
+
+// index lists of the levels after the full mesh, each one with a fraction of its triangles
+std::vector<std::vector<unsigned int> > generateLodLevels(const std::vector<glm::vec3> &positions,
+                                                          const std::vector<glm::vec3> &normals,
+                                                          const std::vector<unsigned int> &indices,
+                                                          const std::vector<float> &ratios) {
+    std::vector<std::vector<unsigned int> > levels;
+    for (float ratio: ratios) {
+        size_t target = static_cast<size_t>(indices.size() / 3 * ratio);
+        levels.push_back(simplifyMesh(positions, normals, indices, target).indices);
+    }
+    return levels;
+}
+
+// pixels per unit of radius at unit distance, for the projection matrix and the height of the viewport
+float lodPixelScale(const glm::mat4 &projection, float viewportHeight) {
+    return projection[1][1] * viewportHeight * 0.5f;
+}
+
+// projected radius (pixels) of a sphere
+float projectedRadius(const glm::vec3 &center, float radius, const glm::vec3 &eye, float pixelScale) {
+    float distance = glm::length(center - eye);
+    return distance > radius ? radius * pixelScale / distance : FLT_MAX;
+}
+
+// updates the levels of a set of objects of the same radius (e.g., a column of an archetype). With enabled set to
+// false all the objects use the full model
+void selectLods(const std::vector<glm::vec3> &centers, float radius, const glm::vec3 &eye, float pixelScale,
+                const LodSettings &settings, bool enabled, std::vector<uint8_t> &levels) {
+    for (size_t i = 0; i < centers.size() && i < levels.size(); i++)
+        levels[i] = enabled ? settings.select(projectedRadius(centers[i], radius, eye, pixelScale), levels[i]) : 0;
+}
+#endif
@@ -6,8 +6,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <utils/shader.h>
+#include "shader_cache.h"
+#include "geometry_arena.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -22,14 +24,51 @@ struct Vertex {
     glm::vec3 Normal;
     // texCoords
     glm::vec2 TexCoords;
+    // coordinates in the lightmap atlas (only for the level, see util3d/lightmap.h)
+    glm::vec2 LightmapCoords;
+    // ceiling light of the emissive term (only for the level, see util3d/light_assignment.h)
+    GLuint LightId;
+
+    // attribute pointers of the vertex buffer bound to GL_ARRAY_BUFFER (see util3d/geometry_arena.h)
+    static void setupAttributes()
+    {
+        // A great thing about structs is that their memory layout is sequential for all its items.
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+        // again translates to 3/2 floats which translates to a byte array.
+        // vertex Positions
+        glEnableVertexAttribArray(0);	
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);	
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);	
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex lightmap coords
+        glEnableVertexAttribArray(3);	
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, LightmapCoords));
+        // vertex light (integer attribute)
+        glEnableVertexAttribArray(4);	
+        glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)offsetof(Vertex, LightId));
+    }
 };
 
+// the vertices and the indices of all the meshes
+typedef GeometryArena<Vertex> MeshArena;
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// range of the element buffer with the triangles of a level of detail
+struct MeshLod {
+    GLsizei count;
+    // in bytes
+    size_t offset;
+};
+
 struct Material {
     glm::vec3 ambient;
     glm::vec3 diffuse;
@@ -44,29 +83,139 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
     Material             material;
-    unsigned int VAO;
+    // levels of detail (see util3d/lod.h): the first one is the full mesh, the others are index lists of the same
+    // vertices, stored after it in the element buffer
+    vector<MeshLod>      lods;
+    // the ranges of the arena are freed with the mesh, which can be moved but not copied
+    MeshArena::Block geometry;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, Material material)
+    // constructor: the data is moved into the mesh (the callers pass their vectors with std::move), and uploaded in
+    // the arena
+    Mesh(MeshArena &arena, vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         Material material)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), material(material)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-        this->material = material;
-
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        // now that we have all the required data, copy it in the buffers of the arena
+        setupMesh(arena);
     }
 
     // render the mesh
-    void Draw(Shader &shader) 
+    void Draw(ShaderProgram &shader) 
+    {
+        bindMaterial(shader);
+
+        // draw mesh (the full level of detail, also after releaseCpuData)
+        geometry.bind();
+        glDrawElementsBaseVertex(GL_TRIANGLES, lods[0].count, GL_UNSIGNED_INT, geometry.indexOffset(0),
+                                 geometry.baseVertex());
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render only some ranges of the indices (e.g., the visible chunks of the level): counts[i] indices starting
+    // from the byte offset offsets[i] of the element buffer, with a single draw call
+    void DrawRanges(ShaderProgram &shader, const vector<GLsizei> &counts, const vector<const void *> &offsets)
+    {
+        if (counts.empty())
+            return;
+        bindMaterial(shader);
+
+        // the offsets are relative to the first index of the mesh in the arena
+        rangeOffsets.resize(offsets.size());
+        for (size_t i = 0; i < offsets.size(); i++)
+            rangeOffsets[i] = geometry.indexOffset(reinterpret_cast<size_t>(offsets[i]));
+        rangeBaseVertices.assign(counts.size(), geometry.baseVertex());
+        geometry.bind();
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, rangeOffsets.data(),
+                                      static_cast<GLsizei>(counts.size()), rangeBaseVertices.data());
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render a level of detail (the coarsest one if the mesh has less levels)
+    void DrawLod(ShaderProgram &shader, size_t level)
+    {
+        const MeshLod &lod = lods[std::min(level, lods.size() - 1)];
+        bindMaterial(shader);
+
+        geometry.bind();
+        glDrawElementsBaseVertex(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, geometry.indexOffset(lod.offset),
+                                 geometry.baseVertex());
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // replaces the indices (same number of indices, e.g. reordered triangles), and updates the element buffer.
+    // The levels of detail are dropped
+    void setIndices(const vector<unsigned int> &newIndices)
+    {
+        indices = newIndices;
+        lods.assign(1, MeshLod{static_cast<GLsizei>(indices.size()), 0});
+        geometry.resizeIndices(indices.size());
+        geometry.uploadIndices(indices.data(), indices.size());
+    }
+
+    // sets the levels of detail after the full mesh (index lists of the same vertices), and uploads all of them
+    // in the element buffer
+    void setLods(const vector<vector<unsigned int> > &levels)
+    {
+        vector<unsigned int> elements = indices;
+        lods.assign(1, MeshLod{static_cast<GLsizei>(indices.size()), 0});
+        for (auto &level: levels) {
+            lods.push_back(MeshLod{static_cast<GLsizei>(level.size()), elements.size() * sizeof(unsigned int)});
+            elements.insert(elements.end(), level.begin(), level.end());
+        }
+        geometry.resizeIndices(elements.size());
+        geometry.uploadIndices(elements.data(), elements.size());
+    }
+
+    // frees the vertices and the indices kept in memory after the upload, when they are not needed anymore (e.g.,
+    // after the collision shapes and the levels of detail are built): the mesh can still be drawn, but not changed
+    void releaseCpuData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // true if the mesh has a diffuse texture: it is drawn with the TEXTURED variant of shader.frag
+    bool textured() const
+    {
+        for (auto &texture: textures)
+            if (texture.type == "texture_diffuse")
+                return true;
+        return false;
+    }
+
+    // sets the lightmap coordinates of the vertices (one per vertex), and updates the vertex buffer
+    void setLightmapCoords(const vector<glm::vec2> &coords)
+    {
+        for (size_t i = 0; i < vertices.size() && i < coords.size(); i++)
+            vertices[i].LightmapCoords = coords[i];
+        updateVertexBuffer();
+    }
+
+    // sets the light of the vertices (one per vertex), and updates the vertex buffer
+    void setLightIds(const vector<unsigned int> &lightIds)
+    {
+        for (size_t i = 0; i < vertices.size() && i < lightIds.size(); i++)
+            vertices[i].LightId = lightIds[i];
+        updateVertexBuffer();
+    }
+
+private:
+    // index offsets and base vertices of DrawRanges, kept to avoid allocations at each frame
+    vector<const void *> rangeOffsets;
+    vector<GLint>        rangeBaseVertices;
+
+    // binds the textures and sets the material uniforms
+    void bindMaterial(ShaderProgram &shader)
     {
         // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
-        glUniform1i(glGetUniformLocation(shader.Program, "texture_diffuse1_present"), 0);
         for(unsigned int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
@@ -88,8 +237,6 @@ public:
             }
             // now set the sampler to the correct texture unit
             glUniform1i(location, i);
-            // set texture_xxxN_present to true
-            glUniform1i(glGetUniformLocation(shader.Program, (name + number + "_present").c_str()), 1);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
@@ -100,51 +247,20 @@ public:
             glUniform3fv(glGetUniformLocation(shader.Program, "material.specular"), 1, &material.specular[0]);
             glUniform3fv(glGetUniformLocation(shader.Program, "material.emissive"), 1, &material.emissive[0]);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    void updateVertexBuffer()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        geometry.uploadVertices(vertices.data(), vertices.size());
+    }
 
-        glBindVertexArray(0);
+    // takes the ranges of the arena and uploads the vertices and the indices
+    void setupMesh(MeshArena &arena)
+    {
+        geometry = arena.allocate(vertices.size(), indices.size());
+        geometry.uploadVertices(vertices.data(), vertices.size());
+        geometry.uploadIndices(indices.data(), indices.size());
+        lods.assign(1, MeshLod{static_cast<GLsizei>(indices.size()), 0});
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -11,6 +11,8 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "lod.h"
+#include "obj_loader.h"
 
 #include <string>
 #include <fstream>
@@ -22,27 +24,92 @@ using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// the OBJ files are read by util3d/obj_loader.h, unless ASSIMP is asked for (e.g., to compare the load times)
+enum ModelLoader {
+    MODEL_LOADER_AUTO,
+    MODEL_LOADER_ASSIMP,
+};
+
 class Model {
 public:
     // model data
     vector<Texture> textures_loaded;
     // stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh> meshes;
+    // the textures of the meshes belong to the model (a texture can be shared by several meshes)
+    vector<GLTexture> textureObjects;
     string directory;
     bool gammaCorrection;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma) {
-        loadModel(path);
+    // constructor, expects a filepath to a 3D model. The meshes are stored in the arena, which must outlive the model
+    Model(MeshArena &arena, string const &path, bool gamma = false, ModelLoader loader = MODEL_LOADER_AUTO)
+        : gammaCorrection(gamma), arena(&arena) {
+        if (loader == MODEL_LOADER_AUTO && isObjFile(path))
+            loadObjModel(path);
+        else
+            loadModel(path);
+    }
+
+    // a model without meshes (e.g., the level when it is generated by util3d/procedural.h)
+    explicit Model(MeshArena &arena) : gammaCorrection(false), arena(&arena) {
     }
 
+    // the meshes own ranges of the arena, and the model owns GL textures: a model can be moved, but not copied
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+    Model(Model &&) = default;
+    Model &operator=(Model &&) = default;
+
     // draws the model, and thus all its meshes
-    void Draw(Shader &shader) {
+    void Draw(ShaderProgram &shader) {
         for (unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // draws a level of detail of the model (see generateLods)
+    void DrawLod(ShaderProgram &shader, size_t level) {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawLod(shader, level);
+    }
+
+    // true if all the meshes have a diffuse texture. The dynamic objects are drawn with a single variant of
+    // shader.frag for the whole model (they have a single material)
+    bool textured() const {
+        for (auto &mesh: meshes)
+            if (!mesh.textured())
+                return false;
+        return !meshes.empty();
+    }
+
+    // generates the levels of detail after the full model, each one with a fraction of the triangles of each mesh
+    void generateLods(const vector<float> &ratios) {
+        for (auto &mesh: meshes) {
+            vector<glm::vec3> positions, normals;
+            for (auto &vertex: mesh.vertices) {
+                positions.push_back(vertex.Position);
+                normals.push_back(vertex.Normal);
+            }
+            mesh.setLods(generateLodLevels(positions, normals, mesh.indices, ratios));
+        }
+    }
+
+    // frees the vertices and the indices of the meshes kept in memory after the upload (see Mesh::releaseCpuData)
+    void releaseCpuData() {
+        for (auto &mesh: meshes)
+            mesh.releaseCpuData();
+    }
+
+    // triangles drawn by DrawLod
+    size_t triangleCount(size_t level) const {
+        size_t count = 0;
+        for (auto &mesh: meshes)
+            count += mesh.lods[std::min(level, mesh.lods.size() - 1)].count / 3;
+        return count;
+    }
+
 private:
+    MeshArena *arena;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path) {
         // read file via ASSIMP
@@ -57,11 +124,42 @@ private:
         }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
+        meshes.reserve(scene->mNumMeshes);
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
     }
 
+    // the OBJ files, without ASSIMP: same meshes, materials and textures, with the corners shared by the faces
+    // joined in a single vertex
+    void loadObjModel(string const &path) {
+        ObjModel model;
+        if (!loadObj(path, model))
+            return;
+        directory = path.substr(0, path.find_last_of('/'));
+        meshes.reserve(model.meshes.size());
+        for (ObjMesh &mesh: model.meshes) {
+            // same filter of processNode
+            if (mesh.name == "obj2")
+                continue;
+            vector<Vertex> vertices(mesh.positions.size());
+            for (size_t i = 0; i < vertices.size(); i++)
+                vertices[i] = Vertex{mesh.positions[i], mesh.normals[i], mesh.texCoords[i], glm::vec2(0.0f), 0};
+            const ObjMaterial &material = model.materials[mesh.material];
+            vector<Texture> textures;
+            // the same types of the maps of processMesh
+            const std::pair<const string *, const char *> maps[] = {
+                {&material.diffuseMap, "texture_diffuse"}, {&material.specularMap, "texture_specular"},
+                {&material.bumpMap, "texture_normal"}, {&material.ambientMap, "texture_height"}
+            };
+            for (auto &map: maps)
+                if (!map.first->empty())
+                    textures.push_back(loadTexture(map.first->c_str(), map.second));
+            meshes.push_back(Mesh(*arena, std::move(vertices), std::move(mesh.indices), std::move(textures),
+                                  Material{material.ambient, material.diffuse, material.specular, material.emissive}));
+        }
+    }
+
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
     void processNode(aiNode *node, const aiScene *scene) {
         // process each mesh located at the current node
@@ -87,6 +185,8 @@ private:
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
 
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -116,6 +216,9 @@ private:
                 vertex.TexCoords = vec;
             } else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            // set later if the model has a baked lightmap
+            vertex.LightmapCoords = glm::vec2(0.0f, 0.0f);
+            vertex.LightId = 0;
 
             vertices.push_back(vertex);
         }
@@ -158,7 +261,7 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures,
+        return Mesh(*arena, std::move(vertices), std::move(indices), std::move(textures),
                     Material{
                         glm::vec3(ambient.r, ambient.g, ambient.b),
                         glm::vec3(diffuse.r, diffuse.g, diffuse.b),
@@ -174,29 +277,30 @@ private:
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true;
-                    // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if (!skip) {
-                // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
-                // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            textures.push_back(loadTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // the texture of a file of the directory of the model, loaded the first time
+    Texture loadTexture(const char *path, const string &typeName) {
+        // check if texture was loaded before and if so, return it: skip loading a new texture
+        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
+            if (std::strcmp(textures_loaded[j].path.data(), path) == 0) {
+                // a texture with the same filepath has already been loaded (optimization)
+                return textures_loaded[j];
+            }
+        }
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory);
+        textureObjects.emplace_back(texture.id);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        return texture;
+    }
 };
 
 
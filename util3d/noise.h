@@ -0,0 +1,59 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+// tiling noise texture for the VHS effect of composite.frag. The effect used to compute 2D simplex noise in the
+// shader, up to 17 evaluations per pixel; here the noise is computed once, at load time: gradient (Perlin) noise on
+// a lattice which wraps around every `period` cells, so the texture tiles with GL_REPEAT, and the shader reads it
+// with a single bilinear lookup. The values are scaled to [-1, 1], the range of the simplex noise.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// size x size values (row major), with `period` lattice cells across the texture
+std::vector<float> tilingNoise(int size, int period, unsigned int seed) {
+    // a random unit gradient for each lattice point of the period
+    std::default_random_engine generator(seed);
+    std::uniform_real_distribution<float> angle(0.0f, 6.28318531f);
+    std::vector<glm::vec2> gradients(static_cast<size_t>(period) * period);
+    for (auto &g: gradients) {
+        float a = angle(generator);
+        g = glm::vec2(std::cos(a), std::sin(a));
+    }
+    auto gradient = [&](int x, int y) {
+        x = ((x % period) + period) % period;
+        y = ((y % period) + period) % period;
+        return gradients[static_cast<size_t>(y) * period + x];
+    };
+    // quintic fade, continuous second derivative across the cells
+    auto fade = [](float t) {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    };
+
+    std::vector<float> values(static_cast<size_t>(size) * size);
+    float largest = 0.0f;
+    for (int j = 0; j < size; j++) {
+        for (int i = 0; i < size; i++) {
+            // texel centers, in lattice units
+            glm::vec2 p = (glm::vec2(i, j) + 0.5f) * (static_cast<float>(period) / size);
+            glm::ivec2 cell = glm::ivec2(glm::floor(p));
+            glm::vec2 f = p - glm::vec2(cell);
+            float n00 = glm::dot(gradient(cell.x, cell.y), f);
+            float n10 = glm::dot(gradient(cell.x + 1, cell.y), f - glm::vec2(1, 0));
+            float n01 = glm::dot(gradient(cell.x, cell.y + 1), f - glm::vec2(0, 1));
+            float n11 = glm::dot(gradient(cell.x + 1, cell.y + 1), f - glm::vec2(1, 1));
+            float u = fade(f.x), v = fade(f.y);
+            float value = glm::mix(glm::mix(n00, n10, u), glm::mix(n01, n11, u), v);
+            values[static_cast<size_t>(j) * size + i] = value;
+            largest = std::max(largest, std::abs(value));
+        }
+    }
+    if (largest > 0.0f)
+        for (auto &value: values)
+            value /= largest;
+    return values;
+}
+#endif
@@ -0,0 +1,679 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+// fast path for the OBJ models and their MTL materials, instead of the generic importer of ASSIMP. The file is
+// memory-mapped and split at line boundaries in a part for each thread; each thread parses its lines with a float
+// parser made for the numbers of the OBJ files, then the meshes are built in parallel. The corners of the faces with
+// the same position, texture coordinates and normal become a single vertex (ASSIMP gives a vertex to each corner),
+// and only the attributes of Vertex (util3d/mesh.h) are computed, no tangents.
+// The result matches the post-processing used by Model with ASSIMP: triangles (quads are split as ASSIMP does, from
+// the concave corner if there is one, larger polygons as a fan), texture coordinates flipped vertically, smooth
+// normals where the file has none (the normalized sum of the normals of the triangles around each position), and a
+// mesh for each object and material, in the order of the file.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct ObjMaterial {
+    std::string name;
+    // the defaults of ASSIMP for a material without values
+    glm::vec3 ambient = glm::vec3(0.0f), diffuse = glm::vec3(0.6f), specular = glm::vec3(0.0f),
+            emissive = glm::vec3(0.0f);
+    // texture files, relative to the directory of the model: map_Kd, map_Ks, map_Bump (the texture_normal of Model)
+    // and map_Ka (texture_height)
+    std::string diffuseMap, specularMap, bumpMap, ambientMap;
+};
+
+struct ObjMesh {
+    std::string name;
+    unsigned int material = 0;
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<unsigned int> indices;
+    // normals and texture coordinates read from the file (the normals are generated otherwise, the coordinates are 0)
+    bool hasNormals = false, hasTexCoords = false;
+};
+
+struct ObjModel {
+    std::vector<ObjMesh> meshes;
+    std::vector<ObjMaterial> materials;
+    // size of the file, corners of the faces, and time of the phases of the loading
+    size_t fileBytes = 0, corners = 0;
+    double mapMs = 0, parseMs = 0, buildMs = 0;
+};
+
+// read-only view of a whole file, mapped in memory
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                           NULL);
+        LARGE_INTEGER size;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0)
+            return;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+            return;
+        bytes = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (bytes != nullptr)
+            length = static_cast<size_t>(size.QuadPart);
+#else
+        descriptor = open(path.c_str(), O_RDONLY);
+        struct stat status;
+        if (descriptor < 0 || fstat(descriptor, &status) != 0 || status.st_size == 0)
+            return;
+        void *address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address == MAP_FAILED)
+            return;
+        // all the threads read their part at once
+        madvise(address, static_cast<size_t>(status.st_size), MADV_WILLNEED);
+        bytes = static_cast<const char *>(address);
+        length = static_cast<size_t>(status.st_size);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes != nullptr)
+            UnmapViewOfFile(bytes);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if (bytes != nullptr)
+            munmap(const_cast<char *>(bytes), length);
+        if (descriptor >= 0)
+            close(descriptor);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // false if the file is missing or empty
+    bool valid() const {
+        return bytes != nullptr;
+    }
+
+    const char *data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = NULL;
+#else
+    int descriptor = -1;
+#endif
+};
+
+// a number as written in the OBJ files (sign, digits, fraction, exponent), without the locale and the checks of
+// strtof: the first 19 significant digits are accumulated in an integer, which is scaled once by a power of 10.
+// p is moved after the number
+float parseObjFloat(const char *&p, const char *end) {
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                    1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; p < end && static_cast<unsigned>(*p - '0') < 10; p++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && static_cast<unsigned>(*p - '0') < 10; p++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+        int value = 0;
+        for (; p < end && static_cast<unsigned>(*p - '0') < 10; p++)
+            value = std::min(value * 10 + (*p - '0'), 1000);
+        exponent += negativeExponent ? -value : value;
+    }
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0) {
+        for (; exponent > 22; exponent -= 22)
+            result *= 1e22;
+        for (; exponent < -22; exponent += 22)
+            result /= 1e22;
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+    }
+    return static_cast<float>(negative ? -result : result);
+}
+
+// an index of a face (1-based, negative from the end of the list read so far, 0 if missing)
+int parseObjIndex(const char *&p, const char *end) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    int value = 0;
+    for (; p < end && static_cast<unsigned>(*p - '0') < 10; p++)
+        value = value * 10 + (*p - '0');
+    return negative ? -value : value;
+}
+
+// the lines of a part of the file, and where they belong: the statements which change object or material are kept
+// with the number of faces read before them
+enum ObjStatementType {
+    OBJ_OBJECT,
+    OBJ_MATERIAL,
+    OBJ_LIBRARY,
+};
+
+struct ObjStatement {
+    ObjStatementType type;
+    std::string name;
+    size_t face;
+};
+
+// indices of the position, texture coordinates and normal of a corner (0-based, -1 if missing)
+struct ObjCorner {
+    int32_t position, texCoord, normal;
+};
+
+struct ObjChunk {
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<ObjCorner> corners;
+    // end of the corners of each face
+    std::vector<uint32_t> faceEnds;
+    std::vector<ObjStatement> statements;
+    // the negative indices refer to the lists of the part: the corners and the attributes (0, 1, 2) which need the
+    // offset of the part once all the parts are parsed
+    std::vector<std::pair<size_t, int> > relative;
+};
+
+// the rest of the line without the spaces around it (names of objects, materials and files)
+std::string objLineRest(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        end--;
+    return std::string(p, end);
+}
+
+bool objKeyword(const char *p, const char *end, const char *keyword) {
+    size_t length = std::strlen(keyword);
+    return static_cast<size_t>(end - p) > length && std::memcmp(p, keyword, length) == 0 &&
+           (p[length] == ' ' || p[length] == '\t');
+}
+
+void parseObjChunk(const char *begin, const char *end, ObjChunk &chunk) {
+    auto skipSpaces = [](const char *&p, const char *lineEnd) {
+        while (p < lineEnd && (*p == ' ' || *p == '\t'))
+            p++;
+    };
+    // resolved index of an attribute of a corner (the list has count elements so far)
+    auto resolve = [&chunk](int index, size_t count, int attribute) -> int32_t {
+        if (index > 0)
+            return index - 1;
+        if (index == 0)
+            return -1;
+        chunk.relative.push_back({chunk.corners.size(), attribute});
+        return static_cast<int32_t>(static_cast<int64_t>(count) + index);
+    };
+
+    // a guess of the size of the lists, from a face of 3 corners every 70 bytes (the vertices take a line each)
+    size_t bytes = static_cast<size_t>(end - begin);
+    chunk.corners.reserve(bytes / 24);
+    chunk.faceEnds.reserve(bytes / 70);
+    const char *p = begin;
+    while (p < end) {
+        skipSpaces(p, end);
+        const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (lineEnd == nullptr)
+            lineEnd = end;
+        if (lineEnd - p >= 2) {
+            if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+                p += 2;
+                glm::vec3 position;
+                for (int k = 0; k < 3; k++) {
+                    skipSpaces(p, lineEnd);
+                    position[k] = parseObjFloat(p, lineEnd);
+                }
+                chunk.positions.push_back(position);
+            } else if (p[0] == 'v' && p[1] == 't') {
+                p += 2;
+                glm::vec2 coords;
+                for (int k = 0; k < 2; k++) {
+                    skipSpaces(p, lineEnd);
+                    coords[k] = parseObjFloat(p, lineEnd);
+                }
+                chunk.texCoords.push_back(coords);
+            } else if (p[0] == 'v' && p[1] == 'n') {
+                p += 2;
+                glm::vec3 normal;
+                for (int k = 0; k < 3; k++) {
+                    skipSpaces(p, lineEnd);
+                    normal[k] = parseObjFloat(p, lineEnd);
+                }
+                chunk.normals.push_back(normal);
+            } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+                p += 2;
+                size_t first = chunk.corners.size();
+                for (;;) {
+                    skipSpaces(p, lineEnd);
+                    if (p >= lineEnd || (static_cast<unsigned>(*p - '0') >= 10 && *p != '-'))
+                        break;
+                    int position = parseObjIndex(p, lineEnd), texCoord = 0, normal = 0;
+                    if (p < lineEnd && *p == '/') {
+                        p++;
+                        if (p < lineEnd && *p != '/')
+                            texCoord = parseObjIndex(p, lineEnd);
+                        if (p < lineEnd && *p == '/') {
+                            p++;
+                            normal = parseObjIndex(p, lineEnd);
+                        }
+                    }
+                    ObjCorner corner;
+                    corner.position = resolve(position, chunk.positions.size(), 0);
+                    corner.texCoord = resolve(texCoord, chunk.texCoords.size(), 1);
+                    corner.normal = resolve(normal, chunk.normals.size(), 2);
+                    chunk.corners.push_back(corner);
+                    // anything else in the corner is ignored
+                    while (p < lineEnd && *p != ' ' && *p != '\t' && *p != '\r')
+                        p++;
+                }
+                if (chunk.corners.size() - first >= 3) {
+                    chunk.faceEnds.push_back(static_cast<uint32_t>(chunk.corners.size()));
+                } else {
+                    // points and lines are not drawn
+                    while (!chunk.relative.empty() && chunk.relative.back().first >= first)
+                        chunk.relative.pop_back();
+                    chunk.corners.resize(first);
+                }
+            } else if ((p[0] == 'o' || p[0] == 'g') && (p[1] == ' ' || p[1] == '\t')) {
+                std::string name = objLineRest(p + 2, lineEnd);
+                if (!name.empty())
+                    chunk.statements.push_back({OBJ_OBJECT, name, chunk.faceEnds.size()});
+            } else if (objKeyword(p, lineEnd, "usemtl")) {
+                chunk.statements.push_back({OBJ_MATERIAL, objLineRest(p + 6, lineEnd), chunk.faceEnds.size()});
+            } else if (objKeyword(p, lineEnd, "mtllib")) {
+                chunk.statements.push_back({OBJ_LIBRARY, objLineRest(p + 6, lineEnd), chunk.faceEnds.size()});
+            }
+        }
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+// the materials of an MTL file, added to the list (few lines, read without the fast path)
+void loadObjMaterials(const std::string &path, std::vector<ObjMaterial> &materials) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "ERROR::OBJ:: cannot read the material library " << path << std::endl;
+        return;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "newmtl") {
+            materials.emplace_back();
+            materials.back().name = objLineRest(line.data() + line.find("newmtl") + 6, line.data() + line.size());
+            continue;
+        }
+        if (materials.empty())
+            continue;
+        ObjMaterial &material = materials.back();
+        glm::vec3 *color = keyword == "Ka" ? &material.ambient : keyword == "Kd" ? &material.diffuse :
+                           keyword == "Ks" ? &material.specular : keyword == "Ke" ? &material.emissive : nullptr;
+        std::string *map = keyword == "map_Kd" ? &material.diffuseMap : keyword == "map_Ks" ? &material.specularMap :
+                           keyword == "map_Ka" ? &material.ambientMap :
+                           keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump" ? &material.bumpMap :
+                           nullptr;
+        if (color != nullptr) {
+            words >> color->x >> color->y >> color->z;
+        } else if (map != nullptr) {
+            // the file is the last word, after the options of the map
+            std::string word;
+            while (words >> word)
+                *map = word;
+        }
+    }
+}
+
+// the faces of a mesh: ranges of faces of the parts
+struct ObjFaceRange {
+    size_t chunk, begin, end;
+};
+
+struct ObjMeshFaces {
+    std::string name;
+    unsigned int material = 0;
+    std::vector<ObjFaceRange> ranges;
+    size_t corners = 0;
+};
+
+// vertices and triangles of a mesh: the corners are joined with a hash table with open addressing
+void buildObjMesh(const ObjMeshFaces &faces, const std::vector<ObjChunk> &chunks,
+                  const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &texCoords,
+                  const std::vector<glm::vec3> &normals, ObjMesh &mesh) {
+    mesh.name = faces.name;
+    mesh.material = faces.material;
+    size_t capacity = 16;
+    while (capacity < faces.corners + faces.corners / 2)
+        capacity *= 2;
+    std::vector<ObjCorner> keys(capacity);
+    std::vector<uint32_t> slots(capacity, UINT32_MAX);
+    // position of each vertex in the file, for the generated normals
+    std::vector<int32_t> vertexPositions;
+    mesh.positions.reserve(faces.corners / 2);
+    mesh.texCoords.reserve(faces.corners / 2);
+    mesh.normals.reserve(faces.corners / 2);
+    mesh.indices.reserve(faces.corners * 3 / 2);
+
+    auto vertexOf = [&](const ObjCorner &corner) -> uint32_t {
+        uint64_t hash = static_cast<uint32_t>(corner.position) * 0x9E3779B97F4A7C15ull ^
+                        static_cast<uint32_t>(corner.texCoord) * 0xC2B2AE3D27D4EB4Full ^
+                        static_cast<uint32_t>(corner.normal) * 0x165667B19E3779F9ull;
+        hash ^= hash >> 29;
+        for (size_t slot = hash & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+            if (slots[slot] == UINT32_MAX) {
+                keys[slot] = corner;
+                slots[slot] = static_cast<uint32_t>(mesh.positions.size());
+                vertexPositions.push_back(corner.position);
+                mesh.positions.push_back(positions[corner.position]);
+                mesh.normals.push_back(corner.normal >= 0 ? normals[corner.normal] : glm::vec3(0.0f));
+                // flipped as with aiProcess_FlipUVs
+                glm::vec2 coords = corner.texCoord >= 0 ? texCoords[corner.texCoord] : glm::vec2(0.0f);
+                mesh.texCoords.push_back(glm::vec2(coords.x, 1.0f - coords.y));
+                return slots[slot];
+            }
+            const ObjCorner &key = keys[slot];
+            if (key.position == corner.position && key.texCoord == corner.texCoord && key.normal == corner.normal)
+                return slots[slot];
+        }
+    };
+
+    std::vector<ObjCorner> polygon;
+    std::vector<uint32_t> vertices;
+    for (const ObjFaceRange &range: faces.ranges) {
+        const ObjChunk &chunk = chunks[range.chunk];
+        for (size_t face = range.begin; face < range.end; face++) {
+            size_t first = face == 0 ? 0 : chunk.faceEnds[face - 1];
+            polygon.assign(chunk.corners.begin() + first, chunk.corners.begin() + chunk.faceEnds[face]);
+            bool valid = true;
+            for (ObjCorner &corner: polygon) {
+                valid = valid && corner.position >= 0 && static_cast<size_t>(corner.position) < positions.size();
+                if (corner.texCoord >= static_cast<int32_t>(texCoords.size()))
+                    corner.texCoord = -1;
+                if (corner.normal >= static_cast<int32_t>(normals.size()))
+                    corner.normal = -1;
+                mesh.hasTexCoords = mesh.hasTexCoords || corner.texCoord >= 0;
+                mesh.hasNormals = mesh.hasNormals || corner.normal >= 0;
+            }
+            if (!valid)
+                continue;
+            vertices.clear();
+            for (const ObjCorner &corner: polygon)
+                vertices.push_back(vertexOf(corner));
+            size_t start = 0, count = vertices.size();
+            if (count == 4) {
+                // as aiProcess_Triangulate: the diagonal from the concave corner, if any
+                for (size_t i = 0; i < 4; i++) {
+                    const glm::vec3 &v = positions[polygon[i].position];
+                    glm::vec3 left = positions[polygon[(i + 3) % 4].position] - v;
+                    glm::vec3 diagonal = positions[polygon[(i + 2) % 4].position] - v;
+                    glm::vec3 right = positions[polygon[(i + 1) % 4].position] - v;
+                    if (glm::length(left) == 0.0f || glm::length(diagonal) == 0.0f || glm::length(right) == 0.0f)
+                        continue;
+                    left = glm::normalize(left);
+                    diagonal = glm::normalize(diagonal);
+                    right = glm::normalize(right);
+                    float angle = std::acos(glm::clamp(glm::dot(left, diagonal), -1.0f, 1.0f)) +
+                                  std::acos(glm::clamp(glm::dot(right, diagonal), -1.0f, 1.0f));
+                    if (angle > glm::pi<float>()) {
+                        start = i;
+                        break;
+                    }
+                }
+            }
+            for (size_t k = 1; k + 1 < count; k++) {
+                mesh.indices.push_back(vertices[start]);
+                mesh.indices.push_back(vertices[(start + k) % count]);
+                mesh.indices.push_back(vertices[(start + k + 1) % count]);
+            }
+        }
+    }
+
+    if (!mesh.hasTexCoords)
+        std::fill(mesh.texCoords.begin(), mesh.texCoords.end(), glm::vec2(0.0f));
+    if (!mesh.hasNormals) {
+        // as aiProcess_GenSmoothNormals: the normals of the triangles around each position, averaged
+        std::unordered_map<int32_t, glm::vec3> sums;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const unsigned int *triangle = &mesh.indices[i];
+            glm::vec3 normal = glm::cross(mesh.positions[triangle[1]] - mesh.positions[triangle[0]],
+                                          mesh.positions[triangle[2]] - mesh.positions[triangle[0]]);
+            float length = glm::length(normal);
+            if (length == 0.0f)
+                continue;
+            for (int k = 0; k < 3; k++)
+                sums[vertexPositions[triangle[k]]] += normal / length;
+        }
+        for (size_t v = 0; v < mesh.positions.size(); v++) {
+            glm::vec3 sum = sums[vertexPositions[v]];
+            mesh.normals[v] = glm::length(sum) > 0.0f ? glm::normalize(sum) : glm::vec3(0.0f);
+        }
+    }
+}
+
+bool isObjFile(const std::string &path) {
+    if (path.size() < 4)
+        return false;
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".obj";
+}
+
+// loads the meshes and the materials of an OBJ file, with the given number of threads (0: one per core).
+// Returns false if the file cannot be read
+bool loadObj(const std::string &path, ObjModel &model, unsigned int threads = 0) {
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [](std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    };
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    MappedFile file(path);
+    if (!file.valid()) {
+        std::cout << "ERROR::OBJ:: cannot read " << path << std::endl;
+        return false;
+    }
+    model = ObjModel();
+    model.fileBytes = file.size();
+    model.mapMs = elapsedMs(start);
+
+    // parts of at least 256 KB, which start and end at the start of a line
+    auto parseStart = std::chrono::steady_clock::now();
+    size_t parts = std::max<size_t>(1, std::min<size_t>(threads, file.size() / (256 * 1024)));
+    std::vector<const char *> bounds = {file.data()};
+    const char *end = file.data() + file.size();
+    for (size_t i = 1; i < parts; i++) {
+        const char *bound = std::max(file.data() + file.size() * i / parts, bounds.back());
+        const char *line = static_cast<const char *>(std::memchr(bound, '\n', static_cast<size_t>(end - bound)));
+        bounds.push_back(line != nullptr ? line + 1 : end);
+    }
+    bounds.push_back(end);
+    std::vector<ObjChunk> chunks(parts);
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < parts; i++)
+            workers.emplace_back(parseObjChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+        parseObjChunk(bounds[0], bounds[1], chunks[0]);
+        for (auto &worker: workers)
+            worker.join();
+    }
+
+    // the attributes of all the parts, and the negative indices made absolute
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    size_t offsets[3] = {0, 0, 0};
+    for (ObjChunk &chunk: chunks) {
+        for (auto &relative: chunk.relative) {
+            ObjCorner &corner = chunk.corners[relative.first];
+            int32_t &index = relative.second == 0 ? corner.position :
+                             relative.second == 1 ? corner.texCoord : corner.normal;
+            index += static_cast<int32_t>(offsets[relative.second]);
+        }
+        offsets[0] += chunk.positions.size();
+        offsets[1] += chunk.texCoords.size();
+        offsets[2] += chunk.normals.size();
+        model.corners += chunk.corners.size();
+    }
+    positions.reserve(offsets[0]);
+    texCoords.reserve(offsets[1]);
+    normals.reserve(offsets[2]);
+    for (ObjChunk &chunk: chunks) {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        std::vector<glm::vec3>().swap(chunk.positions);
+        std::vector<glm::vec2>().swap(chunk.texCoords);
+        std::vector<glm::vec3>().swap(chunk.normals);
+    }
+    model.parseMs = elapsedMs(parseStart);
+
+    // the meshes, as the importer of ASSIMP splits them: a new one at each object, and at each change of material
+    // after some faces. The material libraries are read when they are found
+    auto buildStart = std::chrono::steady_clock::now();
+    std::string directory = path.find_last_of("/\\") == std::string::npos ? "" :
+                            path.substr(0, path.find_last_of("/\\") + 1);
+    std::map<std::string, unsigned int> materialIds;
+    auto materialOf = [&](const std::string &name) {
+        auto found = materialIds.find(name);
+        if (found != materialIds.end())
+            return found->second;
+        // the unknown materials and the faces without one get the default material
+        found = materialIds.find("DefaultMaterial");
+        if (found != materialIds.end())
+            return found->second;
+        model.materials.emplace_back();
+        model.materials.back().name = "DefaultMaterial";
+        return materialIds["DefaultMaterial"] = static_cast<unsigned int>(model.materials.size() - 1);
+    };
+    std::vector<ObjMeshFaces> meshFaces;
+    bool hasMaterial = false;
+    std::string currentMaterial;
+    auto newMesh = [&](const std::string &name) {
+        meshFaces.emplace_back();
+        meshFaces.back().name = name;
+        meshFaces.back().material = materialOf(hasMaterial ? currentMaterial : "DefaultMaterial");
+    };
+    auto addFaces = [&](const ObjChunk &chunk, size_t chunkIndex, size_t begin, size_t end) {
+        if (begin == end)
+            return;
+        if (meshFaces.empty())
+            newMesh("defaultobject");
+        ObjMeshFaces &mesh = meshFaces.back();
+        mesh.ranges.push_back({chunkIndex, begin, end});
+        mesh.corners += chunk.faceEnds[end - 1] - (begin == 0 ? 0 : chunk.faceEnds[begin - 1]);
+    };
+    for (size_t c = 0; c < chunks.size(); c++) {
+        const ObjChunk &chunk = chunks[c];
+        size_t face = 0;
+        for (const ObjStatement &statement: chunk.statements) {
+            addFaces(chunk, c, face, statement.face);
+            face = statement.face;
+            if (statement.type == OBJ_LIBRARY) {
+                size_t first = model.materials.size();
+                loadObjMaterials(directory + statement.name, model.materials);
+                for (size_t m = first; m < model.materials.size(); m++)
+                    materialIds.insert({model.materials[m].name, static_cast<unsigned int>(m)});
+            } else if (statement.type == OBJ_OBJECT) {
+                newMesh(statement.name);
+            } else if (!hasMaterial || statement.name != currentMaterial) {
+                if (meshFaces.empty() || !meshFaces.back().ranges.empty())
+                    newMesh(statement.name);
+                hasMaterial = true;
+                currentMaterial = statement.name;
+                meshFaces.back().material = materialOf(currentMaterial);
+            }
+        }
+        addFaces(chunk, c, face, chunk.faceEnds.size());
+    }
+    meshFaces.erase(std::remove_if(meshFaces.begin(), meshFaces.end(), [](const ObjMeshFaces &mesh) {
+        return mesh.ranges.empty();
+    }), meshFaces.end());
+
+    // the largest meshes first, so they do not end up last on a thread
+    model.meshes.resize(meshFaces.size());
+    std::vector<size_t> order(meshFaces.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return meshFaces[a].corners > meshFaces[b].corners;
+    });
+    std::atomic<size_t> next(0);
+    auto buildMeshes = [&]() {
+        for (size_t i = next++; i < order.size(); i = next++)
+            buildObjMesh(meshFaces[order[i]], chunks, positions, texCoords, normals, model.meshes[order[i]]);
+    };
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < std::min<size_t>(threads, order.size()); i++)
+            workers.emplace_back(buildMeshes);
+        buildMeshes();
+        for (auto &worker: workers)
+            worker.join();
+    }
+    model.buildMs = elapsedMs(buildStart);
+    return true;
+}
+#endif
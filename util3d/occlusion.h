@@ -0,0 +1,270 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+// occlusion culling on the CPU, for the corridors of the backrooms:
+// - the level meshes are split in chunks (cells of a grid on the XZ plane), by reordering only the indices of each mesh,
+//   so that the triangles of a chunk are a contiguous range which can be drawn on its own. The vertices are not
+//   touched, so gl_VertexID (used by shader.vert to find the light of a ceiling panel) is still valid
+// - at each frame, the large triangles of the level (walls, floor, ceiling) are rasterized in a small depth buffer,
+//   and a hierarchy of max-depth mipmaps (hierarchical Z) is built on top of it
+// - chunks, bullets and splats are tested against the hierarchy with their bounding box: an object is hidden if its
+//   nearest depth is farther than the farthest occluder depth in the screen rectangle it covers
+// Depth is the distance along the view direction (clip w), and everything runs without an OpenGL context.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// a contiguous range of the indices of a mesh, with the bounding box of its triangles
+struct LevelChunk {
+    unsigned int mesh;
+    unsigned int firstIndex;
+    unsigned int count;
+    glm::vec3 aabbMin;
+    glm::vec3 aabbMax;
+};
+
+// reorders the triangles of a mesh by cell of a grid on XZ (cellSize meters), and appends one chunk per non-empty cell.
+// Triangles are assigned to the cell of their centroid, and the bounding box of the chunk includes them entirely
+void buildLevelChunks(const std::vector<glm::vec3> &positions, std::vector<unsigned int> &indices, unsigned int mesh,
+                      float cellSize, std::vector<LevelChunk> &chunks) {
+    struct CellTriangle {
+        long long cell;
+        unsigned int triangle;
+    };
+    std::vector<CellTriangle> order;
+    order.reserve(indices.size() / 3);
+    for (unsigned int t = 0; t + 2 < indices.size(); t += 3) {
+        glm::vec3 centroid = (positions[indices[t]] + positions[indices[t + 1]] + positions[indices[t + 2]]) / 3.0f;
+        long long x = static_cast<long long>(std::floor(centroid.x / cellSize));
+        long long z = static_cast<long long>(std::floor(centroid.z / cellSize));
+        order.push_back({(x << 32) ^ (z & 0xFFFFFFFFll), t});
+    }
+    // stable, to keep the original order (and so the same rasterization order) inside each cell
+    std::stable_sort(order.begin(), order.end(), [](const CellTriangle &a, const CellTriangle &b) {
+        return a.cell < b.cell;
+    });
+
+    std::vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        if (i == 0 || order[i].cell != order[i - 1].cell)
+            chunks.push_back({mesh, static_cast<unsigned int>(reordered.size()), 0, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)});
+        LevelChunk &chunk = chunks.back();
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int index = indices[order[i].triangle + k];
+            reordered.push_back(index);
+            chunk.aabbMin = glm::min(chunk.aabbMin, positions[index]);
+            chunk.aabbMax = glm::max(chunk.aabbMax, positions[index]);
+        }
+        chunk.count += 3;
+    }
+    indices.swap(reordered);
+}
+
+// the triangles (3 consecutive vertices each) with an area of at least minArea: small details are not worth rasterizing
+std::vector<glm::vec3> selectOccluders(const std::vector<glm::vec3> &triangles, float minArea) {
+    std::vector<glm::vec3> occluders;
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+        float area = 0.5f * glm::length(glm::cross(triangles[t + 1] - triangles[t], triangles[t + 2] - triangles[t]));
+        if (area >= minArea)
+            occluders.insert(occluders.end(), {triangles[t], triangles[t + 1], triangles[t + 2]});
+    }
+    return occluders;
+}
+
+class OcclusionBuffer {
+public:
+    // occluders closer than this are clipped (it must be smaller than the near plane of the projection)
+    static constexpr float NEAR_DEPTH = 0.05f;
+    // an object is hidden only if it is farther than the occluders by at least this distance
+    static constexpr float DEPTH_BIAS = 0.02f;
+
+    // counters of the last frame
+    size_t rasterizedTriangles = 0;
+    size_t tests = 0;
+    size_t culled = 0;
+
+    OcclusionBuffer(int width = 256, int height = 144) {
+        resize(width, height);
+    }
+
+    void resize(int width, int height) {
+        sizes.clear();
+        levels.clear();
+        int w = width, h = height;
+        while (true) {
+            sizes.push_back(glm::ivec2(w, h));
+            levels.emplace_back(static_cast<size_t>(w) * h, FLT_MAX);
+            if (w == 1 && h == 1)
+                break;
+            w = std::max(1, (w + 1) / 2);
+            h = std::max(1, (h + 1) / 2);
+        }
+    }
+
+    int width() const { return sizes[0].x; }
+    int height() const { return sizes[0].y; }
+
+    // depth of the full resolution level (FLT_MAX where there are no occluders)
+    const std::vector<float> &depth() const { return levels[0]; }
+
+    // clears the buffer for a new frame
+    void begin(const glm::mat4 &viewProjection) {
+        this->viewProjection = viewProjection;
+        std::fill(levels[0].begin(), levels[0].end(), FLT_MAX);
+        rasterizedTriangles = tests = culled = 0;
+    }
+
+    // rasterizes the occluders (world space, 3 consecutive vertices per triangle)
+    void rasterize(const std::vector<glm::vec3> &triangles) {
+        for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+            glm::vec4 clip[3];
+            for (int k = 0; k < 3; k++)
+                clip[k] = viewProjection * glm::vec4(triangles[t + k], 1.0f);
+            // trivial rejection, all the vertices outside the same plane of the frustum
+            if ((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+                (clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+                (clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+                (clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w) ||
+                (clip[0].w < NEAR_DEPTH && clip[1].w < NEAR_DEPTH && clip[2].w < NEAR_DEPTH))
+                continue;
+
+            // clipping against the near plane gives a polygon of at most 4 vertices
+            glm::vec4 polygon[4];
+            int n = 0;
+            for (int k = 0; k < 3; k++) {
+                const glm::vec4 &a = clip[k], &b = clip[(k + 1) % 3];
+                if (a.w >= NEAR_DEPTH)
+                    polygon[n++] = a;
+                if ((a.w >= NEAR_DEPTH) != (b.w >= NEAR_DEPTH))
+                    polygon[n++] = a + (b - a) * ((NEAR_DEPTH - a.w) / (b.w - a.w));
+            }
+
+            glm::vec3 screen[4];
+            for (int k = 0; k < n; k++)
+                screen[k] = glm::vec3((polygon[k].x / polygon[k].w * 0.5f + 0.5f) * width(),
+                                      (polygon[k].y / polygon[k].w * 0.5f + 0.5f) * height(),
+                                      1.0f / polygon[k].w);
+            for (int k = 1; k + 1 < n; k++)
+                rasterizeTriangle(screen[0], screen[k], screen[k + 1]);
+            rasterizedTriangles++;
+        }
+    }
+
+    // builds the max-depth hierarchy: each texel is the farthest of the (up to) 4 texels it covers in the level below
+    void buildHierarchy() {
+        for (size_t l = 1; l < levels.size(); l++) {
+            const std::vector<float> &src = levels[l - 1];
+            std::vector<float> &dst = levels[l];
+            glm::ivec2 srcSize = sizes[l - 1], dstSize = sizes[l];
+            for (int y = 0; y < dstSize.y; y++) {
+                int y0 = std::min(y * 2, srcSize.y - 1), y1 = std::min(y * 2 + 1, srcSize.y - 1);
+                for (int x = 0; x < dstSize.x; x++) {
+                    int x0 = std::min(x * 2, srcSize.x - 1), x1 = std::min(x * 2 + 1, srcSize.x - 1);
+                    dst[y * dstSize.x + x] = std::max(std::max(src[y0 * srcSize.x + x0], src[y0 * srcSize.x + x1]),
+                                                      std::max(src[y1 * srcSize.x + x0], src[y1 * srcSize.x + x1]));
+                }
+            }
+        }
+    }
+
+    // false if the box is outside the frustum, or hidden by the occluders
+    bool visible(const glm::vec3 &aabbMin, const glm::vec3 &aabbMax) {
+        tests++;
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minDepth = FLT_MAX;
+        // each clip plane test (e.g., x > w) is a plane in world space: if all the corners are outside the same plane,
+        // the box is outside the frustum
+        int outside[4] = {0, 0, 0, 0};
+        bool crossesNear = false;
+        for (int c = 0; c < 8; c++) {
+            glm::vec3 corner(c & 1 ? aabbMax.x : aabbMin.x, c & 2 ? aabbMax.y : aabbMin.y, c & 4 ? aabbMax.z : aabbMin.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            outside[0] += clip.x > clip.w;
+            outside[1] += clip.x < -clip.w;
+            outside[2] += clip.y > clip.w;
+            outside[3] += clip.y < -clip.w;
+            if (clip.w < NEAR_DEPTH) {
+                crossesNear = true;
+                continue;
+            }
+            minX = std::min(minX, clip.x / clip.w);
+            maxX = std::max(maxX, clip.x / clip.w);
+            minY = std::min(minY, clip.y / clip.w);
+            maxY = std::max(maxY, clip.y / clip.w);
+            minDepth = std::min(minDepth, clip.w);
+        }
+        if (outside[0] == 8 || outside[1] == 8 || outside[2] == 8 || outside[3] == 8) {
+            culled++;
+            return false;
+        }
+        // the box crosses the near plane: its projection cannot be bounded, so it is considered visible
+        if (crossesNear)
+            return true;
+
+        // screen rectangle, enlarged by one pixel to compensate the sampling of the occluders at the pixel centers
+        int x0 = std::max(0, static_cast<int>(std::floor((minX * 0.5f + 0.5f) * width())) - 1);
+        int x1 = std::min(width() - 1, static_cast<int>(std::floor((maxX * 0.5f + 0.5f) * width())) + 1);
+        int y0 = std::max(0, static_cast<int>(std::floor((minY * 0.5f + 0.5f) * height())) - 1);
+        int y1 = std::min(height() - 1, static_cast<int>(std::floor((maxY * 0.5f + 0.5f) * height())) + 1);
+
+        // level of the hierarchy where the rectangle covers at most 4x4 texels
+        size_t level = 0;
+        while (level + 1 < levels.size() && std::max(x1 - x0, y1 - y0) >= 4) {
+            x0 /= 2;
+            x1 /= 2;
+            y0 /= 2;
+            y1 /= 2;
+            level++;
+        }
+        const std::vector<float> &depth = levels[level];
+        int stride = sizes[level].x;
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                if (minDepth <= depth[y * stride + x] + DEPTH_BIAS)
+                    return true;
+        culled++;
+        return false;
+    }
+
+    bool visibleSphere(const glm::vec3 &center, float radius) {
+        return visible(center - glm::vec3(radius), center + glm::vec3(radius));
+    }
+
+private:
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<std::vector<float> > levels;
+    std::vector<glm::ivec2> sizes;
+
+    // screen space triangle (x, y in pixels, z = 1/depth), sampled at the pixel centers; 1/depth is linear on the screen
+    void rasterizeTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::abs(area) < 1e-8f)
+            return;
+        int x0 = std::max(0, static_cast<int>(std::floor(std::min({a.x, b.x, c.x}))));
+        int x1 = std::min(width() - 1, static_cast<int>(std::ceil(std::max({a.x, b.x, c.x}))));
+        int y0 = std::max(0, static_cast<int>(std::floor(std::min({a.y, b.y, c.y}))));
+        int y1 = std::min(height() - 1, static_cast<int>(std::ceil(std::max({a.y, b.y, c.y}))));
+        std::vector<float> &depth = levels[0];
+        float invArea = 1.0f / area;
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            for (int x = x0; x <= x1; x++) {
+                float px = x + 0.5f;
+                float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) * invArea;
+                float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) * invArea;
+                float w2 = 1.0f - w0 - w1;
+                if (w0 < 0 || w1 < 0 || w2 < 0)
+                    continue;
+                float d = 1.0f / (w0 * a.z + w1 * b.z + w2 * c.z);
+                float &stored = depth[y * width() + x];
+                if (d < stored)
+                    stored = d;
+            }
+        }
+    }
+};
+#endif
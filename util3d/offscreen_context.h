@@ -0,0 +1,169 @@
+#ifndef OFFSCREEN_CONTEXT_H
+#define OFFSCREEN_CONTEXT_H
+
+// an OpenGL context without a window, for the render benchmark (work06b --render-benchmark): EGL on the surfaceless
+// platform of Mesa (EGL_MESA_platform_surfaceless, which llvmpipe also supports), or the default display of EGL when
+// the platform is missing, with no surface at all (EGL_KHR_surfaceless_context). As there is no default framebuffer,
+// the frame is composited in a framebuffer of its own, which the benchmark can read back to dump the frames.
+// EGL is only used on Linux: elsewhere create() fails and the benchmark needs a window.
+
+#include <glad/glad.h>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+class OffscreenContext {
+public:
+    OffscreenContext() = default;
+    OffscreenContext(const OffscreenContext &) = delete;
+    OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+    ~OffscreenContext() {
+        destroy();
+    }
+
+    // a core profile context of this version, made current: false (with the reason in error()) if it cannot be
+    // created
+    bool create(int major, int minor) {
+#ifdef __linux__
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (getPlatformDisplay != nullptr && clientExtensions != nullptr &&
+            std::string(clientExtensions).find("EGL_MESA_platform_surfaceless") != std::string::npos)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+            display = EGL_NO_DISPLAY;
+            return fail("no EGL display");
+        }
+        if (std::string(eglQueryString(display, EGL_EXTENSIONS)).find("EGL_KHR_surfaceless_context") ==
+            std::string::npos)
+            return fail("EGL_KHR_surfaceless_context is not supported");
+        if (!eglBindAPI(EGL_OPENGL_API))
+            return fail("desktop OpenGL is not supported by EGL");
+
+        // a config is only needed by the drivers without EGL_KHR_no_config_context
+        EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+        EGLConfig config = nullptr;
+        EGLint configs = 0;
+        eglChooseConfig(display, configAttributes, &config, 1, &configs);
+        EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major, EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE
+        };
+        context = eglCreateContext(display, configs > 0 ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT)
+            return fail("no OpenGL " + std::to_string(major) + "." + std::to_string(minor) + " core context");
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+            return fail("the context cannot be made current without a surface");
+        return true;
+#else
+        (void) major;
+        (void) minor;
+        return fail("EGL is only used on Linux");
+#endif
+    }
+
+    // for gladLoadGLLoader
+    static GLADloadproc loader() {
+#ifdef __linux__
+        return reinterpret_cast<GLADloadproc>(eglGetProcAddress);
+#else
+        return nullptr;
+#endif
+    }
+
+    const std::string &error() const {
+        return errorMessage;
+    }
+
+    void destroy() {
+#ifdef __linux__
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+#endif
+    }
+
+private:
+#ifdef __linux__
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+    std::string errorMessage;
+
+    bool fail(const std::string &message) {
+        errorMessage = message;
+        destroy();
+        return false;
+    }
+};
+
+// the framebuffer which stands in for the one of the window: 8 bit color and a depth buffer
+class OffscreenFramebuffer {
+public:
+    OffscreenFramebuffer() = default;
+    OffscreenFramebuffer(const OffscreenFramebuffer &) = delete;
+    OffscreenFramebuffer &operator=(const OffscreenFramebuffer &) = delete;
+
+    // needs the context, as the other owners of OpenGL objects
+    ~OffscreenFramebuffer() {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(2, renderbuffers);
+    }
+
+    bool create(int width, int height) {
+        this->width = width;
+        this->height = height;
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    GLuint id() const {
+        return fbo;
+    }
+
+    // the color as a binary PPM (top row first), to compare the frames of two runs
+    bool writePpm(const std::string &path) const {
+        std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        std::ofstream out(path, std::ios::binary);
+        out << "P6\n" << width << " " << height << "\n255\n";
+        for (int y = height - 1; y >= 0; y--)
+            out.write(reinterpret_cast<const char *>(pixels.data()) + static_cast<size_t>(y) * width * 3, width * 3);
+        return static_cast<bool>(out);
+    }
+
+private:
+    GLuint fbo = 0;
+    GLuint renderbuffers[2] = {0, 0};
+    int width = 0, height = 0;
+};
+#endif
@@ -0,0 +1,295 @@
+#ifndef PHYSICS_POOL_H
+#define PHYSICS_POOL_H
+
+// memory management for the Bullet objects created while shooting:
+// - PhysicsAllocator: size-class pool installed as Bullet's allocator (btAlignedAllocSetCustom), so every
+//   btAlignedAlloc (bodies, shapes, broadphase proxies, manifolds, arrays) is served from free lists of slabs
+// - ObjectPool: typed free list, used to recycle rigid bodies and motion states without going through the allocator
+// - BulletBodyPool: creates and destroys the bullet bodies, sharing one immutable sphere shape per radius
+//
+// N.B.) the allocator must be installed before any Bullet object is created (see installPhysicsAllocator),
+// because blocks allocated by the default allocator cannot be released by the pool and vice versa
+
+#include <glm/glm.hpp>
+#include <utils/physics.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+struct PhysicsAllocatorStats {
+    // number of calls since the installation
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    // allocations served by a free list (no new memory requested to the system)
+    uint64_t recycled = 0;
+    uint64_t liveBlocks = 0;
+    uint64_t liveBytes = 0;
+    uint64_t peakLiveBytes = 0;
+    // memory requested to the system for the slabs of the size classes
+    uint64_t slabBytes = 0;
+};
+
+class PhysicsAllocator {
+public:
+    // blocks up to MAX_POOLED_SIZE bytes are served by NR_CLASSES size classes, GRANULARITY bytes apart
+    static const size_t GRANULARITY = 16;
+    static const size_t NR_CLASSES = 64;
+    static const size_t MAX_POOLED_SIZE = GRANULARITY * NR_CLASSES;
+    // each block is preceded by a header with its size class, which keeps the block 16-byte aligned
+    static const size_t HEADER_SIZE = 16;
+    static const size_t SLAB_SIZE = 64 * 1024;
+    static const uint32_t LARGE_BLOCK = 0xFFFFFFFFu;
+
+    // the allocator is never destroyed: Bullet objects can be released during the program exit
+    static PhysicsAllocator &instance() {
+        static PhysicsAllocator *allocator = new PhysicsAllocator();
+        return *allocator;
+    }
+
+    void *allocate(size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.allocations++;
+        stats.liveBlocks++;
+
+        char *block;
+        uint32_t sizeClass;
+        size_t blockSize;
+        if (size > MAX_POOLED_SIZE) {
+            sizeClass = LARGE_BLOCK;
+            blockSize = size;
+            block = static_cast<char *>(std::malloc(HEADER_SIZE + size));
+            if (!block)
+                return nullptr;
+        } else {
+            sizeClass = static_cast<uint32_t>((size + GRANULARITY - 1) / GRANULARITY);
+            if (sizeClass == 0)
+                sizeClass = 1;
+            blockSize = sizeClass * GRANULARITY;
+            FreeBlock *&freeList = freeLists[sizeClass - 1];
+            if (!freeList)
+                refill(sizeClass);
+            else
+                stats.recycled++;
+            block = reinterpret_cast<char *>(freeList);
+            freeList = freeList->next;
+        }
+
+        Header *header = reinterpret_cast<Header *>(block);
+        header->sizeClass = sizeClass;
+        header->size = blockSize;
+        stats.liveBytes += blockSize;
+        if (stats.liveBytes > stats.peakLiveBytes)
+            stats.peakLiveBytes = stats.liveBytes;
+        return block + HEADER_SIZE;
+    }
+
+    void release(void *ptr) {
+        if (!ptr)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        char *block = static_cast<char *>(ptr) - HEADER_SIZE;
+        Header *header = reinterpret_cast<Header *>(block);
+        stats.frees++;
+        stats.liveBlocks--;
+        stats.liveBytes -= header->size;
+        if (header->sizeClass == LARGE_BLOCK) {
+            std::free(block);
+            return;
+        }
+        FreeBlock *freeBlock = reinterpret_cast<FreeBlock *>(block);
+        freeBlock->next = freeLists[header->sizeClass - 1];
+        freeLists[header->sizeClass - 1] = freeBlock;
+    }
+
+    PhysicsAllocatorStats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Header {
+        uint32_t sizeClass;
+        uint64_t size;
+    };
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    FreeBlock *freeLists[NR_CLASSES] = {};
+    std::vector<char *> slabs;
+    PhysicsAllocatorStats stats;
+    std::mutex mutex;
+
+    PhysicsAllocator() = default;
+
+    // carves a new slab in blocks of the given size class, and puts them in its free list
+    void refill(uint32_t sizeClass) {
+        size_t stride = HEADER_SIZE + sizeClass * GRANULARITY;
+        size_t count = SLAB_SIZE / stride;
+        char *slab = static_cast<char *>(std::malloc(count * stride));
+        if (!slab)
+            throw std::bad_alloc();
+        slabs.push_back(slab);
+        stats.slabBytes += count * stride;
+
+        FreeBlock *&freeList = freeLists[sizeClass - 1];
+        for (size_t i = count; i-- > 0;) {
+            FreeBlock *block = reinterpret_cast<FreeBlock *>(slab + i * stride);
+            block->next = freeList;
+            freeList = block;
+        }
+    }
+};
+
+void *physicsAlloc(size_t size) {
+    return PhysicsAllocator::instance().allocate(size);
+}
+
+void physicsFree(void *ptr) {
+    PhysicsAllocator::instance().release(ptr);
+}
+
+// to be called before the creation of the first Bullet object (e.g., to initialize a global before the Physics one)
+bool installPhysicsAllocator() {
+    btAlignedAllocSetCustom(physicsAlloc, physicsFree);
+    return true;
+}
+
+//////////////////////////////////////////
+// free list of objects of type T, allocated in chunks of CHUNK_SIZE elements. Objects are 16-byte aligned,
+// as required by the Bullet classes
+template<typename T, size_t CHUNK_SIZE = 256>
+class ObjectPool {
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool() {
+        for (Slot *chunk: chunks)
+            btAlignedFree(chunk);
+    }
+
+    template<typename... Args>
+    T *create(Args &&... args) {
+        Slot *slot;
+        if (freeList) {
+            slot = freeList;
+            freeList = freeList->next;
+        } else {
+            if (chunks.empty() || nextInChunk == CHUNK_SIZE) {
+                chunks.push_back(static_cast<Slot *>(btAlignedAlloc(sizeof(Slot) * CHUNK_SIZE, 16)));
+                nextInChunk = 0;
+            }
+            slot = chunks.back() + nextInChunk++;
+        }
+        live++;
+        return ::new(static_cast<void *>(slot->storage)) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T *object) {
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+        live--;
+    }
+
+    size_t liveObjects() const {
+        return live;
+    }
+
+    size_t capacity() const {
+        return chunks.size() * CHUNK_SIZE;
+    }
+
+private:
+    union Slot {
+        Slot *next;
+        alignas(16) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<Slot *> chunks;
+    size_t nextInChunk = 0;
+    Slot *freeList = nullptr;
+    size_t live = 0;
+};
+
+//////////////////////////////////////////
+// creation and destruction of the bullets' rigid bodies: bodies and motion states are recycled through the typed
+// pools, and all the bullets with the same radius share the same (immutable) sphere shape
+class BulletBodyPool {
+public:
+    // the pool lives until the program exit, like the allocator
+    static BulletBodyPool &instance() {
+        static BulletBodyPool *pool = new BulletBodyPool();
+        return *pool;
+    }
+
+    // same parameters of Physics::createRigidBody for a SPHERE
+    btRigidBody *create(Physics &physics, glm::vec3 position, float radius, float mass, float friction,
+                        float restitution) {
+        btSphereShape *shape = sphereShape(radius);
+
+        btTransform transform;
+        transform.setIdentity();
+        transform.setOrigin(btVector3(position.x, position.y, position.z));
+        btDefaultMotionState *motionState = motionStates.create(transform);
+
+        btVector3 localInertia(0.0, 0.0, 0.0);
+        if (mass != 0.0f)
+            shape->calculateLocalInertia(mass, localInertia);
+        btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, shape, localInertia);
+        rbInfo.m_friction = friction;
+        rbInfo.m_restitution = restitution;
+        rbInfo.m_angularDamping = 0.3;
+        rbInfo.m_rollingFriction = 0.3;
+
+        btRigidBody *body = bodies.create(rbInfo);
+        physics.dynamicsWorld->addRigidBody(body);
+        return body;
+    }
+
+    // removes the body from the simulation, and gives back body and motion state to the pools (the shape is shared)
+    void destroy(Physics &physics, btRigidBody *body) {
+        physics.dynamicsWorld->removeRigidBody(body);
+        btMotionState *motionState = body->getMotionState();
+        bodies.destroy(body);
+        motionStates.destroy(static_cast<btDefaultMotionState *>(motionState));
+    }
+
+    btSphereShape *sphereShape(float radius) {
+        auto it = sphereShapes.find(radius);
+        if (it != sphereShapes.end())
+            return it->second;
+        btSphereShape *shape = new btSphereShape(radius);
+        sphereShapes[radius] = shape;
+        return shape;
+    }
+
+    size_t liveBodies() const {
+        return bodies.liveObjects();
+    }
+
+    size_t liveMotionStates() const {
+        return motionStates.liveObjects();
+    }
+
+    size_t sharedShapes() const {
+        return sphereShapes.size();
+    }
+
+private:
+    ObjectPool<btRigidBody> bodies;
+    ObjectPool<btDefaultMotionState> motionStates;
+    std::map<float, btSphereShape *> sphereShapes;
+
+    BulletBodyPool() = default;
+};
+#endif
@@ -0,0 +1,152 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// irradiance probes for the dynamic objects (bullets and splats).
+// A regular grid of probes covers the level; for each probe and ceiling light the bake stores the attenuation of the
+// light (which scales its ambient and specular terms, like in calcPointLight of shader.frag) and the diffuse term
+// max(dot(N, L), 0) projected on the L1 spherical harmonics, i.e. 1/4 + 1/2 dot(N, L) times attenuation and
+// visibility of the light from the probe. These values do not depend on the light intensities, so at each frame the
+// flicker is applied by summing them weighted by the current intensities of the lights (combine), the shader of
+// the dynamic objects reads the sums with a trilinear lookup instead of looping over the lights.
+//
+// N.B.) the light intensities are grey, so only their first component is used
+
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+class ProbeGrid {
+public:
+    // position of the first probe, distance between probes and number of probes along each axis
+    glm::vec3 origin = glm::vec3(0.0f);
+    float spacing = 0.5f;
+    glm::ivec3 dims = glm::ivec3(0);
+    size_t nrLights = 0;
+
+    // per probe and light (probe-major): attenuation, and L1 SH of the attenuated and shadowed diffuse term
+    std::vector<float> attenuation;
+    std::vector<glm::vec4> diffuse;
+
+    // output of combine, per probe: SH of the diffuse lighting (the ambient terms are in the constant coefficient),
+    // and the specular factor
+    std::vector<glm::vec4> irradiance;
+    std::vector<float> specular;
+
+    // intensities used by the last combine
+    std::vector<glm::vec3> lastAmbient, lastDiffuse, lastSpecular;
+
+    size_t probeCount() const {
+        return static_cast<size_t>(dims.x) * dims.y * dims.z;
+    }
+
+    size_t probeIndex(int x, int y, int z) const {
+        return (static_cast<size_t>(z) * dims.y + y) * dims.x + x;
+    }
+
+    glm::vec3 probePosition(int x, int y, int z) const {
+        return origin + glm::vec3(x, y, z) * spacing;
+    }
+
+    // bakes the probes over the box [boundsMin, boundsMax], with the shadow rays traced on the BVH of the level.
+    // The probes are distributed on the given number of threads
+    void bake(const Bvh &bvh, const std::vector<glm::vec3> &lightPositions,
+              const std::vector<glm::vec3> &lightAttenuations, glm::vec3 boundsMin, glm::vec3 boundsMax,
+              float probeSpacing, unsigned int threads, bool shadows = true) {
+        spacing = probeSpacing;
+        origin = boundsMin;
+        dims = glm::ivec3(glm::ceil((boundsMax - boundsMin) / spacing)) + 1;
+        nrLights = lightPositions.size();
+        irradiance.clear();
+        attenuation.assign(probeCount() * nrLights, 0.0f);
+        diffuse.assign(probeCount() * nrLights, glm::vec4(0.0f));
+
+        std::atomic<int> nextSlice(0);
+        auto worker = [&]() {
+            // one slice (fixed z) at a time
+            for (int z = nextSlice++; z < dims.z; z = nextSlice++) {
+                for (int y = 0; y < dims.y; y++) {
+                    for (int x = 0; x < dims.x; x++) {
+                        glm::vec3 position = probePosition(x, y, z);
+                        size_t base = probeIndex(x, y, z) * nrLights;
+                        for (size_t i = 0; i < nrLights; i++) {
+                            glm::vec3 toLight = lightPositions[i] - position;
+                            float distance = glm::length(toLight);
+                            glm::vec3 direction = distance > 0.0f ? toLight / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+                            const glm::vec3 &a = lightAttenuations[i];
+                            float att = 1.0f / (a.x + a.y * distance + a.z * distance * distance);
+                            attenuation[base + i] = att;
+                            if (shadows && bvh.occluded(position, direction, distance - 0.01f))
+                                continue;
+                            diffuse[base + i] = glm::vec4(0.25f, direction * 0.5f) * att;
+                        }
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned int t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &thread: pool)
+            thread.join();
+    }
+
+    // sums of the baked values weighted by the current intensities of the lights. Returns false (and does nothing)
+    // if the intensities did not change since the last call, which is the case outside of the flicker
+    bool combine(const std::vector<glm::vec3> &lightAmbient, const std::vector<glm::vec3> &lightDiffuse,
+                 const std::vector<glm::vec3> &lightSpecular) {
+        if (!irradiance.empty() && lightAmbient == lastAmbient && lightDiffuse == lastDiffuse &&
+            lightSpecular == lastSpecular)
+            return false;
+        lastAmbient = lightAmbient;
+        lastDiffuse = lightDiffuse;
+        lastSpecular = lightSpecular;
+        size_t count = probeCount();
+        irradiance.resize(count);
+        specular.resize(count);
+        for (size_t p = 0; p < count; p++) {
+            const float *att = &attenuation[p * nrLights];
+            const glm::vec4 *dif = &diffuse[p * nrLights];
+            glm::vec4 sh(0.0f);
+            float ambient = 0.0f, spec = 0.0f;
+            for (size_t i = 0; i < nrLights; i++) {
+                ambient += lightAmbient[i].x * att[i];
+                spec += lightSpecular[i].x * att[i];
+                sh += dif[i] * lightDiffuse[i].x;
+            }
+            sh.x += ambient;
+            irradiance[p] = sh;
+            specular[p] = spec;
+        }
+        return true;
+    }
+
+    // trilinear interpolation of the combined values, like the texture lookup of the shader
+    void sample(const glm::vec3 &position, glm::vec4 &outIrradiance, float &outSpecular) const {
+        glm::vec3 g = glm::clamp((position - origin) / spacing, glm::vec3(0.0f), glm::vec3(dims - 1));
+        glm::ivec3 i0 = glm::min(glm::ivec3(g), dims - 2);
+        i0 = glm::max(i0, glm::ivec3(0));
+        glm::vec3 f = g - glm::vec3(i0);
+        outIrradiance = glm::vec4(0.0f);
+        outSpecular = 0.0f;
+        for (int k = 0; k < 8; k++) {
+            glm::ivec3 c = glm::min(i0 + glm::ivec3(k & 1, (k >> 1) & 1, (k >> 2) & 1), dims - 1);
+            float w = ((k & 1) ? f.x : 1.0f - f.x) * ((k & 2) ? f.y : 1.0f - f.y) * ((k & 4) ? f.z : 1.0f - f.z);
+            size_t index = probeIndex(c.x, c.y, c.z);
+            outIrradiance += irradiance[index] * w;
+            outSpecular += specular[index] * w;
+        }
+    }
+};
+
+// evaluation of the probe lighting for a normal, as in the shader (N is the abs(vNormal) of calcPointLight)
+float evalProbeDiffuse(const glm::vec4 &sh, const glm::vec3 &normal) {
+    return std::max(sh.x + glm::dot(glm::vec3(sh.y, sh.z, sh.w), normal), 0.0f);
+}
+#endif
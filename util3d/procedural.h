@@ -0,0 +1,571 @@
+#ifndef PROCEDURAL_H
+#define PROCEDURAL_H
+
+// endless backrooms generated from a seed, in square chunks of cells. The walls are on the edges of the cells, and
+// each edge belongs to the chunk of the cell on its east (x) or north (z) side, so its wall depends only on the seed
+// and on the global coordinates of the edge: two chunks next to each other always agree, in any order they are
+// generated. The chunks are generated on worker threads (ChunkGenerator), with their meshes, ceiling lights and
+// collision shape (Bullet objects can be created on other threads, the allocator of util3d/physics_pool.h has a
+// lock), and ChunkStreamer decides at each frame which chunks to ask for, which ones to hand to the renderer and
+// to the physics (a few per frame, on the main thread) and which ones to evict, within a memory budget.
+// Nothing here needs OpenGL: the renderer gets the meshes in its own vertex format in the load callback.
+
+#include <glm/glm.hpp>
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// sizes of the level of backrooms.obj: height of floor and ceiling, and of the ceiling lights
+const float PROCEDURAL_CELL_SIZE = 3.0f;
+const int PROCEDURAL_CHUNK_CELLS = 6;
+const float PROCEDURAL_CHUNK_SIZE = PROCEDURAL_CELL_SIZE * PROCEDURAL_CHUNK_CELLS;
+const float PROCEDURAL_FLOOR = -1.437f;
+const float PROCEDURAL_CEILING = 1.437f;
+const float PROCEDURAL_LIGHT_HEIGHT = 1.25f;
+const float PROCEDURAL_WALL_THICKNESS = 0.2f;
+const float PROCEDURAL_DOOR_WIDTH = 1.2f;
+const float PROCEDURAL_DOOR_HEIGHT = 2.1f;
+// texture coordinates per meter, about the ones of the level (its textures cover the whole level)
+const float PROCEDURAL_WALL_TEXTURE_SCALE = 0.025f;
+const float PROCEDURAL_FLOOR_TEXTURE_SCALE = 0.0366f;
+// lights of the shader which the panels follow for the flicker (see LightId in util3d/mesh.h)
+const unsigned int PROCEDURAL_PANEL_LIGHTS = 25;
+
+struct ChunkCoord {
+    int x, z;
+
+    bool operator<(const ChunkCoord &other) const {
+        return x < other.x || (x == other.x && z < other.z);
+    }
+
+    bool operator==(const ChunkCoord &other) const {
+        return x == other.x && z == other.z;
+    }
+};
+
+ChunkCoord chunkAt(const glm::vec3 &position) {
+    return ChunkCoord{static_cast<int>(std::floor(position.x / PROCEDURAL_CHUNK_SIZE)),
+                      static_cast<int>(std::floor(position.z / PROCEDURAL_CHUNK_SIZE))};
+}
+
+glm::vec3 chunkCenter(ChunkCoord coord) {
+    return glm::vec3((coord.x + 0.5f) * PROCEDURAL_CHUNK_SIZE, 0.0f, (coord.z + 0.5f) * PROCEDURAL_CHUNK_SIZE);
+}
+
+// distance in chunks, along the farthest axis (the chunks around another one are a square)
+int chunkDistance(ChunkCoord a, ChunkCoord b) {
+    return std::max(std::abs(a.x - b.x), std::abs(a.z - b.z));
+}
+
+// the meshes of a chunk, one per material
+enum ChunkSurface {
+    CHUNK_WALLS,
+    CHUNK_FLOOR,
+    CHUNK_CEILING,
+    CHUNK_PANELS,
+    CHUNK_SURFACES,
+};
+
+// triangles in world coordinates, counter-clockwise seen from the front
+struct ChunkMesh {
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> texCoords;
+    // ceiling light of each vertex, for the emissive panels
+    std::vector<unsigned int> lightIds;
+    std::vector<unsigned int> indices;
+
+    size_t bytes() const {
+        return positions.capacity() * sizeof(glm::vec3) + normals.capacity() * sizeof(glm::vec3) +
+               texCoords.capacity() * sizeof(glm::vec2) + lightIds.capacity() * sizeof(unsigned int) +
+               indices.capacity() * sizeof(unsigned int);
+    }
+};
+
+// axis-aligned box of a wall, a floor or a ceiling
+struct ChunkBox {
+    glm::vec3 center, halfExtents;
+};
+
+struct Chunk {
+    ChunkCoord coord;
+    ChunkMesh meshes[CHUNK_SURFACES];
+    std::vector<glm::vec3> lights;
+    std::vector<ChunkBox> boxes;
+    // a compound of the boxes, in world coordinates
+    btCompoundShape *shape = nullptr;
+    double generationMs = 0;
+    // memory of the chunk in the renderer (e.g., its ranges of the buffers), set by the load callback
+    size_t rendererBytes = 0;
+
+    Chunk() = default;
+
+    ~Chunk() {
+        if (shape == nullptr)
+            return;
+        for (int i = shape->getNumChildShapes() - 1; i >= 0; i--)
+            delete shape->getChildShape(i);
+        delete shape;
+    }
+
+    Chunk(const Chunk &) = delete;
+    Chunk &operator=(const Chunk &) = delete;
+
+    // the meshes are not needed after the renderer copied them
+    void releaseMeshes() {
+        for (auto &mesh: meshes)
+            mesh = ChunkMesh();
+    }
+
+    size_t bytes() const {
+        size_t total = sizeof(Chunk) + lights.capacity() * sizeof(glm::vec3) + boxes.capacity() * sizeof(ChunkBox);
+        for (auto &mesh: meshes)
+            total += mesh.bytes();
+        // each box of the compound is a shape, a child with its transform and a node of the tree of the compound
+        if (shape != nullptr)
+            total += sizeof(btCompoundShape) + boxes.size() * (sizeof(btBoxShape) + 2 * sizeof(btTransform));
+        return total + rendererBytes;
+    }
+};
+
+// 32 well mixed bits of the seed and of a position (splitmix64)
+uint32_t proceduralHash(uint32_t seed, int x, int z, uint32_t salt) {
+    uint64_t h = seed * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint32_t>(x) * 0xC2B2AE3D27D4EB4Full;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(z)) << 32;
+    h ^= salt * 0xD6E8FEB86659FD93ull;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>(h ^ (h >> 31));
+}
+
+enum EdgeWall {
+    EDGE_OPEN,
+    EDGE_WALL,
+    EDGE_DOOR,
+};
+
+// the wall on the west (axis 0, along z) or south (axis 1, along x) edge of the cell (x, z). The walls around the
+// cell (0, 0), where the player starts, always have a door
+EdgeWall edgeWall(uint32_t seed, int x, int z, int axis) {
+    uint32_t h = proceduralHash(seed, x, z, 1 + axis);
+    if (h % 100 >= 45)
+        return EDGE_OPEN;
+    bool start = axis == 0 ? (z == 0 && (x == 0 || x == 1)) : (x == 0 && (z == 0 || z == 1));
+    return start || (h >> 8) % 100 < 50 ? EDGE_DOOR : EDGE_WALL;
+}
+
+// a face of a box: normal along axis, with the given sign
+void addBoxFace(ChunkMesh &mesh, const ChunkBox &box, int axis, float sign, float textureScale,
+                unsigned int lightId = 0) {
+    glm::vec3 n(0.0f);
+    n[axis] = sign;
+    // u horizontal, and u x v = n, so the corners are counter-clockwise seen from the normal
+    glm::vec3 u = axis == 1 ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), n);
+    glm::vec3 v = glm::cross(n, u);
+    glm::vec3 center = box.center + n * box.halfExtents[axis];
+    glm::vec3 hu = u * glm::abs(glm::dot(u, box.halfExtents)), hv = v * glm::abs(glm::dot(v, box.halfExtents));
+    glm::vec3 corners[4] = {center - hu - hv, center + hu - hv, center + hu + hv, center - hu + hv};
+    unsigned int first = static_cast<unsigned int>(mesh.positions.size());
+    for (auto &corner: corners) {
+        mesh.positions.push_back(corner);
+        mesh.normals.push_back(n);
+        // planar mapping in world coordinates, so the textures continue from a chunk to the next one
+        glm::vec2 uv = axis == 1 ? glm::vec2(corner.x, corner.z) : glm::vec2(axis == 0 ? corner.z : corner.x, corner.y);
+        mesh.texCoords.push_back(uv * textureScale);
+        mesh.lightIds.push_back(lightId);
+    }
+    for (unsigned int i: {0u, 1u, 2u, 0u, 2u, 3u})
+        mesh.indices.push_back(first + i);
+}
+
+// a wall from a to b on the floor (along x or z), with a door in the middle if door is true: the parts next to the
+// door and the lintel above it are separate boxes. The ends go half the thickness farther, to close the corners
+void addWall(Chunk &chunk, glm::vec3 a, glm::vec3 b, bool door) {
+    glm::vec3 along = glm::normalize(b - a);
+    int axis = along.x != 0.0f ? 0 : 2;
+    float length = glm::length(b - a);
+    auto box = [&](float from, float to, float bottom, float top) {
+        glm::vec3 center = a + along * ((from + to) * 0.5f);
+        center.y = (bottom + top) * 0.5f;
+        glm::vec3 half(PROCEDURAL_WALL_THICKNESS * 0.5f, (top - bottom) * 0.5f, PROCEDURAL_WALL_THICKNESS * 0.5f);
+        half[axis] = (to - from) * 0.5f;
+        return ChunkBox{center, half};
+    };
+    float start = -PROCEDURAL_WALL_THICKNESS * 0.5f, end = length + PROCEDURAL_WALL_THICKNESS * 0.5f;
+    std::vector<ChunkBox> parts;
+    if (door) {
+        float doorStart = (length - PROCEDURAL_DOOR_WIDTH) * 0.5f, doorEnd = doorStart + PROCEDURAL_DOOR_WIDTH;
+        parts.push_back(box(start, doorStart, PROCEDURAL_FLOOR, PROCEDURAL_CEILING));
+        parts.push_back(box(doorEnd, end, PROCEDURAL_FLOOR, PROCEDURAL_CEILING));
+        parts.push_back(box(doorStart, doorEnd, PROCEDURAL_FLOOR + PROCEDURAL_DOOR_HEIGHT, PROCEDURAL_CEILING));
+    } else {
+        parts.push_back(box(start, end, PROCEDURAL_FLOOR, PROCEDURAL_CEILING));
+    }
+    ChunkMesh &mesh = chunk.meshes[CHUNK_WALLS];
+    for (size_t p = 0; p < parts.size(); p++) {
+        for (int side: {0, 2})
+            for (float sign: {-1.0f, 1.0f})
+                addBoxFace(mesh, parts[p], side, sign, PROCEDURAL_WALL_TEXTURE_SCALE);
+        // the bottom of the lintel (the other faces touch the floor or the ceiling)
+        if (door && p == 2)
+            addBoxFace(mesh, parts[p], 1, -1.0f, PROCEDURAL_WALL_TEXTURE_SCALE);
+        chunk.boxes.push_back(parts[p]);
+    }
+}
+
+// the whole chunk: walls, floor and ceiling slabs, panels and lights, and the collision shape
+std::unique_ptr<Chunk> generateChunk(uint32_t seed, ChunkCoord coord) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<Chunk> chunk(new Chunk());
+    chunk->coord = coord;
+    glm::vec3 center = chunkCenter(coord);
+    float half = PROCEDURAL_CHUNK_SIZE * 0.5f;
+
+    ChunkBox floor{glm::vec3(center.x, PROCEDURAL_FLOOR - 0.25f, center.z), glm::vec3(half, 0.25f, half)};
+    ChunkBox ceiling{glm::vec3(center.x, PROCEDURAL_CEILING + 0.25f, center.z), glm::vec3(half, 0.25f, half)};
+    addBoxFace(chunk->meshes[CHUNK_FLOOR], floor, 1, 1.0f, PROCEDURAL_FLOOR_TEXTURE_SCALE);
+    addBoxFace(chunk->meshes[CHUNK_CEILING], ceiling, 1, -1.0f, PROCEDURAL_FLOOR_TEXTURE_SCALE);
+    chunk->boxes.push_back(floor);
+    chunk->boxes.push_back(ceiling);
+
+    for (int i = 0; i < PROCEDURAL_CHUNK_CELLS; i++) {
+        for (int j = 0; j < PROCEDURAL_CHUNK_CELLS; j++) {
+            int x = coord.x * PROCEDURAL_CHUNK_CELLS + i, z = coord.z * PROCEDURAL_CHUNK_CELLS + j;
+            glm::vec3 corner(x * PROCEDURAL_CELL_SIZE, PROCEDURAL_FLOOR, z * PROCEDURAL_CELL_SIZE);
+            EdgeWall west = edgeWall(seed, x, z, 0), south = edgeWall(seed, x, z, 1);
+            if (west != EDGE_OPEN)
+                addWall(*chunk, corner, corner + glm::vec3(0.0f, 0.0f, PROCEDURAL_CELL_SIZE), west == EDGE_DOOR);
+            if (south != EDGE_OPEN)
+                addWall(*chunk, corner, corner + glm::vec3(PROCEDURAL_CELL_SIZE, 0.0f, 0.0f), south == EDGE_DOOR);
+
+            // a panel with its light in most of the cells
+            uint32_t h = proceduralHash(seed, x, z, 3);
+            if (h % 100 < 60) {
+                glm::vec3 cellCenter = corner + glm::vec3(0.5f, 0.0f, 0.5f) * PROCEDURAL_CELL_SIZE;
+                ChunkBox panel{glm::vec3(cellCenter.x, PROCEDURAL_CEILING - 0.01f, cellCenter.z),
+                               glm::vec3(0.6f, 0.0f, 0.3f)};
+                addBoxFace(chunk->meshes[CHUNK_PANELS], panel, 1, -1.0f, 1.0f, (h >> 8) % PROCEDURAL_PANEL_LIGHTS);
+                chunk->lights.push_back(glm::vec3(cellCenter.x, PROCEDURAL_LIGHT_HEIGHT, cellCenter.z));
+            }
+        }
+    }
+
+    chunk->shape = new btCompoundShape();
+    for (auto &box: chunk->boxes) {
+        btTransform transform;
+        transform.setIdentity();
+        transform.setOrigin(btVector3(box.center.x, box.center.y, box.center.z));
+        chunk->shape->addChildShape(transform, new btBoxShape(
+                btVector3(box.halfExtents.x, box.halfExtents.y, box.halfExtents.z)));
+    }
+    chunk->generationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return chunk;
+}
+
+// pool of threads generating the chunks asked with schedule(): the finished ones are taken with collect()
+class ChunkGenerator {
+public:
+    ChunkGenerator(uint32_t seed, unsigned int threads) : seed(seed) {
+        for (unsigned int t = 0; t < std::max(threads, 1u); t++)
+            workers.emplace_back([this]() { work(); });
+    }
+
+    ~ChunkGenerator() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker: workers)
+            worker.join();
+    }
+
+    ChunkGenerator(const ChunkGenerator &) = delete;
+    ChunkGenerator &operator=(const ChunkGenerator &) = delete;
+
+    // the chunks to generate, the most urgent first: they replace the ones still waiting, so the chunks which are
+    // not wanted anymore (e.g., behind the player) are never generated
+    void schedule(const std::vector<ChunkCoord> &wanted) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.clear();
+            for (auto &coord: wanted)
+                if (running.count(coord) == 0 && finished.count(coord) == 0)
+                    jobs.push_back(coord);
+        }
+        wake.notify_all();
+    }
+
+    std::vector<std::unique_ptr<Chunk> > collect() {
+        std::vector<std::unique_ptr<Chunk> > chunks;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &entry: finished)
+            chunks.push_back(std::move(entry.second));
+        finished.clear();
+        return chunks;
+    }
+
+    // chunks waiting or being generated
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return jobs.size() + running.size();
+    }
+
+private:
+    uint32_t seed;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<ChunkCoord> jobs;
+    std::set<ChunkCoord> running;
+    std::map<ChunkCoord, std::unique_ptr<Chunk> > finished;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            ChunkCoord coord = jobs.front();
+            jobs.pop_front();
+            running.insert(coord);
+            lock.unlock();
+            std::unique_ptr<Chunk> chunk = generateChunk(seed, coord);
+            lock.lock();
+            running.erase(coord);
+            finished[coord] = std::move(chunk);
+        }
+    }
+};
+
+struct StreamerSettings {
+    // chunks kept around the chunk of the player (in chunks, along each axis); they are evicted one chunk farther
+    int radius = 3;
+    size_t memoryBudget = 32 * 1024 * 1024;
+    // chunks handed to the load callback at each frame
+    unsigned int loadsPerFrame = 2;
+    unsigned int threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+};
+
+struct StreamerStats {
+    size_t generated = 0, loaded = 0, evicted = 0, evictedForBudget = 0, discarded = 0;
+    double generationMs = 0, maxGenerationMs = 0;
+    // time of the load callbacks in the last frame, the worst one and the sum over all the frames
+    double loadMs = 0, maxLoadMs = 0, totalLoadMs = 0;
+    unsigned int frames = 0;
+    // memory of the resident chunks and of the ones waiting to be loaded (the peak after the evictions of a frame)
+    size_t residentBytes = 0, peakResidentBytes = 0;
+    // chunks next to the player which are not loaded yet
+    size_t missing = 0;
+};
+
+class ChunkStreamer {
+public:
+    // called on the thread of update(): load adds the chunk to the renderer and to the physics, and sets its
+    // rendererBytes, unload removes it (before the chunk and its shape are deleted)
+    std::function<void(Chunk &)> onLoad, onUnload;
+    StreamerStats stats;
+
+    ChunkStreamer(uint32_t seed, const StreamerSettings &settings = StreamerSettings())
+        : settings(settings), radius(settings.radius), generator(seed, settings.threads) {}
+
+    ChunkStreamer(const ChunkStreamer &) = delete;
+    ChunkStreamer &operator=(const ChunkStreamer &) = delete;
+
+    // once per frame, with the position of the player
+    void update(const glm::vec3 &position) {
+        ChunkCoord center = chunkAt(position);
+        auto closer = [&](ChunkCoord a, ChunkCoord b) {
+            return glm::length(chunkCenter(a) - position) < glm::length(chunkCenter(b) - position);
+        };
+
+        // the generated chunks wait here until they are loaded, if they are still wanted
+        for (auto &chunk: generator.collect()) {
+            stats.generated++;
+            stats.generationMs += chunk->generationMs;
+            stats.maxGenerationMs = std::max(stats.maxGenerationMs, chunk->generationMs);
+            if (chunkDistance(chunk->coord, center) > radius) {
+                stats.discarded++;
+                continue;
+            }
+            ready[chunk->coord] = std::move(chunk);
+        }
+
+        // the nearest ready chunks are loaded
+        std::vector<ChunkCoord> order;
+        for (auto &entry: ready)
+            order.push_back(entry.first);
+        std::sort(order.begin(), order.end(), closer);
+        stats.loadMs = 0;
+        for (size_t i = 0; i < order.size() && i < settings.loadsPerFrame; i++) {
+            std::unique_ptr<Chunk> chunk = std::move(ready[order[i]]);
+            ready.erase(order[i]);
+            auto start = std::chrono::steady_clock::now();
+            if (onLoad)
+                onLoad(*chunk);
+            chunk->releaseMeshes();
+            stats.loadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                    .count();
+            stats.loaded++;
+            resident[chunk->coord] = std::move(chunk);
+        }
+        stats.maxLoadMs = std::max(stats.maxLoadMs, stats.loadMs);
+        stats.totalLoadMs += stats.loadMs;
+        stats.frames++;
+
+        // eviction: the chunks out of the radius (with a margin of a chunk, to avoid reloading the chunks along the
+        // border while the player walks on it), then the farthest ones until the memory is within the budget.
+        // Evicting for the budget also reduces the radius, which grows again when the next ring of chunks fits
+        for (auto it = resident.begin(); it != resident.end();) {
+            if (chunkDistance(it->first, center) > settings.radius + 1) {
+                evict(it->second);
+                it = resident.erase(it);
+                stats.evicted++;
+            } else {
+                ++it;
+            }
+        }
+        updateMemory();
+        while (stats.residentBytes > settings.memoryBudget) {
+            // the farthest chunk, loaded or not, except the ones next to the player
+            std::map<ChunkCoord, std::unique_ptr<Chunk> > *owner = nullptr;
+            ChunkCoord farthest{0, 0};
+            for (auto *chunks: {&ready, &resident}) {
+                for (auto &entry: *chunks) {
+                    if (chunkDistance(entry.first, center) > 1 && (owner == nullptr || closer(farthest, entry.first))) {
+                        farthest = entry.first;
+                        owner = chunks;
+                    }
+                }
+            }
+            if (owner == nullptr)
+                break;
+            radius = std::max(1, std::min(radius, chunkDistance(farthest, center) - 1));
+            if (owner == &resident) {
+                evict(resident[farthest]);
+                resident.erase(farthest);
+                stats.evictedForBudget++;
+            } else {
+                ready.erase(farthest);
+                stats.discarded++;
+            }
+            updateMemory();
+        }
+        for (auto it = ready.begin(); it != ready.end();) {
+            if (chunkDistance(it->first, center) > radius)
+                it = ready.erase(it);
+            else
+                ++it;
+        }
+        if (radius < settings.radius && !resident.empty()) {
+            size_t ring = 8 * static_cast<size_t>(radius + 1) * (stats.residentBytes / resident.size());
+            if (stats.residentBytes + ring <= settings.memoryBudget)
+                radius++;
+        }
+
+        // the chunks to generate, the nearest first
+        std::vector<ChunkCoord> wanted;
+        stats.missing = 0;
+        for (int dx = -radius; dx <= radius; dx++) {
+            for (int dz = -radius; dz <= radius; dz++) {
+                ChunkCoord coord{center.x + dx, center.z + dz};
+                if (resident.count(coord) > 0)
+                    continue;
+                if (chunkDistance(coord, center) <= 1)
+                    stats.missing++;
+                if (ready.count(coord) == 0)
+                    wanted.push_back(coord);
+            }
+        }
+        std::sort(wanted.begin(), wanted.end(), closer);
+        generator.schedule(wanted);
+        stats.peakResidentBytes = std::max(stats.peakResidentBytes, stats.residentBytes);
+    }
+
+    // updates until the chunks around the position are loaded (e.g., the floor under the player at the start)
+    void preload(const glm::vec3 &position) {
+        update(position);
+        while (stats.missing > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            update(position);
+        }
+    }
+
+    // the lights of the chunks around the position, the nearest first, in lights (which keeps its size, the number
+    // of lights of the shader): the lights beyond the ones of the chunks go far below the floor
+    void nearestLights(const glm::vec3 &position, std::vector<glm::vec3> &lights) {
+        ChunkCoord center = chunkAt(position);
+        candidates.clear();
+        for (auto &entry: resident)
+            if (chunkDistance(entry.first, center) <= 1)
+                candidates.insert(candidates.end(), entry.second->lights.begin(), entry.second->lights.end());
+        size_t count = std::min(lights.size(), candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                          [&](const glm::vec3 &a, const glm::vec3 &b) {
+                              glm::vec3 da = a - position, db = b - position;
+                              return glm::dot(da, da) < glm::dot(db, db);
+                          });
+        for (size_t i = 0; i < lights.size(); i++)
+            lights[i] = i < count ? candidates[i] : glm::vec3(position.x, -1000.0f, position.z);
+    }
+
+    // unloads all the chunks (e.g., before the physics world is deleted)
+    void clear() {
+        for (auto &entry: resident)
+            evict(entry.second);
+        resident.clear();
+        ready.clear();
+        updateMemory();
+    }
+
+    const std::map<ChunkCoord, std::unique_ptr<Chunk> > &residentChunks() const {
+        return resident;
+    }
+
+    // chunks waiting for a worker or being generated
+    size_t pending() {
+        return generator.pending();
+    }
+
+    // current radius, smaller than the one of the settings when the memory budget is exceeded
+    int currentRadius() const {
+        return radius;
+    }
+
+private:
+    StreamerSettings settings;
+    int radius;
+    std::map<ChunkCoord, std::unique_ptr<Chunk> > resident, ready;
+    // lights of nearestLights, kept to avoid allocations at each frame
+    std::vector<glm::vec3> candidates;
+    // last member: its threads are stopped before the chunks are deleted
+    ChunkGenerator generator;
+
+    void evict(std::unique_ptr<Chunk> &chunk) {
+        if (onUnload)
+            onUnload(*chunk);
+    }
+
+    void updateMemory() {
+        stats.residentBytes = 0;
+        for (auto &entry: resident)
+            stats.residentBytes += entry.second->bytes();
+        for (auto &entry: ready)
+            stats.residentBytes += entry.second->bytes();
+    }
+};
+#endif
@@ -0,0 +1,181 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+// suballocation of ranges of a large buffer (in elements, e.g. vertices or indices), without OpenGL: the GPU side
+// is in util3d/geometry_arena.h. The free space is a list of blocks sorted by offset, and a freed range is merged
+// with the free blocks around it. A range is placed in the smallest free block which can hold it; when none can,
+// the capacity grows (at least doubling) and the owner of the buffer must reallocate it, keeping the contents.
+// The ranges are found by id, so compact() can move them to the start of the buffer (the owner copies the data
+// with the moves returned) without changing what their users hold.
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <vector>
+
+typedef int RangeId;
+
+// a range moved by compact(): the owner of the buffer copies size elements from source to destination
+struct RangeMove {
+    size_t source, destination, size;
+};
+
+class RangeAllocator {
+public:
+    explicit RangeAllocator(size_t capacity = 0) {
+        grow(capacity);
+    }
+
+    // a new range of size elements (an empty range has offset 0 and takes no space)
+    RangeId allocate(size_t size) {
+        RangeId id;
+        if (freeIds.empty()) {
+            id = static_cast<RangeId>(ranges.size());
+            ranges.push_back(Range());
+        } else {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        Range &range = ranges[id];
+        range.offset = 0;
+        range.size = size;
+        range.live = true;
+        liveRanges++;
+        if (size == 0)
+            return id;
+
+        auto best = freeBlocks.end();
+        for (auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block)
+            if (block->second >= size && (best == freeBlocks.end() || block->second < best->second))
+                best = block;
+        if (best == freeBlocks.end()) {
+            grow(std::max(total * 2, total + size));
+            // the new space is merged with the free block at the end, if any
+            best = std::prev(freeBlocks.end());
+        }
+        range.offset = best->first;
+        size_t remaining = best->second - size;
+        freeBlocks.erase(best);
+        if (remaining > 0)
+            freeBlocks[range.offset + size] = remaining;
+        usedSize += size;
+        return id;
+    }
+
+    // the range goes back to the free space, merged with the free blocks before and after it
+    void free(RangeId id) {
+        Range &range = ranges[id];
+        if (!range.live)
+            return;
+        range.live = false;
+        liveRanges--;
+        freeIds.push_back(id);
+        if (range.size == 0)
+            return;
+        usedSize -= range.size;
+        addFreeBlock(range.offset, range.size);
+    }
+
+    // adds free space at the end of the buffer
+    void grow(size_t capacity) {
+        if (capacity <= total)
+            return;
+        addFreeBlock(total, capacity - total);
+        total = capacity;
+    }
+
+    // moves all the ranges to the start of the buffer, in the order of their offsets, so the free space is a single
+    // block at the end. The moves are returned in the same order (the destination is never after the source)
+    std::vector<RangeMove> compact() {
+        std::vector<RangeId> order;
+        for (RangeId id = 0; id < static_cast<RangeId>(ranges.size()); id++)
+            if (ranges[id].live && ranges[id].size > 0)
+                order.push_back(id);
+        std::sort(order.begin(), order.end(), [this](RangeId a, RangeId b) {
+            return ranges[a].offset < ranges[b].offset;
+        });
+        std::vector<RangeMove> moves;
+        size_t end = 0;
+        for (RangeId id: order) {
+            Range &range = ranges[id];
+            if (range.offset != end)
+                moves.push_back(RangeMove{range.offset, end, range.size});
+            range.offset = end;
+            end += range.size;
+        }
+        freeBlocks.clear();
+        if (end < total)
+            freeBlocks[end] = total - end;
+        return moves;
+    }
+
+    size_t offset(RangeId id) const {
+        return ranges[id].offset;
+    }
+
+    size_t size(RangeId id) const {
+        return ranges[id].size;
+    }
+
+    size_t capacity() const {
+        return total;
+    }
+
+    size_t used() const {
+        return usedSize;
+    }
+
+    size_t allocations() const {
+        return liveRanges;
+    }
+
+    size_t freeBlockCount() const {
+        return freeBlocks.size();
+    }
+
+    size_t largestFreeBlock() const {
+        size_t largest = 0;
+        for (auto &block: freeBlocks)
+            largest = std::max(largest, block.second);
+        return largest;
+    }
+
+    // fraction of the free space which is not in the largest free block: 0 when the free space is contiguous
+    float fragmentation() const {
+        size_t free = total - usedSize;
+        return free == 0 ? 0.0f : 1.0f - static_cast<float>(largestFreeBlock()) / static_cast<float>(free);
+    }
+
+    // the free blocks (offset -> size), e.g. to check them
+    const std::map<size_t, size_t> &freeList() const {
+        return freeBlocks;
+    }
+
+private:
+    struct Range {
+        size_t offset = 0, size = 0;
+        bool live = false;
+    };
+    std::vector<Range> ranges;
+    std::vector<RangeId> freeIds;
+    std::map<size_t, size_t> freeBlocks;
+    size_t total = 0, usedSize = 0, liveRanges = 0;
+
+    void addFreeBlock(size_t offset, size_t size) {
+        auto next = freeBlocks.lower_bound(offset);
+        if (next != freeBlocks.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                size += previous->second;
+                freeBlocks.erase(previous);
+            }
+        }
+        if (next != freeBlocks.end() && offset + size == next->first) {
+            size += next->second;
+            freeBlocks.erase(next);
+        }
+        freeBlocks[offset] = size;
+    }
+};
+#endif
@@ -0,0 +1,255 @@
+#ifndef RENDER_BENCHMARK_H
+#define RENDER_BENCHMARK_H
+
+// measurements of the render benchmark (work06b --render-benchmark), which renders the frames of a camera path with a
+// fixed time step (util3d/camera_path.h), in an offscreen context (util3d/offscreen_context.h):
+// - the draw calls: the draw functions loaded by glad are replaced with ones which count the call and then call the
+//   original (the functions of glad are global pointers, so the call sites do not change);
+// - the CPU and GPU time of each pass of the render graph: a GL_TIMESTAMP query and the time of the CPU at the start
+//   of each pass and after the last one, read PASS_TIMER_FRAMES frames later so that the CPU does not wait the GPU;
+// - a CSV with a row for each pass of each frame, and one for the whole frame.
+
+#include <glad/glad.h>
+
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+struct DrawCounts {
+    // draw commands, and meshes drawn (a multi-draw command draws several)
+    unsigned long long calls = 0, draws = 0;
+};
+
+DrawCounts &drawCounts() {
+    static DrawCounts counts;
+    return counts;
+}
+
+// the hook of a draw function: Id tells apart the functions with the same signature, Multi is true for the
+// multi-draw commands, whose 5th argument is the number of meshes
+template<int Id, bool Multi, typename Function>
+struct DrawHook;
+
+template<int Id, bool Multi, typename... Args>
+struct DrawHook<Id, Multi, void (APIENTRY *)(Args...)> {
+    typedef void (APIENTRY *Function)(Args...);
+
+    static Function &original() {
+        static Function function = nullptr;
+        return function;
+    }
+
+    static void APIENTRY call(Args... args) {
+        DrawCounts &counts = drawCounts();
+        counts.calls++;
+        if constexpr (Multi)
+            counts.draws += static_cast<unsigned long long>(std::get<4>(std::make_tuple(args...)));
+        else
+            counts.draws++;
+        original()(args...);
+    }
+
+    static void install(Function &loaded) {
+        if (loaded != nullptr && loaded != call) {
+            original() = loaded;
+            loaded = call;
+        }
+    }
+};
+
+// after gladLoadGLLoader: the draw functions used by the application count their calls in drawCounts()
+void installDrawCounter() {
+    DrawHook<0, false, decltype(glDrawArrays)>::install(glDrawArrays);
+    DrawHook<1, false, decltype(glDrawArraysInstanced)>::install(glDrawArraysInstanced);
+    DrawHook<2, false, decltype(glDrawElements)>::install(glDrawElements);
+    DrawHook<3, false, decltype(glDrawElementsBaseVertex)>::install(glDrawElementsBaseVertex);
+    DrawHook<4, true, decltype(glMultiDrawElementsBaseVertex)>::install(glMultiDrawElementsBaseVertex);
+}
+
+struct PassTiming {
+    std::string name;
+    double cpuMs = 0, gpuMs = 0;
+    DrawCounts draws;
+};
+
+struct FrameTiming {
+    unsigned int frame = 0;
+    // CPU time of the whole frame, and GPU time from the first pass to the end of the last one
+    double cpuMs = 0, gpuMs = 0;
+    std::vector<PassTiming> passes;
+};
+
+const unsigned int PASS_TIMER_FRAMES = 3;
+
+class PassTimer {
+public:
+    // the frames whose times were read, in order
+    std::deque<FrameTiming> ready;
+
+    PassTimer() = default;
+    PassTimer(const PassTimer &) = delete;
+    PassTimer &operator=(const PassTimer &) = delete;
+
+    // needs the context, as the other owners of OpenGL objects
+    ~PassTimer() {
+        for (Slot &slot: slots)
+            if (!slot.queries.empty())
+                glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+    }
+
+    // at the start of the frame: reads the frame which used the same queries, PASS_TIMER_FRAMES frames ago
+    void beginFrame(unsigned int frame) {
+        Slot &slot = slots[frame % PASS_TIMER_FRAMES];
+        collect(slot);
+        slot.frame = frame;
+        slot.start = std::chrono::steady_clock::now();
+        slot.names.clear();
+        slot.cpu.clear();
+        slot.draws.clear();
+        current = &slot;
+    }
+
+    // for executeRenderGraph: the start of a pass, or the end of the last one (empty name)
+    void mark(const std::string &name) {
+        if (current == nullptr)
+            return;
+        size_t index = current->names.size();
+        if (index == current->queries.size()) {
+            current->queries.push_back(0);
+            glGenQueries(1, &current->queries.back());
+        }
+        glQueryCounter(current->queries[index], GL_TIMESTAMP);
+        current->names.push_back(name);
+        current->cpu.push_back(std::chrono::steady_clock::now());
+        current->draws.push_back(drawCounts());
+    }
+
+    // at the end of the frame (after the swap)
+    void endFrame() {
+        if (current == nullptr)
+            return;
+        current->cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                   current->start).count();
+        current->pending = true;
+        current = nullptr;
+    }
+
+    // reads all the frames still pending (waits for the GPU)
+    void finish() {
+        unsigned int oldest = 0;
+        bool any = false;
+        for (Slot &slot: slots) {
+            if (slot.pending && (!any || slot.frame < oldest)) {
+                oldest = slot.frame;
+                any = true;
+            }
+        }
+        for (unsigned int f = 0; any && f < PASS_TIMER_FRAMES; f++)
+            collect(slots[(oldest + f) % PASS_TIMER_FRAMES]);
+    }
+
+private:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    struct Slot {
+        bool pending = false;
+        unsigned int frame = 0;
+        TimePoint start;
+        double cpuMs = 0;
+        std::vector<GLuint> queries;
+        std::vector<std::string> names;
+        std::vector<TimePoint> cpu;
+        std::vector<DrawCounts> draws;
+    };
+    Slot slots[PASS_TIMER_FRAMES];
+    Slot *current = nullptr;
+
+    void collect(Slot &slot) {
+        if (!slot.pending)
+            return;
+        slot.pending = false;
+        std::vector<GLuint64> gpu(slot.names.size());
+        for (size_t i = 0; i < gpu.size(); i++)
+            glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &gpu[i]);
+
+        FrameTiming timing;
+        timing.frame = slot.frame;
+        timing.cpuMs = slot.cpuMs;
+        for (size_t i = 0; i + 1 < slot.names.size(); i++) {
+            PassTiming pass;
+            pass.name = slot.names[i];
+            pass.cpuMs = std::chrono::duration<double, std::milli>(slot.cpu[i + 1] - slot.cpu[i]).count();
+            pass.gpuMs = (gpu[i + 1] - gpu[i]) / 1e6;
+            pass.draws.calls = slot.draws[i + 1].calls - slot.draws[i].calls;
+            pass.draws.draws = slot.draws[i + 1].draws - slot.draws[i].draws;
+            timing.passes.push_back(pass);
+        }
+        if (slot.names.size() > 1)
+            timing.gpuMs = (gpu.back() - gpu.front()) / 1e6;
+        ready.push_back(timing);
+    }
+};
+
+// the CSV of the benchmark (frame, pass, cpu_ms, gpu_ms, draw_calls, draws: the row of the whole frame has the pass
+// "frame"), and the statistics of each pass for the summary
+class RenderBenchmarkLog {
+public:
+    explicit RenderBenchmarkLog(std::ostream &csv) : csv(csv) {
+        csv << "frame,pass,cpu_ms,gpu_ms,draw_calls,draws" << std::endl;
+    }
+
+    void add(const FrameTiming &timing) {
+        DrawCounts total;
+        for (const PassTiming &pass: timing.passes) {
+            row(timing.frame, pass.name, pass.cpuMs, pass.gpuMs, pass.draws);
+            Stats &stats = passStats[pass.name];
+            stats.cpu.add(pass.cpuMs);
+            stats.gpu.add(pass.gpuMs);
+            stats.calls += pass.draws.calls;
+            total.calls += pass.draws.calls;
+            total.draws += pass.draws.draws;
+        }
+        row(timing.frame, "frame", timing.cpuMs, timing.gpuMs, total);
+        frameCpu.add(timing.cpuMs);
+        frameGpu.add(timing.gpuMs);
+        frameCalls += total.calls;
+    }
+
+    void summary(std::ostream &out) {
+        out << std::fixed << std::setprecision(3);
+        out << "  frame: cpu " << frameCpu.summary() << std::endl;
+        out << "         gpu " << frameGpu.summary() << std::endl;
+        out << "         " << (frameCpu.count() > 0 ? frameCalls / frameCpu.count() : 0) << " draw calls per frame"
+                << std::endl;
+        for (auto &pass: passStats)
+            out << "  " << std::left << std::setw(14) << pass.first << std::right << " cpu " << pass.second.cpu.mean()
+                    << " ms, gpu " << pass.second.gpu.mean() << " ms (p99 " << pass.second.gpu.percentile(0.99)
+                    << "), " << pass.second.calls / std::max<size_t>(pass.second.cpu.count(), 1) << " draw calls"
+                    << std::endl;
+        out << std::defaultfloat;
+    }
+
+private:
+    struct Stats {
+        FrameTimeStats cpu, gpu;
+        unsigned long long calls = 0;
+    };
+    std::ostream &csv;
+    std::map<std::string, Stats> passStats;
+    FrameTimeStats frameCpu, frameGpu;
+    unsigned long long frameCalls = 0;
+
+    void row(unsigned int frame, const std::string &pass, double cpuMs, double gpuMs, const DrawCounts &draws) {
+        csv << frame << "," << pass << "," << cpuMs << "," << gpuMs << "," << draws.calls << "," << draws.draws
+                << std::endl;
+    }
+};
+#endif
@@ -0,0 +1,286 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+// minimal render graph: at each frame the application declares its passes, with the render targets each one reads
+// and writes, and the graph checks the order of the passes, skips the ones whose results are never used, and
+// decides which targets can share the same memory.
+// The targets are transient: they exist only from the first to the last pass which uses them, so two targets with
+// the same size and format whose lifetimes do not overlap get the same slot (memory aliasing), and a slot becomes
+// a texture of the pool of util3d/render_targets.h only at execution. The graph itself does not use OpenGL, so it
+// can be checked headless (see the "graph" group of the benchmark).
+// Retained targets are the exception: they keep their content from one frame to the next (e.g., to show again the
+// last image drawn), so they get a slot of their own, and a pass can read them before any pass of the frame writes
+// them.
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum TargetFormat {
+    TARGET_RGBA16F,
+    TARGET_DEPTH24
+};
+
+struct TargetDesc {
+    TargetFormat format = TARGET_RGBA16F;
+    int width = 0, height = 0;
+
+    bool isDepth() const {
+        return format == TARGET_DEPTH24;
+    }
+
+    // bytes of the texture (a 24 bit depth takes 32 bits in memory)
+    size_t bytes() const {
+        return static_cast<size_t>(width) * height * (format == TARGET_RGBA16F ? 8 : 4);
+    }
+
+    bool operator==(const TargetDesc &other) const {
+        return format == other.format && width == other.width && height == other.height;
+    }
+};
+
+// index of a target in its graph
+typedef int RenderTarget;
+
+// what the passes get when they are executed: the textures of the targets, and framebuffers with the targets
+// attached. It is implemented with OpenGL objects by util3d/render_targets.h
+class RenderPassContext {
+public:
+    virtual ~RenderPassContext() {}
+
+    // called before each pass, with the targets it writes (e.g., to bind their framebuffer)
+    virtual void beginPass(const std::vector<RenderTarget> &writes) = 0;
+
+    virtual unsigned int texture(RenderTarget target) = 0;
+
+    // framebuffer with the color targets attached in order, and the depth target if any (0 for the backbuffer)
+    virtual unsigned int framebuffer(const std::vector<RenderTarget> &targets) = 0;
+
+    // called before each executed pass with its name, and after the last one with an empty name (e.g., to time the
+    // passes)
+    virtual void markPass(const std::string &name) {
+        (void) name;
+    }
+};
+
+class RenderGraph {
+public:
+    struct Target {
+        std::string name;
+        TargetDesc desc;
+        // imported targets (the backbuffer) are not allocated by the graph
+        bool imported = false;
+        bool retained = false;
+        // first and last pass using the target, and its slot (-1 if it is not used)
+        int first = -1, last = -1;
+        int slot = -1;
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<RenderTarget> reads, writes;
+        std::function<void(RenderPassContext &)> execute;
+        bool culled = false;
+    };
+
+    void reset() {
+        targetList.clear();
+        passList.clear();
+        slotList.clear();
+        slotRetained.clear();
+        errorMessage.clear();
+    }
+
+    RenderTarget create(const std::string &name, const TargetDesc &desc) {
+        Target target;
+        target.name = name;
+        target.desc = desc;
+        targetList.push_back(target);
+        return static_cast<RenderTarget>(targetList.size() - 1);
+    }
+
+    // target kept from frame to frame, found again by its name
+    RenderTarget retain(const std::string &name, const TargetDesc &desc) {
+        RenderTarget target = create(name, desc);
+        targetList[target].retained = true;
+        return target;
+    }
+
+    RenderTarget import(const std::string &name) {
+        Target target;
+        target.name = name;
+        target.imported = true;
+        targetList.push_back(target);
+        return static_cast<RenderTarget>(targetList.size() - 1);
+    }
+
+    // the passes are executed in the order they are added
+    void addPass(const std::string &name, const std::vector<RenderTarget> &reads,
+                 const std::vector<RenderTarget> &writes, const std::function<void(RenderPassContext &)> &execute) {
+        Pass pass;
+        pass.name = name;
+        pass.reads = reads;
+        pass.writes = writes;
+        pass.execute = execute;
+        passList.push_back(pass);
+    }
+
+    // culls the passes, checks that each target is written before it is read, and assigns the slots.
+    // Returns false (see error) if the passes are not in a valid order
+    bool compile() {
+        errorMessage.clear();
+        slotList.clear();
+        slotRetained.clear();
+        for (auto &target: targetList) {
+            target.first = target.last = -1;
+            target.slot = -1;
+        }
+
+        // a pass is needed if it writes an imported target, or a target read by a later pass which is needed
+        std::vector<bool> needed(targetList.size(), false);
+        for (size_t t = 0; t < targetList.size(); t++)
+            needed[t] = targetList[t].imported;
+        for (size_t p = passList.size(); p-- > 0;) {
+            Pass &pass = passList[p];
+            pass.culled = true;
+            for (RenderTarget target: pass.writes)
+                if (needed[target])
+                    pass.culled = false;
+            if (!pass.culled)
+                for (RenderTarget target: pass.reads)
+                    needed[target] = true;
+        }
+
+        std::vector<bool> written(targetList.size(), false);
+        for (size_t p = 0; p < passList.size(); p++) {
+            const Pass &pass = passList[p];
+            if (pass.culled)
+                continue;
+            for (RenderTarget target: pass.reads) {
+                if (!targetList[target].imported && !targetList[target].retained && !written[target]) {
+                    errorMessage = "pass '" + pass.name + "' reads '" + targetList[target].name +
+                                   "' before any pass writes it";
+                    return false;
+                }
+                use(target, static_cast<int>(p));
+            }
+            for (RenderTarget target: pass.writes) {
+                written[target] = true;
+                use(target, static_cast<int>(p));
+            }
+        }
+
+        // slots: in order of first use, each target takes the first compatible slot which is free by then (the
+        // retained targets take a new one, which no other target can take)
+        std::vector<RenderTarget> order;
+        for (size_t t = 0; t < targetList.size(); t++)
+            if (!targetList[t].imported && targetList[t].first >= 0)
+                order.push_back(static_cast<RenderTarget>(t));
+        std::stable_sort(order.begin(), order.end(), [&](RenderTarget a, RenderTarget b) {
+            return targetList[a].first < targetList[b].first;
+        });
+        std::vector<int> slotLast;
+        for (RenderTarget t: order) {
+            Target &target = targetList[t];
+            for (size_t s = 0; s < slotList.size() && target.slot < 0 && !target.retained; s++) {
+                if (slotRetained[s].empty() && slotList[s] == target.desc && slotLast[s] < target.first) {
+                    target.slot = static_cast<int>(s);
+                    slotLast[s] = target.last;
+                }
+            }
+            if (target.slot < 0) {
+                target.slot = static_cast<int>(slotList.size());
+                slotList.push_back(target.desc);
+                slotRetained.push_back(target.retained ? target.name : std::string());
+                slotLast.push_back(target.last);
+            }
+        }
+        return true;
+    }
+
+    // runs the passes which are not culled (after compile)
+    void execute(RenderPassContext &context) {
+        for (auto &pass: passList) {
+            if (pass.culled)
+                continue;
+            context.markPass(pass.name);
+            context.beginPass(pass.writes);
+            if (pass.execute)
+                pass.execute(context);
+        }
+        context.markPass(std::string());
+    }
+
+    const std::string &error() const {
+        return errorMessage;
+    }
+
+    const std::vector<Target> &targets() const {
+        return targetList;
+    }
+
+    const std::vector<Pass> &passes() const {
+        return passList;
+    }
+
+    // size and format of each slot, i.e. of each texture needed to execute the graph
+    const std::vector<TargetDesc> &slots() const {
+        return slotList;
+    }
+
+    // name of the retained target of a slot (empty for the slots of the transient targets)
+    const std::string &retainedName(size_t slot) const {
+        return slotRetained[slot];
+    }
+
+    // memory of the slots, and the memory the used targets would take without aliasing
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (auto &slot: slotList)
+            bytes += slot.bytes();
+        return bytes;
+    }
+
+    size_t unaliasedBytes() const {
+        size_t bytes = 0;
+        for (auto &target: targetList)
+            if (target.slot >= 0)
+                bytes += target.desc.bytes();
+        return bytes;
+    }
+
+    // passes and slots, for debugging
+    std::string describe() const {
+        std::ostringstream out;
+        for (auto &pass: passList)
+            out << (pass.culled ? "  (culled) " : "  ") << pass.name << std::endl;
+        for (size_t s = 0; s < slotList.size(); s++) {
+            out << "  slot " << s << " (" << slotList[s].width << "x" << slotList[s].height
+                    << (slotList[s].isDepth() ? " depth" : " rgba16f") << (slotRetained[s].empty() ? "" : ", retained")
+                    << "):";
+            for (auto &target: targetList)
+                if (target.slot == static_cast<int>(s))
+                    out << " " << target.name << " [" << target.first << "-" << target.last << "]";
+            out << std::endl;
+        }
+        return out.str();
+    }
+
+private:
+    std::vector<Target> targetList;
+    std::vector<Pass> passList;
+    std::vector<TargetDesc> slotList;
+    std::vector<std::string> slotRetained;
+    std::string errorMessage;
+
+    void use(RenderTarget t, int pass) {
+        Target &target = targetList[t];
+        if (target.first < 0)
+            target.first = pass;
+        target.last = std::max(target.last, pass);
+    }
+};
+#endif
@@ -0,0 +1,249 @@
+#ifndef RENDER_TARGETS_H
+#define RENDER_TARGETS_H
+
+// OpenGL side of the render graph (util3d/render_graph.h): a pool of textures for the slots of the graph, and the
+// framebuffers with them attached.
+// The textures are kept from frame to frame and given again to the slots with the same size and format, so the
+// graph can be declared again at each frame without allocating anything; the ones no slot asked for in the last
+// frames are deleted (e.g., the copy of the depth when the decals are off, or the old sizes after a resize).
+// The retained targets of the graph have textures of their own, found again by name, so what a frame writes in them
+// is still there in the next frames.
+
+#include <glad/glad.h>
+
+#include "render_graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class RenderTargetPool {
+public:
+    // frames a texture is kept without being used
+    static const unsigned int KEEP_FRAMES = 60;
+
+    // framebuffer of the imported targets: 0 for the window, the one of the offscreen context otherwise (see
+    // util3d/offscreen_context.h)
+    GLuint backbuffer = 0;
+
+    RenderTargetPool() = default;
+    RenderTargetPool(const RenderTargetPool &) = delete;
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+    // needs the context, as the other owners of OpenGL objects (see util3d/gl_handles.h)
+    ~RenderTargetPool() {
+        clear();
+    }
+
+    void beginFrame() {
+        frame++;
+        for (auto &texture: textures)
+            texture.taken = false;
+    }
+
+    // texture for a slot of this frame
+    GLuint acquire(const TargetDesc &desc) {
+        for (auto &texture: textures) {
+            if (!texture.taken && texture.retained.empty() && texture.desc == desc) {
+                texture.taken = true;
+                texture.lastUsed = frame;
+                return texture.id;
+            }
+        }
+        return create(desc, std::string());
+    }
+
+    // texture of a retained target, with what the last frames wrote in it (a new one if its size changed)
+    GLuint acquireRetained(const std::string &name, const TargetDesc &desc) {
+        for (size_t i = 0; i < textures.size(); i++) {
+            if (textures[i].retained != name)
+                continue;
+            if (textures[i].desc == desc) {
+                textures[i].taken = true;
+                textures[i].lastUsed = frame;
+                return textures[i].id;
+            }
+            release(textures[i].id);
+            textures.erase(textures.begin() + i);
+            break;
+        }
+        return create(desc, name);
+    }
+
+    // framebuffer with the given textures attached (colors in order, then the depth, or 0 for none). Creating a new
+    // one changes the framebuffer bound, so the passes bind the ones they need after asking for them
+    GLuint framebuffer(const std::vector<GLuint> &colors, GLuint depth) {
+        std::vector<GLuint> key = colors;
+        key.push_back(depth);
+        auto found = framebuffers.find(key);
+        if (found != framebuffers.end())
+            return found->second;
+
+        GLuint fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        std::vector<GLenum> attachments;
+        for (size_t i = 0; i < colors.size(); i++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i), GL_TEXTURE_2D,
+                                   colors[i], 0);
+            attachments.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+        }
+        if (depth != 0)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (attachments.empty()) {
+            // depth only (e.g., the destination of a blit)
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        } else {
+            glDrawBuffers(static_cast<GLsizei>(attachments.size()), attachments.data());
+        }
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Framebuffer not complete!" << std::endl;
+        framebuffers[key] = fbo;
+        return fbo;
+    }
+
+    // deletes the textures not used in the last frames, with their framebuffers
+    void endFrame() {
+        for (size_t i = textures.size(); i-- > 0;) {
+            if (frame - textures[i].lastUsed <= KEEP_FRAMES)
+                continue;
+            release(textures[i].id);
+            textures.erase(textures.begin() + i);
+        }
+    }
+
+    // deletes everything (e.g., when the window is resized, and before the context is destroyed)
+    void clear() {
+        for (auto &texture: textures)
+            glDeleteTextures(1, &texture.id);
+        textures.clear();
+        for (auto &framebuffer: framebuffers)
+            glDeleteFramebuffers(1, &framebuffer.second);
+        framebuffers.clear();
+    }
+
+    // memory of the textures of the pool
+    size_t allocatedBytes() const {
+        size_t bytes = 0;
+        for (auto &texture: textures)
+            bytes += texture.desc.bytes();
+        return bytes;
+    }
+
+private:
+    struct Texture {
+        TargetDesc desc;
+        GLuint id = 0;
+        unsigned int lastUsed = 0;
+        bool taken = false;
+        // name of the retained target, empty for the shared textures
+        std::string retained;
+    };
+    std::vector<Texture> textures;
+    std::map<std::vector<GLuint>, GLuint> framebuffers;
+    unsigned int frame = 0;
+
+    // new texture, taken for this frame
+    GLuint create(const TargetDesc &desc, const std::string &retained) {
+        Texture texture;
+        texture.desc = desc;
+        texture.retained = retained;
+        texture.lastUsed = frame;
+        texture.taken = true;
+        glGenTextures(1, &texture.id);
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        if (desc.isDepth()) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, desc.width, desc.height, 0, GL_DEPTH_COMPONENT,
+                         GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, desc.width, desc.height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        textures.push_back(texture);
+        return texture.id;
+    }
+
+    void release(GLuint id) {
+        for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+            if (std::find(it->first.begin(), it->first.end(), id) != it->first.end()) {
+                glDeleteFramebuffers(1, &it->second);
+                it = framebuffers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        glDeleteTextures(1, &id);
+    }
+};
+
+// the textures of the slots of a compiled graph, for its passes
+class PooledPassContext : public RenderPassContext {
+public:
+    // onPass (if given) is told the name of each pass before it runs, and an empty name after the last one
+    PooledPassContext(const RenderGraph &graph, RenderTargetPool &pool,
+                      std::function<void(const std::string &)> onPass = nullptr)
+        : graph(graph), pool(pool), onPass(std::move(onPass)) {
+        for (size_t s = 0; s < graph.slots().size(); s++) {
+            const std::string &retained = graph.retainedName(s);
+            slotTextures.push_back(retained.empty() ? pool.acquire(graph.slots()[s])
+                                                    : pool.acquireRetained(retained, graph.slots()[s]));
+        }
+    }
+
+    void beginPass(const std::vector<RenderTarget> &writes) override {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer(writes));
+    }
+
+    unsigned int texture(RenderTarget target) override {
+        int slot = graph.targets()[target].slot;
+        return slot >= 0 ? slotTextures[slot] : 0;
+    }
+
+    unsigned int framebuffer(const std::vector<RenderTarget> &targets) override {
+        std::vector<GLuint> colors;
+        GLuint depth = 0;
+        for (RenderTarget target: targets) {
+            const RenderGraph::Target &info = graph.targets()[target];
+            if (info.imported)
+                return pool.backbuffer;
+            if (info.desc.isDepth())
+                depth = texture(target);
+            else
+                colors.push_back(texture(target));
+        }
+        return pool.framebuffer(colors, depth);
+    }
+
+    void markPass(const std::string &name) override {
+        if (onPass)
+            onPass(name);
+    }
+
+private:
+    const RenderGraph &graph;
+    RenderTargetPool &pool;
+    std::function<void(const std::string &)> onPass;
+    std::vector<GLuint> slotTextures;
+};
+
+// executes a compiled graph with the textures of the pool
+void executeRenderGraph(RenderGraph &graph, RenderTargetPool &pool,
+                        std::function<void(const std::string &)> onPass = nullptr) {
+    pool.beginFrame();
+    PooledPassContext context(graph, pool, std::move(onPass));
+    graph.execute(context);
+    pool.endFrame();
+}
+#endif
@@ -0,0 +1,231 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+// shader programs built from the sources with a list of #defines (the variants of a shader), and kept on disk as
+// program binaries (glGetProgramBinary), so the next starts load them instead of compiling the sources again.
+// A binary is found by a hash of the sources, of the defines and of the driver (vendor, renderer and version
+// strings): when one of them changes the program is compiled again. If the driver does not accept a binary (or
+// supports no binary format at all), the program is compiled from the sources, as without the cache.
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// a linked program, used like the Shader class of the course utils
+class ShaderProgram {
+public:
+    GLuint Program = 0;
+
+    void Use() const {
+        glUseProgram(Program);
+    }
+
+    void Delete() {
+        glDeleteProgram(Program);
+        Program = 0;
+    }
+};
+
+// 64 bit FNV-1a, enough to tell the versions of the sources apart
+uint64_t hashShaderSource(const std::string &text, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c: text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class ShaderCache {
+public:
+    // counters since the creation of the cache
+    unsigned int loadedBinaries = 0, compiledPrograms = 0;
+    double totalMs = 0;
+
+    // needs the OpenGL context, for the driver strings
+    explicit ShaderCache(const std::string &directory) : directory(directory) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binaries = formats > 0;
+        for (GLenum name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const GLubyte *value = glGetString(name);
+            driver += value ? reinterpret_cast<const char *>(value) : "";
+            driver += "\n";
+        }
+        if (binaries) {
+            std::error_code error;
+            std::filesystem::create_directories(directory, error);
+        }
+    }
+
+    // program of the two shaders, with a "#define name" for each of the defines
+    ShaderProgram load(const std::string &vertexPath, const std::string &fragmentPath,
+                       const std::vector<std::string> &defines = {}) {
+        auto start = std::chrono::steady_clock::now();
+        std::string vertexSource = withDefines(readFile(vertexPath), defines);
+        std::string fragmentSource = withDefines(readFile(fragmentPath), defines);
+        uint64_t hash = hashShaderSource(driver);
+        hash = hashShaderSource(vertexSource, hash);
+        hash = hashShaderSource(fragmentSource, hash);
+        std::ostringstream name;
+        name << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+
+        ShaderProgram shader;
+        if (binaries)
+            shader.Program = loadBinary(name.str());
+        if (shader.Program != 0) {
+            loadedBinaries++;
+        } else {
+            shader.Program = compile(vertexPath, vertexSource, fragmentPath, fragmentSource);
+            compiledPrograms++;
+            if (binaries && shader.Program != 0)
+                saveBinary(shader.Program, name.str());
+        }
+        totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return shader;
+    }
+
+private:
+    std::string directory, driver;
+    bool binaries = false;
+
+    static std::string readFile(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            std::cout << "shader not found: " << path << std::endl;
+        std::stringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    // the defines go after the #version line, followed by a #line so the errors keep the lines of the file
+    static std::string withDefines(const std::string &source, const std::vector<std::string> &defines) {
+        if (defines.empty())
+            return source;
+        size_t version = source.find("#version");
+        size_t insert = version == std::string::npos ? 0 : source.find('\n', version);
+        insert = insert == std::string::npos ? source.size() : insert + 1;
+        int line = 1;
+        for (size_t i = 0; i < insert; i++)
+            line += source[i] == '\n';
+        std::string text;
+        for (auto &define: defines)
+            text += "#define " + define + "\n";
+        text += "#line " + std::to_string(line) + "\n";
+        return source.substr(0, insert) + text + source.substr(insert);
+    }
+
+    static GLuint compileShader(GLenum type, const std::string &path, const std::string &source) {
+        GLuint shader = glCreateShader(type);
+        const char *text = source.c_str();
+        glShaderSource(shader, 1, &text, NULL);
+        glCompileShader(shader);
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            GLchar log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            std::cout << "| ERROR::::SHADER-COMPILATION-ERROR of " << path << "\n" << log << std::endl;
+        }
+        return shader;
+    }
+
+    GLuint compile(const std::string &vertexPath, const std::string &vertexSource, const std::string &fragmentPath,
+                   const std::string &fragmentSource) const {
+        GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexPath, vertexSource);
+        GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentPath, fragmentSource);
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        if (binaries)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            GLchar log[1024];
+            glGetProgramInfoLog(program, sizeof(log), NULL, log);
+            std::cout << "| ERROR::::PROGRAM-LINKING-ERROR of " << vertexPath << ", " << fragmentPath << "\n" << log
+                    << std::endl;
+        }
+        glDetachShader(program, vertex);
+        glDetachShader(program, fragment);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return program;
+    }
+
+    // file: binary format (GLenum), then the binary
+    static GLuint loadBinary(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return 0;
+        GLenum format = 0;
+        file.read(reinterpret_cast<char *>(&format), sizeof(format));
+        if (!file)
+            return 0;
+        std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (binary.empty())
+            return 0;
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            // e.g., a driver update which kept the same version string
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    static void saveBinary(GLuint program, const std::string &path) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, NULL, &format, binary.data());
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+        file.write(binary.data(), binary.size());
+    }
+};
+
+// the variants of a shader for each combination of some features: the variant with index i has the defines of
+// the features whose bit is set in i (after the defines common to all the variants)
+class ShaderVariants {
+public:
+    void load(ShaderCache &cache, const std::string &vertexPath, const std::string &fragmentPath,
+              const std::vector<std::string> &common, const std::vector<std::string> &features) {
+        programs.clear();
+        for (unsigned int i = 0; i < (1u << features.size()); i++) {
+            std::vector<std::string> defines = common;
+            for (size_t f = 0; f < features.size(); f++)
+                if (i & (1u << f))
+                    defines.push_back(features[f]);
+            programs.push_back(cache.load(vertexPath, fragmentPath, defines));
+        }
+    }
+
+    ShaderProgram &operator[](unsigned int variant) {
+        return programs[variant];
+    }
+
+    // e.g., to set the uniforms which do not change on all the variants
+    std::vector<ShaderProgram> programs;
+
+    void Delete() {
+        for (auto &program: programs)
+            program.Delete();
+    }
+};
+#endif
@@ -0,0 +1,289 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+// mesh simplification with quadric error metrics (Garland and Heckbert), used to generate the levels of detail of
+// the small models drawn many times (bullets and splats, see util3d/lod.h).
+// The vertices of a triangle list are welded by position, then the edges are collapsed in order of increasing
+// error until the target number of triangles is reached. The collapses are "half-edge" collapses: a vertex is
+// always moved onto one of its neighbours, so the simplified mesh only uses the original vertices and its
+// triangles are a new index list for the same vertex buffer (no new vertices, normals or texture coordinates).
+// Where the welded vertices have different normals (hard edges, seams), the corners moved onto a vertex take the
+// original vertex of that position with the closest normal.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <vector>
+
+// symmetric 4x4 matrix of a quadric, sum of the squared distances from a set of planes
+struct Quadric {
+    double a[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    // sum of the weights of the planes
+    double weight = 0;
+
+    // plane n.p + d = 0, with weight w
+    static Quadric fromPlane(const glm::dvec3 &n, double d, double w) {
+        Quadric q;
+        q.a[0] = w * n.x * n.x; q.a[1] = w * n.x * n.y; q.a[2] = w * n.x * n.z; q.a[3] = w * n.x * d;
+        q.a[4] = w * n.y * n.y; q.a[5] = w * n.y * n.z; q.a[6] = w * n.y * d;
+        q.a[7] = w * n.z * n.z; q.a[8] = w * n.z * d;
+        q.a[9] = w * d * d;
+        q.weight = w;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &other) {
+        for (int i = 0; i < 10; i++)
+            a[i] += other.a[i];
+        weight += other.weight;
+        return *this;
+    }
+
+    double error(const glm::dvec3 &p) const {
+        return a[0] * p.x * p.x + 2 * a[1] * p.x * p.y + 2 * a[2] * p.x * p.z + 2 * a[3] * p.x
+               + a[4] * p.y * p.y + 2 * a[5] * p.y * p.z + 2 * a[6] * p.y
+               + a[7] * p.z * p.z + 2 * a[8] * p.z + a[9];
+    }
+
+    // root mean square distance from the planes
+    double distance(const glm::dvec3 &p) const {
+        return weight > 0 ? std::sqrt(std::max(error(p), 0.0) / weight) : 0.0;
+    }
+};
+
+struct SimplifyResult {
+    // triangles of the simplified mesh, indexing the original vertices
+    std::vector<unsigned int> indices;
+    // largest error of the collapses, as a distance (RMS distance of the moved vertex from its planes)
+    float error = 0.0f;
+};
+
+// simplifies a triangle list down to targetTriangles triangles (or less, if the removed triangles are degenerate),
+// stopping earlier if a collapse would move the surface more than maxError. The normals are optional (one per
+// vertex, or empty)
+SimplifyResult simplifyMesh(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals,
+                            const std::vector<unsigned int> &indices, size_t targetTriangles,
+                            float maxError = FLT_MAX) {
+    // weld the vertices with the same position
+    std::vector<unsigned int> welded(positions.size());
+    std::vector<glm::dvec3> points;
+    std::vector<std::vector<unsigned int> > originals;
+    {
+        std::map<std::tuple<float, float, float>, unsigned int> unique;
+        for (unsigned int v = 0; v < positions.size(); v++) {
+            auto key = std::make_tuple(positions[v].x, positions[v].y, positions[v].z);
+            auto found = unique.find(key);
+            if (found == unique.end()) {
+                found = unique.insert({key, static_cast<unsigned int>(points.size())}).first;
+                points.push_back(glm::dvec3(positions[v]));
+                originals.push_back(std::vector<unsigned int>());
+            }
+            welded[v] = found->second;
+            originals[found->second].push_back(v);
+        }
+    }
+
+    // triangles: welded vertices, and original vertex of each corner (for the attributes)
+    struct Triangle {
+        unsigned int v[3];
+        unsigned int corner[3];
+        bool removed = false;
+    };
+    std::vector<Triangle> triangles;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        Triangle t;
+        for (int k = 0; k < 3; k++) {
+            t.corner[k] = indices[i + k];
+            t.v[k] = welded[indices[i + k]];
+        }
+        if (t.v[0] != t.v[1] && t.v[1] != t.v[2] && t.v[2] != t.v[0])
+            triangles.push_back(t);
+    }
+    std::vector<std::vector<unsigned int> > vertexTriangles(points.size());
+    for (unsigned int t = 0; t < triangles.size(); t++)
+        for (int k = 0; k < 3; k++)
+            vertexTriangles[triangles[t].v[k]].push_back(t);
+
+    auto triangleNormal = [&](const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c) {
+        return glm::cross(b - a, c - a);
+    };
+
+    // quadrics of the planes of the triangles (weighted by area), plus planes perpendicular to the border edges,
+    // so that the open borders keep their shape
+    std::vector<Quadric> quadrics(points.size());
+    std::map<std::pair<unsigned int, unsigned int>, int> edgeUses;
+    for (auto &t: triangles) {
+        glm::dvec3 n = triangleNormal(points[t.v[0]], points[t.v[1]], points[t.v[2]]);
+        double length = glm::length(n);
+        if (length <= 0.0)
+            continue;
+        n /= length;
+        Quadric q = Quadric::fromPlane(n, -glm::dot(n, points[t.v[0]]), length * 0.5);
+        for (int k = 0; k < 3; k++) {
+            quadrics[t.v[k]] += q;
+            unsigned int a = t.v[k], b = t.v[(k + 1) % 3];
+            edgeUses[{std::min(a, b), std::max(a, b)}]++;
+        }
+    }
+    for (auto &t: triangles) {
+        glm::dvec3 n = triangleNormal(points[t.v[0]], points[t.v[1]], points[t.v[2]]);
+        if (glm::length(n) <= 0.0)
+            continue;
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = t.v[k], b = t.v[(k + 1) % 3];
+            if (edgeUses[{std::min(a, b), std::max(a, b)}] != 1)
+                continue;
+            glm::dvec3 edge = points[b] - points[a];
+            glm::dvec3 side = glm::cross(edge, n);
+            double length = glm::length(side);
+            if (length <= 0.0)
+                continue;
+            side /= length;
+            Quadric q = Quadric::fromPlane(side, -glm::dot(side, points[a]), glm::dot(edge, edge) * 10.0);
+            quadrics[a] += q;
+            quadrics[b] += q;
+        }
+    }
+
+    // candidate collapses (from -> to), invalidated when the version of one of the vertices changes. They are sorted
+    // by the quadric error, which is weighted by area (small triangles go first), but maxError is a distance
+    struct Collapse {
+        double error, distance;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+        bool operator>(const Collapse &other) const {
+            return error > other.error;
+        }
+    };
+    std::vector<unsigned int> versions(points.size(), 0);
+    std::vector<bool> removedVertices(points.size(), false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > queue;
+    auto pushCollapses = [&](unsigned int a, unsigned int b) {
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+        queue.push({std::max(q.error(points[b]), 0.0), q.distance(points[b]), a, b, versions[a], versions[b]});
+        queue.push({std::max(q.error(points[a]), 0.0), q.distance(points[a]), b, a, versions[b], versions[a]});
+    };
+    for (auto &edge: edgeUses)
+        pushCollapses(edge.first.first, edge.first.second);
+
+    auto neighbours = [&](unsigned int v) {
+        std::vector<unsigned int> result;
+        for (unsigned int t: vertexTriangles[v])
+            for (int k = 0; k < 3; k++)
+                if (triangles[t].v[k] != v)
+                    result.push_back(triangles[t].v[k]);
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    };
+
+    // original vertex of the welded vertex "to" closest to the attributes of the original vertex "corner"
+    auto matchCorner = [&](unsigned int corner, unsigned int to) {
+        const std::vector<unsigned int> &candidates = originals[to];
+        if (normals.empty())
+            return candidates[0];
+        unsigned int best = candidates[0];
+        float bestDot = -FLT_MAX;
+        for (unsigned int candidate: candidates) {
+            float d = glm::dot(normals[candidate], normals[corner]);
+            if (d > bestDot) {
+                bestDot = d;
+                best = candidate;
+            }
+        }
+        return best;
+    };
+
+    size_t liveTriangles = triangles.size();
+    SimplifyResult result;
+    while (liveTriangles > targetTriangles && !queue.empty()) {
+        Collapse collapse = queue.top();
+        queue.pop();
+        unsigned int from = collapse.from, to = collapse.to;
+        if (removedVertices[from] || removedVertices[to] || versions[from] != collapse.fromVersion ||
+            versions[to] != collapse.toVersion)
+            continue;
+        if (collapse.distance > maxError)
+            continue;
+
+        // link condition: the two vertices can share only the vertices opposite to their edge,
+        // otherwise the collapse pinches the surface
+        std::vector<unsigned int> fromNeighbours = neighbours(from), toNeighbours = neighbours(to);
+        std::vector<unsigned int> shared;
+        std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(),
+                              std::back_inserter(shared));
+        size_t edgeTriangles = 0;
+        for (unsigned int t: vertexTriangles[from])
+            for (int k = 0; k < 3; k++)
+                edgeTriangles += triangles[t].v[k] == to;
+        if (edgeTriangles == 0 || shared.size() > edgeTriangles)
+            continue;
+
+        // the triangles which are kept must not flip or become degenerate
+        bool valid = true;
+        for (unsigned int t: vertexTriangles[from]) {
+            const Triangle &triangle = triangles[t];
+            if (triangle.v[0] == to || triangle.v[1] == to || triangle.v[2] == to)
+                continue;
+            glm::dvec3 before[3], after[3];
+            for (int k = 0; k < 3; k++) {
+                before[k] = points[triangle.v[k]];
+                after[k] = triangle.v[k] == from ? points[to] : before[k];
+            }
+            glm::dvec3 n0 = triangleNormal(before[0], before[1], before[2]);
+            glm::dvec3 n1 = triangleNormal(after[0], after[1], after[2]);
+            double l0 = glm::length(n0), l1 = glm::length(n1);
+            if (l1 <= 1e-12 * glm::dot(before[1] - before[0], before[1] - before[0]) ||
+                glm::dot(n0, n1) < 0.2 * l0 * l1) {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid)
+            continue;
+
+        // collapse: the triangles of the edge are removed, the others are moved to "to"
+        for (unsigned int t: vertexTriangles[from]) {
+            Triangle &triangle = triangles[t];
+            if (triangle.v[0] == to || triangle.v[1] == to || triangle.v[2] == to) {
+                triangle.removed = true;
+                liveTriangles--;
+                for (int k = 0; k < 3; k++) {
+                    if (triangle.v[k] == from)
+                        continue;
+                    auto &list = vertexTriangles[triangle.v[k]];
+                    list.erase(std::remove(list.begin(), list.end(), t), list.end());
+                }
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (triangle.v[k] == from) {
+                    triangle.v[k] = to;
+                    triangle.corner[k] = matchCorner(triangle.corner[k], to);
+                }
+            }
+            vertexTriangles[to].push_back(t);
+        }
+        vertexTriangles[from].clear();
+        removedVertices[from] = true;
+        quadrics[to] += quadrics[from];
+        result.error = std::max(result.error, static_cast<float>(collapse.distance));
+
+        versions[to]++;
+        for (unsigned int neighbour: neighbours(to))
+            pushCollapses(to, neighbour);
+    }
+
+    for (auto &triangle: triangles)
+        if (!triangle.removed)
+            result.indices.insert(result.indices.end(), triangle.corner, triangle.corner + 3);
+    return result;
+}
+#endif
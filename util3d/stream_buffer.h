@@ -0,0 +1,233 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+// ring buffer for the data written at each frame (uniform blocks, instance data): the buffer has a region for each
+// of the frames in flight, and at each frame the data goes to the next region, so the CPU never writes what the GPU
+// may still be reading.
+// With GL_ARB_buffer_storage (core in 4.4) the buffer is mapped once, persistent and coherent, and a fence after the
+// draws of a frame tells when its region can be written again: beginFrame waits for it (a stall, counted, if the
+// GPU is more than the frames in flight behind). On a 4.1 context without the extension the data is written in
+// memory and copied with an unsynchronized map of the region at flush(); when the ring goes back to the first
+// region the buffer is orphaned (glBufferData with NULL), so the driver gives new memory instead of waiting.
+// The data must be flushed before the draws which read it (nothing to do with the persistent mapping).
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// from GL_ARB_buffer_storage, missing from a 4.1 loader
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+enum StreamMode {
+    // persistent mapping if the context supports it, otherwise orphaning
+    STREAM_AUTO,
+    STREAM_PERSISTENT,
+    STREAM_ORPHANING,
+};
+
+// a part of the region of the current frame: data is where to write (null if the region is full), offset is the
+// position in the buffer (for glBindBufferRange, or the attribute pointers)
+struct StreamRange {
+    void *data = nullptr;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+};
+
+class StreamBuffer {
+public:
+    // counters since the creation of the buffer
+    unsigned int frames = 0, stalls = 0, orphans = 0, overflows = 0;
+    double stallMs = 0;
+    size_t bytesWritten = 0;
+
+    // regionBytes for each frame; load gets the functions of the extension (e.g., glfwGetProcAddress)
+    StreamBuffer(GLenum target, size_t regionBytes, unsigned int framesInFlight, GLADloadproc load,
+                 StreamMode mode = STREAM_AUTO)
+        : target(target), regionBytes(regionBytes), regions(std::max(framesInFlight, 1u)),
+          fences(regions, nullptr) {
+        typedef void (*BufferStorageProc)(GLenum, GLsizeiptr, const void *, GLbitfield);
+        BufferStorageProc bufferStorage = nullptr;
+        if (mode != STREAM_ORPHANING && load != nullptr && bufferStorageSupported())
+            bufferStorage = reinterpret_cast<BufferStorageProc>(load("glBufferStorage"));
+
+        glGenBuffers(1, &name);
+        glBindBuffer(target, name);
+        if (bufferStorage != nullptr) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(target, static_cast<GLsizeiptr>(capacity()), NULL, flags);
+            mapped = static_cast<char *>(glMapBufferRange(target, 0, static_cast<GLsizeiptr>(capacity()), flags));
+        }
+        if (mapped == nullptr) {
+            // also when the persistent mapping fails: the storage of glBufferStorage cannot be respecified
+            if (bufferStorage != nullptr) {
+                glDeleteBuffers(1, &name);
+                glGenBuffers(1, &name);
+                glBindBuffer(target, name);
+            }
+            glBufferData(target, static_cast<GLsizeiptr>(capacity()), NULL, GL_STREAM_DRAW);
+            staging.resize(regionBytes);
+        }
+        glBindBuffer(target, 0);
+        // the first beginFrame goes to region 0
+        region = regions - 1;
+    }
+
+    ~StreamBuffer() {
+        for (auto &fence: fences)
+            if (fence != nullptr)
+                glDeleteSync(fence);
+        if (mapped != nullptr) {
+            glBindBuffer(target, name);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+        glDeleteBuffers(1, &name);
+    }
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    // moves to the region of the next frame, waiting for the GPU if it still reads it
+    void beginFrame() {
+        region = (region + 1) % regions;
+        cursor = 0;
+        pendingBegin = pendingEnd = 0;
+        frames++;
+        if (mapped != nullptr) {
+            GLsync &fence = fences[region];
+            if (fence != nullptr) {
+                GLenum status = glClientWaitSync(fence, 0, 0);
+                if (status == GL_TIMEOUT_EXPIRED) {
+                    stalls++;
+                    auto start = std::chrono::steady_clock::now();
+                    while (status == GL_TIMEOUT_EXPIRED)
+                        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+                    stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                            .count();
+                }
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        } else if (region == 0) {
+            glBindBuffer(target, name);
+            glBufferData(target, static_cast<GLsizeiptr>(capacity()), NULL, GL_STREAM_DRAW);
+            glBindBuffer(target, 0);
+            orphans++;
+        }
+    }
+
+    // space for bytes in the region of the frame, at an offset multiple of alignment (see uniformAlignment)
+    StreamRange allocate(size_t bytes, size_t alignment = 1) {
+        StreamRange range;
+        size_t start = (cursor + alignment - 1) / alignment * alignment;
+        if (start + bytes > regionBytes) {
+            overflows++;
+            return range;
+        }
+        cursor = start + bytes;
+        range.offset = static_cast<GLintptr>(region * regionBytes + start);
+        range.size = static_cast<GLsizeiptr>(bytes);
+        if (mapped != nullptr) {
+            range.data = mapped + range.offset;
+        } else {
+            range.data = staging.data() + start;
+            if (pendingBegin == pendingEnd)
+                pendingBegin = start;
+            pendingEnd = cursor;
+        }
+        bytesWritten += bytes;
+        return range;
+    }
+
+    // copy of an object in the region (e.g., a std140 block)
+    template<typename T>
+    StreamRange push(const T &value, size_t alignment = 1) {
+        StreamRange range = allocate(sizeof(T), alignment);
+        if (range.data != nullptr)
+            std::memcpy(range.data, &value, sizeof(T));
+        return range;
+    }
+
+    // makes the data allocated so far visible to the next draws
+    void flush() {
+        if (mapped != nullptr || pendingBegin == pendingEnd)
+            return;
+        glBindBuffer(target, name);
+        void *destination = glMapBufferRange(target, static_cast<GLintptr>(region * regionBytes + pendingBegin),
+                                             static_cast<GLsizeiptr>(pendingEnd - pendingBegin),
+                                             GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                             GL_MAP_INVALIDATE_RANGE_BIT);
+        if (destination != nullptr) {
+            std::memcpy(destination, staging.data() + pendingBegin, pendingEnd - pendingBegin);
+            glUnmapBuffer(target);
+        }
+        glBindBuffer(target, 0);
+        pendingBegin = pendingEnd;
+    }
+
+    // after the last draw which reads the region of the frame
+    void endFrame() {
+        flush();
+        if (mapped != nullptr)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLuint buffer() const {
+        return name;
+    }
+
+    bool persistent() const {
+        return mapped != nullptr;
+    }
+
+    size_t capacity() const {
+        return regionBytes * regions;
+    }
+
+    // alignment of the offsets of glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+    static size_t uniformAlignment() {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return static_cast<size_t>(std::max(alignment, 1));
+    }
+
+    static bool bufferStorageSupported() {
+        GLint major = 0, minor = 0, extensions = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 4))
+            return true;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+        for (GLint i = 0; i < extensions; i++) {
+            const GLubyte *extension = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i));
+            if (extension != nullptr && std::string(reinterpret_cast<const char *>(extension)) ==
+                                        "GL_ARB_buffer_storage")
+                return true;
+        }
+        return false;
+    }
+
+private:
+    GLenum target;
+    GLuint name = 0;
+    size_t regionBytes;
+    unsigned int regions, region;
+    std::vector<GLsync> fences;
+    char *mapped = nullptr;
+    // the orphaning fallback: the data of the frame, and the part of it not flushed yet
+    std::vector<char> staging;
+    size_t cursor = 0, pendingBegin = 0, pendingEnd = 0;
+};
+#endif
@@ -0,0 +1,166 @@
+#ifndef UPLOAD_BENCHMARK_H
+#define UPLOAD_BENCHMARK_H
+
+// throughput of the uploads of the data of each frame, with glBufferSubData on a single buffer (which the driver
+// must copy, or wait for, while the previous frames still read it) and with the ring buffer of
+// util3d/stream_buffer.h (persistent mapping when available, and orphaning). Each frame writes the payload, binds
+// it as a uniform block and draws a small quad which reads it, so the GPU really uses the data of each frame.
+// Needs an OpenGL context (run with work06b --upload-benchmark).
+
+#include <glad/glad.h>
+
+#include "stream_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct UploadResult {
+    std::string method;
+    size_t payload = 0;
+    int frames = 0;
+    // time of the uploads on the CPU, and of all the frames until the GPU is done
+    double uploadMs = 0, totalMs = 0;
+    // glBufferSubData calls slower than UPLOAD_STALL_MS, or waits on the fences of the ring
+    unsigned int stalls = 0;
+};
+
+const double UPLOAD_STALL_MS = 0.5;
+
+// the quad reads a few values of the block (a uniform block can be at most 16 KB in every implementation). The
+// block has the size of the range bound, the payload up to 16 KB: GL leaves the values read undefined when the range
+// is smaller than the block
+const size_t UPLOAD_BLOCK_BYTES = 16 * 1024;
+
+GLuint compileUploadProgram(size_t blockBytes) {
+    const char *vertex = "#version 410 core\n"
+            "void main() { vec2 p = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;"
+            " gl_Position = vec4(p, 0.0, 1.0); }\n";
+    std::string fragment = "#version 410 core\n"
+            "#define VALUES " + std::to_string(std::max<size_t>(blockBytes / 16, 1)) + "\n"
+            "layout (std140) uniform Payload { vec4 values[VALUES]; };\n"
+            "out vec4 color;\n"
+            "void main() { vec4 sum = vec4(0.0);"
+            " for (int i = 0; i < 64; i++) sum += values[(int(gl_FragCoord.x) * 64 + i) % VALUES];"
+            " color = sum; }\n";
+    GLuint program = glCreateProgram();
+    for (GLenum type: {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER}) {
+        GLuint shader = glCreateShader(type);
+        const char *source = type == GL_VERTEX_SHADER ? vertex : fragment.c_str();
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Payload"), 0);
+    return program;
+}
+
+// mode: -1 for glBufferSubData, otherwise the StreamMode of the ring
+UploadResult runUploadBenchmark(int mode, size_t payload, int frames, GLADloadproc load) {
+    UploadResult result;
+    result.payload = payload;
+    result.frames = frames;
+    std::vector<char> data(payload);
+    for (size_t i = 0; i < payload; i++)
+        data[i] = static_cast<char>(i * 7);
+    size_t bound = std::min(payload, UPLOAD_BLOCK_BYTES);
+
+    GLuint program = compileUploadProgram(bound);
+    GLuint vao, framebuffer, color;
+    glGenVertexArrays(1, &vao);
+    glGenTextures(1, &color);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 256, 256, 0, GL_RGBA, GL_FLOAT, NULL);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glViewport(0, 0, 256, 256);
+    glUseProgram(program);
+    glBindVertexArray(vao);
+
+    GLuint single = 0;
+    StreamBuffer *ring = nullptr;
+    if (mode < 0) {
+        result.method = "glBufferSubData";
+        glGenBuffers(1, &single);
+        glBindBuffer(GL_UNIFORM_BUFFER, single);
+        glBufferData(GL_UNIFORM_BUFFER, payload, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    } else {
+        size_t alignment = StreamBuffer::uniformAlignment();
+        ring = new StreamBuffer(GL_UNIFORM_BUFFER, (payload + alignment - 1) / alignment * alignment, 3, load,
+                                static_cast<StreamMode>(mode));
+        result.method = ring->persistent() ? "ring, persistent" : "ring, orphaning";
+    }
+
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        auto uploadStart = std::chrono::steady_clock::now();
+        if (ring == nullptr) {
+            glBindBuffer(GL_UNIFORM_BUFFER, single);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, payload, data.data());
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glBindBufferRange(GL_UNIFORM_BUFFER, 0, single, 0, bound);
+        } else {
+            ring->beginFrame();
+            StreamRange range = ring->allocate(payload, StreamBuffer::uniformAlignment());
+            std::memcpy(range.data, data.data(), payload);
+            ring->flush();
+            glBindBufferRange(GL_UNIFORM_BUFFER, 0, ring->buffer(), range.offset, bound);
+        }
+        double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart)
+                .count();
+        result.uploadMs += uploadMs;
+        if (ring == nullptr && uploadMs > UPLOAD_STALL_MS)
+            result.stalls++;
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        if (ring != nullptr)
+            ring->endFrame();
+        glFlush();
+    }
+    glFinish();
+    result.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (ring != nullptr) {
+        result.stalls = ring->stalls;
+        delete ring;
+    }
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteBuffers(1, &single);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &color);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+    return result;
+}
+
+void printUploadResult(const UploadResult &result) {
+    double megabytes = static_cast<double>(result.payload) * result.frames / (1024.0 * 1024.0);
+    std::cout << std::left << std::setw(18) << result.method << std::right << std::setw(9) << result.payload
+            << " bytes" << std::fixed << std::setprecision(3) << std::setw(10)
+            << result.uploadMs * 1000.0 / result.frames << " us upload" << std::setw(10)
+            << result.totalMs / result.frames << " ms/frame" << std::setw(11) << std::setprecision(1)
+            << megabytes / (result.uploadMs / 1000.0) << " MB/s" << std::setw(6) << result.stalls << " stalls"
+            << std::defaultfloat << std::endl;
+}
+
+// all the methods with payloads from a uniform block of lights to a large batch of instance data
+void benchUploads(GLADloadproc load, int frames = 300) {
+    std::cout << "frame data uploads, " << frames << " frames each (stall: upload over " << UPLOAD_STALL_MS
+            << " ms, or wait on a fence)" << std::endl;
+    for (size_t payload: {256, 4 * 1024, 64 * 1024, 1024 * 1024}) {
+        printUploadResult(runUploadBenchmark(-1, payload, frames, load));
+        if (StreamBuffer::bufferStorageSupported())
+            printUploadResult(runUploadBenchmark(STREAM_PERSISTENT, payload, frames, load));
+        printUploadResult(runUploadBenchmark(STREAM_ORPHANING, payload, frames, load));
+    }
+}
+#endif
@@ -11,6 +11,12 @@ Universita' degli Studi di Milano
 
 // Std. Includes
 #include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
 
 // Loader estensioni OpenGL
 // http://glad.dav1d.de/
@@ -35,19 +41,43 @@ Universita' degli Studi di Milano
     #error windows.h was included!
 #endif
 
-// classes developed during lab lectures to manage shaders, to load models, for FPS camera, and for physical simulation
-#include <utils/shader.h>
+// classes developed during lab lectures to load models, for FPS camera, and for physical simulation
+// (the shaders are built by util3d/shader_cache.h)
 #include <utils/camera.h>
 #include <utils/physics.h>
 
 // we load the GLM classes used in the application
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <random>
 
 #include "util3d/model.h"
+#include "util3d/entities.h"
+#include "util3d/collision_proxy.h"
+#include "util3d/occlusion.h"
+#include "util3d/lightmap.h"
+#include "util3d/probes.h"
+#include "util3d/light_assignment.h"
+#include "util3d/decals.h"
+#include "util3d/dynamic_resolution.h"
+#include "util3d/noise.h"
+#include "util3d/render_targets.h"
+#include "util3d/frame_graph.h"
+#include "util3d/shader_cache.h"
+#include "util3d/stream_buffer.h"
+#include "util3d/light_block.h"
+#include "util3d/upload_benchmark.h"
+#include "util3d/procedural.h"
+#include "util3d/latency.h"
+#include "util3d/frame_pacer.h"
+#include "util3d/frame_fences.h"
+#include "util3d/light_flicker.h"
+#include "util3d/camera_path.h"
+#include "util3d/offscreen_context.h"
+#include "util3d/render_benchmark.h"
 
 // we include the library for images loading
 #define STB_IMAGE_IMPLEMENTATION
@@ -55,6 +85,8 @@ Universita' degli Studi di Milano
 #include <stb_image/stb_image.h>
 
 GLuint screenWidth = 1200, screenHeight = 900;
+// set by framebuffer_size_callback, the projection is updated at the next frame
+bool windowResized = false;
 
 // callback functions for keyboard and mouse events
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
@@ -63,9 +95,19 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 
 void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
 
+// the window can be resized: the render targets follow the size of its framebuffer
+void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+
 // if one of the WASD keys is pressed, we call the corresponding method of the Camera class
 void apply_camera_movements();
 
+// sets the swap interval of the frame pacing settings
+void applySwapInterval();
+
+// work06b --leak-check: false if OpenGL objects are left after releasing the models, the decals, the geometry arena
+// and the render targets
+bool checkGLLeaks();
+
 // we initialize an array of booleans for each keyboard key
 bool keys[1024];
 
@@ -80,7 +122,8 @@ bool firstMouse = true;
 
 // parameters for time calculation (for animations)
 GLfloat deltaTime = 0.0f;
-GLfloat lastFrame = 0.0f;
+// (in double: a float time loses the precision of the frame times after some minutes)
+double lastFrame = 0.0;
 
 // boolean to activate/deactivate wireframe rendering
 GLboolean wireframe = GL_FALSE;
@@ -126,93 +169,336 @@ void renderQuad();
 
 btRigidBody *playerBody;
 
+// Bullet allocations are served by a pool (see util3d/physics_pool.h): the allocator must be installed
+// before the creation of the simulation, so this global is initialized first
+bool physicsAllocatorInstalled = installPhysicsAllocator();
 Physics bulletSimulation;
 
-struct SphereData {
-    btRigidBody *body;
-};
-
-std::vector<SphereData> spheres;
-
-struct SplatData {
-    glm::vec3 pos;
-    glm::mat4 rot;
-};
-
-std::vector<SplatData> splats;
+// simplified collision shape for the level instead of the triangle mesh
+bool useCollisionProxy = true;
+
+// endless level generated from a seed instead of backrooms.obj (work06b --procedural [seed], see
+// util3d/procedural.h). The lightmap and the probes are baked for backrooms.obj, so they are not used
+bool proceduralWorld = false;
+
+// occlusion culling of the level chunks, bullets and splats (K key), and its metrics for the last frame
+bool occlusionCulling = true;
+OcclusionBuffer occlusion(256, 192);
+size_t visibleChunks = 0, visibleBullets = 0, visibleSplats = 0;
+double cullingMs = 0;
+
+// baked lighting of the ceiling lights (J key), available if lightmap_baker has been run on the level
+bool lightmapAvailable = false;
+bool useLightmap = false;
+// texture unit of the lightmap, after the ones used by the materials
+const GLint LIGHTMAP_TEXTURE_UNIT = 5;
+
+// lighting of bullets and splats from the irradiance probes instead of the loop over the lights (P key)
+bool useProbes = true;
+const GLint PROBE_IRRADIANCE_TEXTURE_UNIT = 6;
+const GLint PROBE_SPECULAR_TEXTURE_UNIT = 7;
+// time spent to bake the probes at load time, and to combine and upload them in the last frame
+double probeBakeMs = 0, probeUpdateMs = 0;
+
+// levels of detail of bullets and splats (N key), and the triangles they submitted in the last frame, with the
+// levels and with the full models
+bool useLods = true;
+size_t lodTriangles = 0, fullTriangles = 0;
+
+// splats drawn as screen-space decals instead of meshes (V key), and the time spent on them in the last frame
+bool useDecals = true;
+const GLint DECAL_DEPTH_TEXTURE_UNIT = 8;
+double splatCpuMs = 0, splatGpuMs = 0;
+
+// stress benchmark of the splats (G key): the same random splats drawn as meshes and as decals, for each count
+const size_t STRESS_SPLAT_COUNTS[] = {1000, 10000, 50000};
+const int STRESS_WARMUP_FRAMES = 30, STRESS_FRAMES = 120;
+struct SplatStress {
+    bool requested = false;
+    bool running = false;
+    // count index * 2 + (0: meshes, 1: decals)
+    size_t step = 0;
+    int frame = 0;
+    double cpuMs = 0, gpuMs = 0;
+    bool decalsBefore = true;
+} splatStress;
+// adds splats on random surfaces of the level (hitscan shots from the rooms), up to the given count
+void spawnStressSplats(size_t count, btCollisionObject *level);
+
+// dynamic resolution (R key): scale of the scene and bloom passes, chosen from the GPU time of the frames
+// (see util3d/dynamic_resolution.h), and the GPU time of the last measured frame
+bool dynamicResolution = true;
+ResolutionController resolution;
+float renderScale = 1.0f;
+double frameGpuMs = 0;
+// scripted benchmark of the dynamic resolution (T key): the camera turns around, with a storm of decals in the
+// middle third of the frames, and the scale and the GPU time of each frame are written to a CSV file
+const int RESOLUTION_RUN_FRAMES = 900;
+const size_t RESOLUTION_RUN_SPLATS = 50000;
+struct ResolutionRun {
+    bool requested = false;
+    bool running = false;
+    int frame = 0;
+    std::ofstream log;
+    bool decalsBefore = true;
+} resolutionRun;
+
+// render on demand (U key): when nothing which decides the image of the scene changed since the last frame drawn
+// (the camera, the lights, the objects and the settings, see util3d/frame_graph.h), the frame is only the composite
+// pass on the scene and the bloom kept from that frame. It is always the case while the game is paused, where only
+// the VHS effect of composite.frag moves, so the loop is also limited to pausedFps frames per second then
+// (work06b --paused-fps N, 0 for no limit)
+bool renderOnDemand = true;
+int pausedFps = 30;
+// frames drawn and reused since the last print of the metrics
+unsigned int framesDrawn = 0, framesReused = 0;
+// frames of the current (or last) pause, with their CPU time and the GPU time of the ones already measured
+struct PauseStats {
+    double start = 0;
+    unsigned int frames = 0, reused = 0, gpuFrames = 0;
+    double cpuMs = 0, gpuMs = 0;
+} pauseStats;
+
+// frame pacing (see util3d/frame_pacer.h): the swap interval (F key cycles immediate, vsync and adaptive vsync when
+// supported; work06b --swap-interval N), the frame limiter (--fps N, 0 for none) and the frames the GPU can be behind
+// (--frames-in-flight N, 0 for no limit). The frame times are printed with the metrics, and the pacing run (Z key)
+// writes the CPU start, submit and swap times of each frame to frame_pacing.csv
+PacingSettings pacing;
+bool adaptiveSwapSupported = false;
+FrameTimeStats frameTimes;
+const int PACING_RUN_FRAMES = 600;
+struct PacingRun {
+    bool requested = false;
+    bool running = false;
+    int frame = 0;
+    double start = 0;
+    std::ofstream log;
+    FrameTimeStats times;
+} pacingRun;
+
+// render benchmark (work06b --render-benchmark [--path file] [--frames N] [--size WxH] [--dump-every N] [--seed S]):
+// the camera path of the file (recorded with the E key, see util3d/camera_path.h), or one through the rooms if it is
+// missing, is rendered in an offscreen context (util3d/offscreen_context.h) with a fixed time step, the flicker of
+// the lights from the seed and the shots of the path. The times and the draw calls of the passes are written to
+// render_benchmark.csv (see util3d/render_benchmark.h), and every N-th frame to render_benchmark/frame_N.ppm (the
+// read back slows down these frames)
+const float RENDER_BENCHMARK_STEP = 1.0f / 60.0f;
+struct RenderBenchmark {
+    bool active = false;
+    std::string pathFile = "camera_path.txt";
+    // 0 for the whole path
+    unsigned int frames = 0;
+    int width = 1280, height = 720;
+    unsigned int dumpEvery = 0;
+    unsigned int seed = 1;
+    unsigned int frame = 0;
+    CameraPath path;
+} renderBenchmark;
+// recording of the camera path while playing (E key to start and stop), saved in camera_path.txt
+const double PATH_RECORD_INTERVAL = 0.1;
+struct PathRecording {
+    bool requested = false;
+    bool active = false;
+    double start = 0, lastKey = 0;
+    CameraPath path;
+} pathRecording;
+
+// input latency (see util3d/latency.h): the mouse movements are stamped when they are received and followed to the
+// swap and to the end of their frame on the GPU (printed with the metrics, I key). With the late latch (X key) the
+// inputs are received again just before the scene is submitted, and the view is built again with them.
+// The latency run (Y key) replays the same scripted mouse movements without and then with the late latch, with some
+// CPU work added to the simulation as under load, and prints the histograms (also written to latency.csv)
+bool lateLatch = true;
+// the late latch polls the events again: only the cursor movements are applied there, the other events (keys,
+// buttons, resize) are kept and handled at the start of the next frame, before its own events
+bool deferInputEvents = false;
+std::vector<std::function<void()> > deferredEvents;
+LatencyTracker latency;
+const double LATENCY_RUN_SECONDS = 10.0, LATENCY_RUN_RATE = 500.0, LATENCY_RUN_WORK_MS = 8.0;
+// frames after the end of the replay, until the GPU times of its last frames are read
+const int LATENCY_RUN_DRAIN_FRAMES = 3;
+struct LatencyRun {
+    bool requested = false;
+    bool running = false;
+    // 0: the inputs of the start of the frame only, 1: late latch
+    int phase = 0;
+    int drainFrames = 0;
+    InputReplay replay;
+    LatencyTracker results[2];
+    bool lateLatchBefore = true;
+} latencyRun;
+
+// bits of the variants of shader.frag (see util3d/shader_cache.h): precomputed lighting (lightmap for the level,
+// probes for the dynamic objects) and diffuse texture
+const unsigned int SHADER_PRECOMPUTED = 1, SHADER_TEXTURED = 2;
+
+// bullets, splats and ceiling lights, stored as packed component arrays (see util3d/entities.h)
+EntityWorld world;
+
+// projectile or hitscan shooting (H key), and the hitscan shots of the current frame
+FiringSettings firing;
+std::vector<HitscanShot> hitscanShots;
+
+// age, kill volume and cap of the bullets in the simulation (metrics printed with the I key)
+BulletLifecycle bulletLifecycle;
+bool printMetrics = false;
+// allocator counters at the last print, to report the allocations per second
+PhysicsAllocatorStats lastAllocatorStats;
+double lastMetricsTime = 0;
 
 bool mousepressed = false;
 
-class MyContactResultCallback : public btCollisionWorld::ContactResultCallback {
-public:
-    bool collided;
-    btVector3 position;
-    btVector3 normal;
-
-    MyContactResultCallback() : collided(false) {}
-
-    btScalar addSingleResult(btManifoldPoint& cp, const btCollisionObjectWrapper* colObj0Wrap, int partId0, int index0,
-                                     const btCollisionObjectWrapper* colObj1Wrap, int partId1, int index1) override {
-        collided = true;
-        // store collision point, and normal angle of obj 1
-        normal = cp.m_normalWorldOnB;
-
-        // position is coll position offset a little by in the direction of the normal
-        position = cp.m_positionWorldOnB + cp.m_normalWorldOnB * 0.1;
-
-        return 0; // Not used
-    }
-};
-
 bool bloom = true;
 bool showBlurBuffer = false;
 float exposure = 1.0f;
 ////////////////// MAIN function ///////////////////////
-int main() {
+int main(int argc, char **argv) {
+    renderBenchmark.active = argc > 1 && std::string(argv[1]) == "--render-benchmark";
+    bool glLeakCheck = argc > 1 && std::string(argv[1]) == "--leak-check";
+    // the render benchmark and the leak check need no window (e.g., they run under llvmpipe)
+    bool offscreen = renderBenchmark.active || glLeakCheck;
+    // the options with a value can follow the mode
+    for (int i = 1; i + 1 < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--paused-fps")
+            pausedFps = std::max(std::stoi(argv[i + 1]), 0);
+        else if (option == "--swap-interval")
+            pacing.swapInterval = std::max(std::stoi(argv[i + 1]), static_cast<int>(SWAP_ADAPTIVE));
+        else if (option == "--fps")
+            pacing.targetFps = std::max(std::stod(argv[i + 1]), 0.0);
+        else if (option == "--frames-in-flight")
+            pacing.maxFramesInFlight = static_cast<unsigned int>(std::max(std::stoi(argv[i + 1]), 0));
+        else if (option == "--path")
+            renderBenchmark.pathFile = argv[i + 1];
+        else if (option == "--frames")
+            renderBenchmark.frames = static_cast<unsigned int>(std::max(std::stoi(argv[i + 1]), 0));
+        else if (option == "--size")
+            std::sscanf(argv[i + 1], "%dx%d", &renderBenchmark.width, &renderBenchmark.height);
+        else if (option == "--dump-every")
+            renderBenchmark.dumpEvery = static_cast<unsigned int>(std::max(std::stoi(argv[i + 1]), 0));
+        else if (option == "--seed")
+            renderBenchmark.seed = static_cast<unsigned int>(std::stoul(argv[i + 1]));
+    }
+
     // Initialization of OpenGL context using GLFW
-    glfwInit();
-    // We set OpenGL specifications required for this application
-    // In this case: 4.1 Core
-    // If not supported by your graphics HW, the context will not be created and the application will close
-    // N.B.) creating GLAD code to load extensions, try to take into account the specifications and any extensions you want to use,
-    // in relation also to the values indicated in these GLFW commands
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    // we set if the window is resizable
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-
-    // we create the application's window
-    GLFWwindow *window = glfwCreateWindow(screenWidth, screenHeight, "RTGP Project - Press ESC to Pause", nullptr, nullptr);
-    if (!window) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // (the offscreen modes only use its timer: from GLFW 3.4 the null platform does not need a display)
+#ifdef GLFW_PLATFORM_NULL
+    if (offscreen)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    if (!glfwInit()) {
+        // (its timer is needed by all the modes: without a display the offscreen ones need GLFW 3.4)
+        std::cout << "Failed to initialize GLFW" << std::endl;
         return -1;
     }
-    glfwMakeContextCurrent(window);
-
-    // we put in relation the window and the callbacks
-    glfwSetKeyCallback(window, key_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
-
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GLFW_TRUE);
-    // we disable the mouse cursor
-    //glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    GLFWwindow *window = nullptr;
+    OffscreenContext offscreenContext;
+    GLADloadproc glLoader = (GLADloadproc) glfwGetProcAddress;
+    if (offscreen) {
+        if (!offscreenContext.create(4, 1)) {
+            std::cout << "Failed to create the offscreen context: " << offscreenContext.error() << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glLoader = OffscreenContext::loader();
+        screenWidth = std::max(renderBenchmark.width, 1);
+        screenHeight = std::max(renderBenchmark.height, 1);
+    } else {
+        // We set OpenGL specifications required for this application
+        // In this case: 4.1 Core
+        // If not supported by your graphics HW, the context will not be created and the application will close
+        // N.B.) creating GLAD code to load extensions, try to take into account the specifications and any extensions you want to use,
+        // in relation also to the values indicated in these GLFW commands
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        // we set if the window is resizable
+        glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
+
+        // we create the application's window
+        window = glfwCreateWindow(screenWidth, screenHeight, "RTGP Project - Press ESC to Pause", nullptr, nullptr);
+        if (!window) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+
+        // we put in relation the window and the callbacks
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GLFW_TRUE);
+        // we disable the mouse cursor
+        //glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
-    // GLAD tries to load the context set by GLFW
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+    // GLAD tries to load the context set by GLFW (or the offscreen one)
+    if (!gladLoadGLLoader(glLoader)) {
         std::cout << "Failed to initialize OpenGL context" << std::endl;
         return -1;
     }
+    // the context is destroyed when main returns, after the objects declared below (the destructors of the meshes,
+    // models and render targets delete their OpenGL objects): the ones still alive at that point were leaked
+    struct ContextGuard {
+        ~ContextGuard() {
+            if (liveGLObjects() != 0)
+                std::cout << "leaked OpenGL objects: " << GLBuffer::live() << " buffers, " << GLVertexArray::live()
+                        << " vertex arrays, " << GLTexture::live() << " textures" << std::endl;
+            // we close and delete the created context
+            glfwTerminate();
+        }
+    } contextGuard;
 
+    // work06b --leak-check: exits with 1 if OpenGL objects are leaked (see checkGLLeaks)
+    if (glLeakCheck)
+        return checkGLLeaks() ? 0 : 1;
+
+    // work06b --upload-benchmark: uploads of the frame data, then exits (see util3d/upload_benchmark.h)
+    if (argc > 1 && std::string(argv[1]) == "--upload-benchmark") {
+        benchUploads(glLoader);
+        return 0;
+    }
+    // work06b --assimp: the OBJ models are loaded with ASSIMP instead of util3d/obj_loader.h (to compare load times)
+    ModelLoader modelLoader = MODEL_LOADER_AUTO;
+    if (argc > 1 && std::string(argv[1]) == "--assimp")
+        modelLoader = MODEL_LOADER_ASSIMP;
+    uint32_t proceduralSeed = 1;
+    if (argc > 1 && std::string(argv[1]) == "--procedural") {
+        proceduralWorld = true;
+        if (argc > 2)
+            proceduralSeed = static_cast<uint32_t>(std::stoul(argv[2]));
+        useProbes = useDecals = false;
+        std::cout << "procedural level, seed " << proceduralSeed << std::endl;
+    }
+    // the offscreen context has no swap
+    if (window != nullptr) {
+        adaptiveSwapSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                                glfwExtensionSupported("GLX_EXT_swap_control_tear");
+        applySwapInterval();
+    }
+    // period of the display, for the snapping of the frame times
+    // (none without a window: the offscreen modes are not paced by a display)
+    double refreshPeriod = 0.0;
+    if (window != nullptr) {
+        GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode *videoMode = monitor != nullptr ? glfwGetVideoMode(monitor) : nullptr;
+        if (videoMode != nullptr && videoMode->refreshRate > 0)
+            refreshPeriod = 1.0 / videoMode->refreshRate;
+    }
 
     // we define the viewport dimensions
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    int width = screenWidth, height = screenHeight;
+    if (window != nullptr)
+        glfwGetFramebufferSize(window, &width, &height);
     glViewport(0, 0, width, height);
+    // the render targets have the size of the framebuffer (which is larger than the window on high DPI screens)
+    screenWidth = width;
+    screenHeight = height;
 
     // we enable Z test
     glEnable(GL_DEPTH_TEST);
@@ -220,48 +506,302 @@ int main() {
     //the "clear" color for the frame buffer
     glClearColor(0.26f, 0.46f, 0.98f, 1.0f);
 
-    // the Shader Program for the objects used in the application
-    Shader object_shader = Shader("shader.vert", "shader.frag");
-    Shader blur_shader = Shader("blur.vert", "blur.frag");
-    Shader bloom_shader = Shader("basic.vert", "bloom.frag");
-    Shader tex_shader = Shader("basic.vert", "tex.frag");
-    Shader pause_shader = Shader("basic.vert", "pause.frag");
-
-    GLuint crosshair = TextureFromFile("crosshair.png", "textures");
-    GLuint pauseTex = TextureFromFile("pause.png", "textures");
-
-    Model backrooms("backrooms_map/backrooms.obj");
-
-    Model sphere_model("models/sphere.obj");
-
-    Model splat_model("models/newscene.obj");
+    // the Shader Programs used in the application, loaded from the binaries saved by the previous runs when
+    // possible (see util3d/shader_cache.h). shader.frag has a variant for the level and one for the dynamic
+    // objects, each one with or without the precomputed lighting and the diffuse texture (SHADER_* bits)
+    ShaderCache shaderCache("shader_cache");
+    ShaderVariants levelShaders, objectShaders;
+    levelShaders.load(shaderCache, "shader.vert", "shader.frag", {"LEVEL"}, {"LIGHTMAP", "TEXTURED"});
+    objectShaders.load(shaderCache, "shader.vert", "shader.frag", {}, {"PROBES", "TEXTURED"});
+    ShaderProgram blur_shader = shaderCache.load("blur.vert", "blur.frag");
+    ShaderProgram composite_shader = shaderCache.load("basic.vert", "composite.frag");
+    ShaderProgram decal_shader = shaderCache.load("decal.vert", "decal.frag");
+    std::cout << "shaders: " << shaderCache.loadedBinaries + shaderCache.compiledPrograms << " programs in "
+            << shaderCache.totalMs << " ms (" << shaderCache.loadedBinaries << " from the cache, "
+            << shaderCache.compiledPrograms << " compiled)" << std::endl;
+    // the lightmap sampler has its own unit: samplers of different types cannot share a unit
+    for (ShaderVariants *variants: {&levelShaders, &objectShaders}) {
+        for (auto &shader: variants->programs) {
+            shader.Use();
+            glUniform1i(glGetUniformLocation(shader.Program, "lightmap"), LIGHTMAP_TEXTURE_UNIT);
+            glUniform1i(glGetUniformLocation(shader.Program, "probeIrradiance"), PROBE_IRRADIANCE_TEXTURE_UNIT);
+            glUniform1i(glGetUniformLocation(shader.Program, "probeSpecular"), PROBE_SPECULAR_TEXTURE_UNIT);
+            bindFrameLightsBlock(shader.Program);
+        }
+    }
+    // the data written at each frame (the lights block) goes to a ring buffer with a region for each of 3 frames in
+    // flight (see util3d/stream_buffer.h)
+    const size_t uniformAlignment = StreamBuffer::uniformAlignment();
+    StreamBuffer frameData(GL_UNIFORM_BUFFER, 16 * 1024, 3, glLoader);
+    std::cout << "frame data: " << (frameData.persistent() ? "persistent mapping" : "orphaning") << std::endl;
+    decal_shader.Use();
+    glUniform1i(glGetUniformLocation(decal_shader.Program, "sceneDepth"), DECAL_DEPTH_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(decal_shader.Program, "probeIrradiance"), PROBE_IRRADIANCE_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(decal_shader.Program, "probeSpecular"), PROBE_SPECULAR_TEXTURE_UNIT);
+
+    GLTexture crosshair(TextureFromFile("crosshair.png", "textures"));
+    GLTexture pauseTex(TextureFromFile("pause.png", "textures"));
+
+    // tiling noise of the VHS effect (see util3d/noise.h)
+    const int NOISE_SIZE = 256, NOISE_PERIOD = 32;
+    GLTexture noiseTex = GLTexture::create();
+    {
+        std::vector<float> noise = tilingNoise(NOISE_SIZE, NOISE_PERIOD, 1);
+        glBindTexture(GL_TEXTURE_2D, noiseTex.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, NOISE_SIZE, NOISE_SIZE, 0, GL_RED, GL_FLOAT, noise.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    composite_shader.Use();
+    glUniform1i(glGetUniformLocation(composite_shader.Program, "scene"), 0);
+    glUniform1i(glGetUniformLocation(composite_shader.Program, "bloomBlur"), 1);
+    glUniform1i(glGetUniformLocation(composite_shader.Program, "crosshair"), 2);
+    glUniform1i(glGetUniformLocation(composite_shader.Program, "overlay"), 3);
+    glUniform1i(glGetUniformLocation(composite_shader.Program, "noiseTexture"), 4);
+    glUniform1f(glGetUniformLocation(composite_shader.Program, "noisePeriod"), static_cast<float>(NOISE_PERIOD));
+
+    // the vertices and the indices of all the models, in two buffers (see util3d/geometry_arena.h): room for the
+    // level and the dynamic objects, which grows if needed
+    MeshArena geometryArena(1 << 16, 1 << 18);
+
+    double loadStart = glfwGetTime();
+    Model backrooms = proceduralWorld ? Model(geometryArena) :
+                      Model(geometryArena, "backrooms_map/backrooms.obj", false, modelLoader);
+
+    Model sphere_model(geometryArena, "models/sphere.obj", false, modelLoader);
+
+    Model splat_model(geometryArena, "models/newscene.obj", false, modelLoader);
+    std::cout << "models loaded in " << (glfwGetTime() - loadStart) * 1000.0 << " ms"
+            << (modelLoader == MODEL_LOADER_ASSIMP ? " with ASSIMP" : "") << std::endl;
+    sphere_model.generateLods(BULLET_LODS.ratios);
+    splat_model.generateLods(SPLAT_LODS.ratios);
+    // the bullets and the splats need only their buffers from now on
+    sphere_model.releaseCpuData();
+    splat_model.releaseCpuData();
+    std::cout << "levels of detail: bullet";
+    for (size_t level = 0; level < BULLET_LODS.levels(); level++)
+        std::cout << " " << sphere_model.triangleCount(level);
+    std::cout << ", splat";
+    for (size_t level = 0; level < SPLAT_LODS.levels(); level++)
+        std::cout << " " << splat_model.triangleCount(level);
+    std::cout << " triangles" << std::endl;
     //Model backrooms("backrooms_map3/untitled.obj");
     //Model backrooms("backrooms_map2/Sketchfab_2022_04_30_13_07_42.obj");
     //Model backrooms("test_obj/capsule.obj");
 
-    auto *envMesh = new btTriangleMesh();
+    // collision shape of the level: boxes fitted to the axis-aligned walls, floors and ceilings, plus a triangle mesh
+    // for the rest (see util3d/collision_proxy.h), or the full triangle soup of the render meshes
+    std::vector<glm::vec3> levelTriangles;
     for (auto &value: backrooms.meshes) {
-        for (int i = 0; i < value.vertices.size() / 3; i++) {
-            auto &v1 = value.vertices[i * 3];
-            auto &v2 = value.vertices[i * 3 + 1];
-            auto &v3 = value.vertices[i * 3 + 2];
+        for (size_t i = 0; i + 2 < value.indices.size(); i += 3) {
+            levelTriangles.push_back(value.vertices[value.indices[i]].Position);
+            levelTriangles.push_back(value.vertices[value.indices[i + 1]].Position);
+            levelTriangles.push_back(value.vertices[value.indices[i + 2]].Position);
+        }
+    }
+    // the ceiling light of each vertex (for the flicker of the emissive panels) is the one closest to its triangles
+    LightGrid lightGrid;
+    {
+        LightArchetype lights;
+        initCeilingLights(lights);
+        lightGrid.build(lights.column<LIGHT_POSITION>(), 3.42f);
+    }
+    // the level is split in chunks which can be drawn separately, and its large triangles are the occluders
+    std::vector<LevelChunk> levelChunks;
+    for (unsigned int m = 0; m < backrooms.meshes.size(); m++) {
+        std::vector<glm::vec3> positions;
+        for (auto &vertex: backrooms.meshes[m].vertices)
+            positions.push_back(vertex.Position);
+        std::vector<unsigned int> indices = backrooms.meshes[m].indices;
+        backrooms.meshes[m].setLightIds(assignNearestLights(positions, indices, lightGrid));
+        buildLevelChunks(positions, indices, m, 4.0f, levelChunks);
+        backrooms.meshes[m].setIndices(indices);
+    }
+    std::vector<glm::vec3> occluders = selectOccluders(levelTriangles, 0.25f);
+
+    // baked lighting: lightmap coordinates of the vertices and texture array with the values of the lights
+    GLTexture lightmapTexture;
+    {
+        Lightmap lightmap;
+        if (!proceduralWorld && loadLightmap("backrooms_map/backrooms.lightmap", lightmap)) {
+            bool matches = lightmap.coords.size() == backrooms.meshes.size() && lightmap.nrLights == NR_CEILING_LIGHTS;
+            for (size_t m = 0; matches && m < backrooms.meshes.size(); m++)
+                matches = lightmap.coords[m].size() == backrooms.meshes[m].vertices.size();
+            if (matches) {
+                for (size_t m = 0; m < backrooms.meshes.size(); m++)
+                    backrooms.meshes[m].setLightmapCoords(lightmap.coords[m]);
+                lightmapTexture = GLTexture::create();
+                glBindTexture(GL_TEXTURE_2D_ARRAY, lightmapTexture.get());
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16F, lightmap.width, lightmap.height, lightmap.layers, 0,
+                             GL_RGBA, GL_HALF_FLOAT, lightmap.texels.data());
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+                lightmapAvailable = useLightmap = true;
+                std::cout << "lightmap: " << lightmap.width << "x" << lightmap.height << ", " << lightmap.layers
+                        << " layers" << std::endl;
+            } else {
+                std::cout << "the lightmap does not match the level, run lightmap_baker again" << std::endl;
+            }
+        }
+    }
+    // the vertices of the level are in levelTriangles and in its buffers, the copies of the meshes are not needed
+    backrooms.releaseCpuData();
+    // the levels of detail took new index ranges, leaving holes where the full meshes were
+    geometryArena.compact();
+    std::cout << "geometry arena: " << geometryArena.describe() << std::endl;
+    // index ranges of the visible chunks of each mesh, filled at each frame
+    std::vector<std::vector<GLsizei> > chunkCounts(backrooms.meshes.size());
+    std::vector<std::vector<const void *> > chunkOffsets(backrooms.meshes.size());
+
+    // irradiance probes: baked at load time, on all the hardware threads
+    ProbeGrid probes;
+    GLTexture probeTextures[2];
+    if (!proceduralWorld) {
+        double bakeStart = glfwGetTime();
+        Bvh levelBvh;
+        levelBvh.build(levelTriangles);
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        for (auto &p: levelTriangles) {
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+        std::vector<glm::vec3> positions, attenuations;
+        {
+            LightArchetype lights;
+            initCeilingLights(lights);
+            positions = lights.column<LIGHT_POSITION>();
+            attenuations = lights.column<LIGHT_ATTENUATION>();
+        }
+        probes.bake(levelBvh, positions, attenuations, boundsMin, boundsMax, 0.5f,
+                    std::max(1u, std::thread::hardware_concurrency()));
+        probeBakeMs = (glfwGetTime() - bakeStart) * 1000.0;
+        std::cout << "irradiance probes: " << probes.dims.x << "x" << probes.dims.y << "x" << probes.dims.z
+                << ", baked in " << probeBakeMs << " ms" << std::endl;
+
+        // the contents are uploaded at each frame (see combine)
+        for (int i = 0; i < 2; i++) {
+            probeTextures[i] = GLTexture::create();
+            glBindTexture(GL_TEXTURE_3D, probeTextures[i].get());
+            glTexImage3D(GL_TEXTURE_3D, 0, i == 0 ? GL_RGBA16F : GL_R16F, probes.dims.x, probes.dims.y,
+                         probes.dims.z, 0, i == 0 ? GL_RGBA : GL_RED, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_3D, 0);
+        // texture coordinates of the probes centers
+        glm::vec3 dims = glm::vec3(probes.dims);
+        glm::vec3 scale = 1.0f / (dims * probes.spacing), offset = 0.5f / dims;
+        for (auto &shader: objectShaders.programs) {
+            shader.Use();
+            glUniform3fv(glGetUniformLocation(shader.Program, "probeGridOrigin"), 1, &probes.origin[0]);
+            glUniform3fv(glGetUniformLocation(shader.Program, "probeGridScale"), 1, &scale[0]);
+            glUniform3fv(glGetUniformLocation(shader.Program, "probeGridOffset"), 1, &offset[0]);
+        }
+        decal_shader.Use();
+        glUniform3fv(glGetUniformLocation(decal_shader.Program, "probeGridOrigin"), 1, &probes.origin[0]);
+        glUniform3fv(glGetUniformLocation(decal_shader.Program, "probeGridScale"), 1, &scale[0]);
+        glUniform3fv(glGetUniformLocation(decal_shader.Program, "probeGridOffset"), 1, &offset[0]);
+    }
+
+    btCollisionShape *levelShape;
+    // the compound of the procedural level, where the chunks add their shapes
+    btCompoundShape *chunkShapes = nullptr;
+    if (proceduralWorld) {
+        chunkShapes = new btCompoundShape();
+        levelShape = chunkShapes;
+    } else if (useCollisionProxy) {
+        CollisionProxy levelProxy = createCollisionProxy(levelTriangles);
+        std::cout << "level collision proxy: " << levelProxy.stats.boxes << " boxes, "
+                << levelProxy.stats.fallbackTriangles << " of " << levelProxy.stats.inputTriangles
+                << " triangles kept as mesh" << std::endl;
+        levelShape = levelProxy.shape;
+    } else {
+        auto *envMesh = new btTriangleMesh();
+        for (size_t i = 0; i + 2 < levelTriangles.size(); i += 3) {
+            auto &v1 = levelTriangles[i];
+            auto &v2 = levelTriangles[i + 1];
+            auto &v3 = levelTriangles[i + 2];
             envMesh->addTriangle(
-                btVector3(v1.Position.x, v1.Position.y, v1.Position.z),
-                btVector3(v2.Position.x, v2.Position.y, v2.Position.z),
-                btVector3(v3.Position.x, v3.Position.y, v3.Position.z)
+                btVector3(v1.x, v1.y, v1.z),
+                btVector3(v2.x, v2.y, v2.z),
+                btVector3(v3.x, v3.y, v3.z)
             );
         }
+        levelShape = new btBvhTriangleMeshShape(envMesh, true);
     }
-    auto triMeshShape = new btBvhTriangleMeshShape(envMesh, true);
-    auto backroomBody = new btRigidBody(0, new btDefaultMotionState(), triMeshShape);
+    auto backroomBody = new btRigidBody(0, new btDefaultMotionState(), levelShape);
     backroomBody->setFriction(0.9);
     bulletSimulation.dynamicsWorld->addRigidBody(backroomBody);
+    setKillVolume(bulletLifecycle, backroomBody, 5.0f);
 
-    // player is a cube
+    // player is a cube (in the procedural level, in the middle of the first cell)
+    glm::vec3 playerStart = proceduralWorld ? glm::vec3(1.5f, 0.2f, 1.5f) : glm::vec3(11, 0.2, 11);
     playerBody = bulletSimulation.createRigidBody(
-        BOX, glm::vec3(11, 0.2, 11), glm::vec3(0.2f, 0.9f, 0.2f), glm::vec3(0.0f, 0.0f, 0.0f), 1.0f, 0.9f, 0.0f);
+        BOX, playerStart, glm::vec3(0.2f, 0.9f, 0.2f), glm::vec3(0.0f, 0.0f, 0.0f), 1.0f, 0.9f, 0.0f);
     playerBody->setAngularFactor(btVector3(0.0f, 1.0f, 0.0f));
 
+    // the procedural level: the chunks generated by the workers are loaded in the geometry arena and in the
+    // compound of the level, a few at each frame, with the textures of backrooms.obj for walls, floor and ceiling
+    // (mat3, mat7 and mat10 of original_backrooms.mtl) and emissive panels
+    GLTexture chunkTextures[CHUNK_SURFACES];
+    Material chunkMaterials[CHUNK_SURFACES];
+    std::map<ChunkCoord, std::vector<Mesh> > chunkMeshes;
+    std::unique_ptr<ChunkStreamer> streamer;
+    if (proceduralWorld) {
+        const char *textureFiles[CHUNK_SURFACES] = {"flipy_dd099daa-518b-4df8-af16-5420825d722b.png",
+                                                    "flipy_6e5f9ef6-b015-4efe-8cdf-c504c4207a5b.png",
+                                                    "flipy_b7a7895d-8852-42ae-af2f-e65d5066e6dd.png", nullptr};
+        for (int s = 0; s < CHUNK_SURFACES; s++) {
+            if (textureFiles[s] != nullptr)
+                chunkTextures[s] = GLTexture(TextureFromFile(textureFiles[s], "backrooms_map"));
+            chunkMaterials[s] = Material{glm::vec3(1.0f), glm::vec3(1.0f), glm::vec3(0.0f),
+                                         glm::vec3(s == CHUNK_PANELS ? 1.0f : 0.0f)};
+        }
+        streamer.reset(new ChunkStreamer(proceduralSeed));
+        streamer->onLoad = [&](Chunk &chunk) {
+            std::vector<Mesh> &meshes = chunkMeshes[chunk.coord];
+            for (int s = 0; s < CHUNK_SURFACES; s++) {
+                const ChunkMesh &source = chunk.meshes[s];
+                if (source.indices.empty())
+                    continue;
+                vector<Vertex> vertices(source.positions.size());
+                for (size_t i = 0; i < vertices.size(); i++)
+                    vertices[i] = Vertex{source.positions[i], source.normals[i], source.texCoords[i], glm::vec2(0.0f),
+                                         source.lightIds[i]};
+                vector<Texture> textures;
+                if (textureFiles[s] != nullptr)
+                    textures.push_back(Texture{chunkTextures[s].get(), "texture_diffuse", textureFiles[s]});
+                chunk.rendererBytes += vertices.size() * sizeof(Vertex) + source.indices.size() * sizeof(GLuint);
+                meshes.emplace_back(geometryArena, std::move(vertices), source.indices, std::move(textures),
+                                    chunkMaterials[s]);
+                meshes.back().releaseCpuData();
+            }
+            chunkShapes->addChildShape(btTransform::getIdentity(), chunk.shape);
+            bulletSimulation.dynamicsWorld->updateSingleAabb(backroomBody);
+            setKillVolume(bulletLifecycle, backroomBody, 5.0f);
+        };
+        streamer->onUnload = [&](Chunk &chunk) {
+            chunkMeshes.erase(chunk.coord);
+            chunkShapes->removeChildShape(chunk.shape);
+            bulletSimulation.dynamicsWorld->updateSingleAabb(backroomBody);
+            setKillVolume(bulletLifecycle, backroomBody, 5.0f);
+        };
+        // the floor must be there before the player falls on it
+        double preloadStart = glfwGetTime();
+        streamer->preload(playerStart);
+        std::cout << "procedural level: " << streamer->residentChunks().size() << " chunks loaded in "
+                << (glfwGetTime() - preloadStart) * 1000.0 << " ms" << std::endl;
+    }
+
     //btCollisionShape* shape = new btBvhTriangleMeshShape(backrooms.meshes[0].m_meshes[0].m_mesh->m_btMeshInterface, true);
 
     glm::vec3 plane_pos = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -271,53 +811,27 @@ int main() {
     glm::mat4 planeModelMatrix = glm::mat4(1.0f);
     glm::mat3 planeNormalMatrix = glm::mat3(1.0f);
 
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(
-            GL_TEXTURE_2D, 0, GL_RGBA16F, screenWidth, screenHeight, 0, GL_RGBA, GL_FLOAT, NULL
-        );
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(
-            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0
-        );
-    }
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, screenWidth, screenHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-
-    unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-    glDrawBuffers(2, attachments);
-
-    unsigned int pingpongFBO[3];
-    unsigned int pingpongColorbuffers[3];
-    glGenFramebuffers(3, pingpongFBO);
-    glGenTextures(3, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 3; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, screenWidth, screenHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    // render targets of the frame: the render graph takes them at each frame from a pool of textures
+    // (see util3d/render_graph.h and util3d/frame_graph.h)
+    RenderGraph frameGraph;
+    RenderTargetPool renderTargets;
+
+    DecalBuffer splatDecals;
+    splatDecals.init();
+    decal_shader.Use();
+    glUniform3fv(glGetUniformLocation(decal_shader.Program, "decalDiffuse"), 1,
+                 &splat_model.meshes[0].material.diffuse[0]);
+    glUniform3fv(glGetUniformLocation(decal_shader.Program, "decalSpecular"), 1,
+                 &splat_model.meshes[0].material.specular[0]);
+    // GPU time of the splats, read 2 frames later to avoid waiting for the result
+    GLuint splatQueries[2];
+    glGenQueries(2, splatQueries);
+    bool splatQueryIssued[2] = {false, false};
+    // GPU time of the whole frame for the dynamic resolution, with timestamps since the splat query is nested
+    GLuint frameQueries[2][2];
+    glGenQueries(4, &frameQueries[0][0]);
+    bool frameQueryIssued[2] = {false, false};
+    unsigned int frameIndex = 0;
 
     struct AmbientLight {
         glm::vec3 ambient;
@@ -325,39 +839,10 @@ int main() {
         glm::vec3 specular;
     } ambient;
 
-    struct Light {
-        glm::vec3 position;
-        float constant;
-        float linear;
-        float quadratic;
-        glm::vec3 ambient;
-        glm::vec3 diffuse;
-        glm::vec3 specular;
-    } lights[25];
-
-    glm::vec3 pos(-8.6, 1.25, 7.93); {
-        int i = 0;
-        for (int y = 0; y < 4; y++) {
-            pos.x = -8.6;
-            int x = 0;
-            if (y == 2) {
-                x--;
-                pos.x -= 3.42;
-            }
-            for (; x < 6; x++) {
-                lights[i].position = pos;
-                lights[i].constant = 1;
-                lights[i].linear = 0.09;
-                lights[i].quadratic = 0.032;
-                lights[i].ambient = glm::vec3(-0.1);
-                lights[i].diffuse = glm::vec3(0);
-                lights[i].specular = glm::vec3(0);
-                pos += glm::vec3(3.42, 0, 0);
-                i++;
-            }
-            pos += glm::vec3(0, 0, y == 2 ? -5.67 : -4.54);
-        }
-    }
+    initCeilingLights(world.lights);
+    auto &lightAmbient = world.lights.column<LIGHT_AMBIENT>();
+    auto &lightDiffuse = world.lights.column<LIGHT_DIFFUSE>();
+    auto &lightSpecular = world.lights.column<LIGHT_SPECULAR>();
 
     AmbientLight &light = ambient;
 
@@ -365,49 +850,226 @@ int main() {
     light.diffuse = glm::vec3(0.25f);
     light.specular = glm::vec3(1.0f);
 
-    // Define random generator with Gaussian distribution
-    const double mean = 0.0;
-    const double stddev = 0.1;
-    std::default_random_engine generator;
-    std::normal_distribution<double> dist(mean, stddev);
-
-    std::uniform_int_distribution<int> lightdist(0, 24);
-
     // camera.MovementSpeed = 5.0;
     //camera.onGround = true;
     //camera.Position = glm::vec3(11, 0.2, 11);
 
     camera.ProcessMouseMovement(-176, -3);
 
-    int warmingUp = 0;
-    int warmingUpIdx = 0;
-    float warmingUpDuration = 0.2;
-
-    float lightFlicker = 0;
-    float lightFlickerDuration = 0;
-    float lightFlickerBase;
-    float lightPointFlickerBase;
-    float ceilingFlickerBase;
-    int flickerLight = -1;
-    float flickerLightDuration = 0;
+    // warm-up and flicker of the ceiling lights (see util3d/light_flicker.h), from the seed of the render benchmark
+    // so that its runs draw the same frames
+    CeilingLightFlicker lightFlicker(renderBenchmark.active ? renderBenchmark.seed
+                                                            : std::default_random_engine::default_seed);
+    // flicker of the ceiling, for the shaders
+    float ceilingFlicker = 1.0;
 
     int debugLightId = 0;
     bool debouncelight = false;
 
     float lastbullet = 0;
+    // time of the simulation: it does not advance while the game is paused
+    float simulationTime = 0;
+    // a shot from the camera, of the mouse or of the camera path
+    auto fireShot = [&]() {
+        glm::vec3 bulletPos = camera.Position + camera.Front * 0.5f;
+        if (firing.mode == FIRE_HITSCAN)
+            hitscanShots.push_back({bulletPos, camera.Front});
+        else
+            // give bullet front speed
+            spawnBullet(world, bulletSimulation, bulletPos, camera.Front, BULLET_SPEED, simulationTime, firing.ccd);
+        if (pathRecording.active)
+            pathRecording.path.addShot(static_cast<float>(glfwGetTime() - pathRecording.start));
+    };
+
+    // render benchmark: the frames are drawn in a framebuffer of their own, and the passes of the render graph are
+    // timed (see util3d/render_benchmark.h)
+    OffscreenFramebuffer offscreenFramebuffer;
+    PassTimer passTimer;
+    std::ofstream renderBenchmarkCsv;
+    std::unique_ptr<RenderBenchmarkLog> renderBenchmarkLog;
+    if (renderBenchmark.active) {
+        if (!offscreenFramebuffer.create(screenWidth, screenHeight)) {
+            std::cout << "render benchmark: the offscreen framebuffer is incomplete" << std::endl;
+            return -1;
+        }
+        renderTargets.backbuffer = offscreenFramebuffer.id();
+        installDrawCounter();
+        if (renderBenchmark.path.load(renderBenchmark.pathFile)) {
+            std::cout << "render benchmark: camera path " << renderBenchmark.pathFile << std::endl;
+        } else {
+            // through the rooms, below the lights row by row (one row in each direction)
+            std::vector<glm::vec3> points(world.lights.column<LIGHT_POSITION>().begin(),
+                                          world.lights.column<LIGHT_POSITION>().end());
+            std::sort(points.begin(), points.end(), [](const glm::vec3 &a, const glm::vec3 &b) {
+                return a.z < b.z - 0.5f || (std::abs(a.z - b.z) <= 0.5f && a.x < b.x);
+            });
+            for (size_t row = 0, odd = 0; row < points.size(); odd = 1 - odd) {
+                size_t end = row + 1;
+                while (end < points.size() && std::abs(points[end].z - points[row].z) <= 0.5f)
+                    end++;
+                if (odd)
+                    std::reverse(points.begin() + row, points.begin() + end);
+                row = end;
+            }
+            renderBenchmark.path = pathThrough(points, 1.5f, 1.5f, 0.5f);
+            std::cout << "render benchmark: no camera path in " << renderBenchmark.pathFile
+                    << ", path through the rooms" << std::endl;
+        }
+        if (renderBenchmark.frames == 0)
+            renderBenchmark.frames = static_cast<unsigned int>(renderBenchmark.path.duration() /
+                                                               RENDER_BENCHMARK_STEP) + 1;
+        // the same work at each frame: no scaling of the resolution, no reuse, no limiter
+        dynamicResolution = false;
+        renderOnDemand = false;
+        pacing.targetFps = 0;
+        renderBenchmarkCsv.open("render_benchmark.csv");
+        renderBenchmarkLog.reset(new RenderBenchmarkLog(renderBenchmarkCsv));
+        if (renderBenchmark.dumpEvery > 0)
+            std::filesystem::create_directories("render_benchmark");
+        std::cout << "render benchmark: " << renderBenchmark.frames << " frames of " << screenWidth << "x"
+                << screenHeight << ", seed " << renderBenchmark.seed << ", " << glGetString(GL_RENDERER)
+                << std::endl;
+    }
 
-    GLfloat maxSecPerFrame = 1.0f / 60.0f;
+    // render on demand: signature of this frame and of the last one drawn, and whether the retained targets hold
+    // that frame (see util3d/frame_graph.h)
+    FrameSignature frameSignature, drawnSignature;
+    bool drawnValid = false;
+    // whether the frame of each timestamp query was paused, and reused
+    bool frameQueryPaused[2] = {false, false}, frameQueryReused[2] = {false, false};
+    bool wasPaused = false;
+
+    // GPU time of the timestamps minus the time of glfwGetTime, for the latencies to the end of the frames on the GPU
+    double gpuClockOffset = 0;
+    auto calibrateGpuClock = [&]() {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuClockOffset = gpuNow / 1e9 - glfwGetTime();
+    };
+    calibrateGpuClock();
+    // the mouse movements of the latency run received so far
+    auto receiveReplay = [&]() {
+        if (!latencyRun.running || isPaused)
+            return;
+        latencyRun.replay.deliver(glfwGetTime(), [&](const ReplayEvent &event, double time) {
+            camera.ProcessMouseMovement(event.dx, event.dy);
+            latency.input(time);
+        });
+    };
+
+    // frame pacing: the limiter, and the fences of the frames in flight
+    FrameLimiter frameLimiter;
+    FrameFences frameFences;
+    // period of the frames when the limiter or the vertical sync set it (0 otherwise)
+    auto pacingPeriod = [&]() {
+        double period = pacing.targetFps > 0.0 ? 1.0 / pacing.targetFps : 0.0;
+        if (pacing.swapInterval != SWAP_IMMEDIATE)
+            period = std::max(period, refreshPeriod * std::abs(pacing.swapInterval));
+        return period;
+    };
+
+    // longest step of the simulation in a frame (Bullet takes up to 10 substeps of 1/60 s): the simulation slows
+    // down only below 6 frames per second
+    GLfloat maxSecPerFrame = 10.0f / 60.0f;
     // Rendering loop: this code is executed at each frame
-    while (!glfwWindowShouldClose(window)) {
+    while (renderBenchmark.active ? renderBenchmark.frame < renderBenchmark.frames : !glfwWindowShouldClose(window)) {
+        if (renderBenchmark.active)
+            passTimer.beginFrame(renderBenchmark.frame);
+        // while paused the loop waits for the next frame, or for an event (e.g., ESC to resume)
+        bool pausedWait = isPaused && pausedFps > 0;
+        if (pausedWait) {
+            double wait = lastFrame + 1.0 / pausedFps - glfwGetTime();
+            if (wait > 0)
+                glfwWaitEventsTimeout(wait);
+        }
+        // otherwise the limiter waits for the start of the frame, then the GPU must be less than the frames in
+        // flight behind
+        double limiterMs = pausedWait ? 0.0 : frameLimiter.wait(pacing.targetFps);
+        double fenceMs = frameFences.wait(pacing.maxFramesInFlight);
+
         // we determine the time passed from the beginning
         // and we calculate time difference between current frame rendering and the previous one
-        GLfloat currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
+        double currentFrame = glfwGetTime();
+        double frameSeconds = currentFrame - lastFrame;
+        deltaTime = static_cast<GLfloat>(snapFrameDelta(frameSeconds, pacingPeriod()));
         lastFrame = currentFrame;
-        lightFlicker += deltaTime;
-
-        // Check is an I/O event is happening
+        // the render benchmark advances by a fixed step, whatever the time taken by the frames
+        if (renderBenchmark.active) {
+            deltaTime = RENDER_BENCHMARK_STEP;
+            currentFrame = renderBenchmark.frame * static_cast<double>(RENDER_BENCHMARK_STEP);
+        }
+        if (!isPaused && !wasPaused && frameIndex > 0)
+            frameTimes.add(frameSeconds * 1000.0);
+
+        // Check is an I/O event is happening (after the events kept by the late latch of the last frame)
+        std::vector<std::function<void()> > lateEvents;
+        lateEvents.swap(deferredEvents);
+        for (auto &event: lateEvents)
+            event();
         glfwPollEvents();
+        double frameCpuStart = glfwGetTime();
+        frameData.beginFrame();
+
+        if (isPaused && !wasPaused) {
+            pauseStats = PauseStats();
+            pauseStats.start = currentFrame;
+        } else if (!isPaused && wasPaused) {
+            double seconds = currentFrame - pauseStats.start;
+            unsigned int frames = std::max(pauseStats.frames, 1u);
+            std::cout << "pause of " << seconds << " s: " << pauseStats.frames << " frames ("
+                    << pauseStats.frames / std::max(seconds, 1e-3) << " per second), "
+                    << pauseStats.frames - pauseStats.reused << " drawn and " << pauseStats.reused
+                    << " reused; cpu " << pauseStats.cpuMs / frames << " ms, gpu "
+                    << pauseStats.gpuMs / std::max(pauseStats.gpuFrames, 1u) << " ms per frame (render on demand "
+                    << (renderOnDemand ? "on" : "off") << ", " << (pausedFps > 0 ? std::to_string(pausedFps) : "no")
+                    << " fps limit)" << std::endl;
+        }
+        wasPaused = isPaused;
+
+        // latency run (Y key): the replay without the late latch, then with it
+        if (latencyRun.requested && !latencyRun.running && !isPaused) {
+            latencyRun = LatencyRun();
+            latencyRun.running = true;
+            latencyRun.lateLatchBefore = lateLatch;
+            latencyRun.replay = InputReplay(LATENCY_RUN_SECONDS, LATENCY_RUN_RATE);
+            latencyRun.replay.start(glfwGetTime());
+            lateLatch = false;
+            latency.clear();
+            calibrateGpuClock();
+            std::cout << "latency run (" << LATENCY_RUN_SECONDS << " s of mouse movements at " << LATENCY_RUN_RATE
+                    << " Hz, " << LATENCY_RUN_WORK_MS << " ms of simulation work per frame, each mode)" << std::endl;
+        }
+        if (latencyRun.running && isPaused) {
+            lateLatch = latencyRun.lateLatchBefore;
+            latencyRun.running = false;
+            std::cout << "latency run stopped by the pause" << std::endl;
+        }
+        if (latencyRun.running && latencyRun.replay.finished() &&
+            ++latencyRun.drainFrames > LATENCY_RUN_DRAIN_FRAMES) {
+            latencyRun.results[latencyRun.phase] = latency;
+            latency.clear();
+            if (latencyRun.phase == 0) {
+                latencyRun.phase = 1;
+                latencyRun.drainFrames = 0;
+                latencyRun.replay.start(glfwGetTime());
+                lateLatch = true;
+            } else {
+                for (int phase = 0; phase < 2; phase++) {
+                    LatencyTracker &result = latencyRun.results[phase];
+                    std::cout << (phase == 0 ? "  inputs at the start of the frame:" : "  late latch:") << std::endl
+                            << "    input to latch: " << result.toLatch.summary() << std::endl
+                            << "    input to swap:  " << result.toSwap.summary() << std::endl
+                            << "    input to GPU:   " << result.toGpu.summary() << std::endl
+                            << result.toGpu.bars(40);
+                }
+                std::ofstream csv("latency.csv");
+                writeLatencyCsv(csv, {"start", "late_latch"}, {&latencyRun.results[0], &latencyRun.results[1]});
+                std::cout << "latency histograms written to latency.csv" << std::endl;
+                lateLatch = latencyRun.lateLatchBefore;
+                latencyRun.running = false;
+            }
+        }
+        receiveReplay();
 
         if (keys[GLFW_KEY_O]) {
             if (!debouncelight) {
@@ -421,6 +1083,21 @@ int main() {
 
 
 
+        // the pose of the camera path at this frame: applied before the simulation, so that its shots start from
+        // it, and again after the camera follows the player body
+        CameraKey pathPose;
+        auto applyPathPose = [&]() {
+            camera.Position = pathPose.position;
+            camera.Yaw = pathPose.yaw;
+            camera.Pitch = pathPose.pitch;
+            // updates the vectors of the camera
+            camera.ProcessMouseMovement(0, 0);
+        };
+        if (renderBenchmark.active) {
+            pathPose = renderBenchmark.path.sample(renderBenchmark.frame * RENDER_BENCHMARK_STEP);
+            applyPathPose();
+        }
+
         if (!isPaused) {
             // we apply FPS camera movements
             apply_camera_movements();
@@ -428,69 +1105,335 @@ int main() {
 
             if (mousepressed) {
                 if (currentFrame - lastbullet > 0.1) {
-                    glm::vec3 bulletPos = camera.Position + camera.Front * 0.5f;
-                    auto body = bulletSimulation.createRigidBody(SPHERE, bulletPos, glm::vec3(0.13f), camera.Front, 1.0f, 0.9f, 0.0f);
-                    // give bullet front speed
-                    body->setLinearVelocity(body->getLinearVelocity() + btVector3(camera.Front.x, camera.Front.y, camera.Front.z) * 20);
-                    spheres.push_back({body});
+                    fireShot();
                     lastbullet = currentFrame;
                 }
             }
+            if (renderBenchmark.active) {
+                float pathTime = renderBenchmark.frame * RENDER_BENCHMARK_STEP;
+                for (size_t shot = renderBenchmark.path.shotsBetween(pathTime - RENDER_BENCHMARK_STEP, pathTime);
+                     shot > 0; shot--)
+                    fireShot();
+            }
 
 
             bulletSimulation.dynamicsWorld->stepSimulation(min(deltaTime, maxSecPerFrame), 10);
+            // the latency run adds some work, as under load
+            if (latencyRun.running) {
+                double workEnd = glfwGetTime() + LATENCY_RUN_WORK_MS / 1000.0;
+                while (glfwGetTime() < workEnd) {
+                }
+            }
+            simulationTime += min(deltaTime, maxSecPerFrame);
+
+            syncBulletsFromPhysics(world.bullets);
+            collideBulletsWithLevel(world, bulletSimulation, backroomBody);
+            resolveHitscanShots(world, backroomBody, hitscanShots, firing);
+            reclaimBullets(world, bulletSimulation, bulletLifecycle, simulationTime);
+
+            // the lights: they are switched on one group after the other, then they flicker at random times
+            lightFlicker.update(deltaTime, light.ambient, lightAmbient, lightDiffuse, lightSpecular);
+            ceilingFlicker = lightFlicker.ceiling;
+        }
 
-            std::vector<SphereData> newSpheres;
-            for (auto& sphere : spheres) {
-                MyContactResultCallback callback;
-                bulletSimulation.dynamicsWorld->contactPairTest(sphere.body, backroomBody, callback);
-                if (callback.collided) {
-                    auto normal = glm::vec3(callback.normal.x(), callback.normal.y(), callback.normal.z());
-                    normal = glm::normalize(normal);
-
-                    // dot normal with bullet speed so we can check if the normal is flipped
-                    auto speed = sphere.body->getLinearVelocity();
-                    auto speedVec = glm::vec3(speed.x(), speed.y(), speed.z());
-                    if (glm::dot(normal, speedVec) > 0) {
-                        normal = -normal;
-                    }
-
-                    auto initial = glm::vec3(0, 0, 1);
-                    auto angle = glm::acos(glm::dot(initial, normal));
-
-                    auto axis = glm::normalize(glm::cross(initial, normal));
-
-                    glm::mat4 rot;
-                    if (angle > 0.001 && axis.x == axis.x) {
-                        rot = glm::rotate(glm::mat4(1.0f), angle, axis);
-                    } else {
-                        rot = glm::mat4(1.0f);
-                    }
-                    auto pos = glm::vec3(callback.position.x(), callback.position.y(), callback.position.z()) +
-                        normal * -0.04f;
-                    splats.push_back(SplatData{
-                        pos,
-                        rot});
-                    bulletSimulation.dynamicsWorld->removeRigidBody(sphere.body);
-                    delete sphere.body;
-                } else {
-                    newSpheres.push_back(sphere);
+        // splat stress benchmark (G key): for each count, the same splats are drawn as meshes and then as decals,
+        // and the splat pass is timed over some frames after a warm-up. The splats of the player are removed
+        if (splatStress.requested && !splatStress.running && !resolutionRun.running) {
+            splatStress = SplatStress();
+            splatStress.running = true;
+            splatStress.decalsBefore = useDecals;
+            std::cout << "splat stress benchmark (" << STRESS_FRAMES << " frames per step)" << std::endl;
+        }
+        if (splatStress.running) {
+            size_t countIndex = splatStress.step / 2;
+            if (splatStress.frame == 0) {
+                if (splatStress.step % 2 == 0) {
+                    while (world.splats.size() > 0)
+                        world.splats.destroyRow(world.splats.size() - 1);
+                    spawnStressSplats(STRESS_SPLAT_COUNTS[countIndex], backroomBody);
+                }
+                useDecals = splatStress.step % 2 == 1;
+            } else if (splatStress.frame > STRESS_WARMUP_FRAMES) {
+                // times of the previous frame
+                splatStress.cpuMs += splatCpuMs;
+                splatStress.gpuMs += splatGpuMs;
+            }
+            if (++splatStress.frame > STRESS_WARMUP_FRAMES + STRESS_FRAMES) {
+                std::cout << "  " << world.splats.size() << " splats, " << (useDecals ? "decals" : "meshes")
+                        << ": cpu " << splatStress.cpuMs / STRESS_FRAMES << " ms, gpu "
+                        << splatStress.gpuMs / STRESS_FRAMES << " ms" << std::endl;
+                splatStress.step++;
+                splatStress.frame = 0;
+                splatStress.cpuMs = splatStress.gpuMs = 0;
+                if (splatStress.step == 2 * (sizeof(STRESS_SPLAT_COUNTS) / sizeof(STRESS_SPLAT_COUNTS[0]))) {
+                    while (world.splats.size() > 0)
+                        world.splats.destroyRow(world.splats.size() - 1);
+                    useDecals = splatStress.decalsBefore;
+                    splatStress.running = false;
                 }
             }
+        }
+
+        // frame pacing run (Z key)
+        if (pacingRun.requested && !pacingRun.running) {
+            pacingRun.requested = false;
+            pacingRun.log.open("frame_pacing.csv");
+            pacingRun.log << "frame,cpu_start_ms,submit_ms,swap_ms,frame_ms,limiter_wait_ms,fence_wait_ms" << std::endl;
+            pacingRun.running = true;
+            pacingRun.frame = 0;
+            pacingRun.start = currentFrame;
+            pacingRun.times.clear();
+            std::cout << "frame pacing run (" << PACING_RUN_FRAMES << " frames, "
+                    << swapIntervalName(pacing.swapInterval) << ", limiter "
+                    << (pacing.targetFps > 0.0 ? std::to_string(pacing.targetFps) + " fps" : "off") << ", "
+                    << pacing.maxFramesInFlight << " frames in flight)" << std::endl;
+        }
+
+        // scripted benchmark of the dynamic resolution (T key)
+        if (resolutionRun.requested && !resolutionRun.running && !splatStress.running) {
+            resolutionRun.requested = false;
+            resolutionRun.log.open("dynamic_resolution.csv");
+            resolutionRun.log << "frame,scale,gpu_ms,average_gpu_ms,cpu_frame_ms" << std::endl;
+            resolutionRun.running = true;
+            resolutionRun.frame = 0;
+            resolutionRun.decalsBefore = useDecals;
+            std::cout << "dynamic resolution benchmark (" << RESOLUTION_RUN_FRAMES << " frames)" << std::endl;
+        }
+        if (resolutionRun.running) {
+            // a full turn in each third of the run
+            camera.ProcessMouseMovement(360.0f / (RESOLUTION_RUN_FRAMES / 3) / camera.MouseSensitivity, 0.0f);
+            if (resolutionRun.frame == RESOLUTION_RUN_FRAMES / 3) {
+                useDecals = true;
+                spawnStressSplats(world.splats.size() + RESOLUTION_RUN_SPLATS, backroomBody);
+            } else if (resolutionRun.frame == 2 * RESOLUTION_RUN_FRAMES / 3) {
+                while (world.splats.size() > 0)
+                    world.splats.destroyRow(world.splats.size() - 1);
+                useDecals = resolutionRun.decalsBefore;
+            }
+        }
+
+        if (printMetrics) {
+            std::cout << "bullets: " << world.bullets.size()
+                    << " bodies: " << bulletSimulation.dynamicsWorld->getNumCollisionObjects()
+                    << " splats: " << world.splats.size()
+                    << " reclaimed: " << bulletLifecycle.reclaimed()
+                    << " (age " << bulletLifecycle.reclaimedAge
+                    << ", bounds " << bulletLifecycle.reclaimedBounds
+                    << ", sleeping " << bulletLifecycle.reclaimedSleeping
+                    << ", evicted " << bulletLifecycle.reclaimedEvicted << ")" << std::endl;
+            PhysicsAllocatorStats allocatorStats = PhysicsAllocator::instance().getStats();
+            double elapsed = glfwGetTime() - lastMetricsTime;
+            std::cout << "physics allocations: " << allocatorStats.allocations
+                    << " (" << (allocatorStats.allocations - lastAllocatorStats.allocations) / elapsed << "/s, "
+                    << allocatorStats.recycled << " recycled)"
+                    << " live: " << allocatorStats.liveBlocks << " blocks, " << allocatorStats.liveBytes / 1024 << " KB"
+                    << " pooled bodies: " << BulletBodyPool::instance().liveBodies() << std::endl;
+            std::cout << "occlusion culling " << (occlusionCulling ? "on" : "off") << ": " << visibleChunks << "/"
+                    << levelChunks.size() << " chunks, " << visibleBullets << " bullets, " << visibleSplats
+                    << " splats visible, " << cullingMs << " ms" << std::endl;
+            std::cout << "irradiance probes " << (useProbes ? "on" : "off") << ": update " << probeUpdateMs
+                    << " ms (bake " << probeBakeMs << " ms)" << std::endl;
+            std::cout << "levels of detail " << (useLods ? "on" : "off") << ": " << lodTriangles
+                    << " bullet and splat triangles submitted (" << fullTriangles << " with the full models)"
+                    << std::endl;
+            std::cout << "splats drawn as " << (useDecals ? "decals" : "meshes") << ": cpu " << splatCpuMs
+                    << " ms, gpu " << splatGpuMs << " ms" << std::endl;
+            std::cout << "dynamic resolution " << (dynamicResolution ? "on" : "off") << ": scale " << renderScale
+                    << ", gpu " << frameGpuMs << " ms per frame (average " << resolution.averageMs() << " ms)"
+                    << std::endl;
+            std::cout << "render targets: " << frameGraph.slots().size() << " textures, "
+                    << frameGraph.memoryBytes() / (1024 * 1024) << " MB ("
+                    << frameGraph.unaliasedBytes() / (1024 * 1024) << " MB without aliasing), pool "
+                    << renderTargets.allocatedBytes() / (1024 * 1024) << " MB"
+                    << std::endl;
+            std::cout << "render on demand " << (renderOnDemand ? "on" : "off") << ": " << framesReused
+                    << " frames reused, " << framesDrawn << " drawn since the last print" << std::endl;
+            framesReused = framesDrawn = 0;
+            std::cout << "frame pacing: " << swapIntervalName(pacing.swapInterval) << ", limiter "
+                    << (pacing.targetFps > 0.0 ? std::to_string(pacing.targetFps) + " fps" : "off") << ", "
+                    << pacing.maxFramesInFlight << " frames in flight (" << frameFences.waits << " waits, "
+                    << frameFences.waitedMs << " ms); frame times " << frameTimes.summary() << std::endl;
+            frameTimes.clear();
+            std::cout << "input latency, late latch " << (lateLatch ? "on" : "off") << ": to swap "
+                    << latency.toSwap.summary() << "; to the GPU end " << latency.toGpu.summary() << std::endl;
+            latency.clear();
+            calibrateGpuClock();
+            std::cout << "geometry arena: " << geometryArena.describe() << std::endl;
+            std::cout << "frame data: " << (frameData.persistent() ? "persistent mapping" : "orphaning") << ", "
+                    << frameData.stalls << " stalls (" << frameData.stallMs << " ms), " << frameData.orphans
+                    << " orphaned buffers in " << frameData.frames << " frames" << std::endl;
+            if (streamer) {
+                const StreamerStats &stats = streamer->stats;
+                std::cout << "procedural level: " << streamer->residentChunks().size() << " chunks (radius "
+                        << streamer->currentRadius() << "), " << stats.residentBytes / 1024 << " KB, "
+                        << streamer->pending() << " pending; generation "
+                        << stats.generationMs / std::max<size_t>(stats.generated, 1) << " ms per chunk, loads "
+                        << stats.loadMs << " ms in the last frame (worst " << stats.maxLoadMs << " ms), "
+                        << stats.evicted + stats.evictedForBudget << " evicted" << std::endl;
+            }
+            lastAllocatorStats = allocatorStats;
+            lastMetricsTime = glfwGetTime();
+            printMetrics = false;
+        }
 
-            spheres = newSpheres;
+        if (windowResized) {
+            projection = glm::perspective(45.0f, (float) screenWidth / (float) screenHeight, 0.1f, 10000.0f);
+            // the textures of the old size would otherwise stay in the pool until they expire
+            renderTargets.clear();
+            drawnValid = false;
+            windowResized = false;
         }
 
         auto ppos = playerBody->getCenterOfMassPosition();
         camera.Position = glm::vec3(ppos.x(), ppos.y() + 0.3, ppos.z());
+        if (renderBenchmark.active)
+            applyPathPose();
+
+        // recording of the camera path (E key)
+        if (pathRecording.requested != pathRecording.active) {
+            pathRecording.active = pathRecording.requested;
+            if (pathRecording.active) {
+                pathRecording.path.clear();
+                pathRecording.start = glfwGetTime();
+                pathRecording.lastKey = -PATH_RECORD_INTERVAL;
+                std::cout << "recording the camera path" << std::endl;
+            } else if (pathRecording.path.save("camera_path.txt")) {
+                std::cout << "camera path of " << pathRecording.path.duration() << " s ("
+                        << pathRecording.path.keys.size() << " keys, " << pathRecording.path.shots.size()
+                        << " shots) written to camera_path.txt" << std::endl;
+            }
+        }
+        if (pathRecording.active && !isPaused) {
+            double time = glfwGetTime() - pathRecording.start;
+            if (time - pathRecording.lastKey >= PATH_RECORD_INTERVAL) {
+                pathRecording.path.addKey({static_cast<float>(time), camera.Position, camera.Yaw, camera.Pitch});
+                pathRecording.lastKey = time;
+            }
+        }
+
+        // the chunks around the player, and the ceiling lights nearest to it as the lights of the shader
+        if (streamer) {
+            streamer->update(camera.Position);
+            streamer->nearestLights(camera.Position, world.lights.column<LIGHT_POSITION>());
+        }
 
         // View matrix (=camera): position, view direction, camera "up" vector
         // in this example, it has been defined as a global variable (we need it in the keyboard callback function)
         view = camera.GetViewMatrix();
+        latency.latch(glfwGetTime());
+
+        // scale of this frame, from the GPU time of the frame which used the same queries (2 frames ago)
+        unsigned int frameSlot = frameIndex % 2;
+        if (frameQueryIssued[frameSlot]) {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(frameQueries[frameSlot][0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(frameQueries[frameSlot][1], GL_QUERY_RESULT, &end);
+            frameGpuMs = (end - start) / 1e6;
+            latency.gpuDone(frameIndex - 2, end / 1e9 - gpuClockOffset);
+            if (frameQueryPaused[frameSlot] && isPaused) {
+                pauseStats.gpuMs += frameGpuMs;
+                pauseStats.gpuFrames++;
+            }
+            // the frames which only composited the last one say nothing of the time of the scene at this scale
+            if (!frameQueryReused[frameSlot])
+                renderScale = dynamicResolution ? resolution.update(static_cast<float>(frameGpuMs)) : 1.0f;
+            if (resolutionRun.running) {
+                resolutionRun.log << resolutionRun.frame << "," << renderScale << "," << frameGpuMs << ","
+                        << resolution.averageMs() << "," << deltaTime * 1000.0f << std::endl;
+                if (resolutionRun.frame % 60 == 0)
+                    std::cout << "  frame " << resolutionRun.frame << ": scale " << renderScale << ", gpu "
+                            << frameGpuMs << " ms" << std::endl;
+                if (++resolutionRun.frame == RESOLUTION_RUN_FRAMES) {
+                    resolutionRun.log.close();
+                    resolutionRun.running = false;
+                    std::cout << "dynamic resolution log written to dynamic_resolution.csv" << std::endl;
+                }
+            }
+        }
 
-        // render
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        // late latch: the mouse movements during the simulation and the wait for the queries go to this frame. The
+        // events are polled (with the cursor disabled, GLFW moves its virtual cursor only while processing them), but
+        // the callbacks other than the cursor one only keep their events for the next frame: running them here would
+        // resize, pause or fire after the parts of the frame which handle that
+        if (lateLatch && !isPaused) {
+            if (window != nullptr) {
+                deferInputEvents = true;
+                glfwPollEvents();
+                deferInputEvents = false;
+            }
+            receiveReplay();
+            view = camera.GetViewMatrix();
+            latency.latch(glfwGetTime());
+        }
+
+        glQueryCounter(frameQueries[frameSlot][0], GL_TIMESTAMP);
+        int renderWidth = scaledSize(screenWidth, renderScale), renderHeight = scaledSize(screenHeight, renderScale);
+        // part of the render targets used by the scaled passes
+        glm::vec2 uvScale(static_cast<float>(renderWidth) / screenWidth,
+                          static_cast<float>(renderHeight) / screenHeight);
+
+        // render on demand: the frame reuses the scene and the bloom of the last one drawn if nothing which decides
+        // them changed. While the game runs the bullets move, so only the frames without bullets can be reused
+        frameSignature.clear();
+        frameSignature.add(view);
+        frameSignature.add(projection);
+        frameSignature.add(screenWidth);
+        frameSignature.add(screenHeight);
+        frameSignature.add(renderScale);
+        frameSignature.add(world.lights.column<LIGHT_POSITION>());
+        frameSignature.add(lightAmbient);
+        frameSignature.add(lightDiffuse);
+        frameSignature.add(lightSpecular);
+        frameSignature.add(light.ambient);
+        frameSignature.add(ceilingFlicker);
+        frameSignature.add(debugLightId);
+        frameSignature.add(world.bullets.size());
+        frameSignature.add(world.splats.size());
+        frameSignature.add(chunkMeshes.size());
+        for (bool setting: {static_cast<bool>(wireframe), useLightmap, useProbes, useDecals, useLods, occlusionCulling})
+            frameSignature.add(setting);
+        bool reuse = renderOnDemand && drawnValid && (isPaused || world.bullets.size() == 0) &&
+                     !splatStress.running && frameSignature == drawnSignature;
+        FrameCaching caching = !renderOnDemand ? FRAME_UNCACHED : reuse ? FRAME_CACHED : FRAME_RETAINED;
+
+        // render: the passes of the frame are declared on the render graph, which gives them their targets
+        // (see util3d/frame_graph.h)
+        float lodScale = lodPixelScale(projection, static_cast<float>(renderHeight));
+        // (the metrics of a reused frame are the ones of the frame drawn)
+        if (!reuse) {
+            lodTriangles = fullTriangles = 0;
+            if (useDecals && world.splats.size() == 0)
+                visibleSplats = 0;
+        }
+
+        // time of the splats (meshes or decals). Their GPU time is read when the same query is used again,
+        // 2 frames later
+        unsigned int splatSlot = frameIndex % 2;
+        double splatStart = 0;
+        auto beginSplats = [&]() {
+            splatStart = glfwGetTime();
+            if (splatQueryIssued[splatSlot]) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(splatQueries[splatSlot], GL_QUERY_RESULT, &elapsed);
+                splatGpuMs = elapsed / 1e6;
+            }
+            glBeginQuery(GL_TIME_ELAPSED, splatQueries[splatSlot]);
+            splatQueryIssued[splatSlot] = true;
+        };
+        auto endSplats = [&]() {
+            glEndQuery(GL_TIME_ELAPSED);
+            splatCpuMs = (glfwGetTime() - splatStart) * 1000.0;
+        };
+
+        // variants of shader.frag for the dynamic objects
+        unsigned int objectLighting = useProbes ? SHADER_PRECOMPUTED : 0;
+        ShaderProgram &splatShader = objectShaders[objectLighting | (splat_model.textured() ? SHADER_TEXTURED : 0)];
+        ShaderProgram &bulletShader = objectShaders[objectLighting | (sphere_model.textured() ? SHADER_TEXTURED : 0)];
+
+        FrameTargets targets;
+        FramePasses passes;
+        passes.scene = [&](RenderPassContext &) {
+            glViewport(0, 0, renderWidth, renderHeight);
 
             // we "clear" the frame and z buffer
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -506,86 +1449,6 @@ int main() {
                 glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
             /////////////////// OBJECTS ////////////////////////////////////////////////
-            // We "install" the selected Shader Program as part of the current rendering process
-            object_shader.Use();
-
-            // vEyePos
-            glUniform3f(glGetUniformLocation(object_shader.Program, "vEyePos"), camera.Position.x, camera.Position.y,
-                        camera.Position.z);
-
-            float ceilingFlicker = 1.0;
-            if (warmingUp < 4) {
-                warmingUpDuration += deltaTime;
-                if (warmingUpDuration > 1.5) {
-                    int i;
-                    for (i = 0; i < (warmingUp == 2 ? 7 : 6); i++) {
-                        lights[warmingUpIdx + i].ambient = glm::vec3(0.05f);
-                        lights[warmingUpIdx + i].diffuse = glm::vec3(0.8f);
-                        lights[warmingUpIdx + i].specular = glm::vec3(1.0f);
-                    }
-                    warmingUpIdx += i;
-                    warmingUp++;
-                    warmingUpDuration = 0;
-                }
-            } else {
-                if (lightFlickerDuration > 0) {
-                    float delta = deltaTime;
-                    do {
-                        float gen = abs(dist(generator));
-                        float amb = lightFlickerBase - gen * 0.5f;
-                        light.ambient = glm::vec3(amb);
-                        for (int i = 0; i < 25; i++) {
-                            if (ceilingFlickerBase < 1 && flickerLight == i)
-                                continue;
-                            lights[i].ambient = glm::vec3(lightPointFlickerBase - abs(dist(generator)) * 1.5f * 0.05f);
-                            lights[i].diffuse = glm::vec3(0);
-                        }
-                        if (ceilingFlickerBase < 1) {
-                            ceilingFlicker = ceilingFlickerBase - gen * 8;
-
-                            flickerLightDuration += deltaTime;
-                            if (flickerLightDuration > 0.3) {
-                                if (dist(generator) > 0) {
-                                    flickerLight = lightdist(generator);
-                                    lights[flickerLight].ambient = glm::vec3(0.2f);
-                                }
-                                flickerLightDuration = 0;
-                            }
-                        }
-                        delta -= 0.01;
-                    } while (delta >= 0.01);
-                    lightFlickerDuration -= deltaTime;
-                } else {
-                    light.ambient = glm::vec3(0.35f);
-                    for (int i = 0; i < 25; i++) {
-                        lights[i].ambient = glm::vec3(0.05f);
-                        lights[i].diffuse = glm::vec3(0.8f);
-                    }
-                    ceilingFlickerBase = 1.0;
-                    if (lightFlicker > (1 / 60.0f)) {
-                        lightFlickerDuration = (dist(generator) - 0.20) * 7;
-                        if (lightFlickerDuration > 0) {
-                            flickerLight = lightdist(generator);
-                            if (dist(generator) > 0.1) {
-                                lightFlickerBase = 0.02f;
-                                lightFlickerDuration += 0.5;
-                                lightFlickerDuration *= 1.8;
-                                lightPointFlickerBase = 0.005f;
-                                ceilingFlickerBase = 0.35f;
-                            } else {
-                                lightFlickerBase = 0.35f;
-                                lightPointFlickerBase = 0.05f;
-                                ceilingFlickerBase = 0.7f;
-                            }
-                        }
-
-                        lightFlicker = 0;
-                    }
-                }
-            }
-            glUniform1f(glGetUniformLocation(object_shader.Program, "ceilingFlicker"), ceilingFlicker);
-
-
             // calculate vEyeDir from yaw and pitch
             glm::vec3 front;
             front.x = cos(glm::radians(camera.Yaw)) * cos(glm::radians(camera.Pitch));
@@ -598,193 +1461,372 @@ int main() {
                         << " direction:" << camera.Yaw << " " << camera.Pitch << std::endl;
             }
 
-            glUniform3f(glGetUniformLocation(object_shader.Program, "vEyeDir"), vEyeDir.x, vEyeDir.y, vEyeDir.z);
-
-            // we pass projection and view matrices to the Shader Program
-            glUniformMatrix4fv(glGetUniformLocation(object_shader.Program, "projectionMatrix"), 1, GL_FALSE,
-                               glm::value_ptr(projection));
-            glUniformMatrix4fv(glGetUniformLocation(object_shader.Program, "viewMatrix"), 1, GL_FALSE,
-                               glm::value_ptr(view));
-
-
             planeModelMatrix = glm::mat4(1.0f);
             planeNormalMatrix = glm::mat3(1.0f);
             planeModelMatrix = glm::translate(planeModelMatrix, plane_pos);
             planeModelMatrix = glm::scale(planeModelMatrix, plane_size);
             planeNormalMatrix = glm::inverseTranspose(glm::mat3(view * planeModelMatrix));
-            glUniformMatrix4fv(glGetUniformLocation(object_shader.Program, "modelMatrix"), 1, GL_FALSE,
-                               glm::value_ptr(planeModelMatrix));
-            glUniformMatrix3fv(glGetUniformLocation(object_shader.Program, "normalMatrix"), 1, GL_FALSE,
-                               glm::value_ptr(planeNormalMatrix));
-
-            glUniform3fv(glGetUniformLocation(object_shader.Program, "ambient.ambient"), 1, &light.ambient[0]);
-            glUniform3fv(glGetUniformLocation(object_shader.Program, "ambient.diffuse"), 1, &light.diffuse[0]);
-            glUniform3fv(glGetUniformLocation(object_shader.Program, "ambient.specular"), 1, &light.specular[0]);
-
-            for (int i = 0; i < 25; i++) {
-                glUniform3fv(
-                    glGetUniformLocation(object_shader.Program, ("lights[" + std::to_string(i) + "].position").c_str()),
-                    1, &lights[i].position[0]);
-                glUniform1f(glGetUniformLocation(object_shader.Program,
-                                                 ("lights[" + std::to_string(i) + "].constant").c_str()),
-                            lights[i].constant);
-                glUniform1f(glGetUniformLocation(object_shader.Program,
-                                                 ("lights[" + std::to_string(i) + "].linear").c_str()),
-                            lights[i].linear);
-                glUniform1f(glGetUniformLocation(object_shader.Program,
-                                                 ("lights[" + std::to_string(i) + "].quadratic").c_str()),
-                            lights[i].quadratic);
-                glUniform3fv(
-                    glGetUniformLocation(object_shader.Program, ("lights[" + std::to_string(i) + "].ambient").c_str()),
-                    1, &lights[i].ambient[0]);
-                glUniform3fv(
-                    glGetUniformLocation(object_shader.Program, ("lights[" + std::to_string(i) + "].diffuse").c_str()),
-                    1, &lights[i].diffuse[0]);
-                glUniform3fv(
-                    glGetUniformLocation(object_shader.Program, ("lights[" + std::to_string(i) + "].specular").c_str()),
-                    1, &lights[i].specular[0]);
-            }
 
-            glUniform1ui(glGetUniformLocation(object_shader.Program, "debugLightId"), debugLightId);
-
-            glUniform1ui(glGetUniformLocation(object_shader.Program, "backrooms"), 1);
+            // the uniforms of the frame go to each variant drawn in this frame
+            auto setFrameUniforms = [&](ShaderProgram &shader) {
+                shader.Use();
+
+                // vEyePos
+                glUniform3f(glGetUniformLocation(shader.Program, "vEyePos"), camera.Position.x, camera.Position.y,
+                            camera.Position.z);
+                glUniform1f(glGetUniformLocation(shader.Program, "ceilingFlicker"), ceilingFlicker);
+                glUniform3f(glGetUniformLocation(shader.Program, "vEyeDir"), vEyeDir.x, vEyeDir.y, vEyeDir.z);
+
+                // we pass projection and view matrices to the Shader Program
+                glUniformMatrix4fv(glGetUniformLocation(shader.Program, "projectionMatrix"), 1, GL_FALSE,
+                                   glm::value_ptr(projection));
+                glUniformMatrix4fv(glGetUniformLocation(shader.Program, "viewMatrix"), 1, GL_FALSE,
+                                   glm::value_ptr(view));
+
+                glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE,
+                                   glm::value_ptr(planeModelMatrix));
+                glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE,
+                                   glm::value_ptr(planeNormalMatrix));
+            };
+
+            // the lights, the camera and the flicker: a single block for all the variants
+            FrameLightsStd140 frameLights = packFrameLights(world.lights, light.ambient, light.diffuse,
+                                                            light.specular);
+            frameLights.eyePosition = camera.Position;
+            frameLights.ceilingFlicker = ceilingFlicker;
+            frameLights.eyeDirection = vEyeDir;
+            frameLights.debugLightId = static_cast<GLuint>(debugLightId);
+            StreamRange lightsRange = frameData.push(frameLights, uniformAlignment);
+            frameData.flush();
+            glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_LIGHTS_BINDING, frameData.buffer(), lightsRange.offset,
+                              lightsRange.size);
+
+            // the level: each mesh with the variant for its material
+            unsigned int levelLighting = useLightmap ? SHADER_PRECOMPUTED : 0;
+            auto levelShader = [&](const Mesh &mesh) -> ShaderProgram & {
+                return levelShaders[levelLighting | (mesh.textured() ? SHADER_TEXTURED : 0)];
+            };
+            setFrameUniforms(levelShaders[levelLighting]);
+            setFrameUniforms(levelShaders[levelLighting | SHADER_TEXTURED]);
+            setFrameUniforms(splatShader);
+            if (bulletShader.Program != splatShader.Program)
+                setFrameUniforms(bulletShader);
+            glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, lightmapTexture.get());
+            glActiveTexture(GL_TEXTURE0);
 
 
-            backrooms.Draw(object_shader);
+            if (occlusionCulling) {
+                double cullingStart = glfwGetTime();
+                occlusion.begin(projection * view);
+                occlusion.rasterize(occluders);
+                occlusion.buildHierarchy();
+                for (auto &counts: chunkCounts)
+                    counts.clear();
+                for (auto &offsets: chunkOffsets)
+                    offsets.clear();
+                visibleChunks = 0;
+                for (auto &chunk: levelChunks) {
+                    if (!occlusion.visible(chunk.aabbMin, chunk.aabbMax))
+                        continue;
+                    chunkCounts[chunk.mesh].push_back(static_cast<GLsizei>(chunk.count));
+                    chunkOffsets[chunk.mesh].push_back(
+                        reinterpret_cast<const void *>(chunk.firstIndex * sizeof(unsigned int)));
+                    visibleChunks++;
+                }
+                cullingMs = (glfwGetTime() - cullingStart) * 1000.0;
+                for (unsigned int m = 0; m < backrooms.meshes.size(); m++) {
+                    ShaderProgram &shader = levelShader(backrooms.meshes[m]);
+                    shader.Use();
+                    backrooms.meshes[m].DrawRanges(shader, chunkCounts[m], chunkOffsets[m]);
+                }
+            } else {
+                for (auto &mesh: backrooms.meshes) {
+                    ShaderProgram &shader = levelShader(mesh);
+                    shader.Use();
+                    mesh.Draw(shader);
+                }
+            }
+            // the chunks of the procedural level, without the ones outside the view when the culling is on
+            for (auto &entry: chunkMeshes) {
+                glm::vec3 center = chunkCenter(entry.first);
+                glm::vec3 half(PROCEDURAL_CHUNK_SIZE * 0.5f, PROCEDURAL_CEILING, PROCEDURAL_CHUNK_SIZE * 0.5f);
+                if (occlusionCulling && !occlusion.visible(center - half, center + half))
+                    continue;
+                for (auto &mesh: entry.second) {
+                    ShaderProgram &shader = levelShader(mesh);
+                    shader.Use();
+                    mesh.Draw(shader);
+                }
+            }
 
-            glUniform1ui(glGetUniformLocation(object_shader.Program, "backrooms"), 0);
+            // the probes are updated with the current light intensities only if there is something to light
+            // (and if the intensities changed)
+            // (the decals always use them)
+            if ((useProbes && world.bullets.size() > 0) || ((useProbes || useDecals) && world.splats.size() > 0)) {
+                double updateStart = glfwGetTime();
+                bool changed = probes.combine(lightAmbient, lightDiffuse, lightSpecular);
+                glActiveTexture(GL_TEXTURE0 + PROBE_IRRADIANCE_TEXTURE_UNIT);
+                glBindTexture(GL_TEXTURE_3D, probeTextures[0].get());
+                if (changed)
+                    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, probes.dims.x, probes.dims.y, probes.dims.z, GL_RGBA,
+                                    GL_FLOAT, probes.irradiance.data());
+                glActiveTexture(GL_TEXTURE0 + PROBE_SPECULAR_TEXTURE_UNIT);
+                glBindTexture(GL_TEXTURE_3D, probeTextures[1].get());
+                if (changed)
+                    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, probes.dims.x, probes.dims.y, probes.dims.z, GL_RED,
+                                    GL_FLOAT, probes.specular.data());
+                glActiveTexture(GL_TEXTURE0);
+                probeUpdateMs = (glfwGetTime() - updateStart) * 1000.0;
+            }
 
-            for (auto& sphere : spheres) {
-                auto modelMatrix = glm::mat4(1.0f);
-                auto normalMatrix = glm::mat3(1.0f);
-                auto pos = sphere.body->getCenterOfMassPosition();
-                auto shape = (btSphereShape*)sphere.body->getCollisionShape();
-                modelMatrix = glm::translate(modelMatrix, glm::vec3(pos.x(), pos.y(), pos.z()));
-                modelMatrix = glm::scale(modelMatrix, glm::vec3(0.05f));
-                normalMatrix = glm::inverseTranspose(glm::mat3(view * modelMatrix));
-                glUniformMatrix4fv(glGetUniformLocation(object_shader.Program, "modelMatrix"), 1, GL_FALSE,
-                                   glm::value_ptr(modelMatrix));
-                glUniformMatrix3fv(glGetUniformLocation(object_shader.Program, "normalMatrix"), 1, GL_FALSE,
-                                   glm::value_ptr(normalMatrix));
-                sphere_model.Draw(object_shader);
+            // splats drawn as meshes (the decals are projected on the level in their own passes, before the bullets)
+            if (!useDecals) {
+                beginSplats();
+                splatShader.Use();
+                const auto &splatPosition = world.splats.column<SPLAT_POSITION>();
+                const auto &splatModel = world.splats.column<SPLAT_MODEL>();
+                const auto &splatLod = world.splats.column<SPLAT_LOD>();
+                selectLods(splatPosition, SPLAT_BOUNDING_RADIUS, camera.Position, lodScale, SPLAT_LODS, useLods,
+                           world.splats.column<SPLAT_LOD>());
+                visibleSplats = 0;
+                for (size_t i = 0; i < splatModel.size(); i++) {
+                    if (occlusionCulling && !occlusion.visibleSphere(splatPosition[i], SPLAT_BOUNDING_RADIUS))
+                        continue;
+                    visibleSplats++;
+                    auto &modelMatrix = splatModel[i];
+                    auto normalMatrix = glm::inverseTranspose(glm::mat3(view * modelMatrix));
+                    glUniformMatrix4fv(glGetUniformLocation(splatShader.Program, "modelMatrix"), 1, GL_FALSE,
+                                       glm::value_ptr(modelMatrix));
+                    glUniformMatrix3fv(glGetUniformLocation(splatShader.Program, "normalMatrix"), 1, GL_FALSE,
+                                       glm::value_ptr(normalMatrix));
+
+                    splat_model.DrawLod(splatShader, splatLod[i]);
+                    lodTriangles += splat_model.triangleCount(splatLod[i]);
+                    fullTriangles += splat_model.triangleCount(0);
+                }
+                endSplats();
             }
+        };
 
-            for (auto& splat : splats) {
-                auto modelMatrix = glm::mat4(1.0f);
-                auto normalMatrix = glm::mat3(1.0f);
-                modelMatrix = glm::translate(modelMatrix, splat.pos);
-                modelMatrix = glm::scale(modelMatrix, glm::vec3(0.002));
-                modelMatrix = modelMatrix * splat.rot;
-                normalMatrix = glm::inverseTranspose(glm::mat3(view * modelMatrix));
-                glUniformMatrix4fv(glGetUniformLocation(object_shader.Program, "modelMatrix"), 1, GL_FALSE,
+        passes.depthCopy = [&](RenderPassContext &context) {
+            beginSplats();
+            splatDecals.sync(world.splats);
+            GLuint source = context.framebuffer({targets.depth});
+            GLuint destination = context.framebuffer({targets.depthCopy});
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination);
+            glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_DEPTH_BUFFER_BIT,
+                              GL_NEAREST);
+        };
+
+        passes.decals = [&](RenderPassContext &context) {
+            decal_shader.Use();
+            glm::mat4 invViewProjection = glm::inverse(projection * view);
+            glUniformMatrix4fv(glGetUniformLocation(decal_shader.Program, "projectionMatrix"), 1, GL_FALSE,
+                               glm::value_ptr(projection));
+            glUniformMatrix4fv(glGetUniformLocation(decal_shader.Program, "viewMatrix"), 1, GL_FALSE,
+                               glm::value_ptr(view));
+            glUniformMatrix4fv(glGetUniformLocation(decal_shader.Program, "invViewProjection"), 1, GL_FALSE,
+                               glm::value_ptr(invViewProjection));
+            // size of the targets for the depth texture, and of the scaled viewport for the clip space
+            glUniform2f(glGetUniformLocation(decal_shader.Program, "targetSize"), screenWidth, screenHeight);
+            glUniform2f(glGetUniformLocation(decal_shader.Program, "renderSize"), renderWidth, renderHeight);
+            glActiveTexture(GL_TEXTURE0 + DECAL_DEPTH_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, context.texture(targets.depthCopy));
+            glActiveTexture(GL_TEXTURE0);
+            // only the front faces, depth tested (but not written) against the level
+            glDepthMask(GL_FALSE);
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_BACK);
+            splatDecals.draw();
+            glDisable(GL_CULL_FACE);
+            glDepthMask(GL_TRUE);
+            visibleSplats = world.splats.size();
+            endSplats();
+        };
+
+        passes.bullets = [&](RenderPassContext &) {
+            bulletShader.Use();
+            extractBulletMatrices(world.bullets, world.bulletModelMatrices);
+            const auto &bulletPosition = world.bullets.column<BULLET_POSITION>();
+            const auto &bulletLod = world.bullets.column<BULLET_LOD>();
+            selectLods(bulletPosition, BULLET_RENDER_RADIUS, camera.Position, lodScale, BULLET_LODS, useLods,
+                       world.bullets.column<BULLET_LOD>());
+            visibleBullets = 0;
+            for (size_t i = 0; i < world.bulletModelMatrices.size(); i++) {
+                if (occlusionCulling && !occlusion.visibleSphere(bulletPosition[i], BULLET_RADIUS))
+                    continue;
+                visibleBullets++;
+                auto &modelMatrix = world.bulletModelMatrices[i];
+                auto normalMatrix = glm::inverseTranspose(glm::mat3(view * modelMatrix));
+                glUniformMatrix4fv(glGetUniformLocation(bulletShader.Program, "modelMatrix"), 1, GL_FALSE,
                                    glm::value_ptr(modelMatrix));
-                glUniformMatrix3fv(glGetUniformLocation(object_shader.Program, "normalMatrix"), 1, GL_FALSE,
+                glUniformMatrix3fv(glGetUniformLocation(bulletShader.Program, "normalMatrix"), 1, GL_FALSE,
                                    glm::value_ptr(normalMatrix));
-
-                splat_model.Draw(object_shader);
+                sphere_model.DrawLod(bulletShader, bulletLod[i]);
+                lodTriangles += sphere_model.triangleCount(bulletLod[i]);
+                fullTriangles += sphere_model.triangleCount(0);
             }
-        }
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        bool horizontal = true, first_iteration = true;
+        };
 
         // blur bloom
-        {
-            unsigned int amount = 10;
+        const unsigned int amount = 10;
+        passes.bloomFirst = [&](RenderPassContext &context) {
+            blur_shader.Use();
+            glUniform2fv(glGetUniformLocation(blur_shader.Program, "uvScale"), 1, glm::value_ptr(uvScale));
+            glUniform1i(glGetUniformLocation(blur_shader.Program, "horizontal"), true);
+            glBindTexture(GL_TEXTURE_2D, context.texture(targets.bright));
+            renderQuad();
+        };
+        passes.bloom = [&](RenderPassContext &context) {
             blur_shader.Use();
-            for (unsigned int i = 0; i < amount; i++) {
-                glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+            // the other iterations, each one reading the target written by the previous one
+            bool horizontal = false;
+            for (unsigned int i = 1; i < amount; i++) {
+                GLuint framebuffer = context.framebuffer({targets.blur[horizontal]});
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
                 glUniform1i(glGetUniformLocation(blur_shader.Program, "horizontal"), horizontal);
-                glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
-                // bind texture of other framebuffer (or scene if first iteration)
+                glBindTexture(GL_TEXTURE_2D, context.texture(targets.blur[!horizontal]));
                 renderQuad();
                 horizontal = !horizontal;
-                if (first_iteration)
-                    first_iteration = false;
             }
-        }
+        };
 
-        // draw finalized framebuffer
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[2]);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            bloom_shader.Use();
+        // draw finalized framebuffer: bloom, tone mapping, upscale to the size of the window, crosshair and VHS
+        // effect, all in one pass (see composite.frag)
+        passes.composite = [&](RenderPassContext &context) {
+            glViewport(0, 0, screenWidth, screenHeight);
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_BLEND);
+            composite_shader.Use();
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-            glUniform1i(glGetUniformLocation(bloom_shader.Program, "scene"), 0);
-
+            glBindTexture(GL_TEXTURE_2D, context.texture(targets.scene));
             glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-            glUniform1i(glGetUniformLocation(bloom_shader.Program, "bloomBlur"), 1);
-
-            glUniform1i(glGetUniformLocation(bloom_shader.Program, "bloom"), bloom);
-            glUniform1f(glGetUniformLocation(bloom_shader.Program, "exposure"), exposure);
-            renderQuad();
-        }
-
-        // draw crosshair
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongColorbuffers[2]);
-            glDisable(GL_DEPTH_TEST);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            tex_shader.Use();
+            glBindTexture(GL_TEXTURE_2D, context.texture(targets.blur[0]));
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, crosshair.get());
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, pauseTex.get());
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_2D, noiseTex.get());
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, crosshair);
-            glUniform1i(glGetUniformLocation(tex_shader.Program, "tex"), 0);
 
-            renderQuad();
-        }
+            glUniform1i(glGetUniformLocation(composite_shader.Program, "bloom"), bloom);
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "exposure"), exposure);
+            glUniform2fv(glGetUniformLocation(composite_shader.Program, "uvScale"), 1, glm::value_ptr(uvScale));
+            // sharper as the scale decreases
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "sharpness"), 0.5f * (1.0f - renderScale));
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "iTime"), currentFrame);
 
-        /*// draw pause background
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongColorbuffers[2]);
-            tex_shader.Use();
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, pauseTex);
-            glUniform1i(glGetUniformLocation(tex_shader.Program, "tex"), 0);
+            auto& settings = isPaused ? paused : inGame;
+
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "vertJerkOpt"), settings.vertJerkOpt);
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "vertMovementOpt"), settings.vertMovementOpt);
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "bottomStaticOpt"), settings.bottomStaticOpt);
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "scalinesOpt"), settings.scalinesOpt);
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "rgbOffsetOpt"), settings.rgbOffsetOpt);
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "horzFuzzOpt"), settings.horzFuzzOpt);
+            glUniform1f(glGetUniformLocation(composite_shader.Program, "desaturate"), settings.desaturate);
 
             renderQuad();
-        }*/
+        };
 
-        // draw pause
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            glDisable(GL_BLEND);
-            pause_shader.Use();
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[2]);
-            glUniform1i(glGetUniformLocation(pause_shader.Program, "iChannel0"), 0);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, pauseTex);
-            glUniform1i(glGetUniformLocation(pause_shader.Program, "iChannel1"), 1);
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "iTime"), currentFrame);
+        targets = declareFrameGraph(frameGraph, screenWidth, screenHeight, useDecals && world.splats.size() > 0,
+                                    passes, caching);
+        bool compiled = frameGraph.compile();
+        if (compiled && renderBenchmark.active)
+            executeRenderGraph(frameGraph, renderTargets, [&](const std::string &pass) { passTimer.mark(pass); });
+        else if (compiled)
+            executeRenderGraph(frameGraph, renderTargets);
+        else
+            std::cout << "render graph: " << frameGraph.error() << std::endl;
+        // the retained targets now hold this frame
+        if (caching == FRAME_RETAINED && compiled) {
+            std::swap(drawnSignature, frameSignature);
+            drawnValid = true;
+        } else if (caching == FRAME_UNCACHED || !compiled) {
+            drawnValid = false;
+        }
 
-            auto& settings = isPaused ? paused : inGame;
+        glQueryCounter(frameQueries[frameSlot][1], GL_TIMESTAMP);
+        frameQueryIssued[frameSlot] = true;
+        frameFences.endFrame(pacing.maxFramesInFlight);
+        double submitTime = glfwGetTime();
+        frameQueryPaused[frameSlot] = isPaused;
+        frameQueryReused[frameSlot] = reuse;
+        if (reuse)
+            framesReused++;
+        else
+            framesDrawn++;
+        if (isPaused) {
+            pauseStats.frames++;
+            if (reuse)
+                pauseStats.reused++;
+            pauseStats.cpuMs += (glfwGetTime() - frameCpuStart) * 1000.0;
+        }
 
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "vertJerkOpt"), settings.vertJerkOpt);
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "vertMovementOpt"), settings.vertMovementOpt);
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "bottomStaticOpt"), settings.bottomStaticOpt);
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "scalinesOpt"), settings.scalinesOpt);
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "rgbOffsetOpt"), settings.rgbOffsetOpt);
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "horzFuzzOpt"), settings.horzFuzzOpt);
-            glUniform1f(glGetUniformLocation(pause_shader.Program, "desaturate"), settings.desaturate);
+        // the region of this frame can be written again when the GPU is past this point
+        frameData.endFrame();
 
-            renderQuad();
+        // Faccio lo swap tra back e front buffer
+        if (window != nullptr)
+            glfwSwapBuffers(window);
+        double swapTime = glfwGetTime();
+        latency.endFrame(frameIndex, swapTime, true);
+        if (pacingRun.running) {
+            pacingRun.log << pacingRun.frame << "," << (currentFrame - pacingRun.start) * 1000.0 << ","
+                    << (submitTime - pacingRun.start) * 1000.0 << "," << (swapTime - pacingRun.start) * 1000.0 << ","
+                    << frameSeconds * 1000.0 << "," << limiterMs << "," << fenceMs << std::endl;
+            pacingRun.times.add(frameSeconds * 1000.0);
+            if (++pacingRun.frame == PACING_RUN_FRAMES) {
+                pacingRun.log.close();
+                pacingRun.running = false;
+                std::cout << "  frame times: " << pacingRun.times.summary() << std::endl;
+                std::cout << "frame pacing log written to frame_pacing.csv" << std::endl;
+            }
+        }
+        if (renderBenchmark.active) {
+            passTimer.endFrame();
+            if (renderBenchmark.dumpEvery > 0 && renderBenchmark.frame % renderBenchmark.dumpEvery == 0) {
+                char name[64];
+                std::snprintf(name, sizeof(name), "render_benchmark/frame_%05u.ppm", renderBenchmark.frame);
+                offscreenFramebuffer.writePpm(name);
+            }
+            for (; !passTimer.ready.empty(); passTimer.ready.pop_front())
+                renderBenchmarkLog->add(passTimer.ready.front());
+            renderBenchmark.frame++;
         }
+        frameIndex++;
+    }
 
-        // Faccio lo swap tra back e front buffer
-        glfwSwapBuffers(window);
+    if (renderBenchmark.active) {
+        passTimer.finish();
+        for (; !passTimer.ready.empty(); passTimer.ready.pop_front())
+            renderBenchmarkLog->add(passTimer.ready.front());
+        std::cout << "render benchmark:" << std::endl;
+        renderBenchmarkLog->summary(std::cout);
+        std::cout << "pass timings written to render_benchmark.csv";
+        if (renderBenchmark.dumpEvery > 0)
+            std::cout << ", frames to render_benchmark/";
+        std::cout << std::endl;
     }
 
     // when I exit from the graphics loop, it is because the application is closing
+    // the chunks are unloaded first: their shapes are children of the level shape, which is still in the dynamics
+    // world, and their meshes need the context
+    if (streamer) {
+        streamer->clear();
+        streamer.reset();
+    }
     // we delete the Shader Programs
-    object_shader.Delete();
-
-    // we close and delete the created context
-    glfwTerminate();
+    levelShaders.Delete();
+    objectShaders.Delete();
+    blur_shader.Delete();
+    composite_shader.Delete();
+    decal_shader.Delete();
+    // the models, the textures and the render targets are deleted by their destructors, then the context by
+    // contextGuard
     return 0;
 }
 
@@ -845,6 +1887,10 @@ void apply_camera_movements() {
 //////////////////////////////////////////
 // callback for keyboard events
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode) {
+    if (deferInputEvents) {
+        deferredEvents.push_back([=]() { key_callback(window, key, scancode, action, mode); });
+        return;
+    }
     // we keep trace of the pressed keys
     // with this method, we can manage 2 keys pressed at the same time:
     // many I/O managers often consider only 1 key pressed at the time (the first pressed, until it is released)
@@ -882,6 +1928,79 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     if (key == GLFW_KEY_C && action == GLFW_PRESS)
         showBlurBuffer = !showBlurBuffer;
 
+    if (key == GLFW_KEY_I && action == GLFW_PRESS)
+        printMetrics = true;
+
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+        occlusionCulling = !occlusionCulling;
+        std::cout << "occlusion culling: " << (occlusionCulling ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_J && action == GLFW_PRESS && lightmapAvailable) {
+        useLightmap = !useLightmap;
+        std::cout << "lighting: " << (useLightmap ? "baked" : "forward") << std::endl;
+    }
+
+    if (key == GLFW_KEY_P && action == GLFW_PRESS && !proceduralWorld) {
+        useProbes = !useProbes;
+        std::cout << "dynamic objects lit by: " << (useProbes ? "irradiance probes" : "all the lights") << std::endl;
+    }
+
+    if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+        useLods = !useLods;
+        std::cout << "levels of detail: " << (useLods ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_V && action == GLFW_PRESS && !splatStress.running && !proceduralWorld) {
+        useDecals = !useDecals;
+        std::cout << "splats: " << (useDecals ? "decals" : "meshes") << std::endl;
+    }
+
+    if (key == GLFW_KEY_G && action == GLFW_PRESS)
+        splatStress.requested = !splatStress.running && !resolutionRun.running;
+
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        dynamicResolution = !dynamicResolution;
+        resolution.reset();
+        std::cout << "dynamic resolution: " << (dynamicResolution ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+        resolutionRun.requested = !resolutionRun.running;
+
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        // immediate, vsync, adaptive vsync (if supported), then immediate again
+        pacing.swapInterval = pacing.swapInterval == SWAP_IMMEDIATE ? SWAP_VSYNC
+                              : pacing.swapInterval == SWAP_VSYNC && adaptiveSwapSupported ? SWAP_ADAPTIVE
+                              : SWAP_IMMEDIATE;
+        applySwapInterval();
+    }
+
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+        pacingRun.requested = !pacingRun.running;
+
+    // recording of the camera path for the render benchmark
+    if (key == GLFW_KEY_E && action == GLFW_PRESS)
+        pathRecording.requested = !pathRecording.active;
+
+    if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+        lateLatch = !lateLatch;
+        std::cout << "late latch: " << (lateLatch ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_Y && action == GLFW_PRESS)
+        latencyRun.requested = !latencyRun.running;
+
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        renderOnDemand = !renderOnDemand;
+        std::cout << "render on demand: " << (renderOnDemand ? "on" : "off") << std::endl;
+    }
+
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        firing.mode = firing.mode == FIRE_HITSCAN ? FIRE_PROJECTILE : FIRE_HITSCAN;
+        std::cout << "firing mode: " << (firing.mode == FIRE_HITSCAN ? "hitscan" : "projectile") << std::endl;
+    }
+
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
         playerBody->activate();
 
@@ -919,12 +2038,106 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
     lastY = ypos;
     if (isPaused)
         return;
+    // (the mouse movements of the latency run are the scripted ones)
+    if (!latencyRun.running)
+        latency.input(glfwGetTime());
 
     // we pass the offset to the Camera class instance in order to update the rendering
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
+//////////////////////////////////////////
+// the swap interval of the pacing settings (vsync if adaptive vsync is not supported)
+void applySwapInterval() {
+    if (pacing.swapInterval == SWAP_ADAPTIVE && !adaptiveSwapSupported) {
+        std::cout << "adaptive vsync is not supported" << std::endl;
+        pacing.swapInterval = SWAP_VSYNC;
+    }
+    glfwSwapInterval(pacing.swapInterval);
+    std::cout << "swap interval " << pacing.swapInterval << " (" << swapIntervalName(pacing.swapInterval) << ")"
+            << std::endl;
+}
+
+//////////////////////////////////////////
+// leak check of the owners of OpenGL objects (see util3d/gl_handles.h): the models (with their levels of detail and
+// textures, and moved), the decals of some splats (also after destroying some), the geometry arena (compacted) and
+// the render targets are created in a scope, and released at its end. The names counted by the handles must go back
+// to the count before, and no name of any kind must be left in the context (found with glIs*, so also the names not
+// owned by the handles, as the textures and the framebuffers of the render target pool)
+bool checkGLLeaks() {
+    GLNames before = glNamesAlive();
+    int liveBefore = liveGLObjects();
+    int liveLoaded = 0;
+    {
+        MeshArena arena(1 << 16, 1 << 18);
+        Model level(arena, "backrooms_map/backrooms.obj");
+        Model sphere(arena, "models/sphere.obj");
+        Model splat(arena, "models/newscene.obj");
+        sphere.generateLods(BULLET_LODS.ratios);
+        splat.generateLods(SPLAT_LODS.ratios);
+        sphere.releaseCpuData();
+        Model moved(std::move(splat));
+        moved.releaseCpuData();
+        {
+            // its blocks are freed in the arena, which is then compacted into new buffers
+            Model released(arena, "models/sphere.obj");
+        }
+        arena.compact();
+
+        DecalBuffer decals;
+        decals.init();
+        SplatArchetype splats;
+        for (int i = 0; i < 200; i++)
+            spawnSplat(splats, glm::vec3(i * 0.1f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                       glm::vec3(0.0f, -1.0f, 0.0f));
+        decals.sync(splats);
+        for (int i = 0; i < 50; i++)
+            splats.destroyRow(0);
+        decals.sync(splats);
+
+        RenderTargetPool pool;
+        for (int frame = 0; frame < 2; frame++) {
+            pool.beginFrame();
+            GLuint color = pool.acquire({TARGET_RGBA16F, 64 << frame, 64});
+            GLuint depth = pool.acquire({TARGET_DEPTH24, 64 << frame, 64});
+            pool.framebuffer({color}, depth);
+            pool.endFrame();
+        }
+        GLTexture crosshair(TextureFromFile("crosshair.png", "textures"));
+        liveLoaded = liveGLObjects();
+    }
+    GLNames leaked = glNamesAdded(before, glNamesAlive());
+    int live = liveGLObjects() - liveBefore;
+    std::cout << "leak check: " << liveLoaded - liveBefore << " OpenGL objects owned by the handles while loaded, "
+            << live << " left (" << GLBuffer::live() << " buffers, " << GLVertexArray::live() << " vertex arrays, "
+            << GLTexture::live() << " textures); names left in the context: " << leaked.buffers.size()
+            << " buffers, " << leaked.vertexArrays.size() << " vertex arrays, " << leaked.textures.size()
+            << " textures, " << leaked.framebuffers.size() << " framebuffers" << std::endl;
+    bool passed = liveLoaded > liveBefore && live == 0 && leaked.count() == 0;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": no OpenGL object leaked" << std::endl;
+    return passed;
+}
+
+//////////////////////////////////////////
+// callback for the resize of the window
+void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
+    if (deferInputEvents) {
+        deferredEvents.push_back([=]() { framebuffer_size_callback(window, width, height); });
+        return;
+    }
+    // minimized window
+    if (width == 0 || height == 0)
+        return;
+    screenWidth = width;
+    screenHeight = height;
+    windowResized = true;
+}
+
 void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    if (deferInputEvents) {
+        deferredEvents.push_back([=]() { mouse_button_callback(window, button, action, mods); });
+        return;
+    }
     if (isPaused)
         return;
 
@@ -938,4 +2151,24 @@ void mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
         mousepressed = false;
     }
-}
\ No newline at end of file
+}
+
+void spawnStressSplats(size_t count, btCollisionObject *level) {
+    // same seed at each run, so that meshes and decals are compared on the same splats
+    std::default_random_engine generator(12345);
+    const auto &lightPosition = world.lights.column<LIGHT_POSITION>();
+    std::uniform_int_distribution<size_t> room(0, lightPosition.size() - 1);
+    std::uniform_real_distribution<float> yaw(0.0f, 2.0f * glm::pi<float>()), height(-1.0f, 1.0f);
+    std::vector<HitscanShot> shots;
+    // the shots which miss the level (e.g., through the openings) are tried again a few times
+    for (int attempt = 0; attempt < 8 && world.splats.size() < count; attempt++) {
+        for (size_t i = world.splats.size(); i < count; i++) {
+            // from the middle of a room, in a uniformly distributed direction
+            glm::vec3 origin = lightPosition[room(generator)];
+            origin.y = 0.5f;
+            float angle = yaw(generator), y = height(generator), r = std::sqrt(1.0f - y * y);
+            shots.push_back({origin, glm::vec3(r * std::cos(angle), y, r * std::sin(angle))});
+        }
+        resolveHitscanShots(world, level, shots, firing);
+    }
+}